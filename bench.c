@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include "cJSON.h"
+#include "cJSON_Utils.h"
+
+#define KEYS 10000
+#define ROUNDS 100
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 旧版 cJSON_Compare 的做法：每个键都在另一个对象里线性查找，两个方向各做一遍 */
+static int compare_quadratic(const cJSON *a, const cJSON *b) {
+    const cJSON *element;
+    cJSON_ArrayForEach(element, a) {
+        if (!cJSON_Compare(element, cJSON_GetObjectItemCaseSensitive(b, element->string), 1)) return 0;
+    }
+    cJSON_ArrayForEach(element, b) {
+        if (!cJSON_Compare(element, cJSON_GetObjectItemCaseSensitive(a, element->string), 1)) return 0;
+    }
+    return 1;
+}
+
+/* 旧版 cJSONUtils_SortObject 的做法：在链表上递归归并排序，每次比较都要读键 */
+static cJSON *sort_list(cJSON *list) {
+    cJSON *slow = list, *fast = list, *second, *result = NULL, *tail = NULL;
+    if (list == NULL || list->next == NULL) return list;
+    while (fast->next != NULL && fast->next->next != NULL) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    second = slow->next;
+    slow->next = NULL;
+    second->prev = NULL;
+    list = sort_list(list);
+    second = sort_list(second);
+    while (list != NULL || second != NULL) {
+        cJSON *smaller;
+        if (second == NULL || (list != NULL && strcmp(list->string, second->string) <= 0)) {
+            smaller = list;
+            list = list->next;
+        } else {
+            smaller = second;
+            second = second->next;
+        }
+        smaller->prev = tail;
+        if (tail == NULL) result = smaller; else tail->next = smaller;
+        tail = smaller;
+    }
+    return result;
+}
+
+/* 成员相同但顺序打乱的两个对象，值不缓存哈希，比较时要逐个匹配键 */
+static cJSON *create_object(unsigned seed) {
+    cJSON *object = cJSON_CreateObject();
+    int order[KEYS];
+    char key[32];
+    int i;
+
+    for (i = 0; i < KEYS; i++) order[i] = i;
+    srand(seed);
+    for (i = KEYS - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "key_%d", order[i]);
+        cJSON_AddNumberToObject(object, key, order[i]);
+    }
+    return object;
+}
+
+int main(void) {
+    cJSON *a = create_object(1);
+    cJSON *b = create_object(2);
+    double start;
+    int i, equal = 0;
+
+    printf("objects with %d keys, member order differs\n", KEYS);
+    start = now();
+    equal = compare_quadratic(a, b);
+    printf("%-32s %10.3f ms (equal: %d)\n", "quadratic compare:", (now() - start) * 1e3, equal);
+
+    start = now();
+    for (i = 0; i < ROUNDS; i++) equal = cJSON_Compare(a, b, 1);
+    printf("%-32s %10.3f ms (equal: %d)\n", "cJSON_Compare:", (now() - start) * 1e3 / ROUNDS, equal);
+
+    start = now();
+    for (i = 0; i < ROUNDS; i++) equal = cJSON_Compare(a, b, 0);
+    printf("%-32s %10.3f ms (equal: %d)\n", "cJSON_Compare case insensitive:", (now() - start) * 1e3 / ROUNDS, equal);
+
+    /* 大小不同时不用看成员 */
+    cJSON_DeleteItemFromObjectCaseSensitive(b, "key_0");
+    start = now();
+    for (i = 0; i < ROUNDS; i++) equal = cJSON_Compare(a, b, 1);
+    printf("%-32s %10.3f ms (equal: %d)\n", "cJSON_Compare, one key missing:", (now() - start) * 1e3 / ROUNDS, equal);
+
+    /* 每轮排序一份新的乱序副本，复制不计时 */
+    {
+        double list_time = 0, sort_time = 0, insensitive_time = 0;
+        for (i = 0; i < ROUNDS; i++) {
+            cJSON *copy = cJSON_Duplicate(a, 1);
+            start = now();
+            copy->child = sort_list(copy->child);
+            list_time += now() - start;
+            cJSON_Delete(copy);
+
+            copy = cJSON_Duplicate(a, 1);
+            start = now();
+            cJSONUtils_SortObjectCaseSensitive(copy);
+            sort_time += now() - start;
+            cJSON_Delete(copy);
+
+            copy = cJSON_Duplicate(a, 1);
+            start = now();
+            cJSONUtils_SortObject(copy);
+            insensitive_time += now() - start;
+            cJSON_Delete(copy);
+        }
+        printf("%-32s %10.3f ms\n", "linked list merge sort:", list_time * 1e3 / ROUNDS);
+        printf("%-32s %10.3f ms\n", "cJSONUtils_SortObject (cs):", sort_time * 1e3 / ROUNDS);
+        printf("%-32s %10.3f ms\n", "cJSONUtils_SortObject:", insensitive_time * 1e3 / ROUNDS);
+    }
+
+    cJSON_Delete(a);
+    cJSON_Delete(b);
+    return 0;
+}
@@ -43,6 +43,12 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <ctype.h>
+#include <errno.h>
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 #ifdef ENABLE_LOCALES
 #include <locale.h>
@@ -56,6 +62,7 @@
 #endif
 
 #include "cJSON.h"
+#include "cJSON_Pool.h"
 
 /* define our own boolean type */
 #ifdef true
@@ -68,11 +75,24 @@
 #endif
 #define false ((cJSON_bool)0)
 
+/* the error position is kept per thread, so that documents can be parsed concurrently */
+#if defined(CJSON_NO_THREADS)
+#define CJSON_THREAD_LOCAL
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#define CJSON_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define CJSON_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define CJSON_THREAD_LOCAL __declspec(thread)
+#else
+#define CJSON_THREAD_LOCAL
+#endif
+
 typedef struct {
     const unsigned char *json;
     size_t position;
 } error;
-static error global_error = { NULL, 0 };
+static CJSON_THREAD_LOCAL error global_error = { NULL, 0 };
 
 CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void)
 {
@@ -220,17 +240,114 @@ static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
     return node;
 }
 
-/* Delete a cJSON structure. */
+/* Explicit stacks let deeply nested documents be walked without recursion. They start in a small array on the C stack
+ * and move to the heap when they outgrow it, initial is that array. */
+static cJSON_bool grow_stack(void ** const stack, size_t * const size, const size_t element_size, const void * const initial)
+{
+    void *grown = global_hooks.allocate(2 * (*size) * element_size);
+    if (grown == NULL)
+    {
+        return false;
+    }
+    memcpy(grown, *stack, (*size) * element_size);
+    if (*stack != initial)
+    {
+        global_hooks.deallocate(*stack);
+    }
+    *stack = grown;
+    *size *= 2;
+
+    return true;
+}
+
+static void free_stack(void * const stack, const void * const initial)
+{
+    if (stack != initial)
+    {
+        global_hooks.deallocate(stack);
+    }
+}
+
+static cJSON_WatchHook watch_hook = NULL;
+
+CJSON_PUBLIC(void) cJSON_SetWatchHook(cJSON_WatchHook hook)
+{
+    watch_hook = hook;
+}
+
+/* Forget the cached hash (and cached text) of item and its parents. Parents of an item without a cached hash don't have one either,
+ * and only items with a cached hash are marked cJSON_PrintCached. Watched items among item and its parents are told about the change. */
+static void invalidate_hash(cJSON *item)
+{
+    cJSON *changed = item;
+
+    for (; (item != NULL) && (item->hash != 0); item = item->parent)
+    {
+        item->hash = 0;
+        item->type &= ~cJSON_PrintCached;
+    }
+
+    if (watch_hook != NULL)
+    {
+        for (; changed != NULL; changed = changed->parent)
+        {
+            if (changed->type & cJSON_Watched)
+            {
+                watch_hook(changed, false);
+            }
+        }
+    }
+}
+
+/* One item sharing the children of owner is gone. Owners that are no longer part of a document (see cJSON_Delete) are deleted
+ * with the last one. */
+static void release_shared(cJSON * const owner)
+{
+    owner->references--;
+    if ((owner->references == 0) && (owner->parent == NULL))
+    {
+        cJSON_Delete(owner);
+    }
+}
+
+/* Delete a cJSON structure. Works through one list without recursion: the first child of an item is taken off its list and
+ * moved in front of it, so every item is freed after its children (the root of a cJSON_DuplicateBlock copy holds the memory
+ * of the others) and no list is walked twice. */
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
 {
     cJSON *next = NULL;
+    cJSON *owner = NULL;
     while (item != NULL)
     {
+        if (!(item->type & cJSON_IsReference) && (item->child != NULL) && (item->references == 0))
+        {
+            next = item->child;
+            item->child = next->next;
+            next->next = item;
+            item = next;
+            continue;
+        }
+
         next = item->next;
-        if (!(item->type & cJSON_IsReference) && (item->child != NULL))
+        if (item->references > 0)
+        {
+            /* other document versions still share the children, only unlink it */
+            if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
+            {
+                global_hooks.deallocate(item->string);
+            }
+            item->string = NULL;
+            item->next = NULL;
+            item->prev = NULL;
+            item->parent = NULL;
+            item = next;
+            continue;
+        }
+        if ((item->type & cJSON_Watched) && (watch_hook != NULL))
         {
-            cJSON_Delete(item->child);
+            watch_hook(item, true);
         }
+        owner = ((item->type & cJSON_IsShared) && (item->child != NULL)) ? item->child->parent : NULL;
         if (!(item->type & cJSON_IsReference) && (item->valuestring != NULL))
         {
             global_hooks.deallocate(item->valuestring);
@@ -239,7 +356,15 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
         {
             global_hooks.deallocate(item->string);
         }
-        global_hooks.deallocate(item);
+        if (!(item->type & cJSON_InBlock))
+        {
+            /* items of a cJSON_DuplicateBlock copy are freed with its root */
+            global_hooks.deallocate(item);
+        }
+        if (owner != NULL)
+        {
+            release_shared(owner);
+        }
         item = next;
     }
 }
@@ -262,6 +387,9 @@ typedef struct
     size_t offset;
     size_t depth; /* How deeply nested (in arrays/objects) is the input at the current offset. */
     internal_hooks hooks;
+    const cJSON_Projection *projection; /* members to parse, NULL for all */
+    cJSON_ElementFilter filter; /* elements of a top level array to keep, NULL for all */
+    void *filter_context;
 } parse_buffer;
 
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
@@ -365,6 +493,8 @@ CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number)
         object->valueint = (int)number;
     }
 
+    invalidate_hash(object);
+
     return object->valuedouble = number;
 }
 
@@ -377,6 +507,7 @@ typedef struct
     cJSON_bool noalloc;
     cJSON_bool format; /* is this print a formatted print */
     internal_hooks hooks;
+    struct cJSON_PrintCache *cache; /* text of unchanged subtrees is copied from here, NULL if not printing with a cache */
 } printbuffer;
 
 /* realloc printbuffer if necessary to have at least "needed" bytes more */
@@ -964,10 +1095,8 @@ static cJSON_bool print_string(const cJSON * const item, printbuffer * const p)
 /* Predeclare these prototypes. */
 static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer);
 static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer);
-static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer);
-static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer);
+static cJSON_bool print_cached_copy(const cJSON * const item, printbuffer * const output_buffer, cJSON_bool * const copied);
+static void print_cached_add(const cJSON * const item, const size_t offset, const size_t depth, printbuffer * const output_buffer);
 
 /* Utility to jump whitespace and cr/lf */
 static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
@@ -1007,24 +1136,27 @@ static parse_buffer *skip_utf8_bom(parse_buffer * const buffer)
 }
 
 /* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated)
+static cJSON *parse_document(const char *value, size_t buffer_length, const cJSON_Projection *projection, cJSON_ElementFilter filter, void *filter_context, const char **return_parse_end, cJSON_bool require_null_terminated)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, NULL, NULL, NULL };
     cJSON *item = NULL;
 
     /* reset error position */
     global_error.json = NULL;
     global_error.position = 0;
 
-    if (value == NULL)
+    if ((value == NULL) || (0 == buffer_length))
     {
         goto fail;
     }
 
     buffer.content = (const unsigned char*)value;
-    buffer.length = strlen((const char*)value) + sizeof("");
+    buffer.length = buffer_length;
     buffer.offset = 0;
     buffer.hooks = global_hooks;
+    buffer.projection = projection;
+    buffer.filter = filter;
+    buffer.filter_context = filter_context;
 
     item = cJSON_New_Item(&global_hooks);
     if (item == NULL) /* memory fail */
@@ -1086,12 +1218,308 @@ fail:
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    size_t buffer_length;
+
+    if (NULL == value)
+    {
+        return cJSON_ParseWithLengthOpts(NULL, 0, return_parse_end, require_null_terminated);
+    }
+
+    /* Adding null character size due to require_null_terminated. */
+    buffer_length = strlen(value) + sizeof("");
+
+    return cJSON_ParseWithLengthOpts(value, buffer_length, return_parse_end, require_null_terminated);
+}
+
+/* Parse an object - create a new root, and populate. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_document(value, buffer_length, NULL, NULL, NULL, return_parse_end, require_null_terminated);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseProjectedWithOpts(const char *value, size_t buffer_length, const cJSON_Projection *projection, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_document(value, buffer_length, projection, NULL, NULL, return_parse_end, require_null_terminated);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
 {
     return cJSON_ParseWithOpts(value, 0, 0);
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    return cJSON_ParseWithLengthOpts(value, buffer_length, 0, 0);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseProjected(const char *value, size_t buffer_length, const cJSON_Projection *projection)
+{
+    return cJSON_ParseProjectedWithOpts(value, buffer_length, projection, 0, 0);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseFiltered(const char *value, size_t buffer_length, cJSON_ElementFilter filter, void *context)
+{
+    return parse_document(value, buffer_length, NULL, filter, context, 0, 0);
+}
+
+/* Parallel parsing of large top level arrays */
+
+/* every chunk of elements handed to a worker is at least this big */
+#define PARALLEL_PARSE_CHUNK_SIZE (64 * 1024)
+/* chunks per thread, more chunks even out elements of different size */
+#define PARALLEL_PARSE_CHUNKS_PER_THREAD 4
+
+typedef struct
+{
+    const unsigned char *content;
+    size_t length;
+    size_t *bounds; /* chunk i starts after bounds[i] ('[' or ',') and ends at bounds[i + 1] (',' or ']') */
+    cJSON *array;
+    cJSON **heads;
+    cJSON **tails;
+    internal_hooks hooks;
+} parallel_parse;
+
+/* find the end of a top level array and the separators that split it into chunks, returns false if that isn't possible.
+ * Brackets inside of the elements are only counted: an element with mismatched brackets fails to parse in its chunk. */
+static cJSON_bool scan_array_bounds(const unsigned char * const content, const size_t length, size_t start, const size_t chunk_size, size_t * const bounds, size_t * const bound_count, const size_t max_bounds)
+{
+    size_t depth = 1;
+    size_t position = start + 1;
+
+    bounds[0] = start;
+    *bound_count = 1;
+
+    while (position < length)
+    {
+        switch (content[position])
+        {
+            case '\"':
+                /* skip the string, escaped characters can't end it */
+                for (position++; (position < length) && (content[position] != '\"'); position++)
+                {
+                    if (content[position] == '\\')
+                    {
+                        position++;
+                    }
+                }
+                break;
+
+            case '[':
+            case '{':
+                depth++;
+                break;
+
+            case ']':
+            case '}':
+                depth--;
+                if (depth == 0)
+                {
+                    /* the workers check that the elements are valid, only the closer of the array itself isn't parsed by them */
+                    bounds[(*bound_count)++] = position;
+                    return content[position] == ']';
+                }
+                break;
+
+            case ',':
+                if ((depth == 1) && ((position - bounds[*bound_count - 1]) >= chunk_size) && (*bound_count < (max_bounds - 1)))
+                {
+                    bounds[(*bound_count)++] = position;
+                }
+                break;
+
+            default:
+                break;
+        }
+        position++;
+    }
+
+    /* unterminated array */
+    return false;
+}
+
+/* parse the elements of one chunk exactly like parse_array does */
+static cJSON_bool parse_array_chunk(void *context, size_t index)
+{
+    parallel_parse *parse = (parallel_parse*)context;
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, NULL, NULL, NULL };
+    size_t end = parse->bounds[index + 1];
+    cJSON *head = NULL;
+    cJSON *current_item = NULL;
+
+    buffer.content = parse->content;
+    buffer.length = parse->length;
+    buffer.offset = parse->bounds[index];
+    buffer.depth = 1;
+    buffer.hooks = parse->hooks;
+
+    do
+    {
+        cJSON *new_item = cJSON_New_Item(&buffer.hooks);
+        if (new_item == NULL)
+        {
+            goto fail;
+        }
+        new_item->parent = parse->array;
+
+        if (head == NULL)
+        {
+            current_item = head = new_item;
+        }
+        else
+        {
+            current_item->next = new_item;
+            new_item->prev = current_item;
+            current_item = new_item;
+        }
+
+        buffer.offset++;
+        buffer_skip_whitespace(&buffer);
+        if (!parse_value(current_item, &buffer))
+        {
+            goto fail;
+        }
+        buffer_skip_whitespace(&buffer);
+    }
+    while ((buffer.offset < end) && (buffer_at_offset(&buffer)[0] == ','));
+
+    if (buffer.offset != end)
+    {
+        goto fail;
+    }
+
+    parse->heads[index] = head;
+    parse->tails[index] = current_item;
+
+    return true;
+
+fail:
+    if (head != NULL)
+    {
+        cJSON_Delete(head);
+    }
+
+    return false;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseParallel(const char *value, size_t buffer_length, struct cJSONPool *pool)
+{
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, NULL, NULL, NULL };
+    parallel_parse parse;
+    size_t max_bounds = 0;
+    size_t bound_count = 0;
+    size_t chunk_size = 0;
+    size_t chunks = 0;
+    size_t i = 0;
+    cJSON *item = NULL;
+    cJSON *tail = NULL;
+
+    if ((value == NULL) || (buffer_length == 0) || (cJSONPool_Threads(pool) < 2) || (buffer_length < (2 * PARALLEL_PARSE_CHUNK_SIZE)))
+    {
+        return cJSON_ParseWithLength(value, buffer_length);
+    }
+
+    buffer.content = (const unsigned char*)value;
+    buffer.length = buffer_length;
+    buffer_skip_whitespace(skip_utf8_bom(&buffer));
+    if (buffer_at_offset(&buffer)[0] != '[')
+    {
+        return cJSON_ParseWithLength(value, buffer_length);
+    }
+
+    chunk_size = buffer_length / ((size_t)cJSONPool_Threads(pool) * PARALLEL_PARSE_CHUNKS_PER_THREAD);
+    if (chunk_size < PARALLEL_PARSE_CHUNK_SIZE)
+    {
+        chunk_size = PARALLEL_PARSE_CHUNK_SIZE;
+    }
+    max_bounds = (buffer_length / chunk_size) + 2;
+
+    memset(&parse, '\0', sizeof(parse));
+    parse.content = buffer.content;
+    parse.length = buffer_length;
+    parse.hooks = global_hooks;
+    parse.bounds = (size_t*)global_hooks.allocate(max_bounds * sizeof(size_t));
+    parse.heads = (cJSON**)global_hooks.allocate(max_bounds * sizeof(cJSON*));
+    parse.tails = (cJSON**)global_hooks.allocate(max_bounds * sizeof(cJSON*));
+    if ((parse.bounds == NULL) || (parse.heads == NULL) || (parse.tails == NULL))
+    {
+        goto serial;
+    }
+    memset(parse.heads, '\0', max_bounds * sizeof(cJSON*));
+
+    if (!scan_array_bounds(parse.content, buffer_length, buffer.offset, chunk_size, parse.bounds, &bound_count, max_bounds) || (bound_count < 3))
+    {
+        goto serial;
+    }
+    chunks = bound_count - 1;
+
+    item = cJSON_New_Item(&global_hooks);
+    if (item == NULL)
+    {
+        goto serial;
+    }
+    item->type = cJSON_Array;
+    parse.array = item;
+
+    if (!cJSONPool_Run(pool, chunks, parse_array_chunk, &parse))
+    {
+        global_hooks.deallocate(item);
+        goto serial;
+    }
+
+    /* stitch the chunks together in order */
+    for (i = 0; i < chunks; i++)
+    {
+        if (tail == NULL)
+        {
+            item->child = parse.heads[i];
+        }
+        else
+        {
+            tail->next = parse.heads[i];
+            parse.heads[i]->prev = tail;
+        }
+        tail = parse.tails[i];
+        parse.heads[i] = NULL;
+    }
+
+    global_hooks.deallocate(parse.bounds);
+    global_hooks.deallocate(parse.heads);
+    global_hooks.deallocate(parse.tails);
+
+    global_error.json = NULL;
+    global_error.position = 0;
+
+    return item;
+
+serial:
+    /* fall back to the serial parser, which also reports the exact error position for invalid input */
+    if (parse.heads != NULL)
+    {
+        for (i = 0; i < max_bounds; i++)
+        {
+            if (parse.heads[i] != NULL)
+            {
+                cJSON_Delete(parse.heads[i]);
+            }
+        }
+        global_hooks.deallocate(parse.heads);
+    }
+    if (parse.bounds != NULL)
+    {
+        global_hooks.deallocate(parse.bounds);
+    }
+    if (parse.tails != NULL)
+    {
+        global_hooks.deallocate(parse.tails);
+    }
+
+    return cJSON_ParseWithLength(value, buffer_length);
+}
+
 #define cjson_min(a, b) ((a < b) ? a : b)
 
 static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
@@ -1171,7 +1599,7 @@ CJSON_PUBLIC(char *) cJSON_PrintUnformatted(const cJSON *item)
 
 CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON_bool fmt)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 }, NULL };
 
     if (prebuffer < 0)
     {
@@ -1201,7 +1629,7 @@ CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON
 
 CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buf, const int len, const cJSON_bool fmt)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 }, NULL };
 
     if ((len < 0) || (buf == NULL))
     {
@@ -1218,1630 +1646,3751 @@ CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buf, const i
     return print_value(item, &p);
 }
 
-/* Parser core - when encountering text, process appropriately. */
-static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer)
+/* Projections: the object members to parse, as a trie of the tokens of JSON pointers. Node 0 is the root, a node where a pointer
+ * ends keeps its whole value. Arrays are transparent, their elements are projected like the array itself. */
+typedef struct
 {
-    if ((input_buffer == NULL) || (input_buffer->content == NULL))
-    {
-        return false; /* no input */
-    }
+    const unsigned char *key; /* unescaped token */
+    size_t length;
+    size_t first_child;
+    size_t next_sibling;
+    cJSON_bool complete;
+} projection_node;
 
-    /* parse the different types of values */
-    /* null */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
-    {
-        item->type = cJSON_NULL;
-        input_buffer->offset += 4;
-        return true;
-    }
-    /* false */
-    if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
-    {
-        item->type = cJSON_False;
-        input_buffer->offset += 5;
-        return true;
-    }
-    /* true */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
-    {
-        item->type = cJSON_True;
-        item->valueint = 1;
-        input_buffer->offset += 4;
-        return true;
-    }
-    /* string */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"'))
+struct cJSON_Projection
+{
+    size_t count;
+    projection_node nodes[1];
+};
+
+/* projection state of a value: a trie node, everything below it or (for object members) none of it */
+#define PROJECTION_ALL ((size_t)-1)
+#define PROJECTION_SKIP ((size_t)-2)
+/* no more projected members in the object */
+#define PROJECTION_END ((size_t)-3)
+#define PROJECTION_NO_NODE ((size_t)-1)
+
+CJSON_PUBLIC(cJSON_Projection *) cJSON_CreateProjection(const char * const *pointers, size_t count)
+{
+    cJSON_Projection *projection = NULL;
+    unsigned char *keys = NULL;
+    size_t tokens = 0;
+    size_t length = 0;
+    size_t i = 0;
+
+    if ((pointers == NULL) && (count > 0))
     {
-        return parse_string(item, input_buffer);
+        return NULL;
     }
-    /* number */
-    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))))
+    for (i = 0; i < count; i++)
     {
-        return parse_number(item, input_buffer);
+        const char *position = pointers[i];
+        if ((position == NULL) || ((position[0] != '\0') && (position[0] != '/')))
+        {
+            return NULL;
+        }
+        for (; *position != '\0'; position++)
+        {
+            tokens += (*position == '/') ? 1 : 0;
+        }
+        length += (size_t)(position - pointers[i]);
     }
-    /* array */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '['))
+
+    /* the unescaped keys are never longer than the pointers */
+    projection = (cJSON_Projection*)global_hooks.allocate(sizeof(cJSON_Projection) + (tokens * sizeof(projection_node)) + length + sizeof(""));
+    if (projection == NULL)
     {
-        return parse_array(item, input_buffer);
+        return NULL;
     }
-    /* object */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '{'))
+    keys = (unsigned char*)(projection->nodes + tokens + 1);
+    memset(&projection->nodes[0], '\0', sizeof(projection_node));
+    projection->nodes[0].first_child = PROJECTION_NO_NODE;
+    projection->nodes[0].next_sibling = PROJECTION_NO_NODE;
+    projection->count = 1;
+
+    for (i = 0; i < count; i++)
     {
-        return parse_object(item, input_buffer);
-    }
-
-    return false;
-}
-
-/* Render a value to text. */
-static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer)
-{
-    unsigned char *output = NULL;
-
-    if ((item == NULL) || (output_buffer == NULL))
-    {
-        return false;
-    }
+        const unsigned char *position = (const unsigned char*)pointers[i];
+        size_t node = 0;
 
-    switch ((item->type) & 0xFF)
-    {
-        case cJSON_NULL:
-            output = ensure(output_buffer, 5);
-            if (output == NULL)
-            {
-                return false;
-            }
-            strcpy((char*)output, "null");
-            return true;
+        while (*position == '/')
+        {
+            const unsigned char *key = keys;
+            size_t child = PROJECTION_NO_NODE;
 
-        case cJSON_False:
-            output = ensure(output_buffer, 6);
-            if (output == NULL)
+            /* skip '/' and unescape ~0 and ~1 */
+            for (position++; (*position != '\0') && (*position != '/'); position++)
             {
-                return false;
+                if (*position == '~')
+                {
+                    if ((position[1] != '0') && (position[1] != '1'))
+                    {
+                        global_hooks.deallocate(projection);
+                        return NULL;
+                    }
+                    *keys++ = (position[1] == '0') ? '~' : '/';
+                    position++;
+                }
+                else
+                {
+                    *keys++ = *position;
+                }
             }
-            strcpy((char*)output, "false");
-            return true;
 
-        case cJSON_True:
-            output = ensure(output_buffer, 5);
-            if (output == NULL)
+            for (child = projection->nodes[node].first_child; child != PROJECTION_NO_NODE; child = projection->nodes[child].next_sibling)
             {
-                return false;
+                if ((projection->nodes[child].length == (size_t)(keys - key)) && (memcmp(projection->nodes[child].key, key, (size_t)(keys - key)) == 0))
+                {
+                    break;
+                }
             }
-            strcpy((char*)output, "true");
-            return true;
-
-        case cJSON_Number:
-            return print_number(item, output_buffer);
-
-        case cJSON_Raw:
-        {
-            size_t raw_length = 0;
-            if (item->valuestring == NULL)
+            if (child == PROJECTION_NO_NODE)
             {
-                return false;
+                child = projection->count++;
+                projection->nodes[child].key = key;
+                projection->nodes[child].length = (size_t)(keys - key);
+                projection->nodes[child].first_child = PROJECTION_NO_NODE;
+                projection->nodes[child].complete = false;
+                projection->nodes[child].next_sibling = projection->nodes[node].first_child;
+                projection->nodes[node].first_child = child;
             }
-
-            raw_length = strlen(item->valuestring) + sizeof("");
-            output = ensure(output_buffer, raw_length);
-            if (output == NULL)
+            else
             {
-                return false;
+                /* the key is stored already */
+                keys = (unsigned char*)key;
             }
-            memcpy(output, item->valuestring, raw_length);
-            return true;
+            node = child;
         }
+        projection->nodes[node].complete = true;
+    }
 
-        case cJSON_String:
-            return print_string(item, output_buffer);
-
-        case cJSON_Array:
-            return print_array(item, output_buffer);
-
-        case cJSON_Object:
-            return print_object(item, output_buffer);
+    return projection;
+}
 
-        default:
-            return false;
+CJSON_PUBLIC(void) cJSON_DeleteProjection(cJSON_Projection *projection)
+{
+    if (projection != NULL)
+    {
+        global_hooks.deallocate(projection);
     }
 }
 
-/* Build an array from input text. */
-static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer)
+/* state of the values below node */
+static size_t projection_state(const cJSON_Projection * const projection, const size_t node)
 {
-    cJSON *head = NULL; /* head of the linked list */
-    cJSON *current_item = NULL;
+    return projection->nodes[node].complete ? PROJECTION_ALL : node;
+}
 
-    if (input_buffer->depth >= CJSON_NESTING_LIMIT)
-    {
-        return false; /* to deeply nested */
-    }
-    input_buffer->depth++;
+/* Check a string like parse_string does, without decoding it. escaped tells whether it contains escape sequences. */
+static cJSON_bool skip_string(parse_buffer * const input_buffer, cJSON_bool * const escaped)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
 
-    if (buffer_at_offset(input_buffer)[0] != '[')
+    *escaped = false;
+    if (buffer_at_offset(input_buffer)[0] != '\"')
     {
-        /* not an array */
         goto fail;
     }
 
-    input_buffer->offset++;
-    buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ']'))
+    while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
     {
-        /* empty array */
-        goto success;
+        if (input_end[0] == '\\')
+        {
+            if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
+            {
+                goto fail;
+            }
+            *escaped = true;
+            input_end++;
+        }
+        input_end++;
     }
-
-    /* check if we skipped to the end of the buffer */
-    if (cannot_access_at_index(input_buffer, 0))
+    if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
     {
-        input_buffer->offset--;
         goto fail;
     }
 
-    /* step back to character in front of the first element */
-    input_buffer->offset--;
-    /* loop through the comma separated array elements */
-    do
+    while (*escaped && (input_pointer < input_end))
     {
-        /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
-        if (new_item == NULL)
-        {
-            goto fail; /* allocation failure */
-        }
+        unsigned char sequence_length = 2;
+        unsigned char utf8[4];
+        unsigned char *output_pointer = utf8;
 
-        /* attach next item to list */
-        if (head == NULL)
+        if (*input_pointer != '\\')
         {
-            /* start the linked list */
-            current_item = head = new_item;
+            input_pointer++;
+            continue;
         }
-        else
+        switch (input_pointer[1])
         {
-            /* add to the end and advance */
-            current_item->next = new_item;
-            new_item->prev = current_item;
-            current_item = new_item;
-        }
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+            case '\"':
+            case '\\':
+            case '/':
+                break;
 
-        /* parse next value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer))
-        {
-            goto fail; /* failed to parse value */
-        }
-        buffer_skip_whitespace(input_buffer);
-    }
-    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
+            case 'u':
+                sequence_length = utf16_literal_to_utf8(input_pointer, input_end, &output_pointer);
+                if (sequence_length == 0)
+                {
+                    goto fail;
+                }
+                break;
 
-    if (cannot_access_at_index(input_buffer, 0) || buffer_at_offset(input_buffer)[0] != ']')
-    {
-        goto fail; /* expected end of array */
+            default:
+                goto fail;
+        }
+        input_pointer += sequence_length;
     }
 
-success:
-    input_buffer->depth--;
-
-    item->type = cJSON_Array;
-    item->child = head;
-
-    input_buffer->offset++;
-
+    input_buffer->offset = (size_t)(input_end - input_buffer->content) + 1;
     return true;
 
 fail:
-    if (head != NULL)
-    {
-        cJSON_Delete(head);
-    }
-
+    input_buffer->offset = (size_t)(input_pointer - input_buffer->content);
     return false;
 }
 
-/* Render an array to text */
-static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer)
+static cJSON_bool is_number_character(const unsigned char character)
 {
-    unsigned char *output_pointer = NULL;
-    size_t length = 0;
-    cJSON *current_element = item->child;
+    return ((character >= '0') && (character <= '9')) || (character == '+') || (character == '-') || (character == 'e') || (character == 'E') || (character == '.');
+}
 
-    if (output_buffer == NULL)
+/* Skip a number like parse_number does: of the characters it copies for strtod, only as many as strtod reads. */
+static cJSON_bool skip_number(parse_buffer * const input_buffer)
+{
+    const unsigned char *number = buffer_at_offset(input_buffer);
+    size_t available = 0;
+    size_t digits = 0;
+    size_t end = 0;
+    size_t i = 0;
+
+    while ((available < 63) && can_access_at_index(input_buffer, available) && is_number_character(number[available]))
     {
-        return false;
+        available++;
     }
 
-    /* Compose the output array. */
-    /* opening square bracket */
-    output_pointer = ensure(output_buffer, 1);
-    if (output_pointer == NULL)
+    /* [sign] digits [. digits] with at least one digit, then an exponent if it has digits */
+    if ((i < available) && ((number[i] == '-') || (number[i] == '+')))
+    {
+        i++;
+    }
+    for (; (i < available) && (number[i] >= '0') && (number[i] <= '9'); i++)
+    {
+        digits++;
+    }
+    if ((i < available) && (number[i] == '.'))
+    {
+        for (i++; (i < available) && (number[i] >= '0') && (number[i] <= '9'); i++)
+        {
+            digits++;
+        }
+    }
+    if (digits == 0)
     {
         return false;
     }
-
-    *output_pointer = '[';
-    output_buffer->offset++;
-    output_buffer->depth++;
-
-    while (current_element != NULL)
+    end = i;
+    if ((i < available) && ((number[i] == 'e') || (number[i] == 'E')))
     {
-        if (!print_value(current_element, output_buffer))
+        i++;
+        if ((i < available) && ((number[i] == '-') || (number[i] == '+')))
         {
-            return false;
+            i++;
         }
-        update_offset(output_buffer);
-        if (current_element->next)
+        if ((i < available) && (number[i] >= '0') && (number[i] <= '9'))
         {
-            length = (size_t) (output_buffer->format ? 2 : 1);
-            output_pointer = ensure(output_buffer, length + 1);
-            if (output_pointer == NULL)
-            {
-                return false;
-            }
-            *output_pointer++ = ',';
-            if(output_buffer->format)
+            while ((i < available) && (number[i] >= '0') && (number[i] <= '9'))
             {
-                *output_pointer++ = ' ';
+                i++;
             }
-            *output_pointer = '\0';
-            output_buffer->offset += length;
+            end = i;
         }
-        current_element = current_element->next;
-    }
-
-    output_pointer = ensure(output_buffer, 2);
-    if (output_pointer == NULL)
-    {
-        return false;
     }
-    *output_pointer++ = ']';
-    *output_pointer = '\0';
-    output_buffer->depth--;
 
+    input_buffer->offset += end;
     return true;
 }
 
-/* Build an object from the text. */
-static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer)
+/* the name and colon of an object member, checked like parse_child does */
+static cJSON_bool skip_member_name(parse_buffer * const input_buffer)
 {
-    cJSON *head = NULL; /* linked list head */
-    cJSON *current_item = NULL;
+    cJSON_bool escaped = false;
 
-    if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+    if (cannot_access_at_index(input_buffer, 0) || !skip_string(input_buffer, &escaped))
     {
-        return false; /* to deeply nested */
+        return false;
     }
-    input_buffer->depth++;
-
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '{'))
+    buffer_skip_whitespace(input_buffer);
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
     {
-        goto fail; /* not an object */
+        return false;
     }
-
     input_buffer->offset++;
     buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '}'))
-    {
-        goto success; /* empty object */
-    }
 
-    /* check if we skipped to the end of the buffer */
-    if (cannot_access_at_index(input_buffer, 0))
-    {
-        input_buffer->offset--;
-        goto fail;
-    }
+    return true;
+}
 
-    /* step back to character in front of the first element */
-    input_buffer->offset--;
-    /* loop through the comma separated array elements */
-    do
+/* Check a value exactly like parse_value would parse it, without creating items or decoding strings. */
+static cJSON_bool skip_value(parse_buffer * const input_buffer)
+{
+    const size_t base = input_buffer->depth;
+    unsigned char initial[64]; /* the closing character of every open array and object */
+    unsigned char *ends = initial;
+    size_t size = sizeof(initial);
+    cJSON_bool escaped = false;
+
+    for (;;)
     {
-        /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
-        if (new_item == NULL)
+        if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
         {
-            goto fail; /* allocation failure */
+            input_buffer->offset += 4;
         }
-
-        /* attach next item to list */
-        if (head == NULL)
+        else if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
         {
-            /* start the linked list */
-            current_item = head = new_item;
+            input_buffer->offset += 5;
         }
-        else
+        else if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
         {
-            /* add to the end and advance */
-            current_item->next = new_item;
-            new_item->prev = current_item;
-            current_item = new_item;
+            input_buffer->offset += 4;
         }
-
-        /* parse the name of the child */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_string(current_item, input_buffer))
+        else if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"'))
         {
-            goto fail; /* failed to parse name */
+            if (!skip_string(input_buffer, &escaped))
+            {
+                goto fail;
+            }
         }
-        buffer_skip_whitespace(input_buffer);
+        else if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))))
+        {
+            if (!skip_number(input_buffer))
+            {
+                goto fail;
+            }
+        }
+        else if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '[') || (buffer_at_offset(input_buffer)[0] == '{')))
+        {
+            const unsigned char end = (buffer_at_offset(input_buffer)[0] == '[') ? ']' : '}';
 
-        /* swap valuestring and string, because we parsed the name */
-        current_item->string = current_item->valuestring;
-        current_item->valuestring = NULL;
+            if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+            {
+                goto fail;
+            }
+            if (((input_buffer->depth - base) == size) && !grow_stack((void**)&ends, &size, sizeof(unsigned char), initial))
+            {
+                goto fail;
+            }
+            ends[input_buffer->depth - base] = end;
+            input_buffer->depth++;
 
-        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0))
+            {
+                input_buffer->offset--;
+                goto fail;
+            }
+            if (buffer_at_offset(input_buffer)[0] != end)
+            {
+                if ((end == '}') && !skip_member_name(input_buffer))
+                {
+                    goto fail;
+                }
+                continue;
+            }
+            input_buffer->depth--;
+            input_buffer->offset++;
+        }
+        else
         {
-            goto fail; /* invalid object */
+            goto fail;
         }
 
-        /* parse the value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer))
+        /* the value is complete, continue with the next one or close the arrays and objects that end here */
+        while (input_buffer->depth > base)
         {
-            goto fail; /* failed to parse value */
+            const unsigned char end = ends[input_buffer->depth - base - 1];
+
+            buffer_skip_whitespace(input_buffer);
+            if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','))
+            {
+                input_buffer->offset++;
+                buffer_skip_whitespace(input_buffer);
+                if ((end == '}') && !skip_member_name(input_buffer))
+                {
+                    goto fail;
+                }
+                break;
+            }
+            if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != end))
+            {
+                goto fail;
+            }
+            input_buffer->depth--;
+            input_buffer->offset++;
         }
-        buffer_skip_whitespace(input_buffer);
-    }
-    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
 
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '}'))
-    {
-        goto fail; /* expected end of object */
+        if (input_buffer->depth == base)
+        {
+            free_stack(ends, initial);
+            return true;
+        }
     }
 
-success:
-    input_buffer->depth--;
-
-    item->type = cJSON_Object;
-    item->child = head;
-
-    input_buffer->offset++;
-    return true;
-
 fail:
-    if (head != NULL)
-    {
-        cJSON_Delete(head);
-    }
-
+    free_stack(ends, initial);
     return false;
 }
 
-/* Render an object to text. */
-static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer)
+/* state of the object member whose name starts at the current offset, the offset is moved past the name */
+static cJSON_bool get_member_projection(parse_buffer * const input_buffer, const size_t node, size_t * const state)
 {
-    unsigned char *output_pointer = NULL;
+    const cJSON_Projection *projection = input_buffer->projection;
+    const size_t start = input_buffer->offset;
+    const unsigned char *name = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *key = NULL;
     size_t length = 0;
-    cJSON *current_item = item->child;
+    size_t end = 0;
+    cJSON_bool escaped = false;
+    cJSON decoded;
+    size_t child = 0;
 
-    if (output_buffer == NULL)
+    if (!skip_string(input_buffer, &escaped))
     {
         return false;
     }
 
-    /* Compose the output: */
-    length = (size_t) (output_buffer->format ? 2 : 1); /* fmt: {\n */
-    output_pointer = ensure(output_buffer, length + 1);
-    if (output_pointer == NULL)
+    /* names without escape sequences are compared in place, with escapes they are decoded first */
+    memset(&decoded, '\0', sizeof(decoded));
+    if (escaped)
     {
-        return false;
-    }
-
-    *output_pointer++ = '{';
-    output_buffer->depth++;
-    if (output_buffer->format)
+        end = input_buffer->offset;
+        input_buffer->offset = start;
+        if (!parse_string(&decoded, input_buffer))
+        {
+            return false;
+        }
+        input_buffer->offset = end;
+        key = (const unsigned char*)decoded.valuestring;
+        length = strlen(decoded.valuestring);
+    }
+    else
     {
-        *output_pointer++ = '\n';
+        key = name;
+        length = (size_t)(buffer_at_offset(input_buffer) - name) - 1;
     }
-    output_buffer->offset += length;
 
-    while (current_item)
+    *state = PROJECTION_SKIP;
+    for (child = projection->nodes[node].first_child; child != PROJECTION_NO_NODE; child = projection->nodes[child].next_sibling)
     {
-        if (output_buffer->format)
+        const projection_node *token = &projection->nodes[child];
+        /* like the parsed name, a name ends at the first '\0' */
+        if ((token->length <= length) && (memcmp(token->key, key, token->length) == 0) && ((token->length == length) || (key[token->length] == '\0')))
         {
-            size_t i;
-            output_pointer = ensure(output_buffer, output_buffer->depth);
-            if (output_pointer == NULL)
-            {
-                return false;
-            }
-            for (i = 0; i < output_buffer->depth; i++)
-            {
-                *output_pointer++ = '\t';
-            }
-            output_buffer->offset += output_buffer->depth;
+            *state = projection_state(projection, child);
+            break;
         }
+    }
 
-        /* print key */
-        if (!print_string_ptr((unsigned char*)current_item->string, output_buffer))
-        {
-            return false;
-        }
-        update_offset(output_buffer);
+    if (decoded.valuestring != NULL)
+    {
+        input_buffer->hooks.deallocate(decoded.valuestring);
+    }
 
-        length = (size_t) (output_buffer->format ? 2 : 1);
-        output_pointer = ensure(output_buffer, length);
-        if (output_pointer == NULL)
+    return true;
+}
+
+/* Skip the members of an object that aren't in node, starting at the name of a member. Stops at the name of the next projected
+ * member and sets state to its projection, or at the '}' that ends the object with state PROJECTION_END. */
+static cJSON_bool skip_unprojected_members(parse_buffer * const input_buffer, const size_t node, size_t * const state)
+{
+    for (;;)
+    {
+        const size_t start = input_buffer->offset;
+
+        if (cannot_access_at_index(input_buffer, 0) || !get_member_projection(input_buffer, node, state))
         {
             return false;
         }
-        *output_pointer++ = ':';
-        if (output_buffer->format)
+        if (*state != PROJECTION_SKIP)
         {
-            *output_pointer++ = '\t';
+            input_buffer->offset = start;
+            return true;
         }
-        output_buffer->offset += length;
 
-        /* print value */
-        if (!print_value(current_item, output_buffer))
+        buffer_skip_whitespace(input_buffer);
+        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
         {
             return false;
         }
-        update_offset(output_buffer);
-
-        /* print comma if not last */
-        length = ((size_t)(output_buffer->format ? 1 : 0) + (size_t)(current_item->next ? 1 : 0));
-        output_pointer = ensure(output_buffer, length + 1);
-        if (output_pointer == NULL)
+        input_buffer->offset++;
+        buffer_skip_whitespace(input_buffer);
+        if (!skip_value(input_buffer))
         {
             return false;
         }
-        if (current_item->next)
-        {
-            *output_pointer++ = ',';
-        }
 
-        if (output_buffer->format)
+        buffer_skip_whitespace(input_buffer);
+        if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','))
         {
-            *output_pointer++ = '\n';
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            continue;
         }
-        *output_pointer = '\0';
-        output_buffer->offset += length;
-
-        current_item = current_item->next;
-    }
-
-    output_pointer = ensure(output_buffer, output_buffer->format ? (output_buffer->depth + 1) : 2);
-    if (output_pointer == NULL)
-    {
-        return false;
-    }
-    if (output_buffer->format)
-    {
-        size_t i;
-        for (i = 0; i < (output_buffer->depth - 1); i++)
+        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '}'))
         {
-            *output_pointer++ = '\t';
+            return false;
         }
+        *state = PROJECTION_END;
+        return true;
     }
-    *output_pointer++ = '}';
-    *output_pointer = '\0';
-    output_buffer->depth--;
-
-    return true;
 }
 
-/* Get Array size/item / object item. */
-CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+/* Start the next child of an array or object after previous (NULL for the first child) at the current position, including
+ * the name and the colon of object members. */
+static cJSON_bool parse_child(cJSON * const parent, cJSON * const previous, parse_buffer * const input_buffer, cJSON ** const child)
 {
-    cJSON *child = NULL;
-    size_t size = 0;
-
-    if (array == NULL)
+    /* allocate next item */
+    cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+    if (new_item == NULL)
     {
-        return 0;
+        return false; /* allocation failure */
     }
 
-    child = array->child;
-
-    while(child != NULL)
+    /* attach next item to list */
+    new_item->parent = parent;
+    if (previous == NULL)
     {
-        size++;
-        child = child->next;
+        /* start the linked list */
+        parent->child = new_item;
     }
+    else
+    {
+        /* add to the end */
+        previous->next = new_item;
+        new_item->prev = previous;
+    }
+    *child = new_item;
 
-    /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
-
-    return (int)size;
-}
-
-static cJSON* get_array_item(const cJSON *array, size_t index)
-{
-    cJSON *current_child = NULL;
-
-    if (array == NULL)
+    if ((parent->type & 0xFF) != cJSON_Object)
     {
-        return NULL;
+        return true;
     }
 
-    current_child = array->child;
-    while ((current_child != NULL) && (index > 0))
+    /* parse the name of the child */
+    if (cannot_access_at_index(input_buffer, 0) || !parse_string(new_item, input_buffer))
     {
-        index--;
-        current_child = current_child->next;
+        return false; /* failed to parse name */
     }
+    buffer_skip_whitespace(input_buffer);
 
-    return current_child;
-}
+    /* swap valuestring and string, because we parsed the name */
+    new_item->string = new_item->valuestring;
+    new_item->valuestring = NULL;
 
-CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
-{
-    if (index < 0)
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
     {
-        return NULL;
+        return false; /* invalid object */
     }
+    input_buffer->offset++;
+    buffer_skip_whitespace(input_buffer);
 
-    return get_array_item(array, (size_t)index);
+    return true;
 }
 
-static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
+/* Parser core - when encountering text, process appropriately. Arrays and objects are parsed without recursion: items are
+ * linked to their parent as soon as they are created, so the innermost open array or object is always the parent of the
+ * last item. On failure the items parsed so far stay linked to item, to be deleted with it.
+ * With a projection, the members of objects that aren't projected are only checked and skipped. */
+static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer)
 {
-    cJSON *current_element = NULL;
+    cJSON *current_item = item;
+    const size_t base = (input_buffer != NULL) ? input_buffer->depth : 0;
+    size_t initial[32]; /* the projection state of every open array and object */
+    size_t *states = initial;
+    size_t size = sizeof(initial) / sizeof(initial[0]);
+    size_t state = PROJECTION_ALL; /* projection state of current_item */
 
-    if ((object == NULL) || (name == NULL))
+    if ((input_buffer == NULL) || (input_buffer->content == NULL))
     {
-        return NULL;
+        return false; /* no input */
+    }
+    if (input_buffer->projection != NULL)
+    {
+        state = projection_state(input_buffer->projection, 0);
     }
 
-    current_element = object->child;
-    if (case_sensitive)
+    for (;;)
     {
-        while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
+        /* parse the different types of values */
+        /* null */
+        if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
         {
-            current_element = current_element->next;
+            current_item->type = cJSON_NULL;
+            input_buffer->offset += 4;
         }
-    }
-    else
-    {
-        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
+        /* false */
+        else if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
         {
-            current_element = current_element->next;
+            current_item->type = cJSON_False;
+            input_buffer->offset += 5;
         }
-    }
+        /* true */
+        else if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
+        {
+            current_item->type = cJSON_True;
+            current_item->valueint = 1;
+            input_buffer->offset += 4;
+        }
+        /* string */
+        else if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"'))
+        {
+            if (!parse_string(current_item, input_buffer))
+            {
+                goto fail;
+            }
+        }
+        /* number */
+        else if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))))
+        {
+            if (!parse_number(current_item, input_buffer))
+            {
+                goto fail;
+            }
+        }
+        /* array or object */
+        else if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '[') || (buffer_at_offset(input_buffer)[0] == '{')))
+        {
+            const unsigned char end = (buffer_at_offset(input_buffer)[0] == '[') ? ']' : '}';
 
-    if ((current_element == NULL) || (current_element->string == NULL)) {
-        return NULL;
-    }
+            if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+            {
+                goto fail; /* to deeply nested */
+            }
+            if (input_buffer->projection != NULL)
+            {
+                if (((input_buffer->depth - base) == size) && !grow_stack((void**)&states, &size, sizeof(size_t), initial))
+                {
+                    goto fail;
+                }
+                states[input_buffer->depth - base] = state;
+            }
+            input_buffer->depth++;
+            current_item->type = (end == ']') ? cJSON_Array : cJSON_Object;
 
-    return current_element;
-}
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            /* check if we skipped to the end of the buffer */
+            if (cannot_access_at_index(input_buffer, 0))
+            {
+                input_buffer->offset--;
+                goto fail;
+            }
+            if ((buffer_at_offset(input_buffer)[0] != end) && (end == '}') && (state != PROJECTION_ALL))
+            {
+                if (!skip_unprojected_members(input_buffer, state, &state))
+                {
+                    goto fail;
+                }
+            }
+            if ((buffer_at_offset(input_buffer)[0] != end) && (state != PROJECTION_END))
+            {
+                /* continue with the first child, the elements of arrays are projected like the array */
+                if (!parse_child(current_item, NULL, input_buffer, &current_item))
+                {
+                    goto fail;
+                }
+                continue;
+            }
 
-CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string)
-{
-    return get_object_item(object, string, false);
-}
+            /* empty array or object */
+            input_buffer->depth--;
+            input_buffer->offset++;
+        }
+        else
+        {
+            goto fail;
+        }
 
-CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string)
-{
-    return get_object_item(object, string, true);
-}
+        /* current_item is complete, continue with the next child of its parent or end the arrays and objects that end here */
+        while (current_item != item)
+        {
+            cJSON *parent = current_item->parent;
+            cJSON *previous = current_item;
 
-CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
-{
-    return cJSON_GetObjectItem(object, string) ? 1 : 0;
-}
+            if ((parent == item) && (input_buffer->filter != NULL) && ((parent->type & 0xFF) == cJSON_Array) && !input_buffer->filter(current_item, input_buffer->filter_context))
+            {
+                /* drop the rejected element right away, the next one takes its place */
+                previous = current_item->prev;
+                if (previous == NULL)
+                {
+                    parent->child = NULL;
+                }
+                else
+                {
+                    previous->next = NULL;
+                }
+                current_item->prev = NULL;
+                cJSON_Delete(current_item);
+                current_item = (previous != NULL) ? previous : parent;
+            }
 
-/* Utility for array list handling. */
-static void suffix_object(cJSON *prev, cJSON *item)
-{
-    prev->next = item;
-    item->prev = prev;
-}
+            buffer_skip_whitespace(input_buffer);
+            if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','))
+            {
+                input_buffer->offset++;
+                buffer_skip_whitespace(input_buffer);
+                state = (input_buffer->projection != NULL) ? states[input_buffer->depth - base - 1] : PROJECTION_ALL;
+                if (((parent->type & 0xFF) == cJSON_Object) && (state != PROJECTION_ALL))
+                {
+                    if (!skip_unprojected_members(input_buffer, state, &state))
+                    {
+                        goto fail;
+                    }
+                    if (state == PROJECTION_END)
+                    {
+                        /* the object ends after skipped members */
+                        continue;
+                    }
+                }
+                if (!parse_child(parent, previous, input_buffer, &current_item))
+                {
+                    goto fail;
+                }
+                break;
+            }
 
-/* Utility for handling references. */
-static cJSON *create_reference(const cJSON *item, const internal_hooks * const hooks)
-{
-    cJSON *reference = NULL;
-    if (item == NULL)
-    {
-        return NULL;
-    }
+            if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != (((parent->type & 0xFF) == cJSON_Array) ? ']' : '}')))
+            {
+                goto fail; /* expected end of array or object */
+            }
+            input_buffer->depth--;
+            input_buffer->offset++;
+            current_item = parent;
+        }
 
-    reference = cJSON_New_Item(hooks);
-    if (reference == NULL)
-    {
-        return NULL;
+        if (current_item == item)
+        {
+            free_stack(states, initial);
+            return true;
+        }
     }
 
-    memcpy(reference, item, sizeof(cJSON));
-    reference->string = NULL;
-    reference->type |= cJSON_IsReference;
-    reference->next = reference->prev = NULL;
-    return reference;
+fail:
+    free_stack(states, initial);
+    return false;
 }
 
-static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
+/* Render a value that isn't an array or object to text. */
+static cJSON_bool print_scalar(const cJSON * const item, printbuffer * const output_buffer)
 {
-    cJSON *child = NULL;
+    unsigned char *output = NULL;
 
-    if ((item == NULL) || (array == NULL))
+    switch ((item->type) & 0xFF)
     {
-        return false;
-    }
-
-    child = array->child;
+        case cJSON_NULL:
+            output = ensure(output_buffer, 5);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "null");
+            return true;
 
-    if (child == NULL)
-    {
-        /* list is empty, start new one */
-        array->child = item;
+        case cJSON_False:
+            output = ensure(output_buffer, 6);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "false");
+            return true;
+
+        case cJSON_True:
+            output = ensure(output_buffer, 5);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "true");
+            return true;
+
+        case cJSON_Number:
+            return print_number(item, output_buffer);
+
+        case cJSON_Raw:
+        {
+            size_t raw_length = 0;
+            if (item->valuestring == NULL)
+            {
+                return false;
+            }
+
+            raw_length = strlen(item->valuestring) + sizeof("");
+            output = ensure(output_buffer, raw_length);
+            if (output == NULL)
+            {
+                return false;
+            }
+            memcpy(output, item->valuestring, raw_length);
+            return true;
+        }
+
+        case cJSON_String:
+            return print_string(item, output_buffer);
+
+        default:
+            return false;
     }
-    else
+}
+
+/* what print_items prints: one value, array elements or object members */
+#define PRINT_VALUE 0
+#define PRINT_ELEMENTS 1
+#define PRINT_MEMBERS 2
+
+/* an array or object print_items is inside of */
+typedef struct
+{
+    const cJSON *item;
+    size_t offset; /* where its text starts and the depth it is printed at, for the print cache */
+    size_t depth;
+} print_frame;
+
+/* indentation, key and colon of an object member */
+static cJSON_bool print_member_key(const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    size_t length = 0;
+
+    if (output_buffer->format)
     {
-        /* append to the end */
-        while (child->next)
+        size_t i;
+        output_pointer = ensure(output_buffer, output_buffer->depth);
+        if (output_pointer == NULL)
         {
-            child = child->next;
+            return false;
         }
-        suffix_object(child, item);
+        for (i = 0; i < output_buffer->depth; i++)
+        {
+            *output_pointer++ = '\t';
+        }
+        output_buffer->offset += output_buffer->depth;
+    }
+
+    /* print key */
+    if (!print_string_ptr((unsigned char*)item->string, output_buffer))
+    {
+        return false;
+    }
+    update_offset(output_buffer);
+
+    length = (size_t) (output_buffer->format ? 2 : 1);
+    output_pointer = ensure(output_buffer, length);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+    *output_pointer++ = ':';
+    if (output_buffer->format)
+    {
+        *output_pointer++ = '\t';
     }
+    output_buffer->offset += length;
 
     return true;
 }
 
-/* Add item to array/object. */
-CJSON_PUBLIC(void) cJSON_AddItemToArray(cJSON *array, cJSON *item)
+/* separator after an array element or object member, if it isn't the last one */
+static cJSON_bool print_separator(const cJSON * const item, const cJSON_bool member, printbuffer * const output_buffer)
 {
-    add_item_to_array(array, item);
-}
+    unsigned char *output_pointer = NULL;
+    size_t length = 0;
 
-#if defined(__clang__) || (defined(__GNUC__)  && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ > 5))))
-    #pragma GCC diagnostic push
-#endif
-#ifdef __GNUC__
-#pragma GCC diagnostic ignored "-Wcast-qual"
-#endif
-/* helper function to cast away const */
-static void* cast_away_const(const void* string)
-{
-    return (void*)string;
-}
-#if defined(__clang__) || (defined(__GNUC__)  && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ > 5))))
-    #pragma GCC diagnostic pop
-#endif
+    if (member)
+    {
+        /* print comma if not last */
+        length = ((size_t)(output_buffer->format ? 1 : 0) + (size_t)(item->next ? 1 : 0));
+        output_pointer = ensure(output_buffer, length + 1);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        if (item->next)
+        {
+            *output_pointer++ = ',';
+        }
+        if (output_buffer->format)
+        {
+            *output_pointer++ = '\n';
+        }
+        *output_pointer = '\0';
+        output_buffer->offset += length;
+    }
+    else if (item->next)
+    {
+        length = (size_t) (output_buffer->format ? 2 : 1);
+        output_pointer = ensure(output_buffer, length + 1);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        *output_pointer++ = ',';
+        if (output_buffer->format)
+        {
+            *output_pointer++ = ' ';
+        }
+        *output_pointer = '\0';
+        output_buffer->offset += length;
+    }
 
+    return true;
+}
 
-static cJSON_bool add_item_to_object(cJSON * const object, const char * const string, cJSON * const item, const internal_hooks * const hooks, const cJSON_bool constant_key)
+/* opening bracket of an array or object */
+static cJSON_bool print_open(const cJSON * const item, printbuffer * const output_buffer)
 {
-    char *new_key = NULL;
-    int new_type = cJSON_Invalid;
+    unsigned char *output_pointer = NULL;
+    size_t length = (((item->type & 0xFF) == cJSON_Object) && output_buffer->format) ? 2 : 1; /* fmt: {\n */
 
-    if ((object == NULL) || (string == NULL) || (item == NULL))
+    output_pointer = ensure(output_buffer, length + 1);
+    if (output_pointer == NULL)
     {
         return false;
     }
+    if ((item->type & 0xFF) == cJSON_Array)
+    {
+        *output_pointer++ = '[';
+    }
+    else
+    {
+        *output_pointer++ = '{';
+        if (output_buffer->format)
+        {
+            *output_pointer++ = '\n';
+        }
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+    output_buffer->depth++;
 
-    if (constant_key)
+    return true;
+}
+
+/* closing bracket of an array or object, including the indentation of objects */
+static cJSON_bool print_close(const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+
+    if ((item->type & 0xFF) == cJSON_Array)
     {
-        new_key = (char*)cast_away_const(string);
-        new_type = item->type | cJSON_StringIsConst;
+        output_pointer = ensure(output_buffer, 2);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        *output_pointer++ = ']';
     }
     else
     {
-        new_key = (char*)cJSON_strdup((const unsigned char*)string, hooks);
-        if (new_key == NULL)
+        output_pointer = ensure(output_buffer, output_buffer->format ? (output_buffer->depth + 1) : 2);
+        if (output_pointer == NULL)
         {
             return false;
         }
-
-        new_type = item->type & ~cJSON_StringIsConst;
+        if (output_buffer->format)
+        {
+            size_t i;
+            for (i = 0; i < (output_buffer->depth - 1); i++)
+            {
+                *output_pointer++ = '\t';
+            }
+            output_buffer->offset += output_buffer->depth - 1;
+        }
+        *output_pointer++ = '}';
     }
+    *output_pointer = '\0';
+    output_buffer->offset++;
+    output_buffer->depth--;
 
-    if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
+    return true;
+}
+
+/* Render up to "count" items starting at current as kind (PRINT_VALUE prints one item, PRINT_ELEMENTS and PRINT_MEMBERS
+ * print each item followed by a separator if it isn't the last one). Nested arrays and objects are printed without
+ * recursion, the ones that are open are kept on an explicit stack. */
+static cJSON_bool print_items(const cJSON *current, size_t count, const int kind, printbuffer * const output_buffer)
+{
+    print_frame initial[32];
+    print_frame *stack = initial;
+    size_t size = sizeof(initial) / sizeof(initial[0]);
+    size_t depth = 0;
+    cJSON_bool success = false;
+
+    while ((current != NULL) && (count > 0))
     {
-        hooks->deallocate(item->string);
+        cJSON_bool member = (depth > 0) ? ((stack[depth - 1].item->type & 0xFF) == cJSON_Object) : (kind == PRINT_MEMBERS);
+        cJSON_bool copied = false;
+
+        if (member && !print_member_key(current, output_buffer))
+        {
+            goto fail;
+        }
+
+        if (((current->type & 0xFF) != cJSON_Array) && ((current->type & 0xFF) != cJSON_Object))
+        {
+            if (!print_scalar(current, output_buffer))
+            {
+                goto fail;
+            }
+            update_offset(output_buffer);
+        }
+        else if ((output_buffer->cache != NULL) && !print_cached_copy(current, output_buffer, &copied))
+        {
+            goto fail;
+        }
+        else if (!copied)
+        {
+            if ((depth == size) && !grow_stack((void**)&stack, &size, sizeof(print_frame), initial))
+            {
+                goto fail;
+            }
+            stack[depth].item = current;
+            stack[depth].offset = output_buffer->offset;
+            stack[depth].depth = output_buffer->depth;
+            depth++;
+
+            if (!print_open(current, output_buffer))
+            {
+                goto fail;
+            }
+            if (current->child != NULL)
+            {
+                current = current->child;
+                continue;
+            }
+            /* empty, closed right away below */
+        }
+
+        /* current is printed: continue with its next sibling, or close the arrays and objects whose last child it was */
+        for (;;)
+        {
+            if ((depth > 0) && (stack[depth - 1].item == current))
+            {
+                /* an empty array or object, or one whose children are done */
+                if (!print_close(current, output_buffer))
+                {
+                    goto fail;
+                }
+                depth--;
+                if (output_buffer->cache != NULL)
+                {
+                    print_cached_add(current, stack[depth].offset, stack[depth].depth, output_buffer);
+                }
+            }
+
+            if (depth == 0)
+            {
+                if ((kind != PRINT_VALUE) && !print_separator(current, kind == PRINT_MEMBERS, output_buffer))
+                {
+                    goto fail;
+                }
+                current = current->next;
+                count--;
+                break;
+            }
+
+            if (!print_separator(current, (stack[depth - 1].item->type & 0xFF) == cJSON_Object, output_buffer))
+            {
+                goto fail;
+            }
+            if (current->next != NULL)
+            {
+                current = current->next;
+                break;
+            }
+            current = stack[depth - 1].item;
+        }
     }
 
-    item->string = new_key;
-    item->type = new_type;
+    success = true;
 
-    return add_item_to_array(object, item);
+fail:
+    free_stack(stack, initial);
+
+    return success;
 }
 
-CJSON_PUBLIC(void) cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+/* Render a value to text. */
+static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer)
 {
-    add_item_to_object(object, string, item, &global_hooks, false);
+    if ((item == NULL) || (output_buffer == NULL))
+    {
+        return false;
+    }
+
+    return print_items(item, 1, PRINT_VALUE, output_buffer);
 }
 
-/* Add an item to an object with constant string as key */
-CJSON_PUBLIC(void) cJSON_AddItemToObjectCS(cJSON *object, const char *string, cJSON *item)
+/* Render up to "count" array elements starting at current_element, each followed by a separator if it isn't the last one */
+static cJSON_bool print_array_elements(const cJSON *current_element, size_t count, printbuffer * const output_buffer)
 {
-    add_item_to_object(object, string, item, &global_hooks, true);
+    return print_items(current_element, count, PRINT_ELEMENTS, output_buffer);
 }
 
-CJSON_PUBLIC(void) cJSON_AddItemReferenceToArray(cJSON *array, cJSON *item)
+/* Render up to "count" object members starting at current_item, including indentation and separators */
+static cJSON_bool print_object_members(const cJSON *current_item, size_t count, printbuffer * const output_buffer)
 {
-    if (array == NULL)
-    {
-        return;
+    return print_items(current_item, count, PRINT_MEMBERS, output_buffer);
+}
+
+/* Parallel printing of large arrays and objects */
+
+/* containers with fewer children are descended into instead of being split */
+#define PARALLEL_PRINT_MIN_SPLIT 64
+/* runs of siblings per thread, more runs even out elements of different size */
+#define PARALLEL_PRINT_RUNS_PER_THREAD 4
+/* how many levels of containers with few children are descended into looking for large ones */
+#define PARALLEL_PRINT_MAX_LEVEL 3
+
+/* A piece of the output: either text in the glue buffer or something a worker prints into its own buffer */
+typedef struct
+{
+    const cJSON *item; /* NULL for glue text */
+    size_t count; /* number of array elements or object members starting at item, 0 to print item itself */
+    size_t depth;
+    cJSON_bool members;
+    size_t glue_start;
+    size_t glue_length;
+    unsigned char *buffer;
+    size_t length;
+} print_segment;
+
+typedef struct
+{
+    printbuffer glue; /* openers, closers, keys and small values printed by the calling thread */
+    size_t glue_start;
+    print_segment *segments;
+    size_t segment_count;
+    size_t segment_capacity;
+    size_t threads;
+} parallel_print;
+
+static print_segment *add_segment(parallel_print * const print)
+{
+    print_segment *segment = NULL;
+
+    if (print->segment_count == print->segment_capacity)
+    {
+        size_t new_capacity = (print->segment_capacity == 0) ? 64 : (print->segment_capacity * 2);
+        print_segment *new_segments = (print_segment*)print->glue.hooks.allocate(new_capacity * sizeof(print_segment));
+        if (new_segments == NULL)
+        {
+            return NULL;
+        }
+        if (print->segments != NULL)
+        {
+            memcpy(new_segments, print->segments, print->segment_count * sizeof(print_segment));
+            print->glue.hooks.deallocate(print->segments);
+        }
+        print->segments = new_segments;
+        print->segment_capacity = new_capacity;
+    }
+
+    segment = &print->segments[print->segment_count++];
+    memset(segment, '\0', sizeof(print_segment));
+
+    return segment;
+}
+
+/* close the glue text written since the last worker segment */
+static cJSON_bool flush_glue(parallel_print * const print)
+{
+    print_segment *segment = NULL;
+
+    if (print->glue.offset == print->glue_start)
+    {
+        return true;
+    }
+
+    segment = add_segment(print);
+    if (segment == NULL)
+    {
+        return false;
+    }
+    segment->glue_start = print->glue_start;
+    segment->glue_length = print->glue.offset - print->glue_start;
+    print->glue_start = print->glue.offset;
+
+    return true;
+}
+
+static cJSON_bool add_work(parallel_print * const print, const cJSON * const item, const size_t count, const size_t depth, const cJSON_bool members)
+{
+    print_segment *segment = NULL;
+
+    if (!flush_glue(print))
+    {
+        return false;
+    }
+
+    segment = add_segment(print);
+    if (segment == NULL)
+    {
+        return false;
+    }
+    segment->item = item;
+    segment->count = count;
+    segment->depth = depth;
+    segment->members = members;
+
+    return true;
+}
+
+static cJSON_bool glue_text(parallel_print * const print, const char * const text, const size_t length)
+{
+    unsigned char *output_pointer = ensure(&print->glue, length + 1);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+    memcpy(output_pointer, text, length);
+    output_pointer[length] = '\0';
+    print->glue.offset += length;
+
+    return true;
+}
+
+static cJSON_bool glue_tabs(parallel_print * const print, const size_t count)
+{
+    size_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!glue_text(print, "\t", 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* split the output of item into glue text and worker segments, producing exactly what print_value would */
+static cJSON_bool plan_print(parallel_print * const print, const cJSON * const item, const size_t depth, const size_t level)
+{
+    cJSON_bool format = print->glue.format;
+    cJSON_bool is_object = cJSON_IsObject(item);
+    const cJSON *child = NULL;
+    size_t count = 0;
+
+    if (is_object || cJSON_IsArray(item))
+    {
+        for (child = item->child; child != NULL; child = child->next)
+        {
+            count++;
+        }
+    }
+
+    if (count == 0)
+    {
+        /* scalars and empty containers are cheap, print them right away */
+        print->glue.depth = depth;
+        if (!print_value(item, &print->glue))
+        {
+            return false;
+        }
+        update_offset(&print->glue);
+        return true;
+    }
+    if (level >= PARALLEL_PRINT_MAX_LEVEL)
+    {
+        /* too deep to keep looking, a worker prints it as a whole */
+        return add_work(print, item, 0, depth, false);
+    }
+
+    if (is_object)
+    {
+        if (!glue_text(print, "{\n", format ? 2 : 1))
+        {
+            return false;
+        }
+    }
+    else if (!glue_text(print, "[", 1))
+    {
+        return false;
+    }
+
+    if ((count >= PARALLEL_PRINT_MIN_SPLIT) && (count >= (2 * print->threads)))
+    {
+        /* split the children into runs of siblings */
+        size_t runs = print->threads * PARALLEL_PRINT_RUNS_PER_THREAD;
+        size_t run_size = (count + runs - 1) / runs;
+        size_t index = 0;
+
+        for (child = item->child, index = 0; child != NULL; index++, child = child->next)
+        {
+            if ((index % run_size) == 0)
+            {
+                if (!add_work(print, child, run_size, depth + 1, is_object))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    else
+    {
+        /* few children, look for large containers inside them */
+        for (child = item->child; child != NULL; child = child->next)
+        {
+            if (is_object)
+            {
+                if (format && !glue_tabs(print, depth + 1))
+                {
+                    return false;
+                }
+                print->glue.depth = depth + 1;
+                if (!print_string_ptr((unsigned char*)child->string, &print->glue))
+                {
+                    return false;
+                }
+                update_offset(&print->glue);
+                if (!glue_text(print, ":\t", format ? 2 : 1))
+                {
+                    return false;
+                }
+            }
+
+            if (!plan_print(print, child, depth + 1, level + 1))
+            {
+                return false;
+            }
+
+            if (is_object)
+            {
+                if ((child->next != NULL) && !glue_text(print, ",", 1))
+                {
+                    return false;
+                }
+                if (format && !glue_text(print, "\n", 1))
+                {
+                    return false;
+                }
+            }
+            else if ((child->next != NULL) && !glue_text(print, ", ", format ? 2 : 1))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (is_object)
+    {
+        if (format && !glue_tabs(print, depth))
+        {
+            return false;
+        }
+        return glue_text(print, "}", 1);
+    }
+
+    return glue_text(print, "]", 1);
+}
+
+static cJSON_bool print_segment_task(void *context, size_t index)
+{
+    parallel_print *print = (parallel_print*)context;
+    print_segment *segment = &print->segments[index];
+    printbuffer buffer = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 }, NULL };
+    cJSON_bool success = false;
+
+    if (segment->item == NULL)
+    {
+        return true;
+    }
+
+    buffer.hooks = print->glue.hooks;
+    buffer.format = print->glue.format;
+    buffer.depth = segment->depth;
+    buffer.length = 256;
+    buffer.buffer = (unsigned char*)buffer.hooks.allocate(buffer.length);
+    if (buffer.buffer == NULL)
+    {
+        return false;
+    }
+
+    if (segment->count == 0)
+    {
+        success = print_value(segment->item, &buffer);
+        update_offset(&buffer);
+    }
+    else if (segment->members)
+    {
+        success = print_object_members(segment->item, segment->count, &buffer);
+    }
+    else
+    {
+        success = print_array_elements(segment->item, segment->count, &buffer);
+    }
+
+    if (!success)
+    {
+        if (buffer.buffer != NULL)
+        {
+            buffer.hooks.deallocate(buffer.buffer);
+        }
+        return false;
+    }
+
+    segment->buffer = buffer.buffer;
+    segment->length = buffer.offset;
+
+    return true;
+}
+
+static void free_parallel_print(parallel_print * const print)
+{
+    size_t i = 0;
+
+    for (i = 0; i < print->segment_count; i++)
+    {
+        if (print->segments[i].buffer != NULL)
+        {
+            print->glue.hooks.deallocate(print->segments[i].buffer);
+        }
+    }
+    if (print->segments != NULL)
+    {
+        print->glue.hooks.deallocate(print->segments);
+    }
+    if (print->glue.buffer != NULL)
+    {
+        print->glue.hooks.deallocate(print->glue.buffer);
+    }
+}
+
+/* plan the output and let the pool print all worker segments */
+static cJSON_bool run_parallel_print(parallel_print * const print, const cJSON * const item, const cJSON_bool format, struct cJSONPool * const pool)
+{
+    memset(print, '\0', sizeof(parallel_print));
+    print->glue.hooks = global_hooks;
+    print->glue.format = format;
+    print->glue.length = 256;
+    print->glue.buffer = (unsigned char*)global_hooks.allocate(print->glue.length);
+    print->threads = (size_t)cJSONPool_Threads(pool);
+    if (print->glue.buffer == NULL)
+    {
+        return false;
+    }
+
+    if (!plan_print(print, item, 0, 0) || !flush_glue(print))
+    {
+        return false;
+    }
+
+    return cJSONPool_Run(pool, print->segment_count, print_segment_task, print);
+}
+
+static const unsigned char *segment_data(const parallel_print * const print, const print_segment * const segment, size_t * const length)
+{
+    if (segment->item == NULL)
+    {
+        *length = segment->glue_length;
+        return print->glue.buffer + segment->glue_start;
+    }
+
+    *length = segment->length;
+    return segment->buffer;
+}
+
+CJSON_PUBLIC(char *) cJSON_PrintParallel(const cJSON *item, cJSON_bool format, struct cJSONPool *pool)
+{
+    parallel_print print;
+    unsigned char *printed = NULL;
+    size_t total = 0;
+    size_t i = 0;
+
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    if (run_parallel_print(&print, item, format, pool))
+    {
+        for (i = 0; i < print.segment_count; i++)
+        {
+            size_t length = 0;
+            segment_data(&print, &print.segments[i], &length);
+            total += length;
+        }
+
+        printed = (unsigned char*)global_hooks.allocate(total + 1);
+        if (printed != NULL)
+        {
+            total = 0;
+            for (i = 0; i < print.segment_count; i++)
+            {
+                size_t length = 0;
+                const unsigned char *data = segment_data(&print, &print.segments[i], &length);
+                memcpy(printed + total, data, length);
+                total += length;
+            }
+            printed[total] = '\0';
+        }
+    }
+
+    free_parallel_print(&print);
+
+    return (char*)printed;
+}
+
+#if !defined(_WIN32)
+CJSON_PUBLIC(cJSON_bool) cJSON_PrintParallelToFd(const cJSON *item, cJSON_bool format, struct cJSONPool *pool, int fd)
+{
+    parallel_print print;
+    struct iovec vectors[64];
+    cJSON_bool success = false;
+    size_t next = 0;
+
+    if ((item == NULL) || (fd < 0))
+    {
+        return false;
+    }
+
+    if (!run_parallel_print(&print, item, format, pool))
+    {
+        free_parallel_print(&print);
+        return false;
+    }
+
+    success = true;
+    while (success && (next < print.segment_count))
+    {
+        int count = 0;
+        int first = 0;
+        ssize_t written = 0;
+
+        /* gather the next segments into one writev call */
+        while ((next < print.segment_count) && (count < (int)(sizeof(vectors) / sizeof(vectors[0]))))
+        {
+            size_t length = 0;
+            const unsigned char *data = segment_data(&print, &print.segments[next++], &length);
+            if (length > 0)
+            {
+                vectors[count].iov_base = (void*)(size_t)data;
+                vectors[count].iov_len = length;
+                count++;
+            }
+        }
+
+        /* writev may write less than requested, continue where it stopped */
+        while (first < count)
+        {
+            written = writev(fd, vectors + first, count - first);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                success = false;
+                break;
+            }
+            while ((first < count) && ((size_t)written >= vectors[first].iov_len))
+            {
+                written -= (ssize_t)vectors[first].iov_len;
+                first++;
+            }
+            if (first < count)
+            {
+                vectors[first].iov_base = (unsigned char*)vectors[first].iov_base + written;
+                vectors[first].iov_len -= (size_t)written;
+            }
+        }
+    }
+
+    free_parallel_print(&print);
+
+    return success;
+}
+#endif
+
+/* Get Array size/item / object item. */
+CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+{
+    cJSON *child = NULL;
+    size_t size = 0;
+
+    if (array == NULL)
+    {
+        return 0;
+    }
+
+    child = array->child;
+
+    while(child != NULL)
+    {
+        size++;
+        child = child->next;
+    }
+
+    /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
+
+    return (int)size;
+}
+
+static cJSON* get_array_item(const cJSON *array, size_t index)
+{
+    cJSON *current_child = NULL;
+
+    if (array == NULL)
+    {
+        return NULL;
+    }
+
+    current_child = array->child;
+    while ((current_child != NULL) && (index > 0))
+    {
+        index--;
+        current_child = current_child->next;
+    }
+
+    return current_child;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    if (index < 0)
+    {
+        return NULL;
+    }
+
+    return get_array_item(array, (size_t)index);
+}
+
+static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
+{
+    cJSON *current_element = NULL;
+
+    if ((object == NULL) || (name == NULL))
+    {
+        return NULL;
+    }
+
+    current_element = object->child;
+    if (case_sensitive)
+    {
+        while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
+        {
+            current_element = current_element->next;
+        }
+    }
+    else
+    {
+        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
+        {
+            current_element = current_element->next;
+        }
+    }
+
+    if ((current_element == NULL) || (current_element->string == NULL)) {
+        return NULL;
+    }
+
+    return current_element;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string)
+{
+    return get_object_item(object, string, false);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string)
+{
+    return get_object_item(object, string, true);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
+{
+    return cJSON_GetObjectItem(object, string) ? 1 : 0;
+}
+
+/* Utility for array list handling. */
+static void suffix_object(cJSON *prev, cJSON *item)
+{
+    prev->next = item;
+    item->prev = prev;
+}
+
+/* Utility for handling references. */
+static cJSON *create_reference(const cJSON *item, const internal_hooks * const hooks)
+{
+    cJSON *reference = NULL;
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    reference = cJSON_New_Item(hooks);
+    if (reference == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(reference, item, sizeof(cJSON));
+    reference->string = NULL;
+    reference->type |= cJSON_IsReference;
+    reference->type &= ~(cJSON_IsShared | cJSON_PrintCached | cJSON_InBlock | cJSON_Watched);
+    reference->references = 0;
+    reference->next = reference->prev = NULL;
+    reference->parent = NULL;
+    /* references can change behind our back, their hash is never cached */
+    reference->hash = 0;
+    return reference;
+}
+
+static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
+{
+    cJSON *child = NULL;
+
+    if ((item == NULL) || (array == NULL))
+    {
+        return false;
+    }
+
+    child = array->child;
+    item->parent = array;
+    invalidate_hash(array);
+
+    if (child == NULL)
+    {
+        /* list is empty, start new one */
+        array->child = item;
+    }
+    else
+    {
+        /* append to the end */
+        while (child->next)
+        {
+            child = child->next;
+        }
+        suffix_object(child, item);
+    }
+
+    return true;
+}
+
+/* Add item to array/object. */
+CJSON_PUBLIC(void) cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    add_item_to_array(array, item);
+}
+
+#if defined(__clang__) || (defined(__GNUC__)  && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ > 5))))
+    #pragma GCC diagnostic push
+#endif
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wcast-qual"
+#endif
+/* helper function to cast away const */
+static void* cast_away_const(const void* string)
+{
+    return (void*)string;
+}
+#if defined(__clang__) || (defined(__GNUC__)  && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ > 5))))
+    #pragma GCC diagnostic pop
+#endif
+
+
+static cJSON_bool add_item_to_object(cJSON * const object, const char * const string, cJSON * const item, const internal_hooks * const hooks, const cJSON_bool constant_key)
+{
+    char *new_key = NULL;
+    int new_type = cJSON_Invalid;
+
+    if ((object == NULL) || (string == NULL) || (item == NULL))
+    {
+        return false;
+    }
+
+    if (constant_key)
+    {
+        new_key = (char*)cast_away_const(string);
+        new_type = item->type | cJSON_StringIsConst;
+    }
+    else
+    {
+        new_key = (char*)cJSON_strdup((const unsigned char*)string, hooks);
+        if (new_key == NULL)
+        {
+            return false;
+        }
+
+        new_type = item->type & ~cJSON_StringIsConst;
+    }
+
+    if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
+    {
+        hooks->deallocate(item->string);
+    }
+
+    item->string = new_key;
+    item->type = new_type;
+
+    return add_item_to_array(object, item);
+}
+
+CJSON_PUBLIC(void) cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+    add_item_to_object(object, string, item, &global_hooks, false);
+}
+
+/* Add an item to an object with constant string as key */
+CJSON_PUBLIC(void) cJSON_AddItemToObjectCS(cJSON *object, const char *string, cJSON *item)
+{
+    add_item_to_object(object, string, item, &global_hooks, true);
+}
+
+CJSON_PUBLIC(void) cJSON_AddItemReferenceToArray(cJSON *array, cJSON *item)
+{
+    if (array == NULL)
+    {
+        return;
+    }
+
+    add_item_to_array(array, create_reference(item, &global_hooks));
+}
+
+CJSON_PUBLIC(void) cJSON_AddItemReferenceToObject(cJSON *object, const char *string, cJSON *item)
+{
+    if ((object == NULL) || (string == NULL))
+    {
+        return;
+    }
+
+    add_item_to_object(object, string, create_reference(item, &global_hooks), &global_hooks, false);
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddNullToObject(cJSON * const object, const char * const name)
+{
+    cJSON *null = cJSON_CreateNull();
+    if (add_item_to_object(object, name, null, &global_hooks, false))
+    {
+        return null;
+    }
+
+    cJSON_Delete(null);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddTrueToObject(cJSON * const object, const char * const name)
+{
+    cJSON *true_item = cJSON_CreateTrue();
+    if (add_item_to_object(object, name, true_item, &global_hooks, false))
+    {
+        return true_item;
+    }
+
+    cJSON_Delete(true_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddFalseToObject(cJSON * const object, const char * const name)
+{
+    cJSON *false_item = cJSON_CreateFalse();
+    if (add_item_to_object(object, name, false_item, &global_hooks, false))
+    {
+        return false_item;
+    }
+
+    cJSON_Delete(false_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddBoolToObject(cJSON * const object, const char * const name, const cJSON_bool boolean)
+{
+    cJSON *bool_item = cJSON_CreateBool(boolean);
+    if (add_item_to_object(object, name, bool_item, &global_hooks, false))
+    {
+        return bool_item;
+    }
+
+    cJSON_Delete(bool_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const double number)
+{
+    cJSON *number_item = cJSON_CreateNumber(number);
+    if (add_item_to_object(object, name, number_item, &global_hooks, false))
+    {
+        return number_item;
+    }
+
+    cJSON_Delete(number_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddStringToObject(cJSON * const object, const char * const name, const char * const string)
+{
+    cJSON *string_item = cJSON_CreateString(string);
+    if (add_item_to_object(object, name, string_item, &global_hooks, false))
+    {
+        return string_item;
+    }
+
+    cJSON_Delete(string_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddRawToObject(cJSON * const object, const char * const name, const char * const raw)
+{
+    cJSON *raw_item = cJSON_CreateRaw(raw);
+    if (add_item_to_object(object, name, raw_item, &global_hooks, false))
+    {
+        return raw_item;
+    }
+
+    cJSON_Delete(raw_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddObjectToObject(cJSON * const object, const char * const name)
+{
+    cJSON *object_item = cJSON_CreateObject();
+    if (add_item_to_object(object, name, object_item, &global_hooks, false))
+    {
+        return object_item;
+    }
+
+    cJSON_Delete(object_item);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_AddArrayToObject(cJSON * const object, const char * const name)
+{
+    cJSON *array = cJSON_CreateArray();
+    if (add_item_to_object(object, name, array, &global_hooks, false))
+    {
+        return array;
+    }
+
+    cJSON_Delete(array);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const item)
+{
+    if ((parent == NULL) || (item == NULL))
+    {
+        return NULL;
+    }
+
+    if (item->prev != NULL)
+    {
+        /* not the first element */
+        item->prev->next = item->next;
+    }
+    if (item->next != NULL)
+    {
+        /* not the last element */
+        item->next->prev = item->prev;
+    }
+
+    if (item == parent->child)
+    {
+        /* first element */
+        parent->child = item->next;
+    }
+    /* make sure the detached item doesn't point anywhere anymore */
+    item->prev = NULL;
+    item->next = NULL;
+    item->parent = NULL;
+    invalidate_hash(parent);
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromArray(cJSON *array, int which)
+{
+    if (which < 0)
+    {
+        return NULL;
+    }
+
+    return cJSON_DetachItemViaPointer(array, get_array_item(array, (size_t)which));
+}
+
+CJSON_PUBLIC(void) cJSON_DeleteItemFromArray(cJSON *array, int which)
+{
+    cJSON_Delete(cJSON_DetachItemFromArray(array, which));
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromObject(cJSON *object, const char *string)
+{
+    cJSON *to_detach = cJSON_GetObjectItem(object, string);
+
+    return cJSON_DetachItemViaPointer(object, to_detach);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromObjectCaseSensitive(cJSON *object, const char *string)
+{
+    cJSON *to_detach = cJSON_GetObjectItemCaseSensitive(object, string);
+
+    return cJSON_DetachItemViaPointer(object, to_detach);
+}
+
+CJSON_PUBLIC(void) cJSON_DeleteItemFromObject(cJSON *object, const char *string)
+{
+    cJSON_Delete(cJSON_DetachItemFromObject(object, string));
+}
+
+CJSON_PUBLIC(void) cJSON_DeleteItemFromObjectCaseSensitive(cJSON *object, const char *string)
+{
+    cJSON_Delete(cJSON_DetachItemFromObjectCaseSensitive(object, string));
+}
+
+/* Replace array/object items with new ones. */
+CJSON_PUBLIC(void) cJSON_InsertItemInArray(cJSON *array, int which, cJSON *newitem)
+{
+    cJSON *after_inserted = NULL;
+
+    if (which < 0)
+    {
+        return;
+    }
+
+    after_inserted = get_array_item(array, (size_t)which);
+    if (after_inserted == NULL)
+    {
+        add_item_to_array(array, newitem);
+        return;
+    }
+
+    newitem->parent = array;
+    invalidate_hash(array);
+    newitem->next = after_inserted;
+    newitem->prev = after_inserted->prev;
+    after_inserted->prev = newitem;
+    if (after_inserted == array->child)
+    {
+        array->child = newitem;
+    }
+    else
+    {
+        newitem->prev->next = newitem;
+    }
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON * const item, cJSON * replacement)
+{
+    if ((parent == NULL) || (replacement == NULL) || (item == NULL))
+    {
+        return false;
+    }
+
+    if (replacement == item)
+    {
+        return true;
+    }
+
+    replacement->parent = parent;
+    invalidate_hash(parent);
+    replacement->next = item->next;
+    replacement->prev = item->prev;
+
+    if (replacement->next != NULL)
+    {
+        replacement->next->prev = replacement;
+    }
+    if (replacement->prev != NULL)
+    {
+        replacement->prev->next = replacement;
+    }
+    if (parent->child == item)
+    {
+        parent->child = replacement;
+    }
+
+    item->next = NULL;
+    item->prev = NULL;
+    item->parent = NULL;
+    cJSON_Delete(item);
+
+    return true;
+}
+
+CJSON_PUBLIC(void) cJSON_ReplaceItemInArray(cJSON *array, int which, cJSON *newitem)
+{
+    if (which < 0)
+    {
+        return;
+    }
+
+    cJSON_ReplaceItemViaPointer(array, get_array_item(array, (size_t)which), newitem);
+}
+
+static cJSON_bool replace_item_in_object(cJSON *object, const char *string, cJSON *replacement, cJSON_bool case_sensitive)
+{
+    if ((replacement == NULL) || (string == NULL))
+    {
+        return false;
+    }
+
+    /* replace the name in the replacement */
+    if (!(replacement->type & cJSON_StringIsConst) && (replacement->string != NULL))
+    {
+        cJSON_free(replacement->string);
+    }
+    replacement->string = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
+    replacement->type &= ~cJSON_StringIsConst;
+
+    cJSON_ReplaceItemViaPointer(object, get_object_item(object, string, case_sensitive), replacement);
+
+    return true;
+}
+
+CJSON_PUBLIC(void) cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem)
+{
+    replace_item_in_object(object, string, newitem, false);
+}
+
+CJSON_PUBLIC(void) cJSON_ReplaceItemInObjectCaseSensitive(cJSON *object, const char *string, cJSON *newitem)
+{
+    replace_item_in_object(object, string, newitem, true);
+}
+
+/* Create basic types: */
+CJSON_PUBLIC(cJSON *) cJSON_CreateNull(void)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_NULL;
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateTrue(void)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_True;
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateFalse(void)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_False;
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateBool(cJSON_bool b)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = b ? cJSON_True : cJSON_False;
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_Number;
+        item->valuedouble = num;
+
+        /* use saturation in case of overflow */
+        if (num >= INT_MAX)
+        {
+            item->valueint = INT_MAX;
+        }
+        else if (num <= (double)INT_MIN)
+        {
+            item->valueint = INT_MIN;
+        }
+        else
+        {
+            item->valueint = (int)num;
+        }
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateString(const char *string)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_String;
+        item->valuestring = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
+        if(!item->valuestring)
+        {
+            cJSON_Delete(item);
+            return NULL;
+        }
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateStringReference(const char *string)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if (item != NULL)
+    {
+        item->type = cJSON_String | cJSON_IsReference;
+        item->valuestring = (char*)cast_away_const(string);
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateObjectReference(const cJSON *child)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if (item != NULL) {
+        item->type = cJSON_Object | cJSON_IsReference;
+        item->child = (cJSON*)cast_away_const(child);
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateArrayReference(const cJSON *child) {
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if (item != NULL) {
+        item->type = cJSON_Array | cJSON_IsReference;
+        item->child = (cJSON*)cast_away_const(child);
     }
 
-    add_item_to_array(array, create_reference(item, &global_hooks));
+    return item;
+}
+
+/* append shared items for every item in the list starting at child to the (empty) children of parent */
+static cJSON_bool share_children(cJSON * const parent, const cJSON *child)
+{
+    cJSON *tail = NULL;
+
+    for (; child != NULL; child = child->next)
+    {
+        cJSON *shared = cJSON_CreateSharedReference(child);
+        if (shared == NULL)
+        {
+            cJSON_Delete(parent->child);
+            parent->child = NULL;
+            return false;
+        }
+        shared->parent = parent;
+        if (tail == NULL)
+        {
+            parent->child = shared;
+        }
+        else
+        {
+            tail->next = shared;
+            shared->prev = tail;
+        }
+        tail = shared;
+    }
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateSharedReference(const cJSON *item)
+{
+    cJSON *shared = NULL;
+    cJSON *owner = NULL;
+
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    if (item->type & cJSON_InBlock)
+    {
+        /* the block of a cJSON_DuplicateBlock copy can't outlive its root, the items are copied instead */
+        return cJSON_Duplicate(item, true);
+    }
+
+    if (!(item->type & cJSON_IsReference) || (item->type & cJSON_IsShared))
+    {
+        if (!(cJSON_IsArray(item) || cJSON_IsObject(item)) || (item->child == NULL))
+        {
+            /* nothing to share */
+            return cJSON_Duplicate(item, false);
+        }
+
+        owner = (item->type & cJSON_IsShared) ? item->child->parent : (cJSON*)cast_away_const(item);
+        if ((owner->parent == NULL) && (owner->references == 0))
+        {
+            /* roots are never counted (cJSON_Delete would take them for items that are kept for other versions),
+             * they are copied and their children are shared */
+            shared = cJSON_Duplicate(item, false);
+            if ((shared != NULL) && !share_children(shared, item->child))
+            {
+                cJSON_Delete(shared);
+                shared = NULL;
+            }
+            return shared;
+        }
+    }
+
+    /* plain references are copied as they are */
+    shared = cJSON_New_Item(&global_hooks);
+    if (shared == NULL)
+    {
+        return NULL;
+    }
+    memcpy(shared, item, sizeof(cJSON));
+    shared->next = NULL;
+    shared->prev = NULL;
+    shared->parent = NULL;
+    shared->references = 0;
+    shared->type &= ~(cJSON_PrintCached | cJSON_Watched);
+    if ((item->string != NULL) && !(item->type & cJSON_StringIsConst))
+    {
+        shared->string = (char*)cJSON_strdup((const unsigned char*)item->string, &global_hooks);
+        if (shared->string == NULL)
+        {
+            global_hooks.deallocate(shared);
+            return NULL;
+        }
+    }
+    if (owner != NULL)
+    {
+        shared->type |= cJSON_IsReference | cJSON_IsShared;
+        owner->references++;
+    }
+
+    return shared;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_Unshare(cJSON * const item)
+{
+    cJSON *owner = NULL;
+    cJSON *children = NULL;
+
+    if ((item == NULL) || !(item->type & cJSON_IsReference) || !(cJSON_IsArray(item) || cJSON_IsObject(item)))
+    {
+        return true;
+    }
+
+    owner = ((item->type & cJSON_IsShared) && (item->child != NULL)) ? item->child->parent : NULL;
+    children = item->child;
+    item->child = NULL;
+    if (!share_children(item, children))
+    {
+        item->child = children;
+        return false;
+    }
+    /* same contents, the hash stays */
+    item->type &= ~(cJSON_IsReference | cJSON_IsShared);
+    if (owner != NULL)
+    {
+        release_shared(owner);
+    }
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateRaw(const char *raw)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type = cJSON_Raw;
+        item->valuestring = (char*)cJSON_strdup((const unsigned char*)raw, &global_hooks);
+        if(!item->valuestring)
+        {
+            cJSON_Delete(item);
+            return NULL;
+        }
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateArray(void)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if(item)
+    {
+        item->type=cJSON_Array;
+    }
+
+    return item;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateObject(void)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if (item)
+    {
+        item->type = cJSON_Object;
+    }
+
+    return item;
+}
+
+/* Create Arrays: */
+CJSON_PUBLIC(cJSON *) cJSON_CreateIntArray(const int *numbers, int count)
+{
+    size_t i = 0;
+    cJSON *n = NULL;
+    cJSON *p = NULL;
+    cJSON *a = NULL;
+
+    if ((count < 0) || (numbers == NULL))
+    {
+        return NULL;
+    }
+
+    a = cJSON_CreateArray();
+    for(i = 0; a && (i < (size_t)count); i++)
+    {
+        n = cJSON_CreateNumber(numbers[i]);
+        if (!n)
+        {
+            cJSON_Delete(a);
+            return NULL;
+        }
+        n->parent = a;
+        if(!i)
+        {
+            a->child = n;
+        }
+        else
+        {
+            suffix_object(p, n);
+        }
+        p = n;
+    }
+
+    return a;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateFloatArray(const float *numbers, int count)
+{
+    size_t i = 0;
+    cJSON *n = NULL;
+    cJSON *p = NULL;
+    cJSON *a = NULL;
+
+    if ((count < 0) || (numbers == NULL))
+    {
+        return NULL;
+    }
+
+    a = cJSON_CreateArray();
+
+    for(i = 0; a && (i < (size_t)count); i++)
+    {
+        n = cJSON_CreateNumber((double)numbers[i]);
+        if(!n)
+        {
+            cJSON_Delete(a);
+            return NULL;
+        }
+        n->parent = a;
+        if(!i)
+        {
+            a->child = n;
+        }
+        else
+        {
+            suffix_object(p, n);
+        }
+        p = n;
+    }
+
+    return a;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateDoubleArray(const double *numbers, int count)
+{
+    size_t i = 0;
+    cJSON *n = NULL;
+    cJSON *p = NULL;
+    cJSON *a = NULL;
+
+    if ((count < 0) || (numbers == NULL))
+    {
+        return NULL;
+    }
+
+    a = cJSON_CreateArray();
+
+    for(i = 0;a && (i < (size_t)count); i++)
+    {
+        n = cJSON_CreateNumber(numbers[i]);
+        if(!n)
+        {
+            cJSON_Delete(a);
+            return NULL;
+        }
+        n->parent = a;
+        if(!i)
+        {
+            a->child = n;
+        }
+        else
+        {
+            suffix_object(p, n);
+        }
+        p = n;
+    }
+
+    return a;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char **strings, int count)
+{
+    size_t i = 0;
+    cJSON *n = NULL;
+    cJSON *p = NULL;
+    cJSON *a = NULL;
+
+    if ((count < 0) || (strings == NULL))
+    {
+        return NULL;
+    }
+
+    a = cJSON_CreateArray();
+
+    for (i = 0; a && (i < (size_t)count); i++)
+    {
+        n = cJSON_CreateString(strings[i]);
+        if(!n)
+        {
+            cJSON_Delete(a);
+            return NULL;
+        }
+        n->parent = a;
+        if(!i)
+        {
+            a->child = n;
+        }
+        else
+        {
+            suffix_object(p,n);
+        }
+        p = n;
+    }
+
+    return a;
+}
+
+/* Pre-order walk over a subtree without recursion. The ancestors of the current item are kept on a stack instead of following
+ * ->parent, which doesn't lead back to the items that children reached through references were found from. */
+typedef struct
+{
+    const cJSON **stack;
+    size_t depth;
+    size_t size;
+    const cJSON *initial[32];
+} item_walk;
+
+static void start_item_walk(item_walk * const walk)
+{
+    walk->stack = walk->initial;
+    walk->depth = 0;
+    walk->size = sizeof(walk->initial) / sizeof(walk->initial[0]);
 }
 
-CJSON_PUBLIC(void) cJSON_AddItemReferenceToObject(cJSON *object, const char *string, cJSON *item)
+/* advance *item to the next item of the subtree, NULL at the end. Returns false if the stack couldn't grow */
+static cJSON_bool item_walk_next(item_walk * const walk, const cJSON ** const item)
 {
-    if ((object == NULL) || (string == NULL))
+    const cJSON *current = *item;
+
+    if (current->child != NULL)
     {
-        return;
+        if ((walk->depth == walk->size) && !grow_stack((void**)&walk->stack, &walk->size, sizeof(cJSON*), walk->initial))
+        {
+            return false;
+        }
+        walk->stack[walk->depth++] = current;
+        *item = current->child;
+        return true;
     }
 
-    add_item_to_object(object, string, create_reference(item, &global_hooks), &global_hooks, false);
-}
-
-CJSON_PUBLIC(cJSON*) cJSON_AddNullToObject(cJSON * const object, const char * const name)
-{
-    cJSON *null = cJSON_CreateNull();
-    if (add_item_to_object(object, name, null, &global_hooks, false))
+    while ((walk->depth > 0) && (current->next == NULL))
     {
-        return null;
+        current = walk->stack[--walk->depth];
     }
+    *item = (walk->depth > 0) ? current->next : NULL;
 
-    cJSON_Delete(null);
-    return NULL;
+    return true;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddTrueToObject(cJSON * const object, const char * const name)
+/* Link the copy of the item a walk just reached to the copies made so far: *last is the copy of the previous item and
+ * *depth the depth it was at. */
+static void link_walk_copy(const item_walk * const walk, cJSON * const copy, cJSON ** const last, size_t * const depth)
 {
-    cJSON *true_item = cJSON_CreateTrue();
-    if (add_item_to_object(object, name, true_item, &global_hooks, false))
+    if (walk->depth > *depth)
     {
-        return true_item;
+        /* first child of the last item */
+        copy->parent = *last;
+        (*last)->child = copy;
     }
-
-    cJSON_Delete(true_item);
-    return NULL;
+    else
+    {
+        for (; *depth > walk->depth; (*depth)--)
+        {
+            *last = (*last)->parent;
+        }
+        copy->parent = (*last)->parent;
+        copy->prev = *last;
+        (*last)->next = copy;
+    }
+    *depth = walk->depth;
+    *last = copy;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddFalseToObject(cJSON * const object, const char * const name)
+/* copy everything but the children and the links of item */
+static cJSON_bool duplicate_value(const cJSON * const item, cJSON * const newitem)
 {
-    cJSON *false_item = cJSON_CreateFalse();
-    if (add_item_to_object(object, name, false_item, &global_hooks, false))
+    /* Copy over all vars */
+    newitem->type = item->type & (~(cJSON_IsReference | cJSON_IsShared | cJSON_PrintCached | cJSON_InBlock | cJSON_Watched));
+    newitem->valueint = item->valueint;
+    newitem->valuedouble = item->valuedouble;
+    if (item->valuestring)
     {
-        return false_item;
+        newitem->valuestring = (char*)cJSON_strdup((unsigned char*)item->valuestring, &global_hooks);
+        if (!newitem->valuestring)
+        {
+            return false;
+        }
+    }
+    if (item->string)
+    {
+        /* keys of cJSON_InBlock items are only constant as long as their block lives */
+        if ((item->type & cJSON_StringIsConst) && !(item->type & cJSON_InBlock))
+        {
+            newitem->string = item->string;
+        }
+        else
+        {
+            newitem->string = (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
+            newitem->type &= ~cJSON_StringIsConst;
+        }
+        if (!newitem->string)
+        {
+            return false;
+        }
     }
 
-    cJSON_Delete(false_item);
-    return NULL;
+    return true;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddBoolToObject(cJSON * const object, const char * const name, const cJSON_bool boolean)
+/* Duplication */
+CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
 {
-    cJSON *bool_item = cJSON_CreateBool(boolean);
-    if (add_item_to_object(object, name, bool_item, &global_hooks, false))
+    item_walk walk;
+    const cJSON *source = item;
+    cJSON *newitem = NULL;
+    cJSON *newchild = NULL;
+    cJSON *last = NULL;
+    size_t depth = 0;
+
+    start_item_walk(&walk);
+
+    /* Bail on bad ptr */
+    if (!item)
     {
-        return bool_item;
+        goto fail;
+    }
+    /* Create new item */
+    newitem = cJSON_New_Item(&global_hooks);
+    if (!newitem)
+    {
+        goto fail;
+    }
+    if (!duplicate_value(item, newitem))
+    {
+        goto fail;
+    }
+    /* If non-recursive, then we're done! */
+    if (!recurse)
+    {
+        if (item->child == NULL)
+        {
+            newitem->hash = item->hash;
+        }
+        return newitem;
     }
 
-    cJSON_Delete(bool_item);
-    return NULL;
-}
-
-CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const double number)
-{
-    cJSON *number_item = cJSON_CreateNumber(number);
-    if (add_item_to_object(object, name, number_item, &global_hooks, false))
+    /* Walk the children in order without recursion, every copy is linked to its parent as soon as it is created */
+    last = newitem;
+    for (;;)
     {
-        return number_item;
+        if (!item_walk_next(&walk, &source))
+        {
+            goto fail;
+        }
+        if (source == NULL)
+        {
+            break;
+        }
+        newchild = cJSON_New_Item(&global_hooks);
+        if (!newchild)
+        {
+            goto fail;
+        }
+        link_walk_copy(&walk, newchild, &last, &depth);
+        if (!duplicate_value(source, newchild))
+        {
+            goto fail;
+        }
+        /* the copy is equal, so is its hash */
+        newchild->hash = source->hash;
     }
+    newitem->hash = item->hash;
+    free_stack(walk.stack, walk.initial);
 
-    cJSON_Delete(number_item);
-    return NULL;
-}
+    return newitem;
 
-CJSON_PUBLIC(cJSON*) cJSON_AddStringToObject(cJSON * const object, const char * const name, const char * const string)
-{
-    cJSON *string_item = cJSON_CreateString(string);
-    if (add_item_to_object(object, name, string_item, &global_hooks, false))
+fail:
+    free_stack(walk.stack, walk.initial);
+    if (newitem != NULL)
     {
-        return string_item;
+        cJSON_Delete(newitem);
     }
 
-    cJSON_Delete(string_item);
     return NULL;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddRawToObject(cJSON * const object, const char * const name, const char * const raw)
+/* bytes the strings of item take in the block */
+static size_t block_strings_size(const cJSON * const item)
 {
-    cJSON *raw_item = cJSON_CreateRaw(raw);
-    if (add_item_to_object(object, name, raw_item, &global_hooks, false))
+    size_t size = 0;
+
+    if (item->valuestring != NULL)
     {
-        return raw_item;
+        size += strlen(item->valuestring) + sizeof("");
+    }
+    if ((item->string != NULL) && !(item->type & cJSON_StringIsConst))
+    {
+        size += strlen(item->string) + sizeof("");
     }
 
-    cJSON_Delete(raw_item);
-    return NULL;
+    return size;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddObjectToObject(cJSON * const object, const char * const name)
+/* keys and values are mostly short, a plain loop beats strlen and memcpy for them */
+static char *copy_block_string(const char *string, unsigned char ** const strings)
 {
-    cJSON *object_item = cJSON_CreateObject();
-    if (add_item_to_object(object, name, object_item, &global_hooks, false))
+    char *copy = (char*)*strings;
+    unsigned char *destination = *strings;
+
+    while ((*destination++ = (unsigned char)*string++) != '\0')
     {
-        return object_item;
     }
+    *strings = destination;
 
-    cJSON_Delete(object_item);
-    return NULL;
+    return copy;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddArrayToObject(cJSON * const object, const char * const name)
+CJSON_PUBLIC(cJSON *) cJSON_DuplicateBlock(const cJSON *item)
 {
-    cJSON *array = cJSON_CreateArray();
-    if (add_item_to_object(object, name, array, &global_hooks, false))
+    item_walk walk;
+    const cJSON *source = NULL;
+    cJSON *block = NULL;
+    cJSON *copy = NULL;
+    cJSON *last = NULL;
+    unsigned char *strings = NULL;
+    size_t items = 0;
+    size_t bytes = 0;
+    size_t depth = 0;
+
+    if (item == NULL)
     {
-        return array;
+        return NULL;
     }
 
-    cJSON_Delete(array);
-    return NULL;
-}
+    start_item_walk(&walk);
 
-CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const item)
-{
-    if ((parent == NULL) || (item == NULL))
+    /* measure the subtree, the strings of the root are allocated on their own so it can be treated like any other root */
+    source = item;
+    while (source != NULL)
     {
-        return NULL;
+        items++;
+        if (source != item)
+        {
+            bytes += block_strings_size(source);
+        }
+        if (!item_walk_next(&walk, &source))
+        {
+            goto fail;
+        }
     }
 
-    if (item->prev != NULL)
+    /* the root is at the start of the block, so freeing it frees the whole block */
+    block = (cJSON*)global_hooks.allocate(items * sizeof(cJSON) + bytes);
+    if (block == NULL)
     {
-        /* not the first element */
-        item->prev->next = item->next;
+        goto fail;
     }
-    if (item->next != NULL)
+    memset(block, '\0', items * sizeof(cJSON));
+    strings = (unsigned char*)(block + items);
+
+    block->type = item->type & ~(cJSON_IsReference | cJSON_IsShared | cJSON_PrintCached | cJSON_InBlock | cJSON_Watched);
+    block->valueint = item->valueint;
+    block->valuedouble = item->valuedouble;
+    block->hash = item->hash;
+    if (item->valuestring != NULL)
     {
-        /* not the last element */
-        item->next->prev = item->prev;
+        block->valuestring = (char*)cJSON_strdup((const unsigned char*)item->valuestring, &global_hooks);
+        if (block->valuestring == NULL)
+        {
+            goto fail;
+        }
+    }
+    if (item->string != NULL)
+    {
+        block->string = (item->type & cJSON_StringIsConst) ? item->string : (char*)cJSON_strdup((const unsigned char*)item->string, &global_hooks);
+        if (block->string == NULL)
+        {
+            goto fail;
+        }
     }
 
-    if (item == parent->child)
+    /* copy the rest in the same order, linking every item to the last one copied or one of its ancestors */
+    source = item;
+    last = block;
+    for (copy = block + 1; copy < block + items; copy++)
     {
-        /* first element */
-        parent->child = item->next;
+        if (!item_walk_next(&walk, &source))
+        {
+            goto fail;
+        }
+
+        link_walk_copy(&walk, copy, &last, &depth);
+
+        copy->type = (source->type & ~(cJSON_IsReference | cJSON_IsShared | cJSON_PrintCached | cJSON_Watched)) | cJSON_InBlock;
+        copy->valueint = source->valueint;
+        copy->valuedouble = source->valuedouble;
+        copy->hash = source->hash;
+        if (source->valuestring != NULL)
+        {
+            copy->valuestring = copy_block_string(source->valuestring, &strings);
+            copy->type |= cJSON_IsReference;
+        }
+        if (source->string != NULL)
+        {
+            copy->string = (source->type & cJSON_StringIsConst) ? source->string : copy_block_string(source->string, &strings);
+            copy->type |= cJSON_StringIsConst;
+        }
     }
-    /* make sure the detached item doesn't point anywhere anymore */
-    item->prev = NULL;
-    item->next = NULL;
 
-    return item;
-}
+    free_stack(walk.stack, walk.initial);
 
-CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromArray(cJSON *array, int which)
-{
-    if (which < 0)
+    return block;
+
+fail:
+    free_stack(walk.stack, walk.initial);
+    if (block != NULL)
     {
-        return NULL;
+        if (block->valuestring != NULL)
+        {
+            global_hooks.deallocate(block->valuestring);
+        }
+        if ((block->string != NULL) && !(block->type & cJSON_StringIsConst))
+        {
+            global_hooks.deallocate(block->string);
+        }
+        global_hooks.deallocate(block);
     }
 
-    return cJSON_DetachItemViaPointer(array, get_array_item(array, (size_t)which));
+    return NULL;
 }
 
-CJSON_PUBLIC(void) cJSON_DeleteItemFromArray(cJSON *array, int which)
+static void skip_oneline_comment(char **input)
 {
-    cJSON_Delete(cJSON_DetachItemFromArray(array, which));
+    *input += static_strlen("//");
+
+    for (; (*input)[0] != '\0'; ++(*input))
+    {
+        if ((*input)[0] == '\n') {
+            *input += static_strlen("\n");
+            return;
+        }
+    }
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromObject(cJSON *object, const char *string)
+static void skip_multiline_comment(char **input)
 {
-    cJSON *to_detach = cJSON_GetObjectItem(object, string);
+    *input += static_strlen("/*");
 
-    return cJSON_DetachItemViaPointer(object, to_detach);
+    for (; (*input)[0] != '\0'; ++(*input))
+    {
+        if (((*input)[0] == '*') && ((*input)[1] == '/'))
+        {
+            *input += static_strlen("*/");
+            return;
+        }
+    }
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_DetachItemFromObjectCaseSensitive(cJSON *object, const char *string)
-{
-    cJSON *to_detach = cJSON_GetObjectItemCaseSensitive(object, string);
+static void minify_string(char **input, char **output) {
+    (*output)[0] = (*input)[0];
+    *input += static_strlen("\"");
+    *output += static_strlen("\"");
 
-    return cJSON_DetachItemViaPointer(object, to_detach);
-}
 
-CJSON_PUBLIC(void) cJSON_DeleteItemFromObject(cJSON *object, const char *string)
-{
-    cJSON_Delete(cJSON_DetachItemFromObject(object, string));
-}
+    for (; (*input)[0] != '\0'; (void)++(*input), ++(*output)) {
+        (*output)[0] = (*input)[0];
 
-CJSON_PUBLIC(void) cJSON_DeleteItemFromObjectCaseSensitive(cJSON *object, const char *string)
-{
-    cJSON_Delete(cJSON_DetachItemFromObjectCaseSensitive(object, string));
+        if ((*input)[0] == '\"') {
+            (*output)[0] = '\"';
+            *input += static_strlen("\"");
+            *output += static_strlen("\"");
+            return;
+        } else if (((*input)[0] == '\\') && ((*input)[1] == '\"')) {
+            (*output)[1] = (*input)[1];
+            *input += static_strlen("\"");
+            *output += static_strlen("\"");
+        }
+    }
 }
 
-/* Replace array/object items with new ones. */
-CJSON_PUBLIC(void) cJSON_InsertItemInArray(cJSON *array, int which, cJSON *newitem)
+CJSON_PUBLIC(void) cJSON_Minify(char *json)
 {
-    cJSON *after_inserted = NULL;
+    char *into = json;
 
-    if (which < 0)
+    if (json == NULL)
     {
         return;
     }
 
-    after_inserted = get_array_item(array, (size_t)which);
-    if (after_inserted == NULL)
+    while (json[0] != '\0')
     {
-        add_item_to_array(array, newitem);
-        return;
-    }
+        switch (json[0])
+        {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                json++;
+                break;
 
-    newitem->next = after_inserted;
-    newitem->prev = after_inserted->prev;
-    after_inserted->prev = newitem;
-    if (after_inserted == array->child)
-    {
-        array->child = newitem;
-    }
-    else
-    {
-        newitem->prev->next = newitem;
-    }
-}
+            case '/':
+                if (json[1] == '/')
+                {
+                    skip_oneline_comment(&json);
+                }
+                else if (json[1] == '*')
+                {
+                    skip_multiline_comment(&json);
+                } else {
+                    json++;
+                }
+                break;
 
-CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON * const item, cJSON * replacement)
-{
-    if ((parent == NULL) || (replacement == NULL) || (item == NULL))
-    {
-        return false;
-    }
+            case '\"':
+                minify_string(&json, (char**)&into);
+                break;
 
-    if (replacement == item)
-    {
-        return true;
+            default:
+                into[0] = json[0];
+                json++;
+                into++;
+        }
     }
 
-    replacement->next = item->next;
-    replacement->prev = item->prev;
+    /* and null-terminate. */
+    *into = '\0';
+}
 
-    if (replacement->next != NULL)
-    {
-        replacement->next->prev = replacement;
-    }
-    if (replacement->prev != NULL)
-    {
-        replacement->prev->next = replacement;
-    }
-    if (parent->child == item)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsInvalid(const cJSON * const item)
+{
+    if (item == NULL)
     {
-        parent->child = replacement;
+        return false;
     }
 
-    item->next = NULL;
-    item->prev = NULL;
-    cJSON_Delete(item);
-
-    return true;
+    return (item->type & 0xFF) == cJSON_Invalid;
 }
 
-CJSON_PUBLIC(void) cJSON_ReplaceItemInArray(cJSON *array, int which, cJSON *newitem)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsFalse(const cJSON * const item)
 {
-    if (which < 0)
+    if (item == NULL)
     {
-        return;
+        return false;
     }
 
-    cJSON_ReplaceItemViaPointer(array, get_array_item(array, (size_t)which), newitem);
+    return (item->type & 0xFF) == cJSON_False;
 }
 
-static cJSON_bool replace_item_in_object(cJSON *object, const char *string, cJSON *replacement, cJSON_bool case_sensitive)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsTrue(const cJSON * const item)
 {
-    if ((replacement == NULL) || (string == NULL))
+    if (item == NULL)
     {
         return false;
     }
 
-    /* replace the name in the replacement */
-    if (!(replacement->type & cJSON_StringIsConst) && (replacement->string != NULL))
-    {
-        cJSON_free(replacement->string);
-    }
-    replacement->string = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
-    replacement->type &= ~cJSON_StringIsConst;
-
-    cJSON_ReplaceItemViaPointer(object, get_object_item(object, string, case_sensitive), replacement);
-
-    return true;
-}
-
-CJSON_PUBLIC(void) cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem)
-{
-    replace_item_in_object(object, string, newitem, false);
+    return (item->type & 0xff) == cJSON_True;
 }
 
-CJSON_PUBLIC(void) cJSON_ReplaceItemInObjectCaseSensitive(cJSON *object, const char *string, cJSON *newitem)
-{
-    replace_item_in_object(object, string, newitem, true);
-}
 
-/* Create basic types: */
-CJSON_PUBLIC(cJSON *) cJSON_CreateNull(void)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsBool(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = cJSON_NULL;
+        return false;
     }
 
-    return item;
+    return (item->type & (cJSON_True | cJSON_False)) != 0;
 }
-
-CJSON_PUBLIC(cJSON *) cJSON_CreateTrue(void)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsNull(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = cJSON_True;
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_NULL;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateFalse(void)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsNumber(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = cJSON_False;
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_Number;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateBool(cJSON_bool b)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsString(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = b ? cJSON_True : cJSON_False;
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_String;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsArray(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = cJSON_Number;
-        item->valuedouble = num;
-
-        /* use saturation in case of overflow */
-        if (num >= INT_MAX)
-        {
-            item->valueint = INT_MAX;
-        }
-        else if (num <= (double)INT_MIN)
-        {
-            item->valueint = INT_MIN;
-        }
-        else
-        {
-            item->valueint = (int)num;
-        }
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_Array;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateString(const char *string)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsObject(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    if (item == NULL)
     {
-        item->type = cJSON_String;
-        item->valuestring = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
-        if(!item->valuestring)
-        {
-            cJSON_Delete(item);
-            return NULL;
-        }
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_Object;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateStringReference(const char *string)
+CJSON_PUBLIC(cJSON_bool) cJSON_IsRaw(const cJSON * const item)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if (item != NULL)
+    if (item == NULL)
     {
-        item->type = cJSON_String | cJSON_IsReference;
-        item->valuestring = (char*)cast_away_const(string);
+        return false;
     }
 
-    return item;
+    return (item->type & 0xFF) == cJSON_Raw;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateObjectReference(const cJSON *child)
+/* finalizer of splitmix64, spreads the bits of a combined hash */
+static unsigned long long mix_hash(unsigned long long hash)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if (item != NULL) {
-        item->type = cJSON_Object | cJSON_IsReference;
-        item->child = (cJSON*)cast_away_const(child);
-    }
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
 
-    return item;
+    return hash;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateArrayReference(const cJSON *child) {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if (item != NULL) {
-        item->type = cJSON_Array | cJSON_IsReference;
-        item->child = (cJSON*)cast_away_const(child);
+/* 64 bit FNV-1a */
+static unsigned long long hash_bytes(unsigned long long hash, const unsigned char *bytes, size_t length)
+{
+    for (; length > 0; (void)bytes++, length--)
+    {
+        hash ^= (unsigned long long)*bytes;
+        hash *= 0x100000001B3ULL;
     }
 
-    return item;
+    return hash;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateRaw(const char *raw)
+/* an array or object compute_hash is inside of */
+typedef struct
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
+    cJSON *item;
+    unsigned long long hash; /* elements are combined into it in order */
+    unsigned long long members; /* sum of the member hashes of an object */
+    cJSON_bool cacheable;
+} hash_frame;
+
+/* Hash of the value of item without its children, the start value they are combined into for arrays and objects.
+ * *cacheable is set to false if the hash of item can't be cached: references can be changed through the item they
+ * point to, and NaN isn't equal to itself. */
+static unsigned long long hash_value(const cJSON * const item, cJSON_bool * const cacheable)
+{
+    unsigned long long hash = mix_hash((unsigned long long)(item->type & 0xFF));
+
+    /* the children of shared items of document versions are never changed */
+    *cacheable = ((item->type & cJSON_IsReference) == 0) || ((item->type & (cJSON_IsShared | cJSON_InBlock)) != 0);
+    switch (item->type & 0xFF)
     {
-        item->type = cJSON_Raw;
-        item->valuestring = (char*)cJSON_strdup((const unsigned char*)raw, &global_hooks);
-        if(!item->valuestring)
+        case cJSON_Number:
         {
-            cJSON_Delete(item);
-            return NULL;
+            /* 0.0 and -0.0 are equal */
+            double number = (item->valuedouble == 0) ? 0 : item->valuedouble;
+            if (number != number)
+            {
+                *cacheable = false;
+            }
+            hash = mix_hash(hash_bytes(hash, (const unsigned char*)&number, sizeof(number)));
+            break;
         }
-    }
 
-    return item;
-}
+        case cJSON_String:
+        case cJSON_Raw:
+            if (item->valuestring != NULL)
+            {
+                hash = hash_bytes(hash, (const unsigned char*)item->valuestring, strlen(item->valuestring));
+            }
+            hash = mix_hash(hash);
+            break;
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateArray(void)
-{
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if(item)
-    {
-        item->type=cJSON_Array;
+        default:
+            break;
     }
 
-    return item;
+    return hash;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateObject(void)
+/* The last step for an item whose children are combined into hash. */
+static unsigned long long finish_hash(cJSON * const item, unsigned long long hash, const cJSON_bool cacheable, const cJSON_bool store)
 {
-    cJSON *item = cJSON_New_Item(&global_hooks);
-    if (item)
+    /* 0 means "not computed" */
+    if (hash == 0)
     {
-        item->type = cJSON_Object;
+        hash = 1;
+    }
+    if (store && cacheable)
+    {
+        item->hash = hash;
     }
 
-    return item;
+    return hash;
 }
 
-/* Create Arrays: */
-CJSON_PUBLIC(cJSON *) cJSON_CreateIntArray(const int *numbers, int count)
+/* Compute the hash of item bottom up, caching it in every item where that is safe if store is set. Nested arrays and
+ * objects are hashed without recursion, the ones that are open are kept on an explicit stack. Returns 0 if out of memory. */
+static unsigned long long compute_hash(cJSON *current, const cJSON_bool store)
 {
-    size_t i = 0;
-    cJSON *n = NULL;
-    cJSON *p = NULL;
-    cJSON *a = NULL;
+    hash_frame initial[32];
+    hash_frame *stack = initial;
+    size_t size = sizeof(initial) / sizeof(initial[0]);
+    size_t depth = 0;
 
-    if ((count < 0) || (numbers == NULL))
+    for (;;)
     {
-        return NULL;
-    }
+        unsigned long long hash = current->hash;
+        cJSON_bool cacheable = true;
 
-    a = cJSON_CreateArray();
-    for(i = 0; a && (i < (size_t)count); i++)
-    {
-        n = cJSON_CreateNumber(numbers[i]);
-        if (!n)
-        {
-            cJSON_Delete(a);
-            return NULL;
-        }
-        if(!i)
+        if (hash == 0)
         {
-            a->child = n;
+            hash = hash_value(current, &cacheable);
+            if ((((current->type & 0xFF) == cJSON_Array) || ((current->type & 0xFF) == cJSON_Object)) && (current->child != NULL))
+            {
+                if ((depth == size) && !grow_stack((void**)&stack, &size, sizeof(hash_frame), initial))
+                {
+                    free_stack(stack, initial);
+                    return 0;
+                }
+                stack[depth].item = current;
+                stack[depth].hash = hash;
+                stack[depth].members = 0;
+                stack[depth].cacheable = cacheable;
+                depth++;
+                current = current->child;
+                continue;
+            }
+            if ((current->type & 0xFF) == cJSON_Object)
+            {
+                /* empty */
+                hash = mix_hash(hash);
+            }
+            hash = finish_hash(current, hash, cacheable, store);
         }
-        else
+
+        /* current is hashed: combine it into the array or object it is in, and finish that one if it was the last child */
+        for (;;)
         {
-            suffix_object(p, n);
+            hash_frame *frame = NULL;
+
+            if (depth == 0)
+            {
+                free_stack(stack, initial);
+                return hash;
+            }
+
+            frame = &stack[depth - 1];
+            if ((frame->item->type & 0xFF) == cJSON_Array)
+            {
+                frame->hash = mix_hash(frame->hash * 31 + hash);
+            }
+            else
+            {
+                /* the sum of the member hashes doesn't depend on the order of the members */
+                unsigned long long key = 0xCBF29CE484222325ULL;
+                if (current->string != NULL)
+                {
+                    key = hash_bytes(key, (const unsigned char*)current->string, strlen(current->string));
+                }
+                frame->members += mix_hash(key ^ mix_hash(hash));
+            }
+            frame->cacheable = frame->cacheable && cacheable;
+
+            if (current->next != NULL)
+            {
+                current = current->next;
+                break;
+            }
+
+            current = frame->item;
+            hash = frame->hash;
+            if ((current->type & 0xFF) == cJSON_Object)
+            {
+                hash = mix_hash(hash ^ frame->members);
+            }
+            cacheable = frame->cacheable;
+            hash = finish_hash(current, hash, cacheable, store);
+            depth--;
         }
-        p = n;
     }
-
-    return a;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateFloatArray(const float *numbers, int count)
+CJSON_PUBLIC(unsigned long long) cJSON_GetHash(cJSON * const item)
 {
-    size_t i = 0;
-    cJSON *n = NULL;
-    cJSON *p = NULL;
-    cJSON *a = NULL;
-
-    if ((count < 0) || (numbers == NULL))
+    if (item == NULL)
     {
-        return NULL;
+        return 0;
     }
 
-    a = cJSON_CreateArray();
+    return compute_hash(item, true);
+}
 
-    for(i = 0; a && (i < (size_t)count); i++)
+CJSON_PUBLIC(unsigned long long) cJSON_ComputeHash(const cJSON * const item)
+{
+    if (item == NULL)
     {
-        n = cJSON_CreateNumber((double)numbers[i]);
-        if(!n)
-        {
-            cJSON_Delete(a);
-            return NULL;
-        }
-        if(!i)
-        {
-            a->child = n;
-        }
-        else
-        {
-            suffix_object(p, n);
-        }
-        p = n;
+        return 0;
     }
 
-    return a;
+    return compute_hash((cJSON*)cast_away_const(item), false);
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateDoubleArray(const double *numbers, int count)
+CJSON_PUBLIC(void) cJSON_InvalidateHash(cJSON * const item)
 {
-    size_t i = 0;
-    cJSON *n = NULL;
-    cJSON *p = NULL;
-    cJSON *a = NULL;
-
-    if ((count < 0) || (numbers == NULL))
-    {
-        return NULL;
-    }
+    invalidate_hash(item);
+}
 
-    a = cJSON_CreateArray();
+/* Incremental printing */
 
-    for(i = 0;a && (i < (size_t)count); i++)
-    {
-        n = cJSON_CreateNumber(numbers[i]);
-        if(!n)
-        {
-            cJSON_Delete(a);
-            return NULL;
-        }
-        if(!i)
-        {
-            a->child = n;
-        }
-        else
-        {
-            suffix_object(p, n);
-        }
-        p = n;
-    }
+/* text of an array or object in the last print of a cJSON_PrintCache */
+typedef struct
+{
+    const cJSON *item;
+    unsigned long long hash; /* hash of item when its text was printed */
+    size_t depth; /* nesting depth it was printed at, formatted text depends on it */
+    size_t offset; /* position of the text in the printed text */
+    size_t length;
+} print_cache_entry;
 
-    return a;
+struct cJSON_PrintCache
+{
+    size_t threshold;
+    cJSON_bool format;
+    unsigned char *text; /* text of the last print */
+    size_t length;
+    print_cache_entry *entries; /* entries of the last print, sorted by offset */
+    size_t count;
+    size_t *index; /* entry index + 1 by item address, open addressing, 0 is empty */
+    size_t index_size; /* power of 2 */
+    print_cache_entry *pending; /* entries of the print in progress */
+    size_t pending_count;
+    size_t pending_capacity;
+};
+
+static size_t hash_print_cache_item(const cJSON * const item, const size_t index_size)
+{
+    return (size_t)mix_hash((unsigned long long)(size_t)item) & (index_size - 1);
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char **strings, int count)
+static const print_cache_entry *find_print_cache_entry(const cJSON_PrintCache * const cache, const cJSON * const item)
 {
-    size_t i = 0;
-    cJSON *n = NULL;
-    cJSON *p = NULL;
-    cJSON *a = NULL;
+    size_t slot = 0;
 
-    if ((count < 0) || (strings == NULL))
+    if (cache->index_size == 0)
     {
         return NULL;
     }
 
-    a = cJSON_CreateArray();
-
-    for (i = 0; a && (i < (size_t)count); i++)
+    for (slot = hash_print_cache_item(item, cache->index_size); cache->index[slot] != 0; slot = (slot + 1) & (cache->index_size - 1))
     {
-        n = cJSON_CreateString(strings[i]);
-        if(!n)
-        {
-            cJSON_Delete(a);
-            return NULL;
-        }
-        if(!i)
-        {
-            a->child = n;
-        }
-        else
+        if (cache->entries[cache->index[slot] - 1].item == item)
         {
-            suffix_object(p,n);
+            return &cache->entries[cache->index[slot] - 1];
         }
-        p = n;
     }
 
-    return a;
+    return NULL;
 }
 
-/* Duplication */
-CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
+/* running out of memory only means that this text won't be reused, so failures are ignored */
+static void add_print_cache_entry(cJSON_PrintCache * const cache, const print_cache_entry * const entry)
 {
-    cJSON *newitem = NULL;
-    cJSON *child = NULL;
-    cJSON *next = NULL;
-    cJSON *newchild = NULL;
-
-    /* Bail on bad ptr */
-    if (!item)
-    {
-        goto fail;
-    }
-    /* Create new item */
-    newitem = cJSON_New_Item(&global_hooks);
-    if (!newitem)
-    {
-        goto fail;
-    }
-    /* Copy over all vars */
-    newitem->type = item->type & (~cJSON_IsReference);
-    newitem->valueint = item->valueint;
-    newitem->valuedouble = item->valuedouble;
-    if (item->valuestring)
+    if (cache->pending_count == cache->pending_capacity)
     {
-        newitem->valuestring = (char*)cJSON_strdup((unsigned char*)item->valuestring, &global_hooks);
-        if (!newitem->valuestring)
+        size_t new_capacity = (cache->pending_capacity == 0) ? 16 : (cache->pending_capacity * 2);
+        print_cache_entry *new_pending = (print_cache_entry*)global_hooks.allocate(new_capacity * sizeof(print_cache_entry));
+        if (new_pending == NULL)
         {
-            goto fail;
+            return;
         }
-    }
-    if (item->string)
-    {
-        newitem->string = (item->type&cJSON_StringIsConst) ? item->string : (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
-        if (!newitem->string)
+        if (cache->pending != NULL)
         {
-            goto fail;
+            memcpy(new_pending, cache->pending, cache->pending_count * sizeof(print_cache_entry));
+            global_hooks.deallocate(cache->pending);
         }
+        cache->pending = new_pending;
+        cache->pending_capacity = new_capacity;
     }
-    /* If non-recursive, then we're done! */
-    if (!recurse)
+
+    cache->pending[cache->pending_count++] = *entry;
+}
+
+/* Copy the text of an array or object from the last print if it hasn't changed since. *copied is left false otherwise,
+ * the item is then printed (subtrees that haven't changed are copied) and passed to print_cached_add. */
+static cJSON_bool print_cached_copy(const cJSON * const item, printbuffer * const output_buffer, cJSON_bool * const copied)
+{
+    cJSON_PrintCache *cache = output_buffer->cache;
+    const print_cache_entry *cached = NULL;
+    const print_cache_entry *end = NULL;
+    const print_cache_entry *inner = NULL;
+    unsigned char *output = NULL;
+
+    *copied = false;
+    if ((item->type & cJSON_PrintCached) && (item->hash != 0))
     {
-        return newitem;
+        cached = find_print_cache_entry(cache, item);
     }
-    /* Walk the ->next chain for the child. */
-    child = item->child;
-    while (child != NULL)
+    if ((cached == NULL) || (cached->hash != item->hash) || (output_buffer->format && (cached->depth != output_buffer->depth)))
     {
-        newchild = cJSON_Duplicate(child, true); /* Duplicate (with recurse) each item in the ->next chain */
-        if (!newchild)
-        {
-            goto fail;
-        }
-        if (next != NULL)
-        {
-            /* If newitem->child already set, then crosswire ->prev and ->next and move on */
-            next->next = newchild;
-            newchild->prev = next;
-            next = newchild;
-        }
-        else
-        {
-            /* Set newitem->child and move to it */
-            newitem->child = newchild;
-            next = newchild;
-        }
-        child = child->next;
+        return true;
     }
 
-    return newitem;
+    output = ensure(output_buffer, cached->length);
+    if (output == NULL)
+    {
+        return false;
+    }
+    memcpy(output, cache->text + cached->offset, cached->length);
+    output[cached->length] = '\0';
 
-fail:
-    if (newitem != NULL)
+    /* the entries inside the copied text stay valid at their new position */
+    end = cache->entries + cache->count;
+    for (inner = cached; (inner < end) && (inner->offset < cached->offset + cached->length); inner++)
     {
-        cJSON_Delete(newitem);
+        print_cache_entry moved = *inner;
+        moved.offset = output_buffer->offset + (inner->offset - cached->offset);
+        moved.depth = output_buffer->depth + inner->depth - cached->depth;
+        add_print_cache_entry(cache, &moved);
     }
+    output_buffer->offset += cached->length;
+    *copied = true;
 
-    return NULL;
+    return true;
 }
 
-static void skip_oneline_comment(char **input)
+/* remember the text of an array or object that was printed at offset and depth if it is long enough */
+static void print_cached_add(const cJSON * const item, const size_t offset, const size_t depth, printbuffer * const output_buffer)
 {
-    *input += static_strlen("//");
-
-    for (; (*input)[0] != '\0'; ++(*input))
-    {
-        if ((*input)[0] == '\n') {
-            *input += static_strlen("\n");
-            return;
+    cJSON_PrintCache *cache = output_buffer->cache;
+    print_cache_entry entry;
+
+    entry.item = item;
+    entry.depth = depth;
+    entry.offset = offset;
+    entry.length = output_buffer->offset - offset;
+    if (entry.length >= cache->threshold)
+    {
+        /* subtrees containing references or NaN don't keep a hash, so they are never copied */
+        entry.hash = cJSON_GetHash((cJSON*)cast_away_const(item));
+        if (item->hash != 0)
+        {
+            add_print_cache_entry(cache, &entry);
         }
     }
 }
 
-static void skip_multiline_comment(char **input)
+static int compare_print_cache_entries(const void *a, const void *b)
 {
-    *input += static_strlen("/*");
+    const print_cache_entry *first = (const print_cache_entry*)a;
+    const print_cache_entry *second = (const print_cache_entry*)b;
 
-    for (; (*input)[0] != '\0'; ++(*input))
+    if (first->offset != second->offset)
     {
-        if (((*input)[0] == '*') && ((*input)[1] == '/'))
-        {
-            *input += static_strlen("*/");
-            return;
-        }
+        return (first->offset < second->offset) ? -1 : 1;
     }
-}
-
-static void minify_string(char **input, char **output) {
-    (*output)[0] = (*input)[0];
-    *input += static_strlen("\"");
-    *output += static_strlen("\"");
-
-
-    for (; (*input)[0] != '\0'; (void)++(*input), ++(*output)) {
-        (*output)[0] = (*input)[0];
 
-        if ((*input)[0] == '\"') {
-            (*output)[0] = '\"';
-            *input += static_strlen("\"");
-            *output += static_strlen("\"");
-            return;
-        } else if (((*input)[0] == '\\') && ((*input)[1] == '\"')) {
-            (*output)[1] = (*input)[1];
-            *input += static_strlen("\"");
-            *output += static_strlen("\"");
-        }
-    }
+    return 0;
 }
 
-CJSON_PUBLIC(void) cJSON_Minify(char *json)
+/* make the entries of the finished print the entries of the cache */
+static void commit_print_cache(cJSON_PrintCache * const cache)
 {
-    char *into = json;
+    size_t index_size = 0;
+    size_t i = 0;
+
+    if (cache->index != NULL)
+    {
+        global_hooks.deallocate(cache->index);
+        cache->index = NULL;
+        cache->index_size = 0;
+    }
+    if (cache->entries != NULL)
+    {
+        global_hooks.deallocate(cache->entries);
+    }
+    cache->entries = cache->pending;
+    cache->count = cache->pending_count;
+    cache->pending = NULL;
+    cache->pending_count = 0;
+    cache->pending_capacity = 0;
 
-    if (json == NULL)
+    if (cache->count == 0)
     {
         return;
     }
 
-    while (json[0] != '\0')
+    /* items are only marked now, during the print an item printed twice (through references) might have changed since the
+     * last print even though it was printed again already */
+    for (i = 0; i < cache->count; i++)
     {
-        switch (json[0])
-        {
-            case ' ':
-            case '\t':
-            case '\r':
-            case '\n':
-                json++;
-                break;
+        ((cJSON*)cast_away_const(cache->entries[i].item))->type |= cJSON_PrintCached;
+    }
 
-            case '/':
-                if (json[1] == '/')
-                {
-                    skip_oneline_comment(&json);
-                }
-                else if (json[1] == '*')
-                {
-                    skip_multiline_comment(&json);
-                } else {
-                    json++;
-                }
-                break;
+    /* an unchanged container and all containers inside it are one range of entries */
+    qsort(cache->entries, cache->count, sizeof(print_cache_entry), compare_print_cache_entries);
 
-            case '\"':
-                minify_string(&json, (char**)&into);
-                break;
+    for (index_size = 16; index_size < (cache->count * 2); index_size *= 2)
+    {
+    }
+    cache->index = (size_t*)global_hooks.allocate(index_size * sizeof(size_t));
+    if (cache->index == NULL)
+    {
+        return;
+    }
+    memset(cache->index, '\0', index_size * sizeof(size_t));
+    cache->index_size = index_size;
 
-            default:
-                into[0] = json[0];
-                json++;
-                into++;
+    for (i = 0; i < cache->count; i++)
+    {
+        size_t slot = hash_print_cache_item(cache->entries[i].item, index_size);
+        /* an item that was printed more than once (through references) keeps its first entry */
+        while ((cache->index[slot] != 0) && (cache->entries[cache->index[slot] - 1].item != cache->entries[i].item))
+        {
+            slot = (slot + 1) & (index_size - 1);
+        }
+        if (cache->index[slot] == 0)
+        {
+            cache->index[slot] = i + 1;
         }
     }
+}
 
-    /* and null-terminate. */
-    *into = '\0';
+static void clear_print_cache(cJSON_PrintCache * const cache)
+{
+    if (cache->text != NULL)
+    {
+        global_hooks.deallocate(cache->text);
+        cache->text = NULL;
+    }
+    if (cache->entries != NULL)
+    {
+        global_hooks.deallocate(cache->entries);
+        cache->entries = NULL;
+    }
+    if (cache->index != NULL)
+    {
+        global_hooks.deallocate(cache->index);
+        cache->index = NULL;
+    }
+    if (cache->pending != NULL)
+    {
+        global_hooks.deallocate(cache->pending);
+        cache->pending = NULL;
+    }
+    cache->length = 0;
+    cache->count = 0;
+    cache->index_size = 0;
+    cache->pending_count = 0;
+    cache->pending_capacity = 0;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsInvalid(const cJSON * const item)
+CJSON_PUBLIC(cJSON_PrintCache *) cJSON_CreatePrintCache(size_t threshold)
 {
-    if (item == NULL)
+    cJSON_PrintCache *cache = (cJSON_PrintCache*)global_hooks.allocate(sizeof(cJSON_PrintCache));
+    if (cache == NULL)
     {
-        return false;
+        return NULL;
     }
+    memset(cache, '\0', sizeof(cJSON_PrintCache));
+    cache->threshold = threshold;
 
-    return (item->type & 0xFF) == cJSON_Invalid;
+    return cache;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsFalse(const cJSON * const item)
+CJSON_PUBLIC(void) cJSON_DeletePrintCache(cJSON_PrintCache *cache)
 {
-    if (item == NULL)
+    if (cache == NULL)
     {
-        return false;
+        return;
     }
-
-    return (item->type & 0xFF) == cJSON_False;
+    clear_print_cache(cache);
+    global_hooks.deallocate(cache);
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsTrue(const cJSON * const item)
+CJSON_PUBLIC(char *) cJSON_PrintWithCache(const cJSON *item, cJSON_bool format, cJSON_PrintCache *cache)
 {
-    if (item == NULL)
+    static const size_t default_buffer_size = 256;
+    printbuffer buffer[1];
+    char *printed = NULL;
+
+    if ((item == NULL) || (cache == NULL))
     {
-        return false;
+        return NULL;
     }
 
-    return (item->type & 0xff) == cJSON_True;
-}
+    /* the text of the last print has to be printed the same way to be reused */
+    if ((cache->text != NULL) && (cache->format != format))
+    {
+        clear_print_cache(cache);
+    }
 
+    memset(buffer, 0, sizeof(buffer));
+    /* edits rarely change the length much */
+    buffer->length = cache->length + default_buffer_size;
+    buffer->buffer = (unsigned char*)global_hooks.allocate(buffer->length);
+    buffer->format = format;
+    buffer->hooks = global_hooks;
+    buffer->cache = cache;
+    if (buffer->buffer == NULL)
+    {
+        goto fail;
+    }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsBool(const cJSON * const item)
-{
-    if (item == NULL)
+    cache->pending_count = 0;
+    if (!print_value(item, buffer))
     {
-        return false;
+        goto fail;
     }
+    update_offset(buffer);
 
-    return (item->type & (cJSON_True | cJSON_False)) != 0;
-}
-CJSON_PUBLIC(cJSON_bool) cJSON_IsNull(const cJSON * const item)
-{
-    if (item == NULL)
+    printed = (char*)global_hooks.allocate(buffer->offset + 1);
+    if (printed == NULL)
     {
-        return false;
+        goto fail;
     }
+    memcpy(printed, buffer->buffer, buffer->offset + 1);
 
-    return (item->type & 0xFF) == cJSON_NULL;
+    /* the new text replaces the old one, the entries point into it */
+    if (cache->text != NULL)
+    {
+        global_hooks.deallocate(cache->text);
+    }
+    cache->text = buffer->buffer;
+    cache->length = buffer->offset;
+    cache->format = format;
+    if (global_hooks.reallocate != NULL)
+    {
+        unsigned char *shrunk = (unsigned char*)global_hooks.reallocate(cache->text, cache->length + 1);
+        if (shrunk != NULL)
+        {
+            cache->text = shrunk;
+        }
+    }
+    commit_print_cache(cache);
+
+    return printed;
+
+fail:
+    /* the text and entries of the last print stay valid */
+    cache->pending_count = 0;
+    if (buffer->buffer != NULL)
+    {
+        global_hooks.deallocate(buffer->buffer);
+    }
+
+    return NULL;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsNumber(const cJSON * const item)
+/* objects with more members than this are compared through a hash table of the keys of b */
+#define CJSON_COMPARE_INDEX_MIN 16
+
+static cJSON_bool compare_keys(const char * const a, const char * const b, const cJSON_bool case_sensitive)
 {
-    if (item == NULL)
+    if (case_sensitive)
     {
-        return false;
+        return strcmp(a, b) == 0;
     }
 
-    return (item->type & 0xFF) == cJSON_Number;
+    return case_insensitive_strcmp((const unsigned char*)a, (const unsigned char*)b) == 0;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsString(const cJSON * const item)
+/* the member of object with the same key as member that occurs as often before it as member does before itself
+ * in its own object, so duplicate keys are matched in order */
+static cJSON *get_matching_member(const cJSON * const object, const cJSON * const member, const cJSON_bool case_sensitive)
 {
-    if (item == NULL)
+    const cJSON *current = NULL;
+    size_t occurrence = 0;
+
+    for (current = member->prev; current != NULL; current = current->prev)
     {
-        return false;
+        if (compare_keys(current->string, member->string, case_sensitive))
+        {
+            occurrence++;
+        }
     }
 
-    return (item->type & 0xFF) == cJSON_String;
+    for (current = object->child; current != NULL; current = current->next)
+    {
+        if (compare_keys(current->string, member->string, case_sensitive))
+        {
+            if (occurrence == 0)
+            {
+                return (cJSON*)cast_away_const(current);
+            }
+            occurrence--;
+        }
+    }
+
+    return NULL;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsArray(const cJSON * const item)
+typedef struct
 {
-    if (item == NULL)
+    const cJSON *member; /* NULL once it was matched */
+    unsigned long long key_hash; /* 0 for empty slots */
+} compare_slot;
+
+static unsigned long long hash_key(const char *key, const cJSON_bool case_sensitive)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+
+    for (; *key != '\0'; key++)
     {
-        return false;
+        hash ^= (unsigned long long)(case_sensitive ? (unsigned char)*key : (unsigned char)tolower((unsigned char)*key));
+        hash *= 0x100000001B3ULL;
     }
 
-    return (item->type & 0xFF) == cJSON_Array;
+    /* 0 marks empty slots */
+    return mix_hash(hash) | 1;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsObject(const cJSON * const item)
+/* Hash index over count members starting at first: the members go into an open addressing table, a member of the other
+ * object takes the first member with the same key that wasn't taken yet (see take_indexed_member). Since both objects have
+ * the same number of members left, that matches them one to one. Returns NULL if the table couldn't be allocated. */
+static compare_slot *index_members(const cJSON * const first, const size_t count, const cJSON_bool case_sensitive, size_t * const mask)
 {
-    if (item == NULL)
+    compare_slot *slots = NULL;
+    size_t size = 1;
+    size_t slot = 0;
+    const cJSON *element = NULL;
+
+    while (size < 2 * count)
     {
-        return false;
+        size *= 2;
     }
+    *mask = size - 1;
+    slots = (compare_slot*)global_hooks.allocate(size * sizeof(compare_slot));
+    if (slots == NULL)
+    {
+        return NULL;
+    }
+    memset(slots, '\0', size * sizeof(compare_slot));
 
-    return (item->type & 0xFF) == cJSON_Object;
+    /* members with the same key are probed in the order they were added, so duplicate keys are matched in order */
+    for (element = first; element != NULL; element = element->next)
+    {
+        unsigned long long key_hash = hash_key(element->string, case_sensitive);
+        for (slot = (size_t)key_hash & *mask; slots[slot].key_hash != 0; slot = (slot + 1) & *mask)
+        {
+        }
+        slots[slot].member = element;
+        slots[slot].key_hash = key_hash;
+    }
+
+    return slots;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_IsRaw(const cJSON * const item)
+static const cJSON *take_indexed_member(compare_slot * const slots, const size_t mask, const cJSON * const member, const cJSON_bool case_sensitive)
 {
-    if (item == NULL)
+    unsigned long long key_hash = hash_key(member->string, case_sensitive);
+    const cJSON *match = NULL;
+    size_t slot = 0;
+
+    for (slot = (size_t)key_hash & mask; slots[slot].key_hash != 0; slot = (slot + 1) & mask)
     {
-        return false;
+        if ((slots[slot].member != NULL) && (slots[slot].key_hash == key_hash) && compare_keys(slots[slot].member->string, member->string, case_sensitive))
+        {
+            match = slots[slot].member;
+            slots[slot].member = NULL;
+            break;
+        }
     }
 
-    return (item->type & 0xFF) == cJSON_Raw;
+    return match;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * const b, const cJSON_bool case_sensitive)
+#define COMPARE_UNEQUAL 0
+#define COMPARE_EQUAL 1
+#define COMPARE_CHILDREN 2 /* equal if the children are */
+
+/* compare a and b without looking at their children. For objects with the same number of members, *count is set to
+ * that number. Arrays of different length are told apart while their elements are compared (see next_compare_pair) */
+static int compare_value(const cJSON * const a, const cJSON * const b, const cJSON_bool case_sensitive, size_t * const count)
 {
     if ((a == NULL) || (b == NULL) || ((a->type & 0xFF) != (b->type & 0xFF)) || cJSON_IsInvalid(a))
     {
-        return false;
+        return COMPARE_UNEQUAL;
     }
 
     /* check if type is valid */
@@ -2858,13 +5407,21 @@ CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * cons
             break;
 
         default:
-            return false;
+            return COMPARE_UNEQUAL;
     }
 
     /* identical objects are equal */
     if (a == b)
     {
-        return true;
+        return COMPARE_EQUAL;
+    }
+
+    /* different cached hashes prove a difference without looking at the children. Keys are hashed case sensitive, so only
+     * for case sensitive comparison. Equal hashes prove nothing: they may collide, and the member hashes of objects are summed
+     * without their order while duplicate keys are compared in order */
+    if (case_sensitive && (a->hash != 0) && (b->hash != 0) && (a->hash != b->hash))
+    {
+        return COMPARE_UNEQUAL;
     }
 
     switch (a->type & 0xFF)
@@ -2873,93 +5430,195 @@ CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * cons
         case cJSON_False:
         case cJSON_True:
         case cJSON_NULL:
-            return true;
+            return COMPARE_EQUAL;
 
         case cJSON_Number:
             if (a->valuedouble == b->valuedouble)
             {
-                return true;
+                return COMPARE_EQUAL;
             }
-            return false;
+            return COMPARE_UNEQUAL;
 
         case cJSON_String:
         case cJSON_Raw:
             if ((a->valuestring == NULL) || (b->valuestring == NULL))
             {
-                return false;
+                return COMPARE_UNEQUAL;
             }
             if (strcmp(a->valuestring, b->valuestring) == 0)
             {
-                return true;
+                return COMPARE_EQUAL;
             }
 
-            return false;
+            return COMPARE_UNEQUAL;
 
         case cJSON_Array:
+            return COMPARE_CHILDREN;
+
+        case cJSON_Object:
         {
             cJSON *a_element = a->child;
             cJSON *b_element = b->child;
 
-            for (; (a_element != NULL) && (b_element != NULL);)
+            *count = 0;
+            for (; (a_element != NULL) && (b_element != NULL); a_element = a_element->next, b_element = b_element->next)
             {
-                if (!cJSON_Compare(a_element, b_element, case_sensitive))
+                /* members without a key never match */
+                if ((a_element->string == NULL) || (b_element->string == NULL))
                 {
-                    return false;
+                    return COMPARE_UNEQUAL;
                 }
-
-                a_element = a_element->next;
-                b_element = b_element->next;
+                (*count)++;
             }
 
-            /* one of the arrays is longer than the other */
-            if (a_element != b_element) {
-                return false;
+            /* one of the objects has more members than the other */
+            if (a_element != b_element)
+            {
+                return COMPARE_UNEQUAL;
             }
 
-            return true;
+            return COMPARE_CHILDREN;
         }
 
-        case cJSON_Object:
+        default:
+            return COMPARE_UNEQUAL;
+    }
+}
+
+/* containers being compared, their children are compared one pair at a time */
+typedef struct
+{
+    const cJSON *a; /* next child of a to compare */
+    const cJSON *b; /* next child of b, for objects only while the keys are in the same order */
+    const cJSON *object; /* b if it is an object */
+    compare_slot *slots; /* index of the remaining members of b for large objects out of order, NULL otherwise */
+    size_t mask;
+    size_t remaining; /* members of a that weren't compared yet */
+} compare_frame;
+
+static void start_compare_frame(compare_frame * const frame, const cJSON * const a, const cJSON * const b, const size_t count)
+{
+    frame->a = a->child;
+    frame->b = b->child;
+    frame->object = cJSON_IsObject(b) ? b : NULL;
+    frame->slots = NULL;
+    frame->mask = 0;
+    frame->remaining = count;
+}
+
+/* the next pair of children of a frame, false once all of them were compared. *b is NULL if a member has no match,
+ * *a or *b is NULL if one array is longer than the other */
+static cJSON_bool next_compare_pair(compare_frame * const frame, const cJSON_bool case_sensitive, const cJSON ** const a, const cJSON ** const b)
+{
+    if (frame->object == NULL)
+    {
+        if ((frame->a == NULL) && (frame->b == NULL))
         {
-            cJSON *a_element = NULL;
-            cJSON *b_element = NULL;
-            cJSON_ArrayForEach(a_element, a)
-            {
-                /* TODO This has O(n^2) runtime, which is horrible! */
-                b_element = get_object_item(b, a_element->string, case_sensitive);
-                if (b_element == NULL)
-                {
-                    return false;
-                }
+            return false;
+        }
+        *a = frame->a;
+        *b = frame->b;
+        if ((frame->a != NULL) && (frame->b != NULL))
+        {
+            frame->a = frame->a->next;
+            frame->b = frame->b->next;
+        }
+        return true;
+    }
+    if (frame->a == NULL)
+    {
+        return false;
+    }
 
-                if (!cJSON_Compare(a_element, b_element, case_sensitive))
-                {
-                    return false;
-                }
-            }
+    *a = frame->a;
+    if ((frame->b != NULL) && compare_keys(frame->a->string, frame->b->string, case_sensitive))
+    {
+        /* all keys before were in the same order, so this is the member with the same key and occurrence */
+        *b = frame->b;
+        frame->b = frame->b->next;
+    }
+    else
+    {
+        if ((frame->b != NULL) && (frame->remaining > CJSON_COMPARE_INDEX_MIN))
+        {
+            /* the members before are matched already. Without memory for the index, members are matched one by one, O(n^2) */
+            frame->slots = index_members(frame->b, frame->remaining, case_sensitive, &frame->mask);
+        }
+        frame->b = NULL;
+        if (frame->slots != NULL)
+        {
+            *b = take_indexed_member(frame->slots, frame->mask, frame->a, case_sensitive);
+        }
+        else
+        {
+            *b = get_matching_member(frame->object, frame->a, case_sensitive);
+        }
+    }
+    frame->a = frame->a->next;
+    frame->remaining--;
 
-            /* doing this twice, once on a and b to prevent true comparison if a subset of b
-             * TODO: Do this the proper way, this is just a fix for now */
-            cJSON_ArrayForEach(b_element, b)
-            {
-                a_element = get_object_item(a, b_element->string, case_sensitive);
-                if (a_element == NULL)
-                {
-                    return false;
-                }
+    return true;
+}
 
-                if (!cJSON_Compare(b_element, a_element, case_sensitive))
-                {
-                    return false;
-                }
+/* Walks both trees with a stack of the containers being compared instead of recursion, so the depth of the documents is
+ * only limited by memory */
+CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * const b, const cJSON_bool case_sensitive)
+{
+    compare_frame initial[32];
+    compare_frame *stack = initial;
+    size_t size = sizeof(initial) / sizeof(initial[0]);
+    size_t depth = 0;
+    size_t count = 0;
+    const cJSON *a_child = NULL;
+    const cJSON *b_child = NULL;
+    int result = compare_value(a, b, case_sensitive, &count);
+
+    if (result != COMPARE_CHILDREN)
+    {
+        return result == COMPARE_EQUAL;
+    }
+
+    start_compare_frame(&stack[depth++], a, b, count);
+    while (depth > 0)
+    {
+        if (!next_compare_pair(&stack[depth - 1], case_sensitive, &a_child, &b_child))
+        {
+            depth--;
+            if (stack[depth].slots != NULL)
+            {
+                global_hooks.deallocate(stack[depth].slots);
             }
+            continue;
+        }
 
-            return true;
+        result = compare_value(a_child, b_child, case_sensitive, &count);
+        if (result == COMPARE_UNEQUAL)
+        {
+            break;
+        }
+        if (result == COMPARE_CHILDREN)
+        {
+            if ((depth == size) && !grow_stack((void**)&stack, &size, sizeof(compare_frame), initial))
+            {
+                /* out of memory, equality can't be proven */
+                result = COMPARE_UNEQUAL;
+                break;
+            }
+            start_compare_frame(&stack[depth++], a_child, b_child, count);
         }
+    }
 
-        default:
-            return false;
+    /* stopped early at a difference */
+    for (; depth > 0; depth--)
+    {
+        if (stack[depth - 1].slots != NULL)
+        {
+            global_hooks.deallocate(stack[depth - 1].slots);
+        }
     }
+    free_stack(stack, initial);
+
+    return result != COMPARE_UNEQUAL;
 }
 
 CJSON_PUBLIC(void *) cJSON_malloc(size_t size)
@@ -98,6 +98,15 @@ then using the CJSON_API_VISIBILITY flag to "export" the same symbols the way CJ
 
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
+/* set while the text of an array or object is kept by a cJSON_PrintCache, cleared together with the cached hash */
+#define cJSON_PrintCached 1024
+/* a cJSON_IsReference item of a document version (see cJSONUtils_ApplyPatchesToVersion), counted in ->references of the item owning the children */
+#define cJSON_IsShared 2048
+/* the item lives in the allocation of the root of a cJSON_DuplicateBlock copy and is freed with it, its key is cJSON_StringIsConst
+ * and its valuestring cJSON_IsReference */
+#define cJSON_InBlock 4096
+/* changes below the item and its deletion are reported to the hook set with cJSON_SetWatchHook */
+#define cJSON_Watched 8192
 
 /* The cJSON structure: */
 typedef struct cJSON
@@ -120,6 +129,13 @@ typedef struct cJSON
 
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
+
+    /* The array or object this item is linked into, NULL for roots. Maintained by all functions that add, insert, replace or detach items. */
+    struct cJSON *parent;
+    /* Cached structural hash, see cJSON_GetHash. 0 if it hasn't been computed or the item was changed since. */
+    unsigned long long hash;
+    /* Number of cJSON_IsShared items of other document versions that point to the children of this item. */
+    int references;
 } cJSON;
 
 typedef struct cJSON_Hooks
@@ -132,7 +148,11 @@ typedef struct cJSON_Hooks
 typedef int cJSON_bool;
 
 /* Limits how deeply nested arrays/objects can be before cJSON rejects to parse them.
- * This is to prevent stack overflows. */
+ * Parsing, printing, cJSON_Delete, cJSON_Duplicate, cJSON_Compare and cJSON_GetHash keep their position on the heap instead
+ * of the call stack, so the limit can be raised for deeply nested documents. These functions of cJSON_Utils still recurse once
+ * per level of the document: cJSONUtils_FindPointerFromObjectTo, cJSONUtils_QueryPath with descendant segments, the "test"
+ * operation of cJSONUtils_ApplyPatches*, "copy" in cJSONUtils_ApplyPatchesToVersion, cJSONUtils_GeneratePatches*,
+ * cJSONUtils_MergePatch* and cJSONUtils_GenerateMergePatch*. */
 #ifndef CJSON_NESTING_LIMIT
 #define CJSON_NESTING_LIMIT 1000
 #endif
@@ -142,13 +162,40 @@ CJSON_PUBLIC(const char*) cJSON_Version(void);
 
 /* Supply malloc, realloc and free functions to cJSON */
 CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks);
+/* Called for every cJSON_Watched item with deleted false when it or one of its descendants is changed by a cJSON function
+ * (the same changes that drop cached hashes, see cJSON_GetHash), and with deleted true right before it is freed. Copies of an
+ * item aren't watched. While no hook is set (NULL, the default) nothing is reported, and changing items costs nothing extra. */
+typedef void (*cJSON_WatchHook)(cJSON *item, cJSON_bool deleted);
+CJSON_PUBLIC(void) cJSON_SetWatchHook(cJSON_WatchHook hook);
 
 /* Memory Management: the caller is always responsible to free the results from all variants of cJSON_Parse (with cJSON_Delete) and cJSON_Print (with stdlib free, cJSON_Hooks.free_fn, or cJSON_free as appropriate). The exception is cJSON_PrintPreallocated, where the caller has full responsibility of the buffer. */
 /* Supply a block of JSON, and this returns a cJSON object you can interrogate. */
 CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value);
+/* Same as cJSON_Parse, but the input doesn't have to be null terminated, at most buffer_length bytes are read. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_length);
 /* ParseWithOpts allows you to require (and check) that the JSON is null terminated, and to retrieve the pointer to the final byte parsed. */
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* Same result as cJSON_ParseWithLength, but the elements of a large top level array are parsed in parallel on pool (see cJSON_Pool.h).
+ * Small inputs and other values are parsed on the calling thread. */
+struct cJSONPool;
+CJSON_PUBLIC(cJSON *) cJSON_ParseParallel(const char *value, size_t buffer_length, struct cJSONPool *pool);
+/* Parse only the object members selected by JSON pointers (RFC 6901), like a field mask: every member on the way to a pointer is
+ * kept and a pointer keeps the whole value it points to. Arrays are transparent, the pointer "/items/id" keeps the member "id"
+ * of every object in the array "items". The other members are checked like the rest of the input but not built. */
+typedef struct cJSON_Projection cJSON_Projection;
+/* Returns NULL for invalid pointers. An empty list selects nothing below the root, the pointer "" selects everything. */
+CJSON_PUBLIC(cJSON_Projection *) cJSON_CreateProjection(const char * const *pointers, size_t count);
+CJSON_PUBLIC(void) cJSON_DeleteProjection(cJSON_Projection *projection);
+/* A NULL projection parses everything. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseProjected(const char *value, size_t buffer_length, const cJSON_Projection *projection);
+CJSON_PUBLIC(cJSON *) cJSON_ParseProjectedWithOpts(const char *value, size_t buffer_length, const cJSON_Projection *projection, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* Parse a top level array keeping only the elements accepted by filter: each element is passed to filter as soon as it is parsed
+ * and deleted right away if it returns false, so memory grows with the kept elements only. filter must not modify the element.
+ * Other values are parsed like cJSON_ParseWithLength. See cJSONUtils_ParseFiltered for compiled predicates. */
+typedef cJSON_bool (*cJSON_ElementFilter)(cJSON *element, void *context);
+CJSON_PUBLIC(cJSON *) cJSON_ParseFiltered(const char *value, size_t buffer_length, cJSON_ElementFilter filter, void *context);
 
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
@@ -159,6 +206,22 @@ CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON
 /* Render a cJSON entity to text using a buffer already allocated in memory with given length. Returns 1 on success and 0 on failure. */
 /* NOTE: cJSON is not always 100% accurate in estimating how much memory it will use, so to be safe allocate 5 bytes more than you actually need */
 CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buffer, const int length, const cJSON_bool format);
+/* Same output as cJSON_Print/cJSON_PrintUnformatted, but large arrays and objects are split into runs of elements that are printed
+ * in parallel on pool (see cJSON_Pool.h) and concatenated. Large containers are also found up to a few levels below the root. */
+CJSON_PUBLIC(char *) cJSON_PrintParallel(const cJSON *item, cJSON_bool format, struct cJSONPool *pool);
+#if !defined(_WIN32)
+/* Print in parallel and write the pieces to fd with writev, without building the whole text in memory (no terminating '\0' is written).
+ * Returns false on failure, output may have been written partially. */
+CJSON_PUBLIC(cJSON_bool) cJSON_PrintParallelToFd(const cJSON *item, cJSON_bool format, struct cJSONPool *pool, int fd);
+#endif
+/* Incremental printing: the cache keeps the text of every array and object of at least threshold bytes from the last print.
+ * Printing again copies the text of subtrees that haven't changed since (tracked with cJSON_PrintCached and the cached hashes,
+ * see cJSON_GetHash) and only renders the changed paths, so small edits of a large document are cheap to print again.
+ * Output is the same as cJSON_Print/cJSON_PrintUnformatted. Use one cache per document, printing writes hashes and flags into the items. */
+typedef struct cJSON_PrintCache cJSON_PrintCache;
+CJSON_PUBLIC(cJSON_PrintCache *) cJSON_CreatePrintCache(size_t threshold);
+CJSON_PUBLIC(void) cJSON_DeletePrintCache(cJSON_PrintCache *cache);
+CJSON_PUBLIC(char *) cJSON_PrintWithCache(const cJSON *item, cJSON_bool format, cJSON_PrintCache *cache);
 /* Delete a cJSON entity and all subentities. */
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *c);
 
@@ -170,7 +233,7 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string);
-/* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. */
+/* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. The error is tracked per thread. */
 CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void);
 
 /* Check if the item is a string and return its valuestring */
@@ -207,6 +270,13 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateStringReference(const char *string);
  * they will not be freed by cJSON_Delete */
 CJSON_PUBLIC(cJSON *) cJSON_CreateObjectReference(const cJSON *child);
 CJSON_PUBLIC(cJSON *) cJSON_CreateArrayReference(const cJSON *child);
+/* Counted references for document versions: the new item shares the children of item (cJSON_IsShared), they are kept alive
+ * by cJSON_Delete until the last item sharing them is deleted. Scalars, empty containers and plain references are copied,
+ * roots are copied with shared children. Items that are shared must not be changed anymore. */
+CJSON_PUBLIC(cJSON *) cJSON_CreateSharedReference(const cJSON *item);
+/* Give a shared (or plain reference) array or object its own children, which share the old ones, so it can be changed.
+ * Returns false if out of memory. */
+CJSON_PUBLIC(cJSON_bool) cJSON_Unshare(cJSON * const item);
 
 /* These utilities create an Array of count items. */
 CJSON_PUBLIC(cJSON *) cJSON_CreateIntArray(const int *numbers, int count);
@@ -246,10 +316,29 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse);
 /* Duplicate will create a new, identical cJSON item to the one you pass, in new memory that will
 need to be released. With recurse!=0, it will duplicate any children connected to the item.
 The item->next and ->prev pointers are always zero on return from Duplicate. */
+/* Duplicate item with all its children into a single allocation: the subtree is measured first, then the items, keys and strings
+ * are copied into one block without recursion, which takes about half the time of cJSON_Duplicate for cloning small template documents.
+ * The copy is changed and deleted with cJSON_Delete like any other item, but its items (cJSON_InBlock) must not be used after the
+ * root of the copy is deleted, so detach and keep only items that were added to it later. Returns NULL if out of memory. */
+CJSON_PUBLIC(cJSON *) cJSON_DuplicateBlock(const cJSON *item);
 /* Recursively compare two cJSON items for equality. If either a or b is NULL or invalid, they will be considered unequal.
- * case_sensitive determines if object keys are treated case sensitive (1) or case insensitive (0) */
+ * case_sensitive determines if object keys are treated case sensitive (1) or case insensitive (0).
+ * Objects are equal if they have the same number of members and the members match by key (duplicate keys in order);
+ * members in the same order are matched as they come, large objects out of order through a hash table of the keys, so comparing them is linear. */
 CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * const b, const cJSON_bool case_sensitive);
 
+/* 64 bit structural hash of item: equal items (cJSON_Compare, case sensitive) have equal hashes, the order of object members
+ * doesn't matter. Computed bottom up and cached in every item, so it is O(1) until the item or one of its children changes.
+ * cJSON_Compare and the diff functions of cJSON_Utils use different hashes to skip comparing subtrees that differ, equal hashes
+ * are always confirmed by comparing.
+ * All functions that change items drop the cached hashes up to the root. If you change valuestring, valuedouble,
+ * valueint or type directly, call cJSON_InvalidateHash on the item afterwards. Subtrees containing references are never cached,
+ * except for the cJSON_IsShared items of document versions, which don't change. Returns 0 if item is NULL or out of memory. */
+CJSON_PUBLIC(unsigned long long) cJSON_GetHash(cJSON * const item);
+/* Same hash, but nothing is written to the items (hashes that are already cached are used), so it is safe on documents shared between threads. */
+CJSON_PUBLIC(unsigned long long) cJSON_ComputeHash(const cJSON * const item);
+CJSON_PUBLIC(void) cJSON_InvalidateHash(cJSON * const item);
+
 
 CJSON_PUBLIC(void) cJSON_Minify(char *json);
 
@@ -265,9 +354,10 @@ CJSON_PUBLIC(cJSON*) cJSON_AddRawToObject(cJSON * const object, const char * con
 CJSON_PUBLIC(cJSON*) cJSON_AddObjectToObject(cJSON * const object, const char * const name);
 CJSON_PUBLIC(cJSON*) cJSON_AddArrayToObject(cJSON * const object, const char * const name);
 
-/* When assigning an integer value, it needs to be propagated to valuedouble too. */
-#define cJSON_SetIntValue(object, number) ((object) ? (object)->valueint = (object)->valuedouble = (number) : (number))
-/* helper for the cJSON_SetNumberValue macro */
+/* When assigning an integer value, it needs to be propagated to valuedouble too. Goes through cJSON_SetNumberHelper so that
+ * cached hashes of the item and its parents are invalidated. */
+#define cJSON_SetIntValue(object, number) ((object) ? cJSON_SetNumberHelper(object, (double)(number)) : (number))
+/* helper for the cJSON_SetNumberValue and cJSON_SetIntValue macros */
 CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number);
 #define cJSON_SetNumberValue(object, number) ((object != NULL) ? cJSON_SetNumberHelper(object, (double)number) : (number))
 
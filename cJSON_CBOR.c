@@ -0,0 +1,1155 @@
+/* CBOR (RFC 8949) encoder and incremental decoder working directly on cJSON trees. */
+
+/* disable warnings about old C89 functions in MSVC */
+#if !defined(_CRT_SECURE_NO_DEPRECATE) && defined(_MSC_VER)
+#define _CRT_SECURE_NO_DEPRECATE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "cJSON_CBOR.h"
+
+/* define our own boolean type */
+#ifdef true
+#undef true
+#endif
+#define true ((cJSON_bool)1)
+
+#ifdef false
+#undef false
+#endif
+#define false ((cJSON_bool)0)
+
+#define MAJOR_UNSIGNED 0
+#define MAJOR_NEGATIVE 1
+#define MAJOR_BYTES 2
+#define MAJOR_TEXT 3
+#define MAJOR_ARRAY 4
+#define MAJOR_MAP 5
+#define MAJOR_TAG 6
+#define MAJOR_SIMPLE 7
+
+/* additional information value for indefinite length items and the "break" stop code */
+#define INDEFINITE 31
+
+typedef struct
+{
+    unsigned char *buffer;
+    size_t length;
+    size_t offset;
+} cbor_buffer;
+
+/* grow the buffer if necessary to have at least "needed" bytes more */
+static unsigned char *ensure(cbor_buffer * const output, size_t needed)
+{
+    unsigned char *new_buffer = NULL;
+    size_t new_size = 0;
+
+    if ((output == NULL) || (output->buffer == NULL))
+    {
+        return NULL;
+    }
+
+    if (needed > ((size_t)-1 / 2) - output->offset)
+    {
+        return NULL;
+    }
+
+    needed += output->offset;
+    if (needed <= output->length)
+    {
+        return output->buffer + output->offset;
+    }
+
+    new_size = needed * 2;
+    new_buffer = (unsigned char*)cJSON_malloc(new_size);
+    if (new_buffer == NULL)
+    {
+        cJSON_free(output->buffer);
+        output->buffer = NULL;
+        output->length = 0;
+
+        return NULL;
+    }
+    if (output->offset > 0)
+    {
+        memcpy(new_buffer, output->buffer, output->offset);
+    }
+    cJSON_free(output->buffer);
+
+    output->buffer = new_buffer;
+    output->length = new_size;
+
+    return new_buffer + output->offset;
+}
+
+/* write an initial byte with the shortest argument encoding */
+static cJSON_bool write_head(cbor_buffer * const output, const unsigned char major, const unsigned long long argument)
+{
+    unsigned char *output_pointer = NULL;
+    size_t size = 0;
+    size_t i = 0;
+    unsigned char additional = 0;
+
+    if (argument < 24)
+    {
+        additional = (unsigned char)argument;
+    }
+    else if (argument <= 0xFF)
+    {
+        additional = 24;
+        size = 1;
+    }
+    else if (argument <= 0xFFFF)
+    {
+        additional = 25;
+        size = 2;
+    }
+    else if (argument <= 0xFFFFFFFFUL)
+    {
+        additional = 26;
+        size = 4;
+    }
+    else
+    {
+        additional = 27;
+        size = 8;
+    }
+
+    output_pointer = ensure(output, size + 1);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+
+    output_pointer[0] = (unsigned char)((major << 5) | additional);
+    for (i = 0; i < size; i++)
+    {
+        output_pointer[size - i] = (unsigned char)((argument >> (8 * i)) & 0xFF);
+    }
+    output->offset += size + 1;
+
+    return true;
+}
+
+/* write a major type 7 float with a fixed size argument */
+static cJSON_bool write_float(cbor_buffer * const output, const unsigned char additional, const unsigned long long bits, const size_t size)
+{
+    unsigned char *output_pointer = ensure(output, size + 1);
+    size_t i = 0;
+
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+
+    output_pointer[0] = (unsigned char)((MAJOR_SIMPLE << 5) | additional);
+    for (i = 0; i < size; i++)
+    {
+        output_pointer[size - i] = (unsigned char)((bits >> (8 * i)) & 0xFF);
+    }
+    output->offset += size + 1;
+
+    return true;
+}
+
+/* convert a single precision bit pattern to half precision if that is lossless */
+static cJSON_bool single_to_half(const unsigned long single, unsigned int * const half)
+{
+    unsigned int sign = (unsigned int)((single >> 16) & 0x8000);
+    int exponent = (int)((single >> 23) & 0xFF);
+    unsigned long mantissa = single & 0x7FFFFF;
+
+    if (exponent == 0xFF)
+    {
+        /* infinity, NaN is always written as the canonical quiet NaN */
+        *half = (mantissa == 0) ? (sign | 0x7C00) : 0x7E00;
+        return true;
+    }
+    if ((exponent == 0) && (mantissa == 0))
+    {
+        *half = sign;
+        return true;
+    }
+    if (exponent == 0)
+    {
+        /* single precision subnormals are far below the half precision range */
+        return false;
+    }
+
+    exponent -= 127;
+    if ((exponent >= -14) && (exponent <= 15))
+    {
+        if ((mantissa & 0x1FFF) != 0)
+        {
+            return false;
+        }
+        *half = sign | (unsigned int)((exponent + 15) << 10) | (unsigned int)(mantissa >> 13);
+        return true;
+    }
+    if ((exponent >= -24) && (exponent < -14))
+    {
+        /* half precision subnormal */
+        int shift = 13 + (-14 - exponent);
+        mantissa |= 0x800000;
+        if ((mantissa & ((1UL << shift) - 1)) != 0)
+        {
+            return false;
+        }
+        *half = sign | (unsigned int)(mantissa >> shift);
+        return true;
+    }
+
+    return false;
+}
+
+static cJSON_bool encode_number(const double number, cbor_buffer * const output)
+{
+    float single = (float)number;
+
+    if ((number >= 0) && (number < 18446744073709551616.0) && !((number == 0) && (1 / number < 0)))
+    {
+        unsigned long long integer = (unsigned long long)number;
+        if ((double)integer == number)
+        {
+            return write_head(output, MAJOR_UNSIGNED, integer);
+        }
+    }
+    else if ((number < 0) && (number >= -18446744073709551616.0))
+    {
+        /* major type 1 encodes -1 - n */
+        double magnitude = -1 - number;
+        if ((magnitude >= 0) && (magnitude < 18446744073709551616.0))
+        {
+            unsigned long long integer = (unsigned long long)magnitude;
+            if ((double)integer == magnitude)
+            {
+                return write_head(output, MAJOR_NEGATIVE, integer);
+            }
+        }
+    }
+
+    /* integers and floats share their byte order, so the bit patterns can be moved through integers */
+    if ((((double)single == number) || (number != number)) && (sizeof(unsigned int) == sizeof(single)))
+    {
+        unsigned int pattern = 0;
+        unsigned int half = 0;
+        memcpy(&pattern, &single, sizeof(single));
+        if (single_to_half(pattern, &half))
+        {
+            return write_float(output, 25, half, 2);
+        }
+        return write_float(output, 26, pattern, 4);
+    }
+
+    {
+        unsigned long long pattern = 0;
+        memcpy(&pattern, &number, sizeof(pattern));
+        return write_float(output, 27, pattern, 8);
+    }
+}
+
+static cJSON_bool encode_text(const char * const string, cbor_buffer * const output)
+{
+    size_t length = (string == NULL) ? 0 : strlen(string);
+    unsigned char *output_pointer = NULL;
+
+    if (!write_head(output, MAJOR_TEXT, length))
+    {
+        return false;
+    }
+
+    output_pointer = ensure(output, length);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+    if (length > 0)
+    {
+        memcpy(output_pointer, string, length);
+    }
+    output->offset += length;
+
+    return true;
+}
+
+static cJSON_bool encode_value(const cJSON * const item, cbor_buffer * const output, size_t depth)
+{
+    const cJSON *child = NULL;
+    size_t count = 0;
+
+    if (depth >= CJSON_NESTING_LIMIT)
+    {
+        return false;
+    }
+
+    switch (item->type & 0xFF)
+    {
+        case cJSON_False:
+            return write_head(output, MAJOR_SIMPLE, 20);
+
+        case cJSON_True:
+            return write_head(output, MAJOR_SIMPLE, 21);
+
+        case cJSON_NULL:
+            return write_head(output, MAJOR_SIMPLE, 22);
+
+        case cJSON_Number:
+            return encode_number(item->valuedouble, output);
+
+        case cJSON_String:
+        case cJSON_Raw:
+            return encode_text(item->valuestring, output);
+
+        case cJSON_Array:
+        case cJSON_Object:
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                count++;
+            }
+            if (!write_head(output, cJSON_IsArray(item) ? MAJOR_ARRAY : MAJOR_MAP, count))
+            {
+                return false;
+            }
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                if (cJSON_IsObject(item) && !encode_text(child->string, output))
+                {
+                    return false;
+                }
+                if (!encode_value(child, output, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+CJSON_PUBLIC(unsigned char *) cJSONCBOR_Encode(const cJSON *item, size_t *length)
+{
+    static const size_t default_buffer_size = 256;
+    cbor_buffer output = { NULL, 0, 0 };
+
+    if ((item == NULL) || (length == NULL))
+    {
+        return NULL;
+    }
+
+    output.buffer = (unsigned char*)cJSON_malloc(default_buffer_size);
+    if (output.buffer == NULL)
+    {
+        return NULL;
+    }
+    output.length = default_buffer_size;
+
+    if (!encode_value(item, &output, 0))
+    {
+        if (output.buffer != NULL)
+        {
+            cJSON_free(output.buffer);
+        }
+        return NULL;
+    }
+
+    *length = output.offset;
+    return output.buffer;
+}
+
+/* Decoder */
+
+typedef struct
+{
+    cJSON *container;
+    cJSON *tail; /* last child, to append in O(1) */
+    unsigned long long remaining; /* items (arrays) or pairs (maps) left for definite length containers */
+    cJSON_bool indefinite;
+    char *key; /* map key waiting for its value */
+} cbor_frame;
+
+enum decoder_state { READ_HEAD, READ_STRING, FINISHED, FAILED };
+
+struct cJSONCBOR_Decoder
+{
+    int bytes_mode;
+    enum decoder_state state;
+
+    /* initial byte and argument of the data item being read */
+    unsigned char head[9];
+    size_t head_length;
+    size_t head_needed;
+
+    /* string being collected, indefinite length strings collect all chunks here */
+    cbor_buffer string;
+    unsigned long long string_remaining;
+    unsigned char string_major;
+    cJSON_bool string_indefinite;
+
+    /* last tag in front of the current item, only 21/22/23 are interpreted */
+    unsigned long long tag;
+
+    cbor_frame *frames;
+    size_t depth;
+    size_t frames_capacity;
+
+    cJSON *result;
+};
+
+static void reset_decoder(cJSONCBOR_Decoder * const decoder)
+{
+    size_t i = 0;
+
+    for (i = 0; i < decoder->depth; i++)
+    {
+        if (decoder->frames[i].key != NULL)
+        {
+            cJSON_free(decoder->frames[i].key);
+        }
+    }
+    /* the outermost container owns everything that is still open */
+    if (decoder->depth > 0)
+    {
+        cJSON_Delete(decoder->frames[0].container);
+    }
+    decoder->depth = 0;
+
+    if (decoder->string.buffer != NULL)
+    {
+        cJSON_free(decoder->string.buffer);
+    }
+    decoder->string.buffer = NULL;
+    decoder->string.length = 0;
+    decoder->string.offset = 0;
+    decoder->string_remaining = 0;
+    decoder->string_indefinite = false;
+
+    if (decoder->result != NULL)
+    {
+        cJSON_Delete(decoder->result);
+        decoder->result = NULL;
+    }
+
+    decoder->head_length = 0;
+    decoder->head_needed = 0;
+    decoder->tag = 0;
+    decoder->state = READ_HEAD;
+}
+
+CJSON_PUBLIC(cJSONCBOR_Decoder *) cJSONCBOR_CreateDecoder(int bytes_mode)
+{
+    cJSONCBOR_Decoder *decoder = NULL;
+
+    if ((bytes_mode < cJSONCBOR_BytesBase64Url) || (bytes_mode > cJSONCBOR_BytesRaw))
+    {
+        return NULL;
+    }
+
+    decoder = (cJSONCBOR_Decoder*)cJSON_malloc(sizeof(cJSONCBOR_Decoder));
+    if (decoder == NULL)
+    {
+        return NULL;
+    }
+    memset(decoder, '\0', sizeof(cJSONCBOR_Decoder));
+    decoder->bytes_mode = bytes_mode;
+    decoder->state = READ_HEAD;
+
+    return decoder;
+}
+
+CJSON_PUBLIC(void) cJSONCBOR_DeleteDecoder(cJSONCBOR_Decoder *decoder)
+{
+    if (decoder == NULL)
+    {
+        return;
+    }
+
+    reset_decoder(decoder);
+    if (decoder->frames != NULL)
+    {
+        cJSON_free(decoder->frames);
+    }
+    cJSON_free(decoder);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONCBOR_TakeResult(cJSONCBOR_Decoder *decoder)
+{
+    cJSON *result = NULL;
+
+    if ((decoder == NULL) || (decoder->state != FINISHED))
+    {
+        return NULL;
+    }
+
+    result = decoder->result;
+    decoder->result = NULL;
+    reset_decoder(decoder);
+
+    return result;
+}
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64url_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* convert collected byte string data into a zero terminated cJSON string */
+static char *convert_bytes(const unsigned char * const bytes, const size_t length, const int mode)
+{
+    char *string = NULL;
+    size_t i = 0;
+    size_t position = 0;
+
+    if (mode == cJSONCBOR_BytesRaw)
+    {
+        if ((length > 0) && (memchr(bytes, '\0', length) != NULL))
+        {
+            return NULL;
+        }
+        string = (char*)cJSON_malloc(length + sizeof(""));
+        if (string == NULL)
+        {
+            return NULL;
+        }
+        if (length > 0)
+        {
+            memcpy(string, bytes, length);
+        }
+        string[length] = '\0';
+        return string;
+    }
+
+    if (mode == -1)
+    {
+        /* base16, requested by tag 23 */
+        static const char hex[] = "0123456789abcdef";
+        string = (char*)cJSON_malloc(2 * length + sizeof(""));
+        if (string == NULL)
+        {
+            return NULL;
+        }
+        for (i = 0; i < length; i++)
+        {
+            string[position++] = hex[bytes[i] >> 4];
+            string[position++] = hex[bytes[i] & 0x0F];
+        }
+        string[position] = '\0';
+        return string;
+    }
+
+    {
+        const char *alphabet = (mode == cJSONCBOR_BytesBase64) ? base64_alphabet : base64url_alphabet;
+        string = (char*)cJSON_malloc(((length + 2) / 3) * 4 + sizeof(""));
+        if (string == NULL)
+        {
+            return NULL;
+        }
+        for (i = 0; (i + 2) < length; i += 3)
+        {
+            unsigned long group = ((unsigned long)bytes[i] << 16) | ((unsigned long)bytes[i + 1] << 8) | bytes[i + 2];
+            string[position++] = alphabet[(group >> 18) & 0x3F];
+            string[position++] = alphabet[(group >> 12) & 0x3F];
+            string[position++] = alphabet[(group >> 6) & 0x3F];
+            string[position++] = alphabet[group & 0x3F];
+        }
+        if (i < length)
+        {
+            unsigned long group = (unsigned long)bytes[i] << 16;
+            if ((i + 1) < length)
+            {
+                group |= (unsigned long)bytes[i + 1] << 8;
+            }
+            string[position++] = alphabet[(group >> 18) & 0x3F];
+            string[position++] = alphabet[(group >> 12) & 0x3F];
+            if ((i + 1) < length)
+            {
+                string[position++] = alphabet[(group >> 6) & 0x3F];
+            }
+            else if (mode == cJSONCBOR_BytesBase64)
+            {
+                string[position++] = '=';
+            }
+            if (mode == cJSONCBOR_BytesBase64)
+            {
+                string[position++] = '=';
+            }
+        }
+        string[position] = '\0';
+        return string;
+    }
+}
+
+/* multiply by 2^exponent without pulling in libm */
+static double scale(double value, int exponent)
+{
+    for (; exponent > 0; exponent--)
+    {
+        value *= 2;
+    }
+    for (; exponent < 0; exponent++)
+    {
+        value /= 2;
+    }
+
+    return value;
+}
+
+/* see RFC 8949 appendix D */
+static double decode_half(const unsigned int half)
+{
+    unsigned int exponent = (half >> 10) & 0x1F;
+    unsigned int mantissa = half & 0x3FF;
+    double value = 0;
+
+    if (exponent == 0)
+    {
+        value = scale((double)mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = scale((double)(mantissa + 1024), (int)exponent - 25);
+    }
+    else
+    {
+        value = (mantissa == 0) ? HUGE_VAL : (HUGE_VAL - HUGE_VAL);
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+static cJSON_bool push_frame(cJSONCBOR_Decoder * const decoder, cJSON * const container, const unsigned long long count, const cJSON_bool indefinite)
+{
+    cbor_frame *frame = NULL;
+
+    if (decoder->depth >= CJSON_NESTING_LIMIT)
+    {
+        return false;
+    }
+
+    if (decoder->depth == decoder->frames_capacity)
+    {
+        size_t new_capacity = (decoder->frames_capacity == 0) ? 8 : (decoder->frames_capacity * 2);
+        cbor_frame *new_frames = (cbor_frame*)cJSON_malloc(new_capacity * sizeof(cbor_frame));
+        if (new_frames == NULL)
+        {
+            return false;
+        }
+        if (decoder->frames != NULL)
+        {
+            memcpy(new_frames, decoder->frames, decoder->depth * sizeof(cbor_frame));
+            cJSON_free(decoder->frames);
+        }
+        decoder->frames = new_frames;
+        decoder->frames_capacity = new_capacity;
+    }
+
+    frame = &decoder->frames[decoder->depth];
+    frame->container = container;
+    frame->tail = NULL;
+    frame->remaining = count;
+    frame->indefinite = indefinite;
+    frame->key = NULL;
+    decoder->depth++;
+
+    return true;
+}
+
+/* turn a decoded map key into a string */
+static char *take_key(cJSON * const item)
+{
+    char *key = NULL;
+
+    if (cJSON_IsString(item))
+    {
+        key = item->valuestring;
+        item->valuestring = NULL;
+    }
+    else if (cJSON_IsNumber(item))
+    {
+        /* RFC 8949 section 6.1 suggests converting integer keys to their decimal form */
+        char number[32];
+        size_t length = 0;
+        if ((item->valuedouble > -9.2e18) && (item->valuedouble < 9.2e18) && ((double)(long long)item->valuedouble == item->valuedouble))
+        {
+            sprintf(number, "%lld", (long long)item->valuedouble);
+        }
+        else
+        {
+            sprintf(number, "%1.17g", item->valuedouble);
+        }
+        length = strlen(number) + sizeof("");
+        key = (char*)cJSON_malloc(length);
+        if (key != NULL)
+        {
+            memcpy(key, number, length);
+        }
+    }
+
+    cJSON_Delete(item);
+    return key;
+}
+
+/* link an item into a container frame, map members get the key waiting in the frame */
+static void link_item(cbor_frame * const frame, cJSON * const item)
+{
+    if (cJSON_IsObject(frame->container))
+    {
+        item->string = frame->key;
+        frame->key = NULL;
+    }
+    item->parent = frame->container;
+    if (frame->tail == NULL)
+    {
+        frame->container->child = item;
+    }
+    else
+    {
+        frame->tail->next = item;
+        item->prev = frame->tail;
+    }
+    frame->tail = item;
+}
+
+/* one more item of the innermost container is complete, close every container that becomes complete */
+static void close_frames(cJSONCBOR_Decoder * const decoder)
+{
+    while (decoder->depth > 0)
+    {
+        cbor_frame *frame = &decoder->frames[decoder->depth - 1];
+
+        if (frame->indefinite)
+        {
+            return;
+        }
+        frame->remaining--;
+        if (frame->remaining > 0)
+        {
+            return;
+        }
+
+        decoder->depth--;
+        if (decoder->depth == 0)
+        {
+            decoder->result = frame->container;
+            decoder->state = FINISHED;
+        }
+    }
+}
+
+/* hand a finished scalar (or empty container) to the innermost open container */
+static cJSON_bool complete_item(cJSONCBOR_Decoder * const decoder, cJSON * const item)
+{
+    cbor_frame *frame = NULL;
+
+    if (decoder->depth == 0)
+    {
+        decoder->result = item;
+        decoder->state = FINISHED;
+        return true;
+    }
+
+    frame = &decoder->frames[decoder->depth - 1];
+    if (cJSON_IsObject(frame->container) && (frame->key == NULL))
+    {
+        frame->key = take_key(item);
+        return frame->key != NULL;
+    }
+
+    link_item(frame, item);
+    close_frames(decoder);
+
+    return true;
+}
+
+static cJSON_bool finish_string(cJSONCBOR_Decoder * const decoder)
+{
+    cJSON *item = NULL;
+    char *string = NULL;
+    unsigned char *bytes = decoder->string.buffer;
+    size_t length = decoder->string.offset;
+
+    if (decoder->string_major == MAJOR_TEXT)
+    {
+        string = convert_bytes(bytes, length, cJSONCBOR_BytesRaw);
+    }
+    else
+    {
+        int mode = decoder->bytes_mode;
+        if (decoder->tag == 21)
+        {
+            mode = cJSONCBOR_BytesBase64Url;
+        }
+        else if (decoder->tag == 22)
+        {
+            mode = cJSONCBOR_BytesBase64;
+        }
+        else if (decoder->tag == 23)
+        {
+            mode = -1;
+        }
+        string = convert_bytes(bytes, length, mode);
+    }
+
+    if (bytes != NULL)
+    {
+        cJSON_free(bytes);
+    }
+    decoder->string.buffer = NULL;
+    decoder->string.length = 0;
+    decoder->string.offset = 0;
+    decoder->string_indefinite = false;
+    decoder->tag = 0;
+    decoder->state = READ_HEAD;
+
+    if (string == NULL)
+    {
+        return false;
+    }
+
+    item = cJSON_CreateNull();
+    if (item == NULL)
+    {
+        cJSON_free(string);
+        return false;
+    }
+    item->type = cJSON_String;
+    item->valuestring = string;
+
+    return complete_item(decoder, item);
+}
+
+/* start collecting the payload of a definite length string (or string chunk) */
+static cJSON_bool start_string(cJSONCBOR_Decoder * const decoder, const unsigned long long length)
+{
+    if (decoder->string.buffer == NULL)
+    {
+        /* don't trust the announced length for the allocation, the data might never arrive */
+        decoder->string.length = (length < 4096) ? ((size_t)length + 1) : 4096;
+        decoder->string.buffer = (unsigned char*)cJSON_malloc(decoder->string.length);
+        if (decoder->string.buffer == NULL)
+        {
+            return false;
+        }
+        decoder->string.offset = 0;
+    }
+
+    decoder->string_remaining = length;
+    decoder->state = READ_STRING;
+    if (length == 0)
+    {
+        if (decoder->string_indefinite)
+        {
+            /* empty chunk */
+            decoder->state = READ_HEAD;
+            return true;
+        }
+        return finish_string(decoder);
+    }
+
+    return true;
+}
+
+/* handle a data item whose initial byte and argument have been read completely */
+static cJSON_bool process_head(cJSONCBOR_Decoder * const decoder)
+{
+    unsigned char major = (unsigned char)(decoder->head[0] >> 5);
+    unsigned char additional = (unsigned char)(decoder->head[0] & 0x1F);
+    unsigned long long argument = additional;
+    cJSON *item = NULL;
+    size_t i = 0;
+
+    decoder->head_length = 0;
+    decoder->head_needed = 0;
+
+    if ((additional >= 24) && (additional < INDEFINITE))
+    {
+        argument = 0;
+        for (i = 1; i < (size_t)(1 << (additional - 24)) + 1; i++)
+        {
+            argument = (argument << 8) | decoder->head[i];
+        }
+    }
+
+    if (decoder->string_indefinite)
+    {
+        /* inside an indefinite length string only definite chunks of the same type and "break" are allowed */
+        if ((major == MAJOR_SIMPLE) && (additional == INDEFINITE))
+        {
+            return finish_string(decoder);
+        }
+        if ((major != decoder->string_major) || (additional == INDEFINITE))
+        {
+            return false;
+        }
+        return start_string(decoder, argument);
+    }
+
+    switch (major)
+    {
+        case MAJOR_UNSIGNED:
+            item = cJSON_CreateNumber((double)argument);
+            break;
+
+        case MAJOR_NEGATIVE:
+            item = cJSON_CreateNumber(-1 - (double)argument);
+            break;
+
+        case MAJOR_BYTES:
+        case MAJOR_TEXT:
+            decoder->string_major = major;
+            if (additional == INDEFINITE)
+            {
+                decoder->string_indefinite = true;
+                decoder->string.length = 64;
+                decoder->string.offset = 0;
+                decoder->string.buffer = (unsigned char*)cJSON_malloc(decoder->string.length);
+                return decoder->string.buffer != NULL;
+            }
+            return start_string(decoder, argument);
+
+        case MAJOR_ARRAY:
+        case MAJOR_MAP:
+            item = (major == MAJOR_ARRAY) ? cJSON_CreateArray() : cJSON_CreateObject();
+            if (item == NULL)
+            {
+                return false;
+            }
+            decoder->tag = 0;
+            if ((additional != INDEFINITE) && (argument == 0))
+            {
+                return complete_item(decoder, item);
+            }
+            if (decoder->depth > 0)
+            {
+                /* link the container right away, so that it is owned by the outermost container if decoding fails */
+                cbor_frame *frame = &decoder->frames[decoder->depth - 1];
+                if (cJSON_IsObject(frame->container) && (frame->key == NULL))
+                {
+                    /* containers can't be map keys */
+                    cJSON_Delete(item);
+                    return false;
+                }
+                link_item(frame, item);
+            }
+            if (!push_frame(decoder, item, argument, additional == INDEFINITE))
+            {
+                if (decoder->depth == 0)
+                {
+                    cJSON_Delete(item);
+                }
+                return false;
+            }
+            return true;
+
+        case MAJOR_TAG:
+            /* tags are transparent, only remember the last one for byte string conversion */
+            if (additional == INDEFINITE)
+            {
+                return false;
+            }
+            decoder->tag = argument;
+            return true;
+
+        case MAJOR_SIMPLE:
+            switch (additional)
+            {
+                case 20:
+                    item = cJSON_CreateFalse();
+                    break;
+                case 21:
+                    item = cJSON_CreateTrue();
+                    break;
+                case 22:
+                case 23: /* undefined */
+                    item = cJSON_CreateNull();
+                    break;
+                case 25:
+                    item = cJSON_CreateNumber(decode_half((unsigned int)argument));
+                    break;
+                case 26:
+                {
+                    unsigned int pattern = (unsigned int)argument;
+                    float single = 0;
+                    if (sizeof(pattern) != sizeof(single))
+                    {
+                        return false;
+                    }
+                    memcpy(&single, &pattern, sizeof(single));
+                    item = cJSON_CreateNumber((double)single);
+                    break;
+                }
+                case 27:
+                {
+                    double number = 0;
+                    memcpy(&number, &argument, sizeof(number));
+                    item = cJSON_CreateNumber(number);
+                    break;
+                }
+                case INDEFINITE:
+                {
+                    /* "break" closes the innermost indefinite length container */
+                    cbor_frame *frame = NULL;
+                    if (decoder->depth == 0)
+                    {
+                        return false;
+                    }
+                    frame = &decoder->frames[decoder->depth - 1];
+                    if (!frame->indefinite || (frame->key != NULL))
+                    {
+                        return false;
+                    }
+                    decoder->depth--;
+                    if (decoder->depth == 0)
+                    {
+                        decoder->result = frame->container;
+                        decoder->state = FINISHED;
+                        return true;
+                    }
+                    /* the container is already linked into its parent */
+                    close_frames(decoder);
+                    return true;
+                }
+                default:
+                    /* other simple values have no JSON representation */
+                    return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    if (item == NULL)
+    {
+        return false;
+    }
+    decoder->tag = 0;
+
+    return complete_item(decoder, item);
+}
+
+CJSON_PUBLIC(int) cJSONCBOR_Feed(cJSONCBOR_Decoder *decoder, const unsigned char *data, size_t length, size_t *consumed)
+{
+    size_t offset = 0;
+
+    if (consumed != NULL)
+    {
+        *consumed = 0;
+    }
+    if (decoder == NULL)
+    {
+        return cJSONCBOR_Error;
+    }
+    if ((data == NULL) && (length > 0))
+    {
+        decoder->state = FAILED;
+    }
+
+    while ((offset < length) && ((decoder->state == READ_HEAD) || (decoder->state == READ_STRING)))
+    {
+        if (decoder->state == READ_STRING)
+        {
+            size_t available = length - offset;
+            unsigned char *output = NULL;
+            if ((unsigned long long)available > decoder->string_remaining)
+            {
+                available = (size_t)decoder->string_remaining;
+            }
+            /* keep room for the terminating zero */
+            output = ensure(&decoder->string, available + 1);
+            if (output == NULL)
+            {
+                decoder->state = FAILED;
+                break;
+            }
+            memcpy(output, data + offset, available);
+            decoder->string.offset += available;
+            decoder->string_remaining -= available;
+            offset += available;
+
+            if (decoder->string_remaining == 0)
+            {
+                if (decoder->string_indefinite)
+                {
+                    decoder->state = READ_HEAD;
+                }
+                else if (!finish_string(decoder))
+                {
+                    decoder->state = FAILED;
+                }
+            }
+            continue;
+        }
+
+        if (decoder->head_length == 0)
+        {
+            unsigned char additional = (unsigned char)(data[offset] & 0x1F);
+            decoder->head[0] = data[offset++];
+            decoder->head_length = 1;
+            if ((additional >= 28) && (additional <= 30))
+            {
+                /* reserved */
+                decoder->state = FAILED;
+                break;
+            }
+            decoder->head_needed = (additional >= 24) && (additional < INDEFINITE) ? ((size_t)1 << (additional - 24)) + 1 : 1;
+        }
+        else
+        {
+            decoder->head[decoder->head_length++] = data[offset++];
+        }
+
+        if ((decoder->head_length == decoder->head_needed) && !process_head(decoder))
+        {
+            decoder->state = FAILED;
+        }
+    }
+
+    if (consumed != NULL)
+    {
+        *consumed = offset;
+    }
+
+    switch (decoder->state)
+    {
+        case FINISHED:
+            return cJSONCBOR_Done;
+        case FAILED:
+            return cJSONCBOR_Error;
+        default:
+            return cJSONCBOR_NeedMore;
+    }
+}
+
+CJSON_PUBLIC(cJSON *) cJSONCBOR_Decode(const unsigned char *data, size_t length, int bytes_mode, size_t *consumed)
+{
+    cJSONCBOR_Decoder *decoder = NULL;
+    cJSON *item = NULL;
+    size_t used = 0;
+
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    decoder = cJSONCBOR_CreateDecoder(bytes_mode);
+    if (decoder == NULL)
+    {
+        return NULL;
+    }
+
+    if ((cJSONCBOR_Feed(decoder, data, length, &used) == cJSONCBOR_Done) && ((consumed != NULL) || (used == length)))
+    {
+        item = cJSONCBOR_TakeResult(decoder);
+        if (consumed != NULL)
+        {
+            *consumed = used;
+        }
+    }
+
+    cJSONCBOR_DeleteDecoder(decoder);
+    return item;
+}
@@ -0,0 +1,45 @@
+#ifndef cJSON_CBOR__h
+#define cJSON_CBOR__h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "cJSON.h"
+
+/* Convert cJSON items to and from CBOR (RFC 8949, https://www.rfc-editor.org/rfc/rfc8949). */
+
+/* How byte strings (major type 2) are stored in cJSON strings. Tags 21, 22 and 23 in front of a byte string override this. */
+#define cJSONCBOR_BytesBase64Url 0 /* base64url without padding, as recommended by RFC 8949 section 6.1 */
+#define cJSONCBOR_BytesBase64    1 /* classic base64 with padding */
+#define cJSONCBOR_BytesRaw       2 /* the bytes themselves, rejected if they contain '\0' */
+
+/* Return values of cJSONCBOR_Feed */
+#define cJSONCBOR_Error    (-1)
+#define cJSONCBOR_NeedMore 0
+#define cJSONCBOR_Done     1
+
+/* Encode an item as CBOR. Returns a buffer allocated with cJSON_malloc (release it with cJSON_free) and stores its size in *length.
+ * Integral numbers become major type 0/1 integers, other numbers the shortest of half, single or double precision that is lossless.
+ * cJSON_Raw items are written as text strings. Returns NULL on failure. */
+CJSON_PUBLIC(unsigned char *) cJSONCBOR_Encode(const cJSON *item, size_t *length);
+/* Decode one complete CBOR data item. If consumed is NULL the item has to span the whole buffer, otherwise the number of bytes used is stored there. */
+CJSON_PUBLIC(cJSON *) cJSONCBOR_Decode(const unsigned char *data, size_t length, int bytes_mode, size_t *consumed);
+
+/* Incremental decoder: input can be split at any byte, the decoder keeps partial headers, strings and open containers between calls. */
+typedef struct cJSONCBOR_Decoder cJSONCBOR_Decoder;
+CJSON_PUBLIC(cJSONCBOR_Decoder *) cJSONCBOR_CreateDecoder(int bytes_mode);
+/* Feed the next chunk of input. Stops after the end of a data item, so *consumed (optional) can be smaller than length when the input
+ * is a sequence of items. Returns cJSONCBOR_Done once an item is complete, cJSONCBOR_NeedMore if more input is needed and
+ * cJSONCBOR_Error on malformed input (the decoder stays in the error state). */
+CJSON_PUBLIC(int) cJSONCBOR_Feed(cJSONCBOR_Decoder *decoder, const unsigned char *data, size_t length, size_t *consumed);
+/* Take the decoded item after cJSONCBOR_Done, the caller owns it. The decoder is reset and can decode the next item. */
+CJSON_PUBLIC(cJSON *) cJSONCBOR_TakeResult(cJSONCBOR_Decoder *decoder);
+CJSON_PUBLIC(void) cJSONCBOR_DeleteDecoder(cJSONCBOR_Decoder *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
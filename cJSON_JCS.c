@@ -0,0 +1,760 @@
+/* Canonical JSON writer (RFC 8785 JSON Canonicalization Scheme) with a SHA-256 sink. */
+
+/* disable warnings about old C89 functions in MSVC */
+#if !defined(_CRT_SECURE_NO_DEPRECATE) && defined(_MSC_VER)
+#define _CRT_SECURE_NO_DEPRECATE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "cJSON_JCS.h"
+
+/* define our own boolean type */
+#ifdef true
+#undef true
+#endif
+#define true ((cJSON_bool)1)
+
+#ifdef false
+#undef false
+#endif
+#define false ((cJSON_bool)0)
+
+/* output is collected in chunks of this size before it is passed to the sink */
+#define JCS_CHUNK_SIZE 4096
+
+typedef struct
+{
+    unsigned char buffer[JCS_CHUNK_SIZE];
+    size_t used;
+    cJSONJCS_Sink sink;
+    void *context;
+} jcs_writer;
+
+static cJSON_bool flush_writer(jcs_writer * const writer)
+{
+    cJSON_bool written = true;
+
+    if (writer->used > 0)
+    {
+        written = writer->sink(writer->buffer, writer->used, writer->context);
+        writer->used = 0;
+    }
+
+    return written;
+}
+
+static cJSON_bool write_bytes(jcs_writer * const writer, const unsigned char *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t piece = JCS_CHUNK_SIZE - writer->used;
+        if (piece > length)
+        {
+            piece = length;
+        }
+        memcpy(writer->buffer + writer->used, data, piece);
+        writer->used += piece;
+        data += piece;
+        length -= piece;
+        if ((writer->used == JCS_CHUNK_SIZE) && !flush_writer(writer))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static cJSON_bool write_byte(jcs_writer * const writer, const unsigned char byte)
+{
+    writer->buffer[writer->used++] = byte;
+    if (writer->used == JCS_CHUNK_SIZE)
+    {
+        return flush_writer(writer);
+    }
+
+    return true;
+}
+
+/* A string with the escapes of RFC 8785 section 3.2.2.2: '"', '\\' and the short forms of \b \f \n \r \t, other control
+ * characters as \u00xx in lowercase, everything else as it is. */
+static cJSON_bool write_string(jcs_writer * const writer, const unsigned char *string)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *run = string;
+    unsigned char escape[6] = { '\\', 'u', '0', '0', '0', '0' };
+
+    if (!write_byte(writer, '\"'))
+    {
+        return false;
+    }
+    for (; *string != '\0'; string++)
+    {
+        size_t escape_length = 2;
+        if ((*string >= 0x20) && (*string != '\"') && (*string != '\\'))
+        {
+            continue;
+        }
+
+        /* write the characters before the escape at once */
+        if (!write_bytes(writer, run, (size_t)(string - run)))
+        {
+            return false;
+        }
+        run = string + 1;
+        switch (*string)
+        {
+            case '\"':
+            case '\\':
+                escape[1] = *string;
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                escape[4] = (unsigned char)hex[*string >> 4];
+                escape[5] = (unsigned char)hex[*string & 0x0F];
+                escape_length = 6;
+                break;
+        }
+        if (!write_bytes(writer, escape, escape_length))
+        {
+            return false;
+        }
+    }
+    if (!write_bytes(writer, run, (size_t)(string - run)))
+    {
+        return false;
+    }
+
+    return write_byte(writer, '\"');
+}
+
+/* Format a number like ECMAScript's Number.prototype.toString (RFC 8785 section 3.2.2.3): the shortest digits that read
+ * back as the same double, in plain notation for decimal exponents from -6 to 20 and in exponential notation otherwise.
+ * Returns the length written to output (at least 32 bytes), 0 for NaN and infinity. */
+static size_t format_number(const double number, char * const output)
+{
+    char scientific[32];
+    char digits[20];
+    double magnitude = fabs(number);
+    size_t digit_count = 0;
+    size_t length = 0;
+    size_t i = 0;
+    int precision = 0;
+    int exponent = 0;
+    const char *current = NULL;
+
+    /* NaN and infinity */
+    if ((number * 0) != 0)
+    {
+        return 0;
+    }
+    /* -0 is written as 0 as well */
+    if (number == 0)
+    {
+        output[0] = '0';
+        output[1] = '\0';
+        return 1;
+    }
+    /* integers that are exact in a double have no shorter form */
+    if ((magnitude < 9007199254740992.0) && ((double)(long long)magnitude == magnitude))
+    {
+        return (size_t)sprintf(output, "%.0f", number);
+    }
+
+    /* The shortest precision that round trips, %e rounds to the closest value with that many digits. A decimal of up to
+     * 15 digits that round trips is closer to the double than half the distance to the next 15 digit decimal, so it is
+     * what %.14e gives and the shorter ones are found by removing trailing zeros. Subnormal numbers have fewer digits */
+    for (precision = (magnitude < 2.2250738585072014e-308) ? 1 : 15; precision < 17; precision++)
+    {
+        sprintf(scientific, "%.*e", precision - 1, magnitude);
+        if (strtod(scientific, NULL) == magnitude)
+        {
+            break;
+        }
+    }
+    if (precision == 17)
+    {
+        sprintf(scientific, "%.16e", magnitude);
+    }
+
+    /* split "d.ddde+x" into its digits and the exponent, the decimal point depends on the locale */
+    for (current = scientific; (*current != 'e') && (*current != '\0'); current++)
+    {
+        if ((*current >= '0') && (*current <= '9'))
+        {
+            digits[digit_count++] = *current;
+        }
+    }
+    if (*current == '\0')
+    {
+        return 0;
+    }
+    exponent = atoi(current + 1) + 1;
+    while ((digit_count > 1) && (digits[digit_count - 1] == '0'))
+    {
+        digit_count--;
+    }
+
+    /* the value is 0.digits * 10^exponent */
+    if (number < 0)
+    {
+        output[length++] = '-';
+    }
+    if (((int)digit_count <= exponent) && (exponent <= 21))
+    {
+        /* an integer with trailing zeros */
+        memcpy(output + length, digits, digit_count);
+        length += digit_count;
+        for (i = digit_count; (int)i < exponent; i++)
+        {
+            output[length++] = '0';
+        }
+    }
+    else if ((exponent > 0) && (exponent <= 21))
+    {
+        memcpy(output + length, digits, (size_t)exponent);
+        length += (size_t)exponent;
+        output[length++] = '.';
+        memcpy(output + length, digits + exponent, digit_count - (size_t)exponent);
+        length += digit_count - (size_t)exponent;
+    }
+    else if ((exponent > -6) && (exponent <= 0))
+    {
+        output[length++] = '0';
+        output[length++] = '.';
+        for (i = 0; (int)i < -exponent; i++)
+        {
+            output[length++] = '0';
+        }
+        memcpy(output + length, digits, digit_count);
+        length += digit_count;
+    }
+    else
+    {
+        output[length++] = digits[0];
+        if (digit_count > 1)
+        {
+            output[length++] = '.';
+            memcpy(output + length, digits + 1, digit_count - 1);
+            length += digit_count - 1;
+        }
+        length += (size_t)sprintf(output + length, "e%c%d", (exponent > 0) ? '+' : '-', abs(exponent - 1));
+    }
+    output[length] = '\0';
+
+    return length;
+}
+
+/* UTF-16 code units sort the characters from U+E000 to U+FFFF after all characters above U+FFFF, which UTF-8 sorts the
+ * other way around. Their lead bytes are 0xEE and 0xEF, those of characters above U+FFFF 0xF0 to 0xF4. */
+static unsigned int utf16_rank(const unsigned char lead)
+{
+    if ((lead == 0xEE) || (lead == 0xEF))
+    {
+        return (unsigned int)lead + 0x10;
+    }
+
+    return lead;
+}
+
+/* order of keys by their UTF-16 code units (RFC 8785 section 3.2.3) */
+static int compare_keys(const void *a, const void *b)
+{
+    const unsigned char *a_key = (const unsigned char*)(*(const cJSON * const *)a)->string;
+    const unsigned char *b_key = (const unsigned char*)(*(const cJSON * const *)b)->string;
+    size_t i = 0;
+
+    for (i = 0; (a_key[i] == b_key[i]) && (a_key[i] != '\0'); i++)
+    {
+    }
+    if (a_key[i] == b_key[i])
+    {
+        return 0;
+    }
+    /* UTF-8 bytes sort like the code points, only the lead bytes of characters need care. Continuation bytes are 10xxxxxx */
+    if (((a_key[i] & 0xC0) != 0x80) && ((b_key[i] & 0xC0) != 0x80))
+    {
+        return (utf16_rank(a_key[i]) < utf16_rank(b_key[i])) ? -1 : 1;
+    }
+
+    return (a_key[i] < b_key[i]) ? -1 : 1;
+}
+
+/* an array or object being written */
+typedef struct
+{
+    const cJSON *current; /* the element of an array being written */
+    const cJSON **members; /* the members of an object in canonical order, NULL for arrays */
+    size_t count;
+    size_t index;
+} jcs_frame;
+
+/* the members of object in canonical order, NULL if memory ran out or they have no canonical order */
+static const cJSON **sort_members(const cJSON * const object, size_t * const count)
+{
+    const cJSON **members = NULL;
+    const cJSON *child = NULL;
+    size_t i = 0;
+
+    *count = 0;
+    for (child = object->child; child != NULL; child = child->next)
+    {
+        if (child->string == NULL)
+        {
+            return NULL;
+        }
+        (*count)++;
+    }
+
+    members = (const cJSON**)cJSON_malloc((*count + 1) * sizeof(cJSON*));
+    if (members == NULL)
+    {
+        return NULL;
+    }
+    for ((void)(i = 0), child = object->child; child != NULL; (void)i++, child = child->next)
+    {
+        members[i] = child;
+    }
+    qsort((void*)members, *count, sizeof(cJSON*), compare_keys);
+
+    /* equal keys end up next to each other */
+    for (i = 1; i < *count; i++)
+    {
+        if (compare_keys(&members[i - 1], &members[i]) == 0)
+        {
+            cJSON_free((void*)members);
+            return NULL;
+        }
+    }
+
+    return members;
+}
+
+static cJSON_bool write_scalar(jcs_writer * const writer, const cJSON * const item)
+{
+    char number[32];
+    size_t length = 0;
+
+    switch (item->type & 0xFF)
+    {
+        case cJSON_NULL:
+            return write_bytes(writer, (const unsigned char*)"null", 4);
+
+        case cJSON_False:
+            return write_bytes(writer, (const unsigned char*)"false", 5);
+
+        case cJSON_True:
+            return write_bytes(writer, (const unsigned char*)"true", 4);
+
+        case cJSON_Number:
+            length = format_number(item->valuedouble, number);
+            return (length > 0) && write_bytes(writer, (const unsigned char*)number, length);
+
+        case cJSON_String:
+            return (item->valuestring != NULL) && write_string(writer, (const unsigned char*)item->valuestring);
+
+        default:
+            /* raw and invalid items have no canonical form */
+            return false;
+    }
+}
+
+/* the key of the member of frame to write next and its separator */
+static cJSON_bool write_member_key(jcs_writer * const writer, const jcs_frame * const frame)
+{
+    return write_string(writer, (const unsigned char*)frame->members[frame->index]->string) && write_byte(writer, ':');
+}
+
+static cJSON_bool write_value(jcs_writer * const writer, const cJSON *item)
+{
+    jcs_frame initial[32];
+    jcs_frame *stack = initial;
+    jcs_frame *frame = NULL;
+    size_t size = sizeof(initial) / sizeof(initial[0]);
+    size_t depth = 0;
+    cJSON_bool success = false;
+
+    for (;;)
+    {
+        const cJSON_bool array = cJSON_IsArray(item);
+        if (array || cJSON_IsObject(item))
+        {
+            /* open the container, continue with its first child */
+            if (depth == size)
+            {
+                jcs_frame *grown = (jcs_frame*)cJSON_malloc(2 * size * sizeof(jcs_frame));
+                if (grown == NULL)
+                {
+                    goto cleanup;
+                }
+                memcpy(grown, stack, size * sizeof(jcs_frame));
+                if (stack != initial)
+                {
+                    cJSON_free(stack);
+                }
+                stack = grown;
+                size *= 2;
+            }
+            frame = &stack[depth];
+            frame->current = item->child;
+            frame->members = NULL;
+            frame->count = 0;
+            frame->index = 0;
+            if (!array)
+            {
+                frame->members = sort_members(item, &frame->count);
+                if (frame->members == NULL)
+                {
+                    goto cleanup;
+                }
+            }
+            depth++;
+
+            if (!write_byte(writer, array ? '[' : '{'))
+            {
+                goto cleanup;
+            }
+            if (array && (frame->current != NULL))
+            {
+                item = frame->current;
+                continue;
+            }
+            if (!array && (frame->count > 0))
+            {
+                if (!write_member_key(writer, frame))
+                {
+                    goto cleanup;
+                }
+                item = frame->members[0];
+                continue;
+            }
+            /* empty, closed below */
+        }
+        else if (!write_scalar(writer, item))
+        {
+            goto cleanup;
+        }
+
+        /* item is complete, continue with the next child of the innermost container or close it */
+        item = NULL;
+        while ((depth > 0) && (item == NULL))
+        {
+            frame = &stack[depth - 1];
+            if (frame->members == NULL)
+            {
+                if (frame->current != NULL)
+                {
+                    frame->current = frame->current->next;
+                }
+                item = frame->current;
+            }
+            else if (frame->count > 0)
+            {
+                frame->index++;
+                if (frame->index < frame->count)
+                {
+                    if (!write_byte(writer, ',') || !write_member_key(writer, frame))
+                    {
+                        goto cleanup;
+                    }
+                    item = frame->members[frame->index];
+                    break;
+                }
+            }
+
+            if (item != NULL)
+            {
+                if (!write_byte(writer, ','))
+                {
+                    goto cleanup;
+                }
+                break;
+            }
+            if (!write_byte(writer, (frame->members == NULL) ? ']' : '}'))
+            {
+                goto cleanup;
+            }
+            if (frame->members != NULL)
+            {
+                cJSON_free((void*)frame->members);
+            }
+            depth--;
+        }
+        if (item == NULL)
+        {
+            break;
+        }
+    }
+    success = true;
+
+cleanup:
+    for (; depth > 0; depth--)
+    {
+        if (stack[depth - 1].members != NULL)
+        {
+            cJSON_free((void*)stack[depth - 1].members);
+        }
+    }
+    if (stack != initial)
+    {
+        cJSON_free(stack);
+    }
+
+    return success;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONJCS_Write(const cJSON *item, cJSONJCS_Sink sink, void *context)
+{
+    jcs_writer *writer = NULL;
+    cJSON_bool success = false;
+
+    if ((item == NULL) || (sink == NULL))
+    {
+        return false;
+    }
+
+    writer = (jcs_writer*)cJSON_malloc(sizeof(jcs_writer));
+    if (writer == NULL)
+    {
+        return false;
+    }
+    writer->used = 0;
+    writer->sink = sink;
+    writer->context = context;
+
+    success = write_value(writer, item) && flush_writer(writer);
+    cJSON_free(writer);
+
+    return success;
+}
+
+typedef struct
+{
+    unsigned char *buffer;
+    size_t length;
+    size_t size;
+} jcs_buffer;
+
+static cJSON_bool append_to_buffer(const unsigned char *data, size_t length, void *context)
+{
+    jcs_buffer *output = (jcs_buffer*)context;
+
+    /* one byte more for the terminating '\0' */
+    if (output->length + length + 1 > output->size)
+    {
+        unsigned char *grown = NULL;
+        size_t new_size = 2 * output->size;
+        while (output->length + length + 1 > new_size)
+        {
+            new_size *= 2;
+        }
+        grown = (unsigned char*)cJSON_malloc(new_size);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        memcpy(grown, output->buffer, output->length);
+        cJSON_free(output->buffer);
+        output->buffer = grown;
+        output->size = new_size;
+    }
+    memcpy(output->buffer + output->length, data, length);
+    output->length += length;
+
+    return true;
+}
+
+CJSON_PUBLIC(char *) cJSONJCS_Print(const cJSON *item)
+{
+    static const size_t default_buffer_size = 256;
+    jcs_buffer output = { NULL, 0, 0 };
+
+    output.buffer = (unsigned char*)cJSON_malloc(default_buffer_size);
+    if (output.buffer == NULL)
+    {
+        return NULL;
+    }
+    output.size = default_buffer_size;
+
+    if (!cJSONJCS_Write(item, append_to_buffer, &output))
+    {
+        cJSON_free(output.buffer);
+        return NULL;
+    }
+    output.buffer[output.length] = '\0';
+
+    return (char*)output.buffer;
+}
+
+/* SHA-256 (FIPS 180-4), words are kept in unsigned long and masked to 32 bits */
+typedef struct
+{
+    unsigned long state[8];
+    unsigned char block[64];
+    size_t used;
+    unsigned long long length;
+} sha256_context;
+
+#define ROTATE_RIGHT(x, n) ((((x) >> (n)) | ((x) << (32 - (n)))) & 0xFFFFFFFFUL)
+
+static void sha256_transform(sha256_context * const sha, const unsigned char * const block)
+{
+    static const unsigned long k[64] = {
+        0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+        0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+        0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+        0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+        0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+        0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+        0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+        0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+    };
+    unsigned long w[64];
+    unsigned long s[8];
+    size_t i = 0;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((unsigned long)block[4 * i] << 24) | ((unsigned long)block[4 * i + 1] << 16) | ((unsigned long)block[4 * i + 2] << 8) | (unsigned long)block[4 * i + 3];
+    }
+    for (i = 16; i < 64; i++)
+    {
+        unsigned long s0 = ROTATE_RIGHT(w[i - 15], 7) ^ ROTATE_RIGHT(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned long s1 = ROTATE_RIGHT(w[i - 2], 17) ^ ROTATE_RIGHT(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = (w[i - 16] + s0 + w[i - 7] + s1) & 0xFFFFFFFFUL;
+    }
+
+    memcpy(s, sha->state, sizeof(s));
+    for (i = 0; i < 64; i++)
+    {
+        unsigned long sum1 = ROTATE_RIGHT(s[4], 6) ^ ROTATE_RIGHT(s[4], 11) ^ ROTATE_RIGHT(s[4], 25);
+        unsigned long choose = (s[4] & s[5]) ^ (~s[4] & s[6]);
+        unsigned long temp1 = (s[7] + sum1 + choose + k[i] + w[i]) & 0xFFFFFFFFUL;
+        unsigned long sum0 = ROTATE_RIGHT(s[0], 2) ^ ROTATE_RIGHT(s[0], 13) ^ ROTATE_RIGHT(s[0], 22);
+        unsigned long majority = (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]);
+        unsigned long temp2 = (sum0 + majority) & 0xFFFFFFFFUL;
+
+        s[7] = s[6];
+        s[6] = s[5];
+        s[5] = s[4];
+        s[4] = (s[3] + temp1) & 0xFFFFFFFFUL;
+        s[3] = s[2];
+        s[2] = s[1];
+        s[1] = s[0];
+        s[0] = (temp1 + temp2) & 0xFFFFFFFFUL;
+    }
+    for (i = 0; i < 8; i++)
+    {
+        sha->state[i] = (sha->state[i] + s[i]) & 0xFFFFFFFFUL;
+    }
+}
+
+static void sha256_init(sha256_context * const sha)
+{
+    static const unsigned long initial_state[8] = {
+        0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL, 0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL
+    };
+
+    memcpy(sha->state, initial_state, sizeof(initial_state));
+    sha->used = 0;
+    sha->length = 0;
+}
+
+/* a cJSONJCS_Sink */
+static cJSON_bool sha256_update(const unsigned char *data, size_t length, void *context)
+{
+    sha256_context *sha = (sha256_context*)context;
+
+    sha->length += length;
+    while (length > 0)
+    {
+        size_t piece = 64 - sha->used;
+        if (piece > length)
+        {
+            piece = length;
+        }
+        /* whole blocks are hashed where they are */
+        if ((sha->used == 0) && (piece == 64))
+        {
+            sha256_transform(sha, data);
+        }
+        else
+        {
+            memcpy(sha->block + sha->used, data, piece);
+            sha->used += piece;
+            if (sha->used == 64)
+            {
+                sha256_transform(sha, sha->block);
+                sha->used = 0;
+            }
+        }
+        data += piece;
+        length -= piece;
+    }
+
+    return true;
+}
+
+static void sha256_final(sha256_context * const sha, unsigned char * const digest)
+{
+    unsigned long long bits = sha->length * 8;
+    size_t i = 0;
+
+    /* padding: 0x80, zeros up to 56 bytes into a block and the length in bits, big endian */
+    sha->block[sha->used++] = 0x80;
+    if (sha->used > 56)
+    {
+        memset(sha->block + sha->used, '\0', 64 - sha->used);
+        sha256_transform(sha, sha->block);
+        sha->used = 0;
+    }
+    memset(sha->block + sha->used, '\0', 56 - sha->used);
+    for (i = 0; i < 8; i++)
+    {
+        sha->block[56 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+    sha256_transform(sha, sha->block);
+
+    for (i = 0; i < 32; i++)
+    {
+        digest[i] = (unsigned char)(sha->state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONJCS_Digest(const cJSON *item, unsigned char digest[cJSONJCS_DigestLength])
+{
+    sha256_context sha;
+
+    if (digest == NULL)
+    {
+        return false;
+    }
+
+    sha256_init(&sha);
+    if (!cJSONJCS_Write(item, sha256_update, &sha))
+    {
+        return false;
+    }
+    sha256_final(&sha, digest);
+
+    return true;
+}
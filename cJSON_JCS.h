@@ -0,0 +1,37 @@
+#ifndef cJSON_JCS__h
+#define cJSON_JCS__h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+#include "cJSON.h"
+
+/* Canonical JSON (RFC 8785 JSON Canonicalization Scheme, https://www.rfc-editor.org/rfc/rfc8785): no whitespace, object members
+ * sorted by the UTF-16 code units of their keys, numbers in the shortest form that reads back as the same double (written like
+ * ECMAScript's Number.prototype.toString) and strings with only the escapes JSON requires. Equal documents give the same bytes,
+ * so the output can be hashed or signed. The input is never modified and documents of any depth are written without recursion.
+ * Raw and invalid items, NaN and infinite numbers, members without a key and objects with duplicate keys have no canonical form
+ * and make all functions fail. Strings are expected to be valid UTF-8 and are written as they are. */
+
+/* Receives the output in pieces of at most 4 KB. Return false to stop writing. */
+typedef cJSON_bool (*cJSONJCS_Sink)(const unsigned char *data, size_t length, void *context);
+
+/* Returns the canonical text allocated with cJSON_malloc (release it with cJSON_free), NULL on failure. */
+CJSON_PUBLIC(char *) cJSONJCS_Print(const cJSON *item);
+/* Write the canonical text to sink without building it in memory (no terminating '\0' is written).
+ * Returns false on failure or if the sink stopped, output may have been written partially. */
+CJSON_PUBLIC(cJSON_bool) cJSONJCS_Write(const cJSON *item, cJSONJCS_Sink sink, void *context);
+
+/* SHA-256 of the canonical text, hashed while it is written without building the string. Returns false on failure. */
+#define cJSONJCS_DigestLength 32
+CJSON_PUBLIC(cJSON_bool) cJSONJCS_Digest(const cJSON *item, unsigned char digest[cJSONJCS_DigestLength]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
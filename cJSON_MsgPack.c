@@ -0,0 +1,641 @@
+/* MessagePack encoder/decoder working directly on cJSON trees. */
+
+/* disable warnings about old C89 functions in MSVC */
+#if !defined(_CRT_SECURE_NO_DEPRECATE) && defined(_MSC_VER)
+#define _CRT_SECURE_NO_DEPRECATE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "cJSON_MsgPack.h"
+
+/* define our own boolean type */
+#ifdef true
+#undef true
+#endif
+#define true ((cJSON_bool)1)
+
+#ifdef false
+#undef false
+#endif
+#define false ((cJSON_bool)0)
+
+typedef struct
+{
+    unsigned char *buffer;
+    size_t length;
+    size_t offset;
+} msgpack_buffer;
+
+/* grow the buffer if necessary to have at least "needed" bytes more */
+static unsigned char *ensure(msgpack_buffer * const output, size_t needed)
+{
+    unsigned char *new_buffer = NULL;
+    size_t new_size = 0;
+
+    if ((output == NULL) || (output->buffer == NULL))
+    {
+        return NULL;
+    }
+
+    if (needed > ((size_t)-1 / 2) - output->offset)
+    {
+        return NULL;
+    }
+
+    needed += output->offset;
+    if (needed <= output->length)
+    {
+        return output->buffer + output->offset;
+    }
+
+    new_size = needed * 2;
+    new_buffer = (unsigned char*)cJSON_malloc(new_size);
+    if (new_buffer == NULL)
+    {
+        cJSON_free(output->buffer);
+        output->buffer = NULL;
+        output->length = 0;
+
+        return NULL;
+    }
+    memcpy(new_buffer, output->buffer, output->offset);
+    cJSON_free(output->buffer);
+
+    output->buffer = new_buffer;
+    output->length = new_size;
+
+    return new_buffer + output->offset;
+}
+
+/* write a type byte followed by a big endian value of "size" bytes */
+static cJSON_bool write_header(msgpack_buffer * const output, const unsigned char type, unsigned long long value, const size_t size)
+{
+    unsigned char *output_pointer = ensure(output, size + 1);
+    size_t i = 0;
+
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+
+    output_pointer[0] = type;
+    for (i = size; i > 0; i--)
+    {
+        output_pointer[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+    output->offset += size + 1;
+
+    return true;
+}
+
+static cJSON_bool encode_number(const double number, msgpack_buffer * const output)
+{
+    float single = (float)number;
+
+    if ((number >= 0) && (number < 18446744073709551616.0) && !((number == 0) && (1 / number < 0)))
+    {
+        unsigned long long integer = (unsigned long long)number;
+        if ((double)integer == number)
+        {
+            if (integer < 0x80)
+            {
+                return write_header(output, (unsigned char)integer, 0, 0);
+            }
+            if (integer <= 0xFF)
+            {
+                return write_header(output, 0xCC, integer, 1);
+            }
+            if (integer <= 0xFFFF)
+            {
+                return write_header(output, 0xCD, integer, 2);
+            }
+            if (integer <= 0xFFFFFFFFUL)
+            {
+                return write_header(output, 0xCE, integer, 4);
+            }
+            return write_header(output, 0xCF, integer, 8);
+        }
+    }
+    else if ((number < 0) && (number >= -9223372036854775808.0))
+    {
+        long long integer = (long long)number;
+        if ((double)integer == number)
+        {
+            if (integer >= -32)
+            {
+                return write_header(output, (unsigned char)(integer & 0xFF), 0, 0);
+            }
+            if (integer >= -128)
+            {
+                return write_header(output, 0xD0, (unsigned long long)integer & 0xFF, 1);
+            }
+            if (integer >= -32768)
+            {
+                return write_header(output, 0xD1, (unsigned long long)integer & 0xFFFF, 2);
+            }
+            if (integer >= -2147483647L - 1)
+            {
+                return write_header(output, 0xD2, (unsigned long long)integer & 0xFFFFFFFFUL, 4);
+            }
+            return write_header(output, 0xD3, (unsigned long long)integer, 8);
+        }
+    }
+
+    /* float32 if it can represent the number exactly (NaN never compares equal and ends up as float64),
+     * integers and floats share their byte order, so the bit pattern can be moved through an integer */
+    if (((double)single == number) && (sizeof(unsigned int) == sizeof(single)))
+    {
+        unsigned int pattern = 0;
+        memcpy(&pattern, &single, sizeof(single));
+        return write_header(output, 0xCA, pattern, 4);
+    }
+
+    {
+        unsigned long long pattern = 0;
+        memcpy(&pattern, &number, sizeof(pattern));
+        return write_header(output, 0xCB, pattern, 8);
+    }
+}
+
+/* strings are always written with the str family (fixstr, str 8/16/32) */
+static cJSON_bool encode_string(const char * const string, msgpack_buffer * const output)
+{
+    size_t length = (string == NULL) ? 0 : strlen(string);
+    unsigned char *output_pointer = NULL;
+    cJSON_bool success = false;
+
+    if (length < 32)
+    {
+        success = write_header(output, (unsigned char)(0xA0 | length), 0, 0);
+    }
+    else if (length <= 0xFF)
+    {
+        success = write_header(output, 0xD9, length, 1);
+    }
+    else if (length <= 0xFFFF)
+    {
+        success = write_header(output, 0xDA, length, 2);
+    }
+    else if (length <= 0xFFFFFFFFUL)
+    {
+        success = write_header(output, 0xDB, length, 4);
+    }
+    if (!success)
+    {
+        return false;
+    }
+
+    output_pointer = ensure(output, length);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+    if (length > 0)
+    {
+        memcpy(output_pointer, string, length);
+    }
+    output->offset += length;
+
+    return true;
+}
+
+static cJSON_bool encode_container_header(const size_t count, const unsigned char fix_type, const unsigned char type16, msgpack_buffer * const output)
+{
+    if (count < 16)
+    {
+        return write_header(output, (unsigned char)(fix_type | count), 0, 0);
+    }
+    if (count <= 0xFFFF)
+    {
+        return write_header(output, type16, count, 2);
+    }
+    if (count <= 0xFFFFFFFFUL)
+    {
+        return write_header(output, (unsigned char)(type16 + 1), count, 4);
+    }
+
+    return false;
+}
+
+static cJSON_bool encode_value(const cJSON * const item, msgpack_buffer * const output, size_t depth)
+{
+    const cJSON *child = NULL;
+    size_t count = 0;
+
+    if (depth >= CJSON_NESTING_LIMIT)
+    {
+        return false;
+    }
+
+    switch (item->type & 0xFF)
+    {
+        case cJSON_NULL:
+            return write_header(output, 0xC0, 0, 0);
+
+        case cJSON_False:
+            return write_header(output, 0xC2, 0, 0);
+
+        case cJSON_True:
+            return write_header(output, 0xC3, 0, 0);
+
+        case cJSON_Number:
+            return encode_number(item->valuedouble, output);
+
+        case cJSON_String:
+        case cJSON_Raw:
+            return encode_string(item->valuestring, output);
+
+        case cJSON_Array:
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                count++;
+            }
+            if (!encode_container_header(count, 0x90, 0xDC, output))
+            {
+                return false;
+            }
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                if (!encode_value(child, output, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+
+        case cJSON_Object:
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                count++;
+            }
+            if (!encode_container_header(count, 0x80, 0xDE, output))
+            {
+                return false;
+            }
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                if (!encode_string(child->string, output) || !encode_value(child, output, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+CJSON_PUBLIC(unsigned char *) cJSONMsgPack_Encode(const cJSON *item, size_t *length)
+{
+    static const size_t default_buffer_size = 256;
+    msgpack_buffer output = { NULL, 0, 0 };
+
+    if ((item == NULL) || (length == NULL))
+    {
+        return NULL;
+    }
+
+    output.buffer = (unsigned char*)cJSON_malloc(default_buffer_size);
+    if (output.buffer == NULL)
+    {
+        return NULL;
+    }
+    output.length = default_buffer_size;
+
+    if (!encode_value(item, &output, 0))
+    {
+        if (output.buffer != NULL)
+        {
+            cJSON_free(output.buffer);
+        }
+        return NULL;
+    }
+
+    *length = output.offset;
+    return output.buffer;
+}
+
+typedef struct
+{
+    const unsigned char *content;
+    size_t length;
+    size_t offset;
+} msgpack_input;
+
+/* read a big endian unsigned value of "size" bytes */
+static cJSON_bool read_uint(msgpack_input * const input, const size_t size, unsigned long long * const value)
+{
+    size_t i = 0;
+
+    if ((input->length - input->offset) < size)
+    {
+        return false;
+    }
+
+    *value = 0;
+    for (i = 0; i < size; i++)
+    {
+        *value = (*value << 8) | input->content[input->offset + i];
+    }
+    input->offset += size;
+
+    return true;
+}
+
+/* copy "size" bytes of string data into a new zero terminated buffer */
+static char *read_string(msgpack_input * const input, const unsigned long long size)
+{
+    char *string = NULL;
+
+    if ((unsigned long long)(input->length - input->offset) < size)
+    {
+        return NULL;
+    }
+    if (memchr(input->content + input->offset, '\0', (size_t)size) != NULL)
+    {
+        /* cJSON strings are zero terminated */
+        return NULL;
+    }
+
+    string = (char*)cJSON_malloc((size_t)size + sizeof(""));
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    memcpy(string, input->content + input->offset, (size_t)size);
+    string[size] = '\0';
+    input->offset += (size_t)size;
+
+    return string;
+}
+
+/* decode the length of a string (str or bin) that is used as an object key */
+static cJSON_bool read_string_length(msgpack_input * const input, unsigned long long * const size)
+{
+    unsigned char type = 0;
+
+    if (input->offset >= input->length)
+    {
+        return false;
+    }
+    type = input->content[input->offset++];
+
+    if ((type & 0xE0) == 0xA0)
+    {
+        *size = type & 0x1F;
+        return true;
+    }
+    switch (type)
+    {
+        case 0xC4:
+        case 0xD9:
+            return read_uint(input, 1, size);
+        case 0xC5:
+        case 0xDA:
+            return read_uint(input, 2, size);
+        case 0xC6:
+        case 0xDB:
+            return read_uint(input, 4, size);
+        default:
+            return false;
+    }
+}
+
+static cJSON *decode_value(msgpack_input * const input, size_t depth);
+
+static cJSON *decode_container(msgpack_input * const input, const unsigned long long count, const cJSON_bool is_object, size_t depth)
+{
+    cJSON *container = is_object ? cJSON_CreateObject() : cJSON_CreateArray();
+    cJSON *tail = NULL;
+    unsigned long long i = 0;
+
+    if (container == NULL)
+    {
+        return NULL;
+    }
+    if (depth >= CJSON_NESTING_LIMIT)
+    {
+        goto fail;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        char *key = NULL;
+        cJSON *child = NULL;
+
+        if (is_object)
+        {
+            unsigned long long key_length = 0;
+            if (!read_string_length(input, &key_length))
+            {
+                goto fail;
+            }
+            key = read_string(input, key_length);
+            if (key == NULL)
+            {
+                goto fail;
+            }
+        }
+
+        child = decode_value(input, depth + 1);
+        if (child == NULL)
+        {
+            if (key != NULL)
+            {
+                cJSON_free(key);
+            }
+            goto fail;
+        }
+        child->string = key;
+
+        /* link directly instead of cJSON_AddItemToArray, which walks the whole list */
+        child->parent = container;
+        if (tail == NULL)
+        {
+            container->child = child;
+        }
+        else
+        {
+            tail->next = child;
+            child->prev = tail;
+        }
+        tail = child;
+    }
+
+    return container;
+
+fail:
+    cJSON_Delete(container);
+    return NULL;
+}
+
+static cJSON *create_string(char * const string)
+{
+    cJSON *item = NULL;
+
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    item = cJSON_CreateNull();
+    if (item == NULL)
+    {
+        cJSON_free(string);
+        return NULL;
+    }
+    item->type = cJSON_String;
+    item->valuestring = string;
+
+    return item;
+}
+
+static cJSON *decode_value(msgpack_input * const input, size_t depth)
+{
+    unsigned char type = 0;
+    unsigned long long value = 0;
+
+    if (input->offset >= input->length)
+    {
+        return NULL;
+    }
+    type = input->content[input->offset++];
+
+    /* fixed size types */
+    if (type < 0x80)
+    {
+        return cJSON_CreateNumber((double)type);
+    }
+    if (type >= 0xE0)
+    {
+        return cJSON_CreateNumber((double)((int)type - 0x100));
+    }
+    if ((type & 0xF0) == 0x80)
+    {
+        return decode_container(input, type & 0x0F, true, depth);
+    }
+    if ((type & 0xF0) == 0x90)
+    {
+        return decode_container(input, type & 0x0F, false, depth);
+    }
+    if ((type & 0xE0) == 0xA0)
+    {
+        return create_string(read_string(input, type & 0x1F));
+    }
+
+    switch (type)
+    {
+        case 0xC0:
+            return cJSON_CreateNull();
+        case 0xC2:
+            return cJSON_CreateFalse();
+        case 0xC3:
+            return cJSON_CreateTrue();
+
+        /* bin 8/16/32 and str 8/16/32 */
+        case 0xC4:
+        case 0xD9:
+            return read_uint(input, 1, &value) ? create_string(read_string(input, value)) : NULL;
+        case 0xC5:
+        case 0xDA:
+            return read_uint(input, 2, &value) ? create_string(read_string(input, value)) : NULL;
+        case 0xC6:
+        case 0xDB:
+            return read_uint(input, 4, &value) ? create_string(read_string(input, value)) : NULL;
+
+        case 0xCA:
+        {
+            unsigned int pattern = 0;
+            float single = 0;
+            if ((sizeof(pattern) != sizeof(single)) || !read_uint(input, 4, &value))
+            {
+                return NULL;
+            }
+            pattern = (unsigned int)value;
+            memcpy(&single, &pattern, sizeof(single));
+            return cJSON_CreateNumber((double)single);
+        }
+        case 0xCB:
+        {
+            double number = 0;
+            if (!read_uint(input, 8, &value))
+            {
+                return NULL;
+            }
+            memcpy(&number, &value, sizeof(number));
+            return cJSON_CreateNumber(number);
+        }
+
+        /* uint 8/16/32/64 */
+        case 0xCC:
+            return read_uint(input, 1, &value) ? cJSON_CreateNumber((double)value) : NULL;
+        case 0xCD:
+            return read_uint(input, 2, &value) ? cJSON_CreateNumber((double)value) : NULL;
+        case 0xCE:
+            return read_uint(input, 4, &value) ? cJSON_CreateNumber((double)value) : NULL;
+        case 0xCF:
+            return read_uint(input, 8, &value) ? cJSON_CreateNumber((double)value) : NULL;
+
+        /* int 8/16/32/64 */
+        case 0xD0:
+            return read_uint(input, 1, &value) ? cJSON_CreateNumber((double)(signed char)(value & 0xFF)) : NULL;
+        case 0xD1:
+            return read_uint(input, 2, &value) ? cJSON_CreateNumber((double)((long)value - ((value & 0x8000) ? 0x10000L : 0))) : NULL;
+        case 0xD2:
+            return read_uint(input, 4, &value) ? cJSON_CreateNumber((double)((long long)value - ((value & 0x80000000UL) ? 0x100000000LL : 0))) : NULL;
+        case 0xD3:
+            return read_uint(input, 8, &value) ? cJSON_CreateNumber((double)(long long)value) : NULL;
+
+        /* array 16/32, map 16/32 */
+        case 0xDC:
+            return read_uint(input, 2, &value) ? decode_container(input, value, false, depth) : NULL;
+        case 0xDD:
+            return read_uint(input, 4, &value) ? decode_container(input, value, false, depth) : NULL;
+        case 0xDE:
+            return read_uint(input, 2, &value) ? decode_container(input, value, true, depth) : NULL;
+        case 0xDF:
+            return read_uint(input, 4, &value) ? decode_container(input, value, true, depth) : NULL;
+
+        /* 0xC1 (never used) and the ext family have no JSON representation */
+        default:
+            return NULL;
+    }
+}
+
+CJSON_PUBLIC(cJSON *) cJSONMsgPack_Decode(const unsigned char *data, size_t length, size_t *consumed)
+{
+    msgpack_input input = { NULL, 0, 0 };
+    cJSON *item = NULL;
+
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    input.content = data;
+    input.length = length;
+
+    item = decode_value(&input, 0);
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    if (consumed != NULL)
+    {
+        *consumed = input.offset;
+    }
+    else if (input.offset != input.length)
+    {
+        /* trailing garbage */
+        cJSON_Delete(item);
+        return NULL;
+    }
+
+    return item;
+}
@@ -0,0 +1,25 @@
+#ifndef cJSON_MsgPack__h
+#define cJSON_MsgPack__h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "cJSON.h"
+
+/* Convert cJSON items to and from MessagePack (https://github.com/msgpack/msgpack/blob/master/spec.md) without a text step. */
+
+/* Encode an item as MessagePack. Returns a buffer allocated with cJSON_malloc (release it with cJSON_free) and stores its size in *length.
+ * Integral numbers are written as the smallest fitting integer, other numbers as float32 if that is lossless and float64 otherwise.
+ * cJSON_Raw items are written as strings. Returns NULL on failure. */
+CJSON_PUBLIC(unsigned char *) cJSONMsgPack_Encode(const cJSON *item, size_t *length);
+/* Decode one MessagePack value. If consumed is NULL the value has to span the whole buffer, otherwise the number of bytes used is stored there.
+ * bin values become strings, map keys have to be str or bin. ext types and strings containing '\0' are rejected. Returns NULL on failure. */
+CJSON_PUBLIC(cJSON *) cJSONMsgPack_Decode(const unsigned char *data, size_t length, size_t *consumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
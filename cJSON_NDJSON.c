@@ -0,0 +1,400 @@
+/* Newline delimited JSON reader: splits the input into lines and parses batches of lines on a worker pool. */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cJSON_NDJSON.h"
+
+/* define our own boolean type */
+#ifdef true
+#undef true
+#endif
+#define true ((cJSON_bool)1)
+
+#ifdef false
+#undef false
+#endif
+#define false ((cJSON_bool)0)
+
+/* a batch is the unit of work for one task, it ends after this many lines or bytes */
+#define BATCH_LINES 1024
+#define BATCH_BYTES (256 * 1024)
+/* batches per thread that are parsed before the results are delivered */
+#define BATCHES_PER_THREAD 4
+/* read size of cJSONNDJSON_ParseFile */
+#define FILE_CHUNK_SIZE (4 * 1024 * 1024)
+
+typedef struct
+{
+    size_t start;
+    size_t length;
+    size_t line;
+    cJSON *item;
+    cJSON_bool empty;
+} ndjson_line;
+
+typedef struct
+{
+    size_t first;
+    size_t count;
+} ndjson_batch;
+
+typedef struct
+{
+    const char *data;
+    ndjson_line *lines;
+    size_t lines_count;
+    size_t lines_capacity;
+    ndjson_batch *batches;
+    size_t batch_count;
+    size_t batches_capacity;
+    int flags;
+    cJSONNDJSON_Callback callback;
+    void *context;
+} ndjson_reader;
+
+/* find the next '\n' in [start, end), returns end if there is none */
+static const char *find_newline(const char *start, const char *end)
+{
+#if defined(__SSE2__) && defined(__GNUC__)
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while ((size_t)(end - start) >= 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(const void*)start), newline));
+        if (mask != 0)
+        {
+            return start + __builtin_ctz((unsigned int)mask);
+        }
+        start += 16;
+    }
+    while ((start < end) && (*start != '\n'))
+    {
+        start++;
+    }
+
+    return start;
+#else
+    const char *newline = (const char*)memchr(start, '\n', (size_t)(end - start));
+
+    return (newline != NULL) ? newline : end;
+#endif
+}
+
+static cJSON_bool add_line(ndjson_reader * const reader, const size_t start, const size_t length, const size_t line)
+{
+    ndjson_line *entry = NULL;
+
+    if (reader->lines_count == reader->lines_capacity)
+    {
+        size_t new_capacity = (reader->lines_capacity == 0) ? BATCH_LINES : (reader->lines_capacity * 2);
+        ndjson_line *new_lines = (ndjson_line*)cJSON_malloc(new_capacity * sizeof(ndjson_line));
+        if (new_lines == NULL)
+        {
+            return false;
+        }
+        if (reader->lines != NULL)
+        {
+            memcpy(new_lines, reader->lines, reader->lines_count * sizeof(ndjson_line));
+            cJSON_free(reader->lines);
+        }
+        reader->lines = new_lines;
+        reader->lines_capacity = new_capacity;
+    }
+
+    entry = &reader->lines[reader->lines_count++];
+    entry->start = start;
+    entry->length = length;
+    entry->line = line;
+    entry->item = NULL;
+    entry->empty = false;
+
+    return true;
+}
+
+static cJSON_bool add_batch(ndjson_reader * const reader, const size_t first, const size_t count)
+{
+    if (reader->batch_count == reader->batches_capacity)
+    {
+        size_t new_capacity = (reader->batches_capacity == 0) ? 16 : (reader->batches_capacity * 2);
+        ndjson_batch *new_batches = (ndjson_batch*)cJSON_malloc(new_capacity * sizeof(ndjson_batch));
+        if (new_batches == NULL)
+        {
+            return false;
+        }
+        if (reader->batches != NULL)
+        {
+            memcpy(new_batches, reader->batches, reader->batch_count * sizeof(ndjson_batch));
+            cJSON_free(reader->batches);
+        }
+        reader->batches = new_batches;
+        reader->batches_capacity = new_capacity;
+    }
+
+    reader->batches[reader->batch_count].first = first;
+    reader->batches[reader->batch_count].count = count;
+    reader->batch_count++;
+
+    return true;
+}
+
+static void parse_line(const char * const data, ndjson_line * const line)
+{
+    const char *start = data + line->start;
+    const char *end = start + line->length;
+    const char *parse_end = NULL;
+
+    while ((start < end) && ((unsigned char)*start <= 32))
+    {
+        start++;
+    }
+    if (start == end)
+    {
+        line->empty = true;
+        return;
+    }
+
+    line->item = cJSON_ParseWithLengthOpts(start, (size_t)(end - start), &parse_end, false);
+    if (line->item == NULL)
+    {
+        return;
+    }
+
+    /* only whitespace may follow the value */
+    while ((parse_end < end) && ((unsigned char)*parse_end <= 32))
+    {
+        parse_end++;
+    }
+    if (parse_end != end)
+    {
+        cJSON_Delete(line->item);
+        line->item = NULL;
+    }
+}
+
+/* hand the lines of a range to the callback, deleting the remaining items if it stops */
+static cJSON_bool deliver(ndjson_reader * const reader, const size_t first, const size_t count)
+{
+    size_t i = 0;
+
+    for (i = first; i < (first + count); i++)
+    {
+        ndjson_line *line = &reader->lines[i];
+        if (line->empty)
+        {
+            continue;
+        }
+        if (!reader->callback(line->item, line->line, reader->context))
+        {
+            for (i++; i < (first + count); i++)
+            {
+                cJSON_Delete(reader->lines[i].item);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static cJSON_bool parse_batch(void *context, size_t index)
+{
+    ndjson_reader *reader = (ndjson_reader*)context;
+    ndjson_batch *batch = &reader->batches[index];
+    size_t i = 0;
+
+    for (i = batch->first; i < (batch->first + batch->count); i++)
+    {
+        parse_line(reader->data, &reader->lines[i]);
+    }
+
+    if (reader->flags & cJSONNDJSON_Unordered)
+    {
+        return deliver(reader, batch->first, batch->count);
+    }
+
+    return true;
+}
+
+/* parse every line in data, line numbers continue after *line */
+static cJSON_bool read_lines(ndjson_reader * const reader, cJSONPool * const pool, const char * const data, const size_t length, size_t * const line)
+{
+    size_t max_batches = (size_t)cJSONPool_Threads(pool) * BATCHES_PER_THREAD;
+    size_t offset = 0;
+
+    reader->data = data;
+    while (offset < length)
+    {
+        reader->lines_count = 0;
+        reader->batch_count = 0;
+
+        /* find the lines for the next window of batches */
+        while ((offset < length) && (reader->batch_count < max_batches))
+        {
+            size_t first = reader->lines_count;
+            size_t bytes = 0;
+
+            while ((offset < length) && ((reader->lines_count - first) < BATCH_LINES) && (bytes < BATCH_BYTES))
+            {
+                size_t end = (size_t)(find_newline(data + offset, data + length) - data);
+                if (!add_line(reader, offset, end - offset, ++(*line)))
+                {
+                    return false;
+                }
+                bytes += end - offset + 1;
+                offset = (end < length) ? (end + 1) : length;
+            }
+
+            if (!add_batch(reader, first, reader->lines_count - first))
+            {
+                return false;
+            }
+        }
+
+        if (!cJSONPool_Run(pool, reader->batch_count, parse_batch, reader))
+        {
+            /* only unordered delivery can cancel */
+            return false;
+        }
+        if (!(reader->flags & cJSONNDJSON_Unordered) && !deliver(reader, 0, reader->lines_count))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void init_reader(ndjson_reader * const reader, const int flags, const cJSONNDJSON_Callback callback, void * const context)
+{
+    memset(reader, '\0', sizeof(ndjson_reader));
+    reader->flags = flags;
+    reader->callback = callback;
+    reader->context = context;
+}
+
+static void free_reader(ndjson_reader * const reader)
+{
+    if (reader->lines != NULL)
+    {
+        cJSON_free(reader->lines);
+    }
+    if (reader->batches != NULL)
+    {
+        cJSON_free(reader->batches);
+    }
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONNDJSON_Parse(const char *data, size_t length, cJSONPool *pool, int flags, cJSONNDJSON_Callback callback, void *context)
+{
+    ndjson_reader reader;
+    size_t line = 0;
+    cJSON_bool success = false;
+
+    if (((data == NULL) && (length > 0)) || (callback == NULL))
+    {
+        return false;
+    }
+
+    init_reader(&reader, flags, callback, context);
+    success = read_lines(&reader, pool, data, length, &line);
+    free_reader(&reader);
+
+    return success;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONNDJSON_ParseFile(FILE *file, cJSONPool *pool, int flags, cJSONNDJSON_Callback callback, void *context)
+{
+    ndjson_reader reader;
+    char *buffer = NULL;
+    size_t size = FILE_CHUNK_SIZE;
+    size_t filled = 0;
+    size_t line = 0;
+    cJSON_bool success = true;
+
+    if ((file == NULL) || (callback == NULL))
+    {
+        return false;
+    }
+
+    buffer = (char*)cJSON_malloc(size);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    init_reader(&reader, flags, callback, context);
+
+    for (;;)
+    {
+        size_t read = 0;
+        size_t complete = 0;
+        cJSON_bool end_of_file = false;
+
+        if (filled == size)
+        {
+            /* a single line is longer than the buffer */
+            char *new_buffer = (char*)cJSON_malloc(size * 2);
+            if (new_buffer == NULL)
+            {
+                success = false;
+                break;
+            }
+            memcpy(new_buffer, buffer, filled);
+            cJSON_free(buffer);
+            buffer = new_buffer;
+            size *= 2;
+        }
+
+        read = fread(buffer + filled, 1, size - filled, file);
+        if (read < (size - filled))
+        {
+            if (ferror(file))
+            {
+                success = false;
+                break;
+            }
+            end_of_file = true;
+        }
+
+        /* only complete lines are parsed, the rest waits for the next read */
+        complete = filled + read;
+        if (!end_of_file)
+        {
+            while ((complete > filled) && (buffer[complete - 1] != '\n'))
+            {
+                complete--;
+            }
+            if (complete == filled)
+            {
+                filled += read;
+                continue;
+            }
+        }
+
+        if (!read_lines(&reader, pool, buffer, complete, &line))
+        {
+            success = false;
+            break;
+        }
+
+        filled = filled + read - complete;
+        if (filled > 0)
+        {
+            memmove(buffer, buffer + complete, filled);
+        }
+        if (end_of_file)
+        {
+            break;
+        }
+    }
+
+    free_reader(&reader);
+    cJSON_free(buffer);
+
+    return success;
+}
@@ -0,0 +1,35 @@
+#ifndef cJSON_NDJSON__h
+#define cJSON_NDJSON__h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdio.h>
+
+#include "cJSON.h"
+#include "cJSON_Pool.h"
+
+/* Read newline delimited JSON (NDJSON / JSON Lines, one value per line) and parse the lines in parallel. */
+
+/* Flags for cJSONNDJSON_Parse and cJSONNDJSON_ParseFile */
+#define cJSONNDJSON_Ordered   0 /* the callback runs on the calling thread, in input order */
+#define cJSONNDJSON_Unordered 1 /* the callback runs on the worker threads as soon as a batch is parsed, it has to be thread safe */
+
+/* Receives the value of one line (1 based line number). The callback owns item and has to cJSON_Delete it.
+ * item is NULL if the line isn't valid JSON. Empty lines are skipped. Return false to stop reading;
+ * in unordered mode batches that are already being parsed can still deliver a few more lines. */
+typedef cJSON_bool (*cJSONNDJSON_Callback)(cJSON *item, size_t line, void *context);
+
+/* Parse all lines in data. Lines end with "\n" (a "\r" before it is ignored), the last line doesn't need one.
+ * A NULL pool parses on the calling thread. Returns false if the callback stopped reading or memory ran out. */
+CJSON_PUBLIC(cJSON_bool) cJSONNDJSON_Parse(const char *data, size_t length, cJSONPool *pool, int flags, cJSONNDJSON_Callback callback, void *context);
+/* Same as cJSONNDJSON_Parse, but reads the input from file in large chunks. Also returns false on read errors. */
+CJSON_PUBLIC(cJSON_bool) cJSONNDJSON_ParseFile(FILE *file, cJSONPool *pool, int flags, cJSONNDJSON_Callback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,264 @@
+/* Fixed size worker pool running parallel-for style jobs. */
+
+#include <string.h>
+#include <stdlib.h>
+
+#if !defined(CJSON_NO_THREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "cJSON_Pool.h"
+
+/* define our own boolean type */
+#ifdef true
+#undef true
+#endif
+#define true ((cJSON_bool)1)
+
+#ifdef false
+#undef false
+#endif
+#define false ((cJSON_bool)0)
+
+struct cJSONPool
+{
+    int threads;
+#if !defined(CJSON_NO_THREADS)
+    pthread_t *workers;
+    int started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake; /* a new job was published or the pool shuts down */
+    pthread_cond_t idle; /* the last worker left the current job */
+    unsigned long generation;
+    cJSON_bool shutdown;
+
+    /* the current job, protected by lock */
+    cJSONPool_Task task;
+    void *context;
+    size_t count;
+    size_t next;
+    cJSON_bool cancelled;
+    int active;
+#endif
+};
+
+static cJSON_bool run_serial(size_t count, cJSONPool_Task task, void *context)
+{
+    size_t index = 0;
+
+    for (index = 0; index < count; index++)
+    {
+        if (!task(context, index))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#if !defined(CJSON_NO_THREADS)
+
+/* take indices of the current job until there are none left, lock has to be held */
+static void run_tasks(cJSONPool * const pool)
+{
+    while (!pool->cancelled && (pool->next < pool->count))
+    {
+        size_t index = pool->next++;
+        cJSONPool_Task task = pool->task;
+        void *context = pool->context;
+        cJSON_bool success = false;
+
+        pthread_mutex_unlock(&pool->lock);
+        success = task(context, index);
+        pthread_mutex_lock(&pool->lock);
+
+        if (!success)
+        {
+            pool->cancelled = true;
+        }
+    }
+}
+
+static void *worker_main(void *argument)
+{
+    cJSONPool *pool = (cJSONPool*)argument;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->shutdown && (pool->generation == seen))
+        {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->shutdown)
+        {
+            break;
+        }
+        seen = pool->generation;
+
+        pool->active++;
+        run_tasks(pool);
+        pool->active--;
+        if (pool->active == 0)
+        {
+            pthread_cond_signal(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static int online_processors(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0)
+    {
+        return (count > 256) ? 256 : (int)count;
+    }
+#endif
+    return 1;
+}
+
+#endif /* !CJSON_NO_THREADS */
+
+CJSON_PUBLIC(cJSONPool *) cJSONPool_Create(int threads)
+{
+    cJSONPool *pool = (cJSONPool*)cJSON_malloc(sizeof(cJSONPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    memset(pool, '\0', sizeof(cJSONPool));
+
+#if defined(CJSON_NO_THREADS)
+    (void)threads;
+    pool->threads = 1;
+#else
+    if (threads <= 0)
+    {
+        threads = online_processors();
+    }
+    pool->threads = threads;
+
+    if (threads > 1)
+    {
+        pool->workers = (pthread_t*)cJSON_malloc((size_t)(threads - 1) * sizeof(pthread_t));
+        if (pool->workers == NULL)
+        {
+            cJSON_free(pool);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (pool->started = 0; pool->started < (threads - 1); pool->started++)
+    {
+        if (pthread_create(&pool->workers[pool->started], NULL, worker_main, pool) != 0)
+        {
+            cJSONPool_Delete(pool);
+            return NULL;
+        }
+    }
+#endif
+
+    return pool;
+}
+
+CJSON_PUBLIC(void) cJSONPool_Delete(cJSONPool *pool)
+{
+#if !defined(CJSON_NO_THREADS)
+    int i = 0;
+#endif
+
+    if (pool == NULL)
+    {
+        return;
+    }
+
+#if !defined(CJSON_NO_THREADS)
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->started; i++)
+    {
+        pthread_join(pool->workers[i], NULL);
+    }
+    if (pool->workers != NULL)
+    {
+        cJSON_free(pool->workers);
+    }
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+
+    cJSON_free(pool);
+}
+
+CJSON_PUBLIC(int) cJSONPool_Threads(const cJSONPool *pool)
+{
+    if (pool == NULL)
+    {
+        return 1;
+    }
+
+    return pool->threads;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONPool_Run(cJSONPool *pool, size_t count, cJSONPool_Task task, void *context)
+{
+#if !defined(CJSON_NO_THREADS)
+    cJSON_bool cancelled = false;
+#endif
+
+    if (task == NULL)
+    {
+        return false;
+    }
+
+#if !defined(CJSON_NO_THREADS)
+    if ((pool != NULL) && (pool->started > 0) && (count > 1))
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->task = task;
+        pool->context = context;
+        pool->count = count;
+        pool->next = 0;
+        pool->cancelled = false;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+
+        /* the calling thread works on the job as well */
+        pool->active++;
+        run_tasks(pool);
+        pool->active--;
+        while (pool->active > 0)
+        {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+
+        cancelled = pool->cancelled;
+        /* workers that wake up late must not find anything to do */
+        pool->task = NULL;
+        pool->context = NULL;
+        pool->count = 0;
+        pool->next = 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        return !cancelled;
+    }
+#endif
+
+    (void)pool;
+    return run_serial(count, task, context);
+}
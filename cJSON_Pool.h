@@ -0,0 +1,34 @@
+#ifndef cJSON_Pool__h
+#define cJSON_Pool__h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "cJSON.h"
+
+/* A small fixed size worker pool used by the parallel readers and writers.
+ * Build with CJSON_NO_THREADS to get a pool that runs everything on the calling thread. */
+
+typedef struct cJSONPool cJSONPool;
+
+/* Called once for every index in [0, count). Return false to cancel the indices that haven't been started yet. */
+typedef cJSON_bool (*cJSONPool_Task)(void *context, size_t index);
+
+/* Create a pool that runs tasks on "threads" threads in total (the caller of cJSONPool_Run counts as one).
+ * threads <= 0 uses the number of online processors. Returns NULL on failure. */
+CJSON_PUBLIC(cJSONPool *) cJSONPool_Create(int threads);
+CJSON_PUBLIC(void) cJSONPool_Delete(cJSONPool *pool);
+/* Number of threads working on a cJSONPool_Run call, 1 for a NULL pool. */
+CJSON_PUBLIC(int) cJSONPool_Threads(const cJSONPool *pool);
+/* Run task for every index and wait for all of them. Indices are handed out in increasing order, but finish in any order.
+ * A NULL pool runs the tasks on the calling thread. Returns false if a task cancelled the run.
+ * A pool runs one job at a time: don't call this concurrently on the same pool or from inside a task. */
+CJSON_PUBLIC(cJSON_bool) cJSONPool_Run(cJSONPool *pool, size_t count, cJSONPool_Task task, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
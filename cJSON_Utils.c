@@ -165,13 +165,14 @@ static void encode_string_as_pointer(unsigned char *destination, const unsigned
     {
         if (source[0] == '/')
         {
+            destination[0] = '~';
             destination[1] = '1';
             destination++;
         }
         else if (source[0] == '~')
         {
             destination[0] = '~';
-            destination[1] = '1';
+            destination[1] = '0';
             destination++;
         }
         else
@@ -183,6 +184,151 @@ static void encode_string_as_pointer(unsigned char *destination, const unsigned
     destination[0] = '\0';
 }
 
+/* check that item really is linked into the child list of its parent */
+static cJSON_bool is_linked_to_parent(const cJSON * const item)
+{
+    if (item->parent == NULL)
+    {
+        return false;
+    }
+    if (item->prev == NULL)
+    {
+        return item->parent->child == item;
+    }
+
+    return (item->prev->next == item) && (item->parent->child != item);
+}
+
+/* position of item in the child list of its parent */
+static size_t get_child_index(const cJSON *item)
+{
+    size_t index = 0;
+
+    for (; item->prev != NULL; item = item->prev)
+    {
+        index++;
+    }
+
+    return index;
+}
+
+/* number of decimal digits of an array index */
+static size_t index_length(size_t index)
+{
+    size_t length = 1;
+
+    for (; index >= 10; index /= 10)
+    {
+        length++;
+    }
+
+    return length;
+}
+
+/* Build the pointer by following the parent links from target up to object instead of searching the whole tree. Array
+ * positions are found by walking back to the first element, once per array on the way, so this is O(depth + the sum of those
+ * positions). Returns NULL (without a result) if the links don't lead to object, e.g. for items inside of references. */
+static cJSON_bool find_pointer_via_parents(const cJSON * const object, const cJSON * const target, unsigned char ** const result)
+{
+    const cJSON *current = NULL;
+    unsigned char *pointer = NULL;
+    size_t local_indexes[32];
+    size_t *indexes = local_indexes;
+    size_t arrays = 0;
+    size_t length = 0;
+    size_t i = 0;
+
+    *result = NULL;
+
+    /* first pass: check the links, measure the keys and count the arrays */
+    for (current = target; current != object; current = current->parent)
+    {
+        if (!is_linked_to_parent(current))
+        {
+            return false;
+        }
+        if (cJSON_IsArray(current->parent))
+        {
+            arrays++;
+        }
+        else if (cJSON_IsObject(current->parent) && (current->string != NULL))
+        {
+            length += 1 + pointer_encoded_length((const unsigned char*)current->string);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (arrays > sizeof(local_indexes) / sizeof(local_indexes[0]))
+    {
+        indexes = (size_t*)cJSON_malloc(arrays * sizeof(size_t));
+        if (indexes == NULL)
+        {
+            /* found, but out of memory */
+            return true;
+        }
+    }
+
+    /* second pass: the positions in the arrays, kept for filling in the pointer */
+    for (current = target; current != object; current = current->parent)
+    {
+        if (cJSON_IsArray(current->parent))
+        {
+            indexes[i] = get_child_index(current);
+            length += 1 + index_length(indexes[i]);
+            i++;
+        }
+    }
+
+    pointer = (unsigned char*)cJSON_malloc(length + sizeof(""));
+    if (pointer == NULL)
+    {
+        /* found, but out of memory */
+        goto cleanup;
+    }
+    pointer[length] = '\0';
+
+    /* third pass: fill in the tokens from the back */
+    i = 0;
+    for (current = target; current != object; current = current->parent)
+    {
+        if (cJSON_IsArray(current->parent))
+        {
+            size_t index = indexes[i++];
+            size_t digits = index_length(index);
+            length -= digits;
+            for (; digits > 0; digits--)
+            {
+                pointer[length + digits - 1] = (unsigned char)('0' + (index % 10));
+                index /= 10;
+            }
+        }
+        else
+        {
+            size_t key_length = pointer_encoded_length((const unsigned char*)current->string);
+            unsigned char last = 0;
+            length -= key_length;
+            /* encode_string_as_pointer terminates the string, don't lose the character after it */
+            last = pointer[length + key_length];
+            encode_string_as_pointer(pointer + length, (const unsigned char*)current->string);
+            pointer[length + key_length] = last;
+        }
+        length--;
+        pointer[length] = '/';
+    }
+
+    *result = pointer;
+
+cleanup:
+    if (indexes != local_indexes)
+    {
+        cJSON_free(indexes);
+    }
+    return true;
+}
+
 CJSON_PUBLIC(char *) cJSONUtils_FindPointerFromObjectTo(const cJSON * const object, const cJSON * const target)
 {
     size_t child_index = 0;
@@ -199,7 +345,15 @@ CJSON_PUBLIC(char *) cJSONUtils_FindPointerFromObjectTo(const cJSON * const obje
         return (char*)cJSONUtils_strdup((const unsigned char*)"");
     }
 
-    /* recursively search all children of the object or array */
+    {
+        unsigned char *pointer = NULL;
+        if (find_pointer_via_parents(object, target, &pointer))
+        {
+            return (char*)pointer;
+        }
+    }
+
+    /* the parent links don't lead to object, recursively search all children of the object or array */
     for (current_child = object->child; current_child != NULL; (void)(current_child = current_child->next), child_index++)
     {
         unsigned char *target_pointer = (unsigned char*)cJSONUtils_FindPointerFromObjectTo(current_child, target);
@@ -269,7 +423,7 @@ static cJSON_bool decode_array_index_from_pointer(const unsigned char * const po
         return 0;
     }
 
-    for (position = 0; (pointer[position] >= '0') && (pointer[0] <= '9'); position++)
+    for (position = 0; (pointer[position] >= '0') && (pointer[position] <= '9'); position++)
     {
         parsed_index = (10 * parsed_index) + (size_t)(pointer[position] - '0');
 
@@ -285,17 +439,13 @@ static cJSON_bool decode_array_index_from_pointer(const unsigned char * const po
     return 1;
 }
 
-static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer, const cJSON_bool case_sensitive)
+/* resolve the pointer that ends at end (either the end of the string or a '/') */
+static cJSON *get_item_from_pointer_range(cJSON * const object, const char * pointer, const char * const end, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = object;
 
-    if (pointer == NULL)
-    {
-        return NULL;
-    }
-
     /* follow path of the pointer */
-    while ((pointer[0] == '/') && (current_element != NULL))
+    while ((pointer < end) && (pointer[0] == '/') && (current_element != NULL))
     {
         pointer++;
         if (cJSON_IsArray(current_element))
@@ -323,7 +473,7 @@ static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer,
         }
 
         /* skip to the next path token or end of string */
-        while ((pointer[0] != '\0') && (pointer[0] != '/'))
+        while ((pointer < end) && (pointer[0] != '/'))
         {
             pointer++;
         }
@@ -332,6 +482,16 @@ static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer,
     return current_element;
 }
 
+static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer, const cJSON_bool case_sensitive)
+{
+    if (pointer == NULL)
+    {
+        return NULL;
+    }
+
+    return get_item_from_pointer_range(object, pointer, pointer + strlen(pointer), case_sensitive);
+}
+
 CJSON_PUBLIC(cJSON *) cJSONUtils_GetPointer(cJSON * const object, const char *pointer)
 {
     return get_item_from_pointer(object, pointer, false);
@@ -342,790 +502,5556 @@ CJSON_PUBLIC(cJSON *) cJSONUtils_GetPointerCaseSensitive(cJSON * const object, c
     return get_item_from_pointer(object, pointer, true);
 }
 
-/* JSON Patch implementation. */
-static void decode_pointer_inplace(unsigned char *string)
+/* Compiled JSON pointers: the tokens are split, unescaped and hashed once, evaluation only compares them against the tree. */
+typedef struct
 {
-    unsigned char *decoded_string = string;
+    const unsigned char *key; /* unescaped token, zero terminated */
+    size_t length;
+    unsigned long hash; /* case insensitive hash of key */
+    size_t index; /* array index, valid if is_index */
+    cJSON_bool is_index;
+} pointer_token;
 
-    if (string == NULL) {
-        return;
-    }
+struct cJSONUtils_Pointer
+{
+    size_t count;
+    pointer_token tokens[1];
+};
 
-    for (; *string; (void)decoded_string++, string++)
-    {
-        if (string[0] == '~')
-        {
-            if (string[1] == '0')
-            {
-                decoded_string[0] = '~';
-            }
-            else if (string[1] == '1')
-            {
-                decoded_string[1] = '/';
-            }
-            else
-            {
-                /* invalid escape sequence */
-                return;
-            }
+/* FNV-1a over the lower case characters, so that it works for both case sensitive and insensitive matching */
+static unsigned long hash_key(const unsigned char *key, size_t length)
+{
+    unsigned long hash = 2166136261UL;
 
-            string++;
-        }
+    for (; length > 0; (void)key++, length--)
+    {
+        hash ^= (unsigned long)tolower(*key);
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
     }
 
-    decoded_string[0] = '\0';
+    return hash;
 }
 
-/* non-broken cJSON_DetachItemFromArray */
-static cJSON *detach_item_from_array(cJSON *array, size_t which)
+/* compare a token against the (zero terminated) key of an object member */
+static cJSON_bool token_matches_key(const pointer_token * const token, const unsigned char *name, const cJSON_bool case_sensitive)
 {
-    cJSON *c = array->child;
-    while (c && (which > 0))
-    {
-        c = c->next;
-        which--;
-    }
-    if (!c)
-    {
-        /* item doesn't exist */
-        return NULL;
-    }
-    if (c->prev)
+    const unsigned char *key = token->key;
+    size_t length = token->length;
+
+    if (name == NULL)
     {
-        /* not the first element */
-        c->prev->next = c->next;
+        return false;
     }
-    if (c->next)
+
+    if (case_sensitive)
     {
-        c->next->prev = c->prev;
+        for (; (length > 0) && (*name == *key); (void)name++, key++, length--)
+        {
+        }
     }
-    if (c==array->child)
+    else
     {
-        array->child = c->next;
+        for (; (length > 0) && (*name != '\0') && (tolower(*name) == tolower(*key)); (void)name++, key++, length--)
+        {
+        }
     }
-    /* make sure the detached item doesn't point anywhere anymore */
-    c->prev = c->next = NULL;
 
-    return c;
+    return (length == 0) && (*name == '\0');
 }
 
-/* detach an item at the given path */
-static cJSON *detach_path(cJSON *object, const unsigned char *path, const cJSON_bool case_sensitive)
+/* resolve one token of a compiled pointer below current */
+static cJSON *get_token_item(const cJSON * const current, const pointer_token * const token, const cJSON_bool case_sensitive)
 {
-    unsigned char *parent_pointer = NULL;
-    unsigned char *child_pointer = NULL;
-    cJSON *parent = NULL;
-    cJSON *detached_item = NULL;
+    cJSON *child = NULL;
 
-    /* copy path and split it in parent and child */
-    parent_pointer = cJSONUtils_strdup(path);
-    if (parent_pointer == NULL) {
-        goto cleanup;
+    if (cJSON_IsArray(current))
+    {
+        return token->is_index ? get_array_item(current, token->index) : NULL;
     }
 
-    child_pointer = (unsigned char*)strrchr((char*)parent_pointer, '/'); /* last '/' */
-    if (child_pointer == NULL)
+    if (cJSON_IsObject(current))
     {
-        goto cleanup;
+        for (child = current->child; child != NULL; child = child->next)
+        {
+            if (token_matches_key(token, (const unsigned char*)child->string, case_sensitive))
+            {
+                return child;
+            }
+        }
     }
-    /* split strings */
-    child_pointer[0] = '\0';
-    child_pointer++;
 
-    parent = get_item_from_pointer(object, (char*)parent_pointer, case_sensitive);
-    decode_pointer_inplace(child_pointer);
+    return NULL;
+}
 
-    if (cJSON_IsArray(parent))
+CJSON_PUBLIC(cJSONUtils_Pointer *) cJSONUtils_CompilePointer(const char *pointer)
+{
+    cJSONUtils_Pointer *compiled = NULL;
+    const unsigned char *position = (const unsigned char*)pointer;
+    unsigned char *keys = NULL;
+    size_t count = 0;
+    size_t size = 0;
+    size_t i = 0;
+
+    if ((pointer == NULL) || ((pointer[0] != '\0') && (pointer[0] != '/')))
     {
-        size_t index = 0;
-        if (!decode_array_index_from_pointer(child_pointer, &index))
-        {
-            goto cleanup;
-        }
-        detached_item = detach_item_from_array(parent, index);
+        return NULL;
     }
-    else if (cJSON_IsObject(parent))
+
+    /* every '/' starts a token, the escaped keys are never longer than the pointer itself */
+    for (; *position != '\0'; position++)
     {
-        detached_item = cJSON_DetachItemFromObject(parent, (char*)child_pointer);
+        if (*position == '/')
+        {
+            count++;
+        }
     }
-    else
+    size = sizeof(cJSONUtils_Pointer) + (count * sizeof(pointer_token)) + strlen(pointer) + sizeof("");
+    compiled = (cJSONUtils_Pointer*)cJSON_malloc(size);
+    if (compiled == NULL)
     {
-        /* Couldn't find object to remove child from. */
-        goto cleanup;
+        return NULL;
     }
+    compiled->count = count;
+    keys = (unsigned char*)(compiled->tokens + ((count > 0) ? count : 1));
 
-cleanup:
-    if (parent_pointer != NULL)
+    position = (const unsigned char*)pointer;
+    for (i = 0; i < count; i++)
     {
-        cJSON_free(parent_pointer);
+        pointer_token *token = &compiled->tokens[i];
+        size_t digits = 0;
+
+        /* skip '/' and unescape ~0 and ~1 */
+        position++;
+        token->key = keys;
+        for (; (*position != '\0') && (*position != '/'); position++)
+        {
+            if (*position == '~')
+            {
+                if ((position[1] != '0') && (position[1] != '1'))
+                {
+                    /* invalid escape sequence */
+                    cJSON_free(compiled);
+                    return NULL;
+                }
+                *keys++ = (position[1] == '0') ? '~' : '/';
+                position++;
+            }
+            else
+            {
+                *keys++ = *position;
+            }
+        }
+        *keys++ = '\0';
+        token->length = (size_t)(keys - token->key) - 1;
+        token->hash = hash_key(token->key, token->length);
+
+        /* array index: digits without leading zeroes that fit into a size_t */
+        token->index = 0;
+        token->is_index = (token->length > 0) && ((token->key[0] != '0') || (token->length == 1));
+        for (digits = 0; token->is_index && (digits < token->length); digits++)
+        {
+            size_t digit = (size_t)(token->key[digits] - '0');
+            if ((token->key[digits] < '0') || (token->key[digits] > '9') || (token->index > (((size_t)-1 - digit) / 10)))
+            {
+                token->is_index = false;
+                token->index = 0;
+            }
+            else
+            {
+                token->index = (10 * token->index) + digit;
+            }
+        }
     }
 
-    return detached_item;
+    return compiled;
 }
 
-/* sort lists using mergesort */
-static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
+CJSON_PUBLIC(void) cJSONUtils_DeletePointer(cJSONUtils_Pointer *pointer)
 {
-    cJSON *first = list;
-    cJSON *second = list;
-    cJSON *current_item = list;
-    cJSON *result = list;
-    cJSON *result_tail = NULL;
-
-    if ((list == NULL) || (list->next == NULL))
+    if (pointer != NULL)
     {
-        /* One entry is sorted already. */
-        return result;
+        cJSON_free(pointer);
     }
+}
 
-    while ((current_item != NULL) && (current_item->next != NULL) && (compare_strings((unsigned char*)current_item->string, (unsigned char*)current_item->next->string, case_sensitive) < 0))
+static cJSON *eval_pointer(cJSON * const object, const cJSONUtils_Pointer * const pointer, const cJSON_bool case_sensitive)
+{
+    cJSON *current_element = object;
+    size_t i = 0;
+
+    if (pointer == NULL)
     {
-        /* Test for list sorted. */
-        current_item = current_item->next;
+        return NULL;
     }
-    if ((current_item == NULL) || (current_item->next == NULL))
+
+    for (i = 0; (i < pointer->count) && (current_element != NULL); i++)
     {
-        /* Leave sorted lists unmodified. */
-        return result;
+        current_element = get_token_item(current_element, &pointer->tokens[i], case_sensitive);
     }
 
-    /* reset pointer to the beginning */
-    current_item = list;
-    while (current_item != NULL)
+    return current_element;
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_EvalPointer(cJSON * const object, const cJSONUtils_Pointer * const pointer)
+{
+    return eval_pointer(object, pointer, false);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_EvalPointerCaseSensitive(cJSON * const object, const cJSONUtils_Pointer * const pointer)
+{
+    return eval_pointer(object, pointer, true);
+}
+
+/* Several compiled pointers are merged into a prefix trie, so that shared prefixes are resolved once */
+typedef struct
+{
+    const pointer_token *token;
+    size_t first_child; /* node index, 0 if there is none (the root is never a child) */
+    size_t next_sibling;
+    size_t first_result; /* 1 + index of the first pointer ending at this node, 0 if none */
+    cJSON_bool matched;
+} pointer_trie_node;
+
+typedef struct
+{
+    pointer_trie_node *nodes;
+    size_t *next_result; /* 1 + index of the next pointer ending at the same node */
+    cJSON **results;
+    cJSON_bool case_sensitive;
+} pointer_trie;
+
+static cJSON_bool tokens_equal(const pointer_token * const a, const pointer_token * const b)
+{
+    return (a->length == b->length) && (a->hash == b->hash) && (memcmp(a->key, b->key, a->length) == 0);
+}
+
+/* resolve the pointers of a trie node and all its descendants below current */
+static void walk_pointer_trie(const pointer_trie * const trie, const size_t node_index, cJSON * const current)
+{
+    pointer_trie_node *node = &trie->nodes[node_index];
+    size_t result = 0;
+    size_t child_index = 0;
+
+    for (result = node->first_result; result != 0; result = trie->next_result[result - 1])
     {
-        /* Walk two pointers to find the middle. */
-        second = second->next;
-        current_item = current_item->next;
-        /* advances current_item two steps at a time */
-        if (current_item != NULL)
-        {
-            current_item = current_item->next;
-        }
+        trie->results[result - 1] = current;
     }
-    if ((second != NULL) && (second->prev != NULL))
+
+    if (node->first_child == 0)
     {
-        /* Split the lists */
-        second->prev->next = NULL;
-        second->prev = NULL;
+        return;
     }
 
-    /* Recursively sort the sub-lists. */
-    first = sort_list(first, case_sensitive);
-    second = sort_list(second, case_sensitive);
-    result = NULL;
-
-    /* Merge the sub-lists */
-    while ((first != NULL) && (second != NULL))
+    if (cJSON_IsArray(current))
     {
-        cJSON *smaller = NULL;
-        if (compare_strings((unsigned char*)first->string, (unsigned char*)second->string, case_sensitive) < 0)
+        size_t last = 0;
+        size_t position = 0;
+        cJSON *element = NULL;
+
+        for (child_index = node->first_child; child_index != 0; child_index = trie->nodes[child_index].next_sibling)
         {
-            smaller = first;
+            const pointer_token *token = trie->nodes[child_index].token;
+            if (token->is_index && (token->index > last))
+            {
+                last = token->index;
+            }
         }
-        else
+
+        /* one pass over the elements up to the largest index */
+        for (element = current->child; (element != NULL) && (position <= last); (void)(element = element->next), position++)
         {
-            smaller = second;
+            for (child_index = node->first_child; child_index != 0; child_index = trie->nodes[child_index].next_sibling)
+            {
+                const pointer_token *token = trie->nodes[child_index].token;
+                if (token->is_index && (token->index == position))
+                {
+                    walk_pointer_trie(trie, child_index, element);
+                }
+            }
         }
+    }
+    else if (cJSON_IsObject(current))
+    {
+        size_t unmatched = 0;
+        cJSON *member = NULL;
 
-        if (result == NULL)
+        for (child_index = node->first_child; child_index != 0; child_index = trie->nodes[child_index].next_sibling)
         {
-            /* start merged list with the smaller element */
-            result_tail = smaller;
-            result = smaller;
+            unmatched++;
         }
-        else
+
+        /* one pass over the members, the first member matching a token wins like in get_token_item */
+        for (member = current->child; (member != NULL) && (unmatched > 0); member = member->next)
+        {
+            unsigned long hash = 0;
+            cJSON_bool hashed = false;
+
+            if (member->string == NULL)
+            {
+                continue;
+            }
+
+            for (child_index = node->first_child; child_index != 0; child_index = trie->nodes[child_index].next_sibling)
+            {
+                pointer_trie_node *child = &trie->nodes[child_index];
+                if (child->matched)
+                {
+                    continue;
+                }
+                /* with many candidates hash the key once instead of comparing it against every token */
+                if (unmatched > 4)
+                {
+                    if (!hashed)
+                    {
+                        hash = hash_key((const unsigned char*)member->string, strlen(member->string));
+                        hashed = true;
+                    }
+                    if (hash != child->token->hash)
+                    {
+                        continue;
+                    }
+                }
+                if (token_matches_key(child->token, (const unsigned char*)member->string, trie->case_sensitive))
+                {
+                    child->matched = true;
+                    unmatched--;
+                    walk_pointer_trie(trie, child_index, member);
+                }
+            }
+        }
+    }
+}
+
+static cJSON_bool eval_pointers(cJSON * const object, const cJSONUtils_Pointer * const * const pointers, const size_t count, cJSON ** const results, const cJSON_bool case_sensitive)
+{
+    pointer_trie trie;
+    size_t node_count = 1;
+    size_t i = 0;
+    size_t j = 0;
+
+    if ((pointers == NULL) || (results == NULL))
+    {
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        results[i] = NULL;
+        if (pointers[i] != NULL)
+        {
+            node_count += pointers[i]->count;
+        }
+    }
+
+    trie.nodes = (pointer_trie_node*)cJSON_malloc((node_count * sizeof(pointer_trie_node)) + ((count + 1) * sizeof(size_t)));
+    if (trie.nodes == NULL)
+    {
+        return false;
+    }
+    trie.next_result = (size_t*)(trie.nodes + node_count);
+    trie.results = results;
+    trie.case_sensitive = case_sensitive;
+    memset(trie.nodes, '\0', sizeof(pointer_trie_node));
+    node_count = 1;
+
+    /* insert every pointer, reusing nodes of equal tokens */
+    for (i = 0; i < count; i++)
+    {
+        size_t node_index = 0;
+
+        if (pointers[i] == NULL)
+        {
+            continue;
+        }
+
+        for (j = 0; j < pointers[i]->count; j++)
+        {
+            const pointer_token *token = &pointers[i]->tokens[j];
+            size_t child_index = trie.nodes[node_index].first_child;
+
+            while ((child_index != 0) && !tokens_equal(trie.nodes[child_index].token, token))
+            {
+                child_index = trie.nodes[child_index].next_sibling;
+            }
+            if (child_index == 0)
+            {
+                child_index = node_count++;
+                memset(&trie.nodes[child_index], '\0', sizeof(pointer_trie_node));
+                trie.nodes[child_index].token = token;
+                trie.nodes[child_index].next_sibling = trie.nodes[node_index].first_child;
+                trie.nodes[node_index].first_child = child_index;
+            }
+            node_index = child_index;
+        }
+
+        trie.next_result[i] = trie.nodes[node_index].first_result;
+        trie.nodes[node_index].first_result = i + 1;
+    }
+
+    if (object != NULL)
+    {
+        walk_pointer_trie(&trie, 0, object);
+    }
+    cJSON_free(trie.nodes);
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_EvalPointers(cJSON * const object, const cJSONUtils_Pointer * const * const pointers, const size_t count, cJSON ** const results)
+{
+    return eval_pointers(object, pointers, count, results, false);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_EvalPointersCaseSensitive(cJSON * const object, const cJSONUtils_Pointer * const * const pointers, const size_t count, cJSON ** const results)
+{
+    return eval_pointers(object, pointers, count, results, true);
+}
+
+/* I-Regexp (RFC 9485, https://www.rfc-editor.org/rfc/rfc9485) for the match() and search() functions of JSONPath.
+ * Patterns are compiled to a program for a Pike VM that runs in time linear in the length of the text. Programs and the
+ * state of the VM fit into REGEX_MAX_INSTRUCTIONS, so patterns that come from the document are matched without allocating.
+ * Unicode character categories (\p{..} and \P{..}) are not supported, patterns using them never match. */
+#define REGEX_MAX_INSTRUCTIONS 256
+/* counts of {n,m} quantifiers and nesting of groups */
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_DEPTH 32
+
+#define REGEX_CHAR 0 /* a code point from low to high */
+#define REGEX_ANY 1 /* any code point but \n and \r */
+#define REGEX_CLASS 2 /* one of the low ranges that follow, or none of them if high is 1 */
+#define REGEX_RANGE 3
+#define REGEX_SPLIT 4 /* continue at both x and y */
+#define REGEX_JUMP 5 /* continue at x */
+#define REGEX_MATCH 6
+
+typedef struct
+{
+    int operation;
+    int x; /* jump targets relative to the instruction, so blocks of code can be moved and copied */
+    int y;
+    unsigned long low;
+    unsigned long high;
+} regex_instruction;
+
+typedef struct
+{
+    const unsigned char *position;
+    regex_instruction *code;
+    size_t count;
+    size_t depth;
+    cJSON_bool exceeded; /* the pattern may be valid, but is too long or deep */
+} regex_compiler;
+
+/* decode one UTF-8 character, returns its length or 0 if it is invalid */
+static size_t decode_utf8(const unsigned char * const string, unsigned long * const code_point)
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    if (string[0] < 0x80)
+    {
+        *code_point = string[0];
+        return 1;
+    }
+    if ((string[0] & 0xE0) == 0xC0)
+    {
+        length = 2;
+        *code_point = string[0] & 0x1F;
+    }
+    else if ((string[0] & 0xF0) == 0xE0)
+    {
+        length = 3;
+        *code_point = string[0] & 0x0F;
+    }
+    else if ((string[0] & 0xF8) == 0xF0)
+    {
+        length = 4;
+        *code_point = string[0] & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+    for (i = 1; i < length; i++)
+    {
+        if ((string[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        *code_point = (*code_point << 6) | (string[i] & 0x3F);
+    }
+    /* overlong forms, surrogates and code points above U+10FFFF */
+    if ((*code_point < ((length == 2) ? 0x80UL : ((length == 3) ? 0x800UL : 0x10000UL))) || ((*code_point >= 0xD800) && (*code_point <= 0xDFFF)) || (*code_point > 0x10FFFF))
+    {
+        return 0;
+    }
+
+    return length;
+}
+
+static cJSON_bool regex_emit(regex_compiler * const compiler, const int operation, const int x, const int y, const unsigned long low, const unsigned long high)
+{
+    regex_instruction *instruction = NULL;
+
+    if (compiler->count == REGEX_MAX_INSTRUCTIONS)
+    {
+        compiler->exceeded = true;
+        return false;
+    }
+    instruction = &compiler->code[compiler->count++];
+    instruction->operation = operation;
+    instruction->x = x;
+    instruction->y = y;
+    instruction->low = low;
+    instruction->high = high;
+
+    return true;
+}
+
+/* insert a split in front of the code from start on */
+static cJSON_bool regex_insert_split(regex_compiler * const compiler, const size_t start, const int x, const int y)
+{
+    if (compiler->count == REGEX_MAX_INSTRUCTIONS)
+    {
+        compiler->exceeded = true;
+        return false;
+    }
+    memmove(compiler->code + start + 1, compiler->code + start, (compiler->count - start) * sizeof(regex_instruction));
+    compiler->count++;
+    compiler->code[start].operation = REGEX_SPLIT;
+    compiler->code[start].x = x;
+    compiler->code[start].y = y;
+    compiler->code[start].low = 0;
+    compiler->code[start].high = 0;
+
+    return true;
+}
+
+/* the character of a SingleCharEsc after the '\\', 0 if there is none */
+static unsigned long regex_single_escape(const unsigned char character)
+{
+    switch (character)
+    {
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+        case '(': case ')': case '*': case '+': case '-': case '.': case '?':
+        case '[': case '\\': case ']': case '^': case '{': case '|': case '}':
+            return character;
+        default:
+            return 0;
+    }
+}
+
+/* a character of a character class expression, which needs '-', '[', '\\' and ']' escaped */
+static cJSON_bool regex_class_char(regex_compiler * const compiler, unsigned long * const code_point)
+{
+    size_t length = 0;
+
+    if (compiler->position[0] == '\\')
+    {
+        *code_point = regex_single_escape(compiler->position[1]);
+        compiler->position += 2;
+        return *code_point != 0;
+    }
+    if ((compiler->position[0] == '-') || (compiler->position[0] == '[') || (compiler->position[0] == ']'))
+    {
+        return false;
+    }
+    length = decode_utf8(compiler->position, code_point);
+    compiler->position += length;
+
+    return (length > 0) && (*code_point != 0);
+}
+
+/* "[" [ "^" ] ( "-" / CCE1 ) *CCE1 [ "-" ] "]", the '[' is consumed already */
+static cJSON_bool regex_class(regex_compiler * const compiler)
+{
+    size_t start = compiler->count;
+    unsigned long low = 0;
+    unsigned long high = 0;
+
+    if (!regex_emit(compiler, REGEX_CLASS, 0, 0, 0, 0))
+    {
+        return false;
+    }
+    if (compiler->position[0] == '^')
+    {
+        compiler->code[start].high = 1;
+        compiler->position++;
+    }
+    /* a '-' is a literal at the start and the end */
+    if (compiler->position[0] == '-')
+    {
+        compiler->position++;
+        if (!regex_emit(compiler, REGEX_RANGE, 0, 0, '-', '-'))
+        {
+            return false;
+        }
+    }
+    while (compiler->position[0] != ']')
+    {
+        if ((compiler->position[0] == '-') && (compiler->position[1] == ']'))
+        {
+            compiler->position++;
+            low = '-';
+            high = '-';
+        }
+        else
+        {
+            if (!regex_class_char(compiler, &low))
+            {
+                return false;
+            }
+            high = low;
+            if ((compiler->position[0] == '-') && (compiler->position[1] != ']'))
+            {
+                compiler->position++;
+                if (!regex_class_char(compiler, &high) || (high < low))
+                {
+                    return false;
+                }
+            }
+        }
+        if (!regex_emit(compiler, REGEX_RANGE, 0, 0, low, high))
+        {
+            return false;
+        }
+    }
+    compiler->position++;
+    compiler->code[start].low = compiler->count - start - 1;
+
+    return true;
+}
+
+static cJSON_bool regex_alternation(regex_compiler * const compiler);
+
+static cJSON_bool regex_atom(regex_compiler * const compiler)
+{
+    unsigned long code_point = 0;
+    size_t length = 0;
+
+    switch (compiler->position[0])
+    {
+        case '(':
+            compiler->position++;
+            if (++compiler->depth > REGEX_MAX_DEPTH)
+            {
+                compiler->exceeded = true;
+                return false;
+            }
+            if (!regex_alternation(compiler) || (compiler->position[0] != ')'))
+            {
+                return false;
+            }
+            compiler->depth--;
+            compiler->position++;
+            return true;
+
+        case '[':
+            compiler->position++;
+            return regex_class(compiler);
+
+        case '.':
+            compiler->position++;
+            return regex_emit(compiler, REGEX_ANY, 0, 0, 0, 0);
+
+        case '\\':
+            /* \p{..} and \P{..} aren't supported */
+            code_point = regex_single_escape(compiler->position[1]);
+            compiler->position += 2;
+            return (code_point != 0) && regex_emit(compiler, REGEX_CHAR, 0, 0, code_point, code_point);
+
+        case '?': case '*': case '+': case '{': case '}': case ')': case ']': case '|': case '\0':
+            return false;
+
+        default:
+            length = decode_utf8(compiler->position, &code_point);
+            compiler->position += length;
+            return (length > 0) && regex_emit(compiler, REGEX_CHAR, 0, 0, code_point, code_point);
+    }
+}
+
+/* the count of a range quantifier */
+static cJSON_bool regex_count(regex_compiler * const compiler, size_t * const count)
+{
+    if ((compiler->position[0] < '0') || (compiler->position[0] > '9'))
+    {
+        return false;
+    }
+    for (*count = 0; (compiler->position[0] >= '0') && (compiler->position[0] <= '9'); compiler->position++)
+    {
+        *count = (10 * (*count)) + (size_t)(compiler->position[0] - '0');
+        if (*count > REGEX_MAX_REPEAT)
+        {
+            compiler->exceeded = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* repeat the code of an atom from start on minimum to maximum times, (size_t)-1 for no maximum */
+static cJSON_bool regex_repeat(regex_compiler * const compiler, const size_t start, const size_t minimum, const size_t maximum)
+{
+    const size_t length = compiler->count - start;
+    size_t end = 0;
+    size_t i = 0;
+
+    /* the atom itself is the first of the minimum copies, without one it is dropped at the end */
+    for (i = 1; i < minimum; i++)
+    {
+        if ((compiler->count + length) > REGEX_MAX_INSTRUCTIONS)
+        {
+            compiler->exceeded = true;
+            return false;
+        }
+        memcpy(compiler->code + compiler->count, compiler->code + start, length * sizeof(regex_instruction));
+        compiler->count += length;
+    }
+
+    if (maximum == (size_t)-1)
+    {
+        /* L: split(next, end) atom jump(L) */
+        size_t loop = compiler->count;
+        if ((compiler->count + length + 2) > REGEX_MAX_INSTRUCTIONS)
+        {
+            compiler->exceeded = true;
+            return false;
+        }
+        (void)regex_emit(compiler, REGEX_SPLIT, 1, (int)length + 2, 0, 0);
+        memcpy(compiler->code + compiler->count, compiler->code + start, length * sizeof(regex_instruction));
+        compiler->count += length;
+        (void)regex_emit(compiler, REGEX_JUMP, -(int)(compiler->count - loop), 0, 0, 0);
+    }
+    else
+    {
+        /* optional copies: split(next, end) atom, ... */
+        size_t optional = compiler->count;
+        if ((compiler->count + ((maximum - minimum) * (length + 1))) > REGEX_MAX_INSTRUCTIONS)
+        {
+            compiler->exceeded = true;
+            return false;
+        }
+        end = optional + ((maximum - minimum) * (length + 1));
+        for (i = minimum; i < maximum; i++)
+        {
+            (void)regex_emit(compiler, REGEX_SPLIT, 1, (int)(end - compiler->count), 0, 0);
+            memcpy(compiler->code + compiler->count, compiler->code + start, length * sizeof(regex_instruction));
+            compiler->count += length;
+        }
+    }
+
+    if (minimum == 0)
+    {
+        memmove(compiler->code + start, compiler->code + start + length, (compiler->count - start - length) * sizeof(regex_instruction));
+        compiler->count -= length;
+    }
+
+    return true;
+}
+
+/* atom [ quantifier ] */
+static cJSON_bool regex_piece(regex_compiler * const compiler)
+{
+    const size_t start = compiler->count;
+    size_t minimum = 0;
+    size_t maximum = 0;
+
+    if (!regex_atom(compiler))
+    {
+        return false;
+    }
+
+    switch (compiler->position[0])
+    {
+        case '*':
+            compiler->position++;
+            return regex_repeat(compiler, start, 0, (size_t)-1);
+
+        case '+':
+            compiler->position++;
+            return regex_repeat(compiler, start, 1, (size_t)-1);
+
+        case '?':
+            compiler->position++;
+            return regex_repeat(compiler, start, 0, 1);
+
+        case '{':
+            compiler->position++;
+            if (!regex_count(compiler, &minimum))
+            {
+                return false;
+            }
+            maximum = minimum;
+            if (compiler->position[0] == ',')
+            {
+                compiler->position++;
+                maximum = (size_t)-1;
+                if ((compiler->position[0] != '}') && (!regex_count(compiler, &maximum) || (maximum < minimum)))
+                {
+                    return false;
+                }
+            }
+            if (compiler->position[0] != '}')
+            {
+                return false;
+            }
+            compiler->position++;
+            return regex_repeat(compiler, start, minimum, maximum);
+
+        default:
+            return true;
+    }
+}
+
+/* branch *( "|" branch ) */
+static cJSON_bool regex_alternation(regex_compiler * const compiler)
+{
+    const size_t start = compiler->count;
+    size_t jump = 0;
+
+    while ((compiler->position[0] != '|') && (compiler->position[0] != ')') && (compiler->position[0] != '\0'))
+    {
+        if (!regex_piece(compiler))
+        {
+            return false;
+        }
+    }
+    if (compiler->position[0] != '|')
+    {
+        return true;
+    }
+    compiler->position++;
+
+    /* split(first, second) first jump(end) second */
+    if (!regex_insert_split(compiler, start, 1, (int)(compiler->count - start) + 2))
+    {
+        return false;
+    }
+    jump = compiler->count;
+    if (!regex_emit(compiler, REGEX_JUMP, 0, 0, 0, 0) || !regex_alternation(compiler))
+    {
+        return false;
+    }
+    compiler->code[jump].x = (int)(compiler->count - jump);
+
+    return true;
+}
+
+/* Compile pattern into code (REGEX_MAX_INSTRUCTIONS long), returns the number of instructions or 0 if it isn't valid.
+ * exceeded tells patterns that are over the limits from invalid ones. */
+static size_t regex_compile(const unsigned char * const pattern, regex_instruction * const code, cJSON_bool * const exceeded)
+{
+    regex_compiler compiler;
+
+    compiler.position = pattern;
+    compiler.code = code;
+    compiler.count = 0;
+    compiler.depth = 0;
+    compiler.exceeded = false;
+    if (!regex_alternation(&compiler) || (compiler.position[0] != '\0') || !regex_emit(&compiler, REGEX_MATCH, 0, 0, 0, 0))
+    {
+        *exceeded = compiler.exceeded;
+        return 0;
+    }
+    *exceeded = false;
+
+    return compiler.count;
+}
+
+/* add the thread at pc and the threads it jumps and splits to, unless they were added for this character already */
+static void regex_add_thread(const regex_instruction * const code, unsigned short * const list, size_t * const list_count, unsigned short * const stack, unsigned long * const marks, const unsigned long generation, const size_t pc)
+{
+    size_t depth = 0;
+
+    if (marks[pc] == generation)
+    {
+        return;
+    }
+    marks[pc] = generation;
+    stack[depth++] = (unsigned short)pc;
+    while (depth > 0)
+    {
+        size_t current = stack[--depth];
+        size_t targets[2];
+        size_t target_count = 0;
+        size_t i = 0;
+
+        switch (code[current].operation)
+        {
+            case REGEX_JUMP:
+                targets[target_count++] = (size_t)((int)current + code[current].x);
+                break;
+            case REGEX_SPLIT:
+                targets[target_count++] = (size_t)((int)current + code[current].y);
+                targets[target_count++] = (size_t)((int)current + code[current].x);
+                break;
+            default:
+                list[(*list_count)++] = (unsigned short)current;
+                break;
+        }
+        for (i = 0; i < target_count; i++)
+        {
+            if (marks[targets[i]] != generation)
+            {
+                marks[targets[i]] = generation;
+                stack[depth++] = (unsigned short)targets[i];
+            }
+        }
+    }
+}
+
+/* the instruction after the one at pc if it takes code_point, 0 otherwise */
+static size_t regex_step(const regex_instruction * const code, const size_t pc, const unsigned long code_point)
+{
+    const regex_instruction *instruction = &code[pc];
+    size_t i = 0;
+    cJSON_bool in_class = false;
+
+    switch (instruction->operation)
+    {
+        case REGEX_CHAR:
+            return ((code_point >= instruction->low) && (code_point <= instruction->high)) ? pc + 1 : 0;
+
+        case REGEX_ANY:
+            return ((code_point != '\n') && (code_point != '\r')) ? pc + 1 : 0;
+
+        case REGEX_CLASS:
+            for (i = 1; (i <= instruction->low) && !in_class; i++)
+            {
+                in_class = (code_point >= instruction[i].low) && (code_point <= instruction[i].high);
+            }
+            return (in_class != (instruction->high != 0)) ? pc + 1 + instruction->low : 0;
+
+        default:
+            return 0;
+    }
+}
+
+/* Run the program over text. match requires the whole text to match, search any part of it */
+static cJSON_bool regex_execute(const regex_instruction * const code, const size_t count, const unsigned char *text, const cJSON_bool search)
+{
+    unsigned short lists[2][REGEX_MAX_INSTRUCTIONS];
+    unsigned short stack[REGEX_MAX_INSTRUCTIONS];
+    unsigned long marks[REGEX_MAX_INSTRUCTIONS];
+    size_t counts[2] = { 0, 0 };
+    unsigned long generation = 1;
+    size_t current = 0;
+    size_t i = 0;
+
+    memset(marks, '\0', count * sizeof(unsigned long));
+    regex_add_thread(code, lists[current], &counts[current], stack, marks, generation, 0);
+    for (;;)
+    {
+        unsigned long code_point = 0;
+        size_t length = 0;
+        const size_t next = 1 - current;
+
+        for (i = 0; i < counts[current]; i++)
+        {
+            if ((code[lists[current][i]].operation == REGEX_MATCH) && (search || (*text == '\0')))
+            {
+                return true;
+            }
+        }
+        if ((*text == '\0') || ((counts[current] == 0) && !search))
+        {
+            return false;
+        }
+
+        /* invalid UTF-8 is taken byte by byte */
+        length = decode_utf8(text, &code_point);
+        if (length == 0)
+        {
+            code_point = *text;
+            length = 1;
+        }
+        text += length;
+
+        generation++;
+        counts[next] = 0;
+        for (i = 0; i < counts[current]; i++)
+        {
+            size_t pc = regex_step(code, lists[current][i], code_point);
+            if (pc != 0)
+            {
+                regex_add_thread(code, lists[next], &counts[next], stack, marks, generation, pc);
+            }
+        }
+        if (search)
+        {
+            /* a match can start at every character */
+            regex_add_thread(code, lists[next], &counts[next], stack, marks, generation, 0);
+        }
+        current = next;
+    }
+}
+
+/* JSONPath (RFC 9535). A path is compiled once into flat arrays of queries, segments, selectors and filter expressions that refer to
+ * each other by index, evaluation walks the tree and hands every selected node to a callback without allocating. */
+#define PATH_NONE ((size_t)-1)
+/* integers of indices and slices are limited to the I-JSON range */
+#define PATH_MAX_INTEGER 9007199254740991LL
+
+typedef struct
+{
+    size_t first_segment;
+    cJSON_bool relative; /* starts at @ instead of $ */
+    cJSON_bool singular; /* only child segments with a single name or index, resolved like a compiled pointer */
+} path_query;
+
+typedef struct
+{
+    size_t first_selector;
+    size_t next;
+    cJSON_bool descendant;
+} path_segment;
+
+#define PATH_SELECT_NAME 0
+#define PATH_SELECT_WILDCARD 1
+#define PATH_SELECT_INDEX 2
+#define PATH_SELECT_SLICE 3
+#define PATH_SELECT_FILTER 4
+
+typedef struct
+{
+    int kind;
+    size_t next;
+    pointer_token name;
+    long long start; /* index, or start of a slice */
+    long long end;
+    long long step;
+    cJSON_bool has_start;
+    cJSON_bool has_end;
+    size_t filter; /* logical expression */
+} path_selector;
+
+#define PATH_EXPRESSION_OR 0
+#define PATH_EXPRESSION_AND 1
+#define PATH_EXPRESSION_NOT 2
+#define PATH_EXPRESSION_COMPARE 3
+#define PATH_EXPRESSION_EXISTS 4 /* test of a query, true if it selects any node */
+#define PATH_EXPRESSION_SINGULAR 5 /* value of the node a singular query selects */
+#define PATH_EXPRESSION_NODES 6 /* nodes of a query as function argument */
+#define PATH_EXPRESSION_LITERAL 7
+#define PATH_EXPRESSION_FUNCTION 8
+
+#define PATH_EQUAL 0
+#define PATH_NOT_EQUAL 1
+#define PATH_LESS 2
+#define PATH_LESS_EQUAL 3
+#define PATH_GREATER 4
+#define PATH_GREATER_EQUAL 5
+
+/* the pattern of match() and search() */
+#define PATH_PATTERN_DYNAMIC 0 /* compiled when the filter is evaluated */
+#define PATH_PATTERN_COMPILED 1
+#define PATH_PATTERN_INVALID 2 /* a literal that isn't a valid I-Regexp */
+
+typedef struct
+{
+    int kind;
+    int operation; /* comparison operator or function */
+    size_t operands[2]; /* sub expressions or function arguments */
+    size_t query;
+    /* literals */
+    int type;
+    double number;
+    const unsigned char *string;
+    size_t length;
+    /* literal patterns of match() and search() */
+    int pattern;
+    size_t first_instruction;
+    size_t instruction_count;
+} path_expression;
+
+/* the types of function extensions */
+#define PATH_TYPE_VALUE 0
+#define PATH_TYPE_LOGICAL 1
+#define PATH_TYPE_NODES 2
+
+#define PATH_FUNCTION_LENGTH 0
+#define PATH_FUNCTION_COUNT 1
+#define PATH_FUNCTION_MATCH 2
+#define PATH_FUNCTION_SEARCH 3
+#define PATH_FUNCTION_VALUE 4
+
+typedef struct
+{
+    const char *name;
+    int result;
+    size_t parameter_count;
+    int parameters[2];
+} path_function;
+
+static const path_function path_functions[] =
+{
+    { "length", PATH_TYPE_VALUE, 1, { PATH_TYPE_VALUE, PATH_TYPE_VALUE } },
+    { "count", PATH_TYPE_VALUE, 1, { PATH_TYPE_NODES, PATH_TYPE_NODES } },
+    { "match", PATH_TYPE_LOGICAL, 2, { PATH_TYPE_VALUE, PATH_TYPE_VALUE } },
+    { "search", PATH_TYPE_LOGICAL, 2, { PATH_TYPE_VALUE, PATH_TYPE_VALUE } },
+    { "value", PATH_TYPE_VALUE, 1, { PATH_TYPE_NODES, PATH_TYPE_NODES } }
+};
+
+/* the first query is the path itself */
+struct cJSONUtils_Path
+{
+    path_query *queries;
+    path_segment *segments;
+    path_selector *selectors;
+    path_expression *expressions;
+    regex_instruction *instructions;
+};
+
+/* arrays of a compiled path share one allocation, every array starts aligned for any of them */
+typedef union
+{
+    double number;
+    long long integer;
+    size_t size;
+    void *pointer;
+} path_alignment;
+#define PATH_ALIGN(size) ((((size) + sizeof(path_alignment) - 1) / sizeof(path_alignment)) * sizeof(path_alignment))
+
+/* Every query, segment, selector and expression takes at least one character of the path, so the parser works in arrays as long
+ * as the path and cJSONUtils_CompilePath copies the result into a block of the exact size. Names and strings are unescaped into
+ * strings, which is never longer than the path either. */
+typedef struct
+{
+    const unsigned char *position;
+    cJSONUtils_Path path;
+    size_t query_count;
+    size_t segment_count;
+    size_t selector_count;
+    size_t expression_count;
+    size_t instruction_count;
+    size_t instruction_capacity;
+    unsigned char *strings;
+    size_t strings_length;
+    size_t depth;
+} path_parser;
+
+static void skip_path_blanks(path_parser * const parser)
+{
+    while ((*parser->position == ' ') || (*parser->position == '\t') || (*parser->position == '\n') || (*parser->position == '\r'))
+    {
+        parser->position++;
+    }
+}
+
+static cJSON_bool is_path_digit(const unsigned char character)
+{
+    return (character >= '0') && (character <= '9');
+}
+
+/* first character of a member name shorthand, non ASCII characters are checked when they are copied */
+static cJSON_bool is_path_name_first(const unsigned char character)
+{
+    return ((character >= 'a') && (character <= 'z')) || ((character >= 'A') && (character <= 'Z')) || (character == '_') || (character >= 0x80);
+}
+
+/* characters of function names */
+static cJSON_bool is_path_function_char(const unsigned char character)
+{
+    return ((character >= 'a') && (character <= 'z')) || is_path_digit(character) || (character == '_');
+}
+
+static size_t encode_utf8(const unsigned long code_point, unsigned char * const output)
+{
+    if (code_point < 0x80)
+    {
+        output[0] = (unsigned char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800)
+    {
+        output[0] = (unsigned char)(0xC0 | (code_point >> 6));
+        output[1] = (unsigned char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000)
+    {
+        output[0] = (unsigned char)(0xE0 | (code_point >> 12));
+        output[1] = (unsigned char)(0x80 | ((code_point >> 6) & 0x3F));
+        output[2] = (unsigned char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    output[0] = (unsigned char)(0xF0 | (code_point >> 18));
+    output[1] = (unsigned char)(0x80 | ((code_point >> 12) & 0x3F));
+    output[2] = (unsigned char)(0x80 | ((code_point >> 6) & 0x3F));
+    output[3] = (unsigned char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+/* four hex digits of a \u escape */
+static cJSON_bool parse_path_hex4(const unsigned char * const input, unsigned long * const code_point)
+{
+    size_t i = 0;
+
+    *code_point = 0;
+    for (i = 0; i < 4; i++)
+    {
+        unsigned char character = input[i];
+        *code_point <<= 4;
+        if (is_path_digit(character))
+        {
+            *code_point |= (unsigned long)(character - '0');
+        }
+        else if (((character | 0x20) >= 'a') && ((character | 0x20) <= 'f'))
+        {
+            *code_point |= (unsigned long)((character | 0x20) - 'a' + 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* the \u escape at position (after the 'u'), surrogates have to come in pairs */
+static cJSON_bool parse_path_unicode(path_parser * const parser, unsigned long * const code_point)
+{
+    unsigned long low = 0;
+
+    if (!parse_path_hex4(parser->position, code_point))
+    {
+        return false;
+    }
+    parser->position += 4;
+    if ((*code_point >= 0xDC00) && (*code_point <= 0xDFFF))
+    {
+        return false;
+    }
+    if ((*code_point >= 0xD800) && (*code_point <= 0xDBFF))
+    {
+        if ((parser->position[0] != '\\') || (parser->position[1] != 'u') || !parse_path_hex4(parser->position + 2, &low) || (low < 0xDC00) || (low > 0xDFFF))
+        {
+            return false;
+        }
+        parser->position += 6;
+        *code_point = 0x10000 + (((*code_point & 0x3FF) << 10) | (low & 0x3FF));
+    }
+
+    /* keys and strings of cJSON end at the first '\0' */
+    return *code_point != 0;
+}
+
+/* unescape the string literal at position into the strings of the parser */
+static cJSON_bool parse_path_string(path_parser * const parser, const unsigned char ** const string, size_t * const length)
+{
+    const unsigned char quote = *parser->position;
+    unsigned char *output = parser->strings + parser->strings_length;
+    unsigned long code_point = 0;
+
+    *string = output;
+    parser->position++;
+    while (*parser->position != quote)
+    {
+        size_t character_length = 0;
+
+        if (*parser->position < 0x20)
+        {
+            /* control characters and the end of the path */
+            return false;
+        }
+        if (*parser->position != '\\')
+        {
+            character_length = decode_utf8(parser->position, &code_point);
+            if (character_length == 0)
+            {
+                return false;
+            }
+            memcpy(output, parser->position, character_length);
+            output += character_length;
+            parser->position += character_length;
+            continue;
+        }
+
+        parser->position++;
+        switch (*parser->position++)
+        {
+            case 'b':
+                *output++ = '\b';
+                break;
+            case 'f':
+                *output++ = '\f';
+                break;
+            case 'n':
+                *output++ = '\n';
+                break;
+            case 'r':
+                *output++ = '\r';
+                break;
+            case 't':
+                *output++ = '\t';
+                break;
+            case '/':
+                *output++ = '/';
+                break;
+            case '\\':
+                *output++ = '\\';
+                break;
+            case '\'':
+            case '"':
+                /* only the quote of the string can be escaped */
+                if (parser->position[-1] != quote)
+                {
+                    return false;
+                }
+                *output++ = quote;
+                break;
+            case 'u':
+                if (!parse_path_unicode(parser, &code_point))
+                {
+                    return false;
+                }
+                output += encode_utf8(code_point, output);
+                break;
+            default:
+                return false;
+        }
+    }
+    parser->position++;
+
+    *length = (size_t)(output - *string);
+    *output++ = '\0';
+    parser->strings_length = (size_t)(output - parser->strings);
+
+    return true;
+}
+
+/* member name shorthand after '.' or '..' */
+static cJSON_bool parse_path_shorthand(path_parser * const parser, const unsigned char ** const name, size_t * const length)
+{
+    unsigned char *output = parser->strings + parser->strings_length;
+    unsigned long code_point = 0;
+
+    if (!is_path_name_first(*parser->position))
+    {
+        return false;
+    }
+    *name = output;
+    while (is_path_name_first(*parser->position) || is_path_digit(*parser->position))
+    {
+        size_t character_length = decode_utf8(parser->position, &code_point);
+        if (character_length == 0)
+        {
+            return false;
+        }
+        memcpy(output, parser->position, character_length);
+        output += character_length;
+        parser->position += character_length;
+    }
+
+    *length = (size_t)(output - *name);
+    *output++ = '\0';
+    parser->strings_length = (size_t)(output - parser->strings);
+
+    return true;
+}
+
+/* "0" / ["-"] DIGIT1 *DIGIT */
+static cJSON_bool parse_path_integer(path_parser * const parser, long long * const value)
+{
+    const unsigned char *position = parser->position;
+    cJSON_bool negative = false;
+    long long integer = 0;
+
+    if (*position == '-')
+    {
+        negative = true;
+        position++;
+    }
+    if (*position == '0')
+    {
+        /* no -0 and no leading zeroes */
+        position++;
+        if (negative || is_path_digit(*position))
+        {
+            return false;
+        }
+    }
+    else if (!is_path_digit(*position))
+    {
+        return false;
+    }
+    for (; is_path_digit(*position); position++)
+    {
+        integer = (10 * integer) + (*position - '0');
+        if (integer > PATH_MAX_INTEGER)
+        {
+            return false;
+        }
+    }
+
+    *value = negative ? -integer : integer;
+    parser->position = position;
+
+    return true;
+}
+
+static void set_name_token(pointer_token * const token, const unsigned char * const name, const size_t length)
+{
+    token->key = name;
+    token->length = length;
+    token->hash = hash_key(name, length);
+    token->index = 0;
+    token->is_index = false;
+}
+
+static size_t new_path_selector(path_parser * const parser, const int kind)
+{
+    path_selector *selector = &parser->path.selectors[parser->selector_count];
+
+    memset(selector, '\0', sizeof(path_selector));
+    selector->kind = kind;
+    selector->next = PATH_NONE;
+    selector->step = 1;
+    selector->filter = PATH_NONE;
+
+    return parser->selector_count++;
+}
+
+static size_t new_path_expression(path_parser * const parser, const int kind)
+{
+    path_expression *expression = &parser->path.expressions[parser->expression_count];
+
+    memset(expression, '\0', sizeof(path_expression));
+    expression->kind = kind;
+    expression->operands[0] = PATH_NONE;
+    expression->operands[1] = PATH_NONE;
+    expression->query = PATH_NONE;
+    expression->pattern = PATH_PATTERN_DYNAMIC;
+
+    return parser->expression_count++;
+}
+
+static size_t parse_path_query(path_parser * const parser);
+static size_t parse_logical_or(path_parser * const parser);
+
+/* number literal, read by cJSON itself so it converts exactly like the document */
+static size_t parse_path_number(path_parser * const parser)
+{
+    const unsigned char *start = parser->position;
+    path_expression *expression = NULL;
+    cJSON *number = NULL;
+    size_t index = PATH_NONE;
+
+    if (*parser->position == '-')
+    {
+        parser->position++;
+    }
+    if (*parser->position == '0')
+    {
+        parser->position++;
+    }
+    else if (is_path_digit(*parser->position))
+    {
+        while (is_path_digit(*parser->position))
+        {
+            parser->position++;
+        }
+    }
+    else
+    {
+        return PATH_NONE;
+    }
+    if (*parser->position == '.')
+    {
+        parser->position++;
+        if (!is_path_digit(*parser->position))
+        {
+            return PATH_NONE;
+        }
+        while (is_path_digit(*parser->position))
+        {
+            parser->position++;
+        }
+    }
+    if ((*parser->position == 'e') || (*parser->position == 'E'))
+    {
+        parser->position++;
+        if ((*parser->position == '-') || (*parser->position == '+'))
+        {
+            parser->position++;
+        }
+        if (!is_path_digit(*parser->position))
+        {
+            return PATH_NONE;
+        }
+        while (is_path_digit(*parser->position))
+        {
+            parser->position++;
+        }
+    }
+
+    number = cJSON_ParseWithLength((const char*)start, (size_t)(parser->position - start));
+    if (!cJSON_IsNumber(number))
+    {
+        cJSON_Delete(number);
+        return PATH_NONE;
+    }
+    index = new_path_expression(parser, PATH_EXPRESSION_LITERAL);
+    expression = &parser->path.expressions[index];
+    expression->type = cJSON_Number;
+    expression->number = number->valuedouble;
+    cJSON_Delete(number);
+
+    return index;
+}
+
+/* length of the literal true, false or null at position and its type, 0 if there is none */
+static size_t path_keyword_length(const unsigned char * const position, int * const type)
+{
+    static const char * const keywords[] = { "true", "false", "null" };
+    static const int types[] = { cJSON_True, cJSON_False, cJSON_NULL };
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+    {
+        size_t length = strlen(keywords[i]);
+        if ((strncmp((const char*)position, keywords[i], length) == 0) && !is_path_function_char(position[length]) && (position[length] != '('))
+        {
+            *type = types[i];
+            return length;
+        }
+    }
+
+    return 0;
+}
+
+static size_t parse_path_function(path_parser * const parser, int * const result);
+
+/* literal, singular query or function of value type */
+static size_t parse_comparable(path_parser * const parser)
+{
+    size_t index = PATH_NONE;
+    size_t length = 0;
+    int result = PATH_TYPE_NODES;
+    int type = 0;
+
+    switch (*parser->position)
+    {
+        case '@':
+        case '$':
+            index = new_path_expression(parser, PATH_EXPRESSION_SINGULAR);
+            parser->path.expressions[index].query = parse_path_query(parser);
+            if ((parser->path.expressions[index].query == PATH_NONE) || !parser->path.queries[parser->path.expressions[index].query].singular)
+            {
+                return PATH_NONE;
+            }
+            return index;
+
+        case '\'':
+        case '"':
+            index = new_path_expression(parser, PATH_EXPRESSION_LITERAL);
+            parser->path.expressions[index].type = cJSON_String;
+            if (!parse_path_string(parser, &parser->path.expressions[index].string, &parser->path.expressions[index].length))
+            {
+                return PATH_NONE;
+            }
+            return index;
+
+        default:
+            break;
+    }
+
+    if ((*parser->position == '-') || is_path_digit(*parser->position))
+    {
+        return parse_path_number(parser);
+    }
+    length = path_keyword_length(parser->position, &type);
+    if (length > 0)
+    {
+        index = new_path_expression(parser, PATH_EXPRESSION_LITERAL);
+        parser->path.expressions[index].type = type;
+        parser->position += length;
+        return index;
+    }
+    index = parse_path_function(parser, &result);
+    return (result == PATH_TYPE_VALUE) ? index : PATH_NONE;
+}
+
+/* function-name "(" S [function-argument *(S "," S function-argument)] S ")", result is the type it returns */
+static size_t parse_path_function(path_parser * const parser, int * const result)
+{
+    const unsigned char *name = parser->position;
+    const path_function *function = NULL;
+    path_expression *expression = NULL;
+    size_t index = PATH_NONE;
+    size_t length = 0;
+    size_t i = 0;
+
+    if ((*name < 'a') || (*name > 'z'))
+    {
+        return PATH_NONE;
+    }
+    while (is_path_function_char(name[length]))
+    {
+        length++;
+    }
+    for (i = 0; (i < sizeof(path_functions) / sizeof(path_functions[0])) && (function == NULL); i++)
+    {
+        if ((strlen(path_functions[i].name) == length) && (strncmp(path_functions[i].name, (const char*)name, length) == 0))
+        {
+            function = &path_functions[i];
+        }
+    }
+    if ((function == NULL) || (name[length] != '('))
+    {
+        return PATH_NONE;
+    }
+    parser->position += length + 1;
+
+    index = new_path_expression(parser, PATH_EXPRESSION_FUNCTION);
+    parser->path.expressions[index].operation = (int)(function - path_functions);
+    for (i = 0; i < function->parameter_count; i++)
+    {
+        size_t argument = PATH_NONE;
+
+        skip_path_blanks(parser);
+        if (i > 0)
+        {
+            if (*parser->position != ',')
+            {
+                return PATH_NONE;
+            }
+            parser->position++;
+            skip_path_blanks(parser);
+        }
+        if (function->parameters[i] == PATH_TYPE_NODES)
+        {
+            if ((*parser->position == '@') || (*parser->position == '$'))
+            {
+                argument = new_path_expression(parser, PATH_EXPRESSION_NODES);
+                parser->path.expressions[argument].query = parse_path_query(parser);
+                if (parser->path.expressions[argument].query == PATH_NONE)
+                {
+                    return PATH_NONE;
+                }
+            }
+        }
+        else
+        {
+            argument = parse_comparable(parser);
+        }
+        if (argument == PATH_NONE)
+        {
+            return PATH_NONE;
+        }
+        parser->path.expressions[index].operands[i] = argument;
+    }
+    skip_path_blanks(parser);
+    if (*parser->position != ')')
+    {
+        return PATH_NONE;
+    }
+    parser->position++;
+
+    /* literal patterns are compiled once */
+    expression = &parser->path.expressions[index];
+    if (((expression->operation == PATH_FUNCTION_MATCH) || (expression->operation == PATH_FUNCTION_SEARCH))
+        && (parser->path.expressions[expression->operands[1]].kind == PATH_EXPRESSION_LITERAL))
+    {
+        const path_expression *pattern = &parser->path.expressions[expression->operands[1]];
+        regex_instruction code[REGEX_MAX_INSTRUCTIONS];
+        cJSON_bool exceeded = false;
+        size_t count = 0;
+
+        expression->pattern = PATH_PATTERN_INVALID;
+        if (pattern->type == cJSON_String)
+        {
+            count = regex_compile(pattern->string, code, &exceeded);
+        }
+        if (exceeded)
+        {
+            /* rather than never matching a valid pattern */
+            return PATH_NONE;
+        }
+        if (count > 0)
+        {
+            if ((parser->instruction_count + count) > parser->instruction_capacity)
+            {
+                size_t capacity = 2 * (parser->instruction_count + count);
+                regex_instruction *instructions = (regex_instruction*)cJSON_malloc(capacity * sizeof(regex_instruction));
+                if (instructions == NULL)
+                {
+                    return PATH_NONE;
+                }
+                if (parser->path.instructions != NULL)
+                {
+                    memcpy(instructions, parser->path.instructions, parser->instruction_count * sizeof(regex_instruction));
+                    cJSON_free(parser->path.instructions);
+                }
+                parser->path.instructions = instructions;
+                parser->instruction_capacity = capacity;
+            }
+            memcpy(parser->path.instructions + parser->instruction_count, code, count * sizeof(regex_instruction));
+            expression->pattern = PATH_PATTERN_COMPILED;
+            expression->first_instruction = parser->instruction_count;
+            expression->instruction_count = count;
+            parser->instruction_count += count;
+        }
+    }
+
+    *result = function->result;
+    return index;
+}
+
+static cJSON_bool is_path_comparison(const unsigned char * const position)
+{
+    return (position[0] == '<') || (position[0] == '>') || (((position[0] == '=') || (position[0] == '!')) && (position[1] == '='));
+}
+
+/* filter query or function of logical type, tested for existence or its logical value */
+static size_t parse_test_expression(path_parser * const parser)
+{
+    size_t index = PATH_NONE;
+    int result = PATH_TYPE_VALUE;
+
+    if ((*parser->position == '@') || (*parser->position == '$'))
+    {
+        index = new_path_expression(parser, PATH_EXPRESSION_EXISTS);
+        parser->path.expressions[index].query = parse_path_query(parser);
+        return (parser->path.expressions[index].query != PATH_NONE) ? index : PATH_NONE;
+    }
+
+    index = parse_path_function(parser, &result);
+    return (result == PATH_TYPE_LOGICAL) ? index : PATH_NONE;
+}
+
+/* paren-expr / comparison-expr / test-expr, only parenthesized expressions and tests can be negated */
+static size_t parse_basic_expression(path_parser * const parser)
+{
+    path_expression *expression = NULL;
+    const unsigned char *after = NULL;
+    size_t index = PATH_NONE;
+    size_t comparison = PATH_NONE;
+    int result = PATH_TYPE_VALUE;
+    int type = 0;
+
+    if (*parser->position == '!')
+    {
+        index = new_path_expression(parser, PATH_EXPRESSION_NOT);
+        parser->position++;
+        skip_path_blanks(parser);
+        if (*parser->position == '(')
+        {
+            parser->path.expressions[index].operands[0] = parse_basic_expression(parser);
+        }
+        else
+        {
+            parser->path.expressions[index].operands[0] = parse_test_expression(parser);
+        }
+        return (parser->path.expressions[index].operands[0] != PATH_NONE) ? index : PATH_NONE;
+    }
+
+    if (*parser->position == '(')
+    {
+        parser->position++;
+        skip_path_blanks(parser);
+        index = parse_logical_or(parser);
+        skip_path_blanks(parser);
+        if ((index == PATH_NONE) || (*parser->position != ')'))
+        {
+            return PATH_NONE;
+        }
+        parser->position++;
+        return index;
+    }
+
+    /* the left side is parsed once, what follows it decides between a test and a comparison */
+    if ((*parser->position == '@') || (*parser->position == '$'))
+    {
+        index = new_path_expression(parser, PATH_EXPRESSION_EXISTS);
+        parser->path.expressions[index].query = parse_path_query(parser);
+        if (parser->path.expressions[index].query == PATH_NONE)
+        {
+            return PATH_NONE;
+        }
+    }
+    else if ((*parser->position >= 'a') && (*parser->position <= 'z') && (path_keyword_length(parser->position, &type) == 0))
+    {
+        index = parse_path_function(parser, &result);
+    }
+    else
+    {
+        index = parse_comparable(parser);
+    }
+    if (index == PATH_NONE)
+    {
+        return PATH_NONE;
+    }
+    expression = &parser->path.expressions[index];
+
+    after = parser->position;
+    skip_path_blanks(parser);
+    if (!is_path_comparison(parser->position))
+    {
+        /* queries are tested for existence, logical functions for their value */
+        parser->position = after;
+        return ((expression->kind == PATH_EXPRESSION_EXISTS) || ((expression->kind == PATH_EXPRESSION_FUNCTION) && (result == PATH_TYPE_LOGICAL))) ? index : PATH_NONE;
+    }
+
+    /* only values are compared: singular queries, literals and functions of value type */
+    if (expression->kind == PATH_EXPRESSION_EXISTS)
+    {
+        if (!parser->path.queries[expression->query].singular)
+        {
+            return PATH_NONE;
+        }
+        expression->kind = PATH_EXPRESSION_SINGULAR;
+    }
+    else if ((expression->kind == PATH_EXPRESSION_FUNCTION) && (result != PATH_TYPE_VALUE))
+    {
+        return PATH_NONE;
+    }
+
+    comparison = new_path_expression(parser, PATH_EXPRESSION_COMPARE);
+    expression = &parser->path.expressions[comparison];
+    expression->operands[0] = index;
+    switch (*parser->position)
+    {
+        case '=':
+            expression->operation = PATH_EQUAL;
+            parser->position += 2;
+            break;
+        case '!':
+            expression->operation = PATH_NOT_EQUAL;
+            parser->position += 2;
+            break;
+        case '<':
+            expression->operation = (parser->position[1] == '=') ? PATH_LESS_EQUAL : PATH_LESS;
+            parser->position += (parser->position[1] == '=') ? 2 : 1;
+            break;
+        default:
+            expression->operation = (parser->position[1] == '=') ? PATH_GREATER_EQUAL : PATH_GREATER;
+            parser->position += (parser->position[1] == '=') ? 2 : 1;
+            break;
+    }
+    skip_path_blanks(parser);
+    index = parse_comparable(parser);
+    if (index == PATH_NONE)
+    {
+        return PATH_NONE;
+    }
+    parser->path.expressions[comparison].operands[1] = index;
+
+    return comparison;
+}
+
+/* basic-expr *(S "&&" S basic-expr) */
+static size_t parse_logical_and(path_parser * const parser)
+{
+    size_t index = parse_basic_expression(parser);
+
+    while (index != PATH_NONE)
+    {
+        const unsigned char *after = parser->position;
+        size_t conjunction = PATH_NONE;
+
+        skip_path_blanks(parser);
+        if ((parser->position[0] != '&') || (parser->position[1] != '&'))
+        {
+            parser->position = after;
+            break;
+        }
+        parser->position += 2;
+        skip_path_blanks(parser);
+        conjunction = new_path_expression(parser, PATH_EXPRESSION_AND);
+        parser->path.expressions[conjunction].operands[0] = index;
+        parser->path.expressions[conjunction].operands[1] = parse_basic_expression(parser);
+        index = (parser->path.expressions[conjunction].operands[1] != PATH_NONE) ? conjunction : PATH_NONE;
+    }
+
+    return index;
+}
+
+/* logical-and-expr *(S "||" S logical-and-expr) */
+static size_t parse_logical_or(path_parser * const parser)
+{
+    size_t index = PATH_NONE;
+
+    if (++parser->depth > CJSON_NESTING_LIMIT)
+    {
+        return PATH_NONE;
+    }
+    index = parse_logical_and(parser);
+    while (index != PATH_NONE)
+    {
+        const unsigned char *after = parser->position;
+        size_t disjunction = PATH_NONE;
+
+        skip_path_blanks(parser);
+        if ((parser->position[0] != '|') || (parser->position[1] != '|'))
+        {
+            parser->position = after;
+            break;
+        }
+        parser->position += 2;
+        skip_path_blanks(parser);
+        disjunction = new_path_expression(parser, PATH_EXPRESSION_OR);
+        parser->path.expressions[disjunction].operands[0] = index;
+        parser->path.expressions[disjunction].operands[1] = parse_logical_and(parser);
+        index = (parser->path.expressions[disjunction].operands[1] != PATH_NONE) ? disjunction : PATH_NONE;
+    }
+    parser->depth--;
+
+    return index;
+}
+
+/* name, wildcard, index, slice or filter selector */
+static size_t parse_path_selector(path_parser * const parser)
+{
+    path_selector *selector = NULL;
+    const unsigned char *name = NULL;
+    const unsigned char *after = NULL;
+    size_t length = 0;
+    size_t index = PATH_NONE;
+
+    switch (*parser->position)
+    {
+        case '\'':
+        case '"':
+            index = new_path_selector(parser, PATH_SELECT_NAME);
+            if (!parse_path_string(parser, &name, &length))
+            {
+                return PATH_NONE;
+            }
+            set_name_token(&parser->path.selectors[index].name, name, length);
+            return index;
+
+        case '*':
+            parser->position++;
+            return new_path_selector(parser, PATH_SELECT_WILDCARD);
+
+        case '?':
+            parser->position++;
+            skip_path_blanks(parser);
+            index = new_path_selector(parser, PATH_SELECT_FILTER);
+            parser->path.selectors[index].filter = parse_logical_or(parser);
+            return (parser->path.selectors[index].filter != PATH_NONE) ? index : PATH_NONE;
+
+        default:
+            break;
+    }
+
+    /* [start S] ":" S [end S] [":" [S step]] or an index */
+    index = new_path_selector(parser, PATH_SELECT_INDEX);
+    selector = &parser->path.selectors[index];
+    if (*parser->position != ':')
+    {
+        if (!parse_path_integer(parser, &selector->start))
+        {
+            return PATH_NONE;
+        }
+        selector->has_start = true;
+        after = parser->position;
+        skip_path_blanks(parser);
+        if (*parser->position != ':')
+        {
+            parser->position = after;
+            return index;
+        }
+    }
+    selector->kind = PATH_SELECT_SLICE;
+    parser->position++;
+    skip_path_blanks(parser);
+    if ((*parser->position == '-') || is_path_digit(*parser->position))
+    {
+        if (!parse_path_integer(parser, &selector->end))
+        {
+            return PATH_NONE;
+        }
+        selector->has_end = true;
+        skip_path_blanks(parser);
+    }
+    if (*parser->position == ':')
+    {
+        parser->position++;
+        after = parser->position;
+        skip_path_blanks(parser);
+        if ((*parser->position == '-') || is_path_digit(*parser->position))
+        {
+            if (!parse_path_integer(parser, &selector->step))
+            {
+                return PATH_NONE;
+            }
+        }
+        else
+        {
+            parser->position = after;
+        }
+    }
+
+    return index;
+}
+
+/* "[" S selector *(S "," S selector) S "]", the selectors are linked to segment */
+static cJSON_bool parse_path_brackets(path_parser * const parser, const size_t segment)
+{
+    size_t last = PATH_NONE;
+
+    parser->position++;
+    skip_path_blanks(parser);
+    for (;;)
+    {
+        size_t selector = parse_path_selector(parser);
+        if (selector == PATH_NONE)
+        {
+            return false;
+        }
+        if (last == PATH_NONE)
+        {
+            parser->path.segments[segment].first_selector = selector;
+        }
+        else
+        {
+            parser->path.selectors[last].next = selector;
+        }
+        last = selector;
+
+        skip_path_blanks(parser);
+        if (*parser->position == ']')
+        {
+            parser->position++;
+            return true;
+        }
+        if (*parser->position != ',')
+        {
+            return false;
+        }
+        parser->position++;
+        skip_path_blanks(parser);
+    }
+}
+
+/* the single selector of "." or ".." followed by a wildcard or member name */
+static cJSON_bool parse_path_dot(path_parser * const parser, const size_t segment)
+{
+    const unsigned char *name = NULL;
+    size_t length = 0;
+    size_t selector = PATH_NONE;
+
+    if (*parser->position == '*')
+    {
+        parser->position++;
+        parser->path.segments[segment].first_selector = new_path_selector(parser, PATH_SELECT_WILDCARD);
+        return true;
+    }
+
+    selector = new_path_selector(parser, PATH_SELECT_NAME);
+    if (!parse_path_shorthand(parser, &name, &length))
+    {
+        return false;
+    }
+    set_name_token(&parser->path.selectors[selector].name, name, length);
+    parser->path.segments[segment].first_selector = selector;
+
+    return true;
+}
+
+/* ("$" / "@") *(S segment) */
+static size_t parse_path_query(path_parser * const parser)
+{
+    const size_t index = parser->query_count++;
+    size_t last = PATH_NONE;
+    cJSON_bool singular = true;
+
+    parser->path.queries[index].first_segment = PATH_NONE;
+    parser->path.queries[index].relative = (*parser->position == '@');
+    parser->position++;
+
+    for (;;)
+    {
+        const unsigned char *after = parser->position;
+        const path_selector *selector = NULL;
+        size_t segment = parser->segment_count;
+        cJSON_bool valid = false;
+
+        skip_path_blanks(parser);
+        if ((*parser->position != '[') && (*parser->position != '.'))
+        {
+            parser->position = after;
+            break;
+        }
+
+        parser->segment_count++;
+        parser->path.segments[segment].first_selector = PATH_NONE;
+        parser->path.segments[segment].next = PATH_NONE;
+        parser->path.segments[segment].descendant = (parser->position[0] == '.') && (parser->position[1] == '.');
+        if (parser->path.segments[segment].descendant)
+        {
+            parser->position += 2;
+            valid = (*parser->position == '[') ? parse_path_brackets(parser, segment) : parse_path_dot(parser, segment);
+        }
+        else if (*parser->position == '.')
+        {
+            parser->position++;
+            valid = parse_path_dot(parser, segment);
+        }
+        else
+        {
+            valid = parse_path_brackets(parser, segment);
+        }
+        if (!valid)
+        {
+            return PATH_NONE;
+        }
+
+        if (last == PATH_NONE)
+        {
+            parser->path.queries[index].first_segment = segment;
+        }
+        else
+        {
+            parser->path.segments[last].next = segment;
+        }
+        last = segment;
+
+        selector = &parser->path.selectors[parser->path.segments[segment].first_selector];
+        singular = singular && !parser->path.segments[segment].descendant && (selector->next == PATH_NONE)
+            && ((selector->kind == PATH_SELECT_NAME) || (selector->kind == PATH_SELECT_INDEX));
+    }
+    parser->path.queries[index].singular = singular;
+
+    return index;
+}
+
+CJSON_PUBLIC(cJSONUtils_Path *) cJSONUtils_CompilePath(const char *path)
+{
+    path_parser parser;
+    cJSONUtils_Path *compiled = NULL;
+    unsigned char *block = NULL;
+    unsigned char *strings = NULL;
+    size_t length = 0;
+    size_t sizes[5];
+    size_t size = 0;
+    size_t i = 0;
+
+    if ((path == NULL) || (path[0] != '$'))
+    {
+        return NULL;
+    }
+
+    length = strlen(path) + 1;
+    memset(&parser, '\0', sizeof(parser));
+    parser.position = (const unsigned char*)path;
+    block = (unsigned char*)cJSON_malloc(PATH_ALIGN(length * sizeof(path_query)) + PATH_ALIGN(length * sizeof(path_segment))
+        + PATH_ALIGN(length * sizeof(path_selector)) + PATH_ALIGN(length * sizeof(path_expression)) + length);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    parser.path.queries = (path_query*)block;
+    parser.path.segments = (path_segment*)(block + PATH_ALIGN(length * sizeof(path_query)));
+    parser.path.selectors = (path_selector*)((unsigned char*)parser.path.segments + PATH_ALIGN(length * sizeof(path_segment)));
+    parser.path.expressions = (path_expression*)((unsigned char*)parser.path.selectors + PATH_ALIGN(length * sizeof(path_selector)));
+    parser.strings = (unsigned char*)parser.path.expressions + PATH_ALIGN(length * sizeof(path_expression));
+
+    /* no blanks around the path */
+    if ((parse_path_query(&parser) == PATH_NONE) || (*parser.position != '\0'))
+    {
+        goto cleanup;
+    }
+
+    /* copy everything into one block of the exact size */
+    sizes[0] = PATH_ALIGN(parser.query_count * sizeof(path_query));
+    sizes[1] = PATH_ALIGN(parser.segment_count * sizeof(path_segment));
+    sizes[2] = PATH_ALIGN(parser.selector_count * sizeof(path_selector));
+    sizes[3] = PATH_ALIGN(parser.expression_count * sizeof(path_expression));
+    sizes[4] = PATH_ALIGN(parser.instruction_count * sizeof(regex_instruction));
+    size = PATH_ALIGN(sizeof(cJSONUtils_Path)) + sizes[0] + sizes[1] + sizes[2] + sizes[3] + sizes[4] + parser.strings_length;
+    compiled = (cJSONUtils_Path*)cJSON_malloc(size);
+    if (compiled == NULL)
+    {
+        goto cleanup;
+    }
+    compiled->queries = (path_query*)((unsigned char*)compiled + PATH_ALIGN(sizeof(cJSONUtils_Path)));
+    compiled->segments = (path_segment*)((unsigned char*)compiled->queries + sizes[0]);
+    compiled->selectors = (path_selector*)((unsigned char*)compiled->segments + sizes[1]);
+    compiled->expressions = (path_expression*)((unsigned char*)compiled->selectors + sizes[2]);
+    compiled->instructions = (regex_instruction*)((unsigned char*)compiled->expressions + sizes[3]);
+    strings = (unsigned char*)compiled->instructions + sizes[4];
+    memcpy(compiled->queries, parser.path.queries, parser.query_count * sizeof(path_query));
+    memcpy(compiled->segments, parser.path.segments, parser.segment_count * sizeof(path_segment));
+    memcpy(compiled->selectors, parser.path.selectors, parser.selector_count * sizeof(path_selector));
+    memcpy(compiled->expressions, parser.path.expressions, parser.expression_count * sizeof(path_expression));
+    if (parser.instruction_count > 0)
+    {
+        memcpy(compiled->instructions, parser.path.instructions, parser.instruction_count * sizeof(regex_instruction));
+    }
+    if (parser.strings_length > 0)
+    {
+        memcpy(strings, parser.strings, parser.strings_length);
+    }
+
+    /* names and string literals point into the new strings */
+    for (i = 0; i < parser.selector_count; i++)
+    {
+        if (compiled->selectors[i].kind == PATH_SELECT_NAME)
+        {
+            compiled->selectors[i].name.key = strings + (compiled->selectors[i].name.key - parser.strings);
+        }
+    }
+    for (i = 0; i < parser.expression_count; i++)
+    {
+        if (compiled->expressions[i].string != NULL)
+        {
+            compiled->expressions[i].string = strings + (compiled->expressions[i].string - parser.strings);
+        }
+    }
+
+cleanup:
+    cJSON_free(block);
+    if (parser.path.instructions != NULL)
+    {
+        cJSON_free(parser.path.instructions);
+    }
+
+    return compiled;
+}
+
+CJSON_PUBLIC(void) cJSONUtils_DeletePath(cJSONUtils_Path *path)
+{
+    if (path != NULL)
+    {
+        cJSON_free(path);
+    }
+}
+
+typedef struct
+{
+    const cJSONUtils_Path *path;
+    cJSON *root;
+} path_evaluation;
+
+/* a value in a filter, cJSON_Invalid stands for Nothing (the result of a query that selects no node) */
+typedef struct
+{
+    int type;
+    double number;
+    const unsigned char *string;
+    size_t length;
+    const cJSON *node;
+} path_value;
+
+/* nodes selected by a query for tests and function arguments, limit stops the query early (0 for no limit) */
+typedef struct
+{
+    cJSON *node;
+    size_t count;
+    size_t limit;
+} path_collector;
+
+static cJSON_bool collect_path_node(cJSON *item, void *context)
+{
+    path_collector *collector = (path_collector*)context;
+
+    if (collector->count == 0)
+    {
+        collector->node = item;
+    }
+    collector->count++;
+
+    return (collector->limit == 0) || (collector->count < collector->limit);
+}
+
+/* element of array at index, negative indices count from the end */
+static cJSON *get_path_index_item(const cJSON * const array, long long index)
+{
+    const cJSON *child = NULL;
+
+    if (!cJSON_IsArray(array))
+    {
+        return NULL;
+    }
+    if (index < 0)
+    {
+        for (child = array->child; child != NULL; child = child->next)
+        {
+            index++;
+        }
+        if (index < 0)
+        {
+            return NULL;
+        }
+    }
+
+    return get_array_item(array, (size_t)index);
+}
+
+/* the node of a singular query, resolved token by token like a compiled pointer */
+static cJSON *get_singular_node(const path_evaluation * const evaluation, const path_query * const query, cJSON * const current)
+{
+    cJSON *node = query->relative ? current : evaluation->root;
+    size_t segment = query->first_segment;
+
+    for (; (segment != PATH_NONE) && (node != NULL); segment = evaluation->path->segments[segment].next)
+    {
+        const path_selector *selector = &evaluation->path->selectors[evaluation->path->segments[segment].first_selector];
+        if (selector->kind == PATH_SELECT_NAME)
+        {
+            node = get_token_item(node, &selector->name, true);
+        }
+        else
+        {
+            node = get_path_index_item(node, selector->start);
+        }
+    }
+
+    return node;
+}
+
+static cJSON_bool select_path_nodes(const path_evaluation * const evaluation, const size_t segment, cJSON * const node, const cJSONUtils_PathCallback callback, void * const context);
+
+static void collect_query_nodes(const path_evaluation * const evaluation, const size_t query_index, cJSON * const current, path_collector * const collector)
+{
+    const path_query *query = &evaluation->path->queries[query_index];
+
+    if (query->singular)
+    {
+        cJSON *node = get_singular_node(evaluation, query, current);
+        if (node != NULL)
+        {
+            (void)collect_path_node(node, collector);
+        }
+        return;
+    }
+
+    (void)select_path_nodes(evaluation, query->first_segment, query->relative ? current : evaluation->root, collect_path_node, collector);
+}
+
+static void get_node_value(const cJSON * const node, path_value * const value)
+{
+    memset(value, '\0', sizeof(path_value));
+    value->type = cJSON_Invalid;
+    if (node == NULL)
+    {
+        return;
+    }
+    value->type = node->type & 0xFF;
+    value->node = node;
+    if (value->type == cJSON_Number)
+    {
+        value->number = node->valuedouble;
+    }
+    else if (value->type == cJSON_String)
+    {
+        value->string = (const unsigned char*)((node->valuestring != NULL) ? node->valuestring : "");
+        value->length = strlen((const char*)value->string);
+    }
+}
+
+static cJSON_bool path_values_equal(const path_value * const a, const path_value * const b)
+{
+    if (a->type != b->type)
+    {
+        return false;
+    }
+    switch (a->type)
+    {
+        case cJSON_Invalid:
+        case cJSON_False:
+        case cJSON_True:
+        case cJSON_NULL:
+            return true;
+        case cJSON_Number:
+            return a->number == b->number;
+        case cJSON_String:
+            return (a->length == b->length) && (memcmp(a->string, b->string, a->length) == 0);
+        case cJSON_Array:
+        case cJSON_Object:
+            return cJSON_Compare(a->node, b->node, true);
+        default:
+            return false;
+    }
+}
+
+/* only numbers and strings (by their code points, which is the order of their UTF-8 bytes) are ordered */
+static cJSON_bool path_value_less(const path_value * const a, const path_value * const b)
+{
+    int difference = 0;
+
+    if ((a->type == cJSON_Number) && (b->type == cJSON_Number))
+    {
+        return a->number < b->number;
+    }
+    if ((a->type != cJSON_String) || (b->type != cJSON_String))
+    {
+        return false;
+    }
+    difference = memcmp(a->string, b->string, (a->length < b->length) ? a->length : b->length);
+
+    return (difference < 0) || ((difference == 0) && (a->length < b->length));
+}
+
+static cJSON_bool eval_path_logical(const path_evaluation * const evaluation, const size_t expression_index, cJSON * const current);
+
+static void eval_path_value(const path_evaluation * const evaluation, const size_t expression_index, cJSON * const current, path_value * const value)
+{
+    const path_expression *expression = &evaluation->path->expressions[expression_index];
+    path_collector collector;
+    const cJSON *child = NULL;
+    const unsigned char *character = NULL;
+
+    memset(value, '\0', sizeof(path_value));
+    value->type = cJSON_Invalid;
+    switch (expression->kind)
+    {
+        case PATH_EXPRESSION_LITERAL:
+            value->type = expression->type;
+            value->number = expression->number;
+            value->string = expression->string;
+            value->length = expression->length;
+            return;
+
+        case PATH_EXPRESSION_SINGULAR:
+            get_node_value(get_singular_node(evaluation, &evaluation->path->queries[expression->query], current), value);
+            return;
+
+        case PATH_EXPRESSION_FUNCTION:
+            break;
+
+        default:
+            return;
+    }
+
+    switch (expression->operation)
+    {
+        case PATH_FUNCTION_LENGTH:
+            eval_path_value(evaluation, expression->operands[0], current, value);
+            if (value->type == cJSON_String)
+            {
+                /* code points, every byte but continuation bytes starts one */
+                value->number = 0;
+                for (character = value->string; character < (value->string + value->length); character++)
+                {
+                    value->number += ((*character & 0xC0) != 0x80) ? 1 : 0;
+                }
+            }
+            else if ((value->type == cJSON_Array) || (value->type == cJSON_Object))
+            {
+                value->number = 0;
+                for (child = value->node->child; child != NULL; child = child->next)
+                {
+                    value->number++;
+                }
+            }
+            else
+            {
+                value->type = cJSON_Invalid;
+                return;
+            }
+            value->type = cJSON_Number;
+            value->node = NULL;
+            return;
+
+        case PATH_FUNCTION_COUNT:
+        case PATH_FUNCTION_VALUE:
+            memset(&collector, '\0', sizeof(collector));
+            collector.limit = (expression->operation == PATH_FUNCTION_VALUE) ? 2 : 0;
+            collect_query_nodes(evaluation, evaluation->path->expressions[expression->operands[0]].query, current, &collector);
+            if (expression->operation == PATH_FUNCTION_COUNT)
+            {
+                value->type = cJSON_Number;
+                value->number = (double)collector.count;
+            }
+            else if (collector.count == 1)
+            {
+                get_node_value(collector.node, value);
+            }
+            return;
+
+        default:
+            /* logical functions aren't values */
+            return;
+    }
+}
+
+/* match() and search() */
+static cJSON_bool eval_path_regex(const path_evaluation * const evaluation, const path_expression * const expression, cJSON * const current)
+{
+    regex_instruction code[REGEX_MAX_INSTRUCTIONS];
+    cJSON_bool exceeded = false;
+    path_value text;
+    path_value pattern;
+    size_t count = 0;
+
+    eval_path_value(evaluation, expression->operands[0], current, &text);
+    if ((text.type != cJSON_String) || (expression->pattern == PATH_PATTERN_INVALID))
+    {
+        return false;
+    }
+    if (expression->pattern == PATH_PATTERN_COMPILED)
+    {
+        return regex_execute(evaluation->path->instructions + expression->first_instruction, expression->instruction_count, text.string, expression->operation == PATH_FUNCTION_SEARCH);
+    }
+
+    /* patterns from the document that are invalid or too long don't match */
+    eval_path_value(evaluation, expression->operands[1], current, &pattern);
+    if (pattern.type != cJSON_String)
+    {
+        return false;
+    }
+    count = regex_compile(pattern.string, code, &exceeded);
+
+    return (count > 0) && regex_execute(code, count, text.string, expression->operation == PATH_FUNCTION_SEARCH);
+}
+
+static cJSON_bool eval_path_logical(const path_evaluation * const evaluation, const size_t expression_index, cJSON * const current)
+{
+    const path_expression *expression = &evaluation->path->expressions[expression_index];
+    path_collector collector;
+    path_value a;
+    path_value b;
+
+    switch (expression->kind)
+    {
+        case PATH_EXPRESSION_OR:
+            return eval_path_logical(evaluation, expression->operands[0], current) || eval_path_logical(evaluation, expression->operands[1], current);
+
+        case PATH_EXPRESSION_AND:
+            return eval_path_logical(evaluation, expression->operands[0], current) && eval_path_logical(evaluation, expression->operands[1], current);
+
+        case PATH_EXPRESSION_NOT:
+            return !eval_path_logical(evaluation, expression->operands[0], current);
+
+        case PATH_EXPRESSION_EXISTS:
+            memset(&collector, '\0', sizeof(collector));
+            collector.limit = 1;
+            collect_query_nodes(evaluation, expression->query, current, &collector);
+            return collector.count > 0;
+
+        case PATH_EXPRESSION_FUNCTION:
+            return eval_path_regex(evaluation, expression, current);
+
+        case PATH_EXPRESSION_COMPARE:
+            eval_path_value(evaluation, expression->operands[0], current, &a);
+            eval_path_value(evaluation, expression->operands[1], current, &b);
+            switch (expression->operation)
+            {
+                case PATH_EQUAL:
+                    return path_values_equal(&a, &b);
+                case PATH_NOT_EQUAL:
+                    return !path_values_equal(&a, &b);
+                case PATH_LESS:
+                    return path_value_less(&a, &b);
+                case PATH_LESS_EQUAL:
+                    return path_value_less(&a, &b) || path_values_equal(&a, &b);
+                case PATH_GREATER:
+                    return path_value_less(&b, &a);
+                default:
+                    return path_value_less(&b, &a) || path_values_equal(&a, &b);
+            }
+
+        default:
+            return false;
+    }
+}
+
+/* apply one selector to node and the segments from next on to what it selects. Returns false if the callback stopped */
+static cJSON_bool apply_path_selector(const path_evaluation * const evaluation, const path_selector * const selector, const size_t next, cJSON * const node, const cJSONUtils_PathCallback callback, void * const context)
+{
+    cJSON *child = NULL;
+    long long length = 0;
+    long long start = 0;
+    long long end = 0;
+    long long i = 0;
+    long long j = 0;
+
+    switch (selector->kind)
+    {
+        case PATH_SELECT_NAME:
+            child = cJSON_IsObject(node) ? get_token_item(node, &selector->name, true) : NULL;
+            return (child == NULL) || select_path_nodes(evaluation, next, child, callback, context);
+
+        case PATH_SELECT_INDEX:
+            child = get_path_index_item(node, selector->start);
+            return (child == NULL) || select_path_nodes(evaluation, next, child, callback, context);
+
+        case PATH_SELECT_WILDCARD:
+        case PATH_SELECT_FILTER:
+            if (!cJSON_IsArray(node) && !cJSON_IsObject(node))
+            {
+                return true;
+            }
+            for (child = node->child; child != NULL; child = child->next)
+            {
+                if (((selector->kind == PATH_SELECT_WILDCARD) || eval_path_logical(evaluation, selector->filter, child))
+                    && !select_path_nodes(evaluation, next, child, callback, context))
+                {
+                    return false;
+                }
+            }
+            return true;
+
+        default:
+            break;
+    }
+
+    /* slices, bounds are normalized and clamped like RFC 9535 section 2.3.4.2.2 */
+    if (!cJSON_IsArray(node) || (selector->step == 0))
+    {
+        return true;
+    }
+    for (child = node->child; child != NULL; child = child->next)
+    {
+        length++;
+    }
+    if (selector->step > 0)
+    {
+        start = selector->has_start ? selector->start : 0;
+        end = selector->has_end ? selector->end : length;
+        start = (start < 0) ? start + length : start;
+        end = (end < 0) ? end + length : end;
+        start = (start < 0) ? 0 : ((start > length) ? length : start);
+        end = (end < 0) ? 0 : ((end > length) ? length : end);
+        child = (start < end) ? get_array_item(node, (size_t)start) : NULL;
+        for (i = start; (i < end) && (child != NULL); i += selector->step)
+        {
+            if (!select_path_nodes(evaluation, next, child, callback, context))
+            {
+                return false;
+            }
+            for (j = 0; (j < selector->step) && (child != NULL); j++)
+            {
+                child = child->next;
+            }
+        }
+    }
+    else
+    {
+        start = selector->has_start ? selector->start : length - 1;
+        end = selector->has_end ? selector->end : -length - 1;
+        start = (start < 0) ? start + length : start;
+        end = (end < 0) ? end + length : end;
+        start = (start < -1) ? -1 : ((start >= length) ? length - 1 : start);
+        end = (end < -1) ? -1 : ((end >= length) ? length - 1 : end);
+        child = (start > end) ? get_array_item(node, (size_t)start) : NULL;
+        for (i = start; (i > end) && (child != NULL); i += selector->step)
+        {
+            if (!select_path_nodes(evaluation, next, child, callback, context))
+            {
+                return false;
+            }
+            /* the first element's prev is the last one */
+            for (j = 0; (j > selector->step) && (child != NULL); j--)
+            {
+                child = (child == node->child) ? NULL : child->prev;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* apply the segments from segment on to node, descendant segments to node and all its descendants in document order */
+static cJSON_bool select_path_nodes(const path_evaluation * const evaluation, const size_t segment, cJSON * const node, const cJSONUtils_PathCallback callback, void * const context)
+{
+    const path_segment *current = NULL;
+    size_t selector = PATH_NONE;
+    cJSON *child = NULL;
+
+    if (segment == PATH_NONE)
+    {
+        return callback(node, context);
+    }
+
+    current = &evaluation->path->segments[segment];
+    for (selector = current->first_selector; selector != PATH_NONE; selector = evaluation->path->selectors[selector].next)
+    {
+        if (!apply_path_selector(evaluation, &evaluation->path->selectors[selector], current->next, node, callback, context))
+        {
+            return false;
+        }
+    }
+    if (current->descendant && (cJSON_IsArray(node) || cJSON_IsObject(node)))
+    {
+        for (child = node->child; child != NULL; child = child->next)
+        {
+            if (!select_path_nodes(evaluation, segment, child, callback, context))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* counts what is passed to the callback of cJSONUtils_QueryPath */
+typedef struct
+{
+    cJSONUtils_PathCallback callback;
+    void *context;
+    size_t count;
+} path_result;
+
+static cJSON_bool deliver_path_node(cJSON *item, void *context)
+{
+    path_result *result = (path_result*)context;
+
+    result->count++;
+
+    return (result->callback == NULL) || result->callback(item, result->context);
+}
+
+CJSON_PUBLIC(size_t) cJSONUtils_QueryPath(cJSON * const root, const cJSONUtils_Path * const path, cJSONUtils_PathCallback callback, void *context)
+{
+    path_evaluation evaluation;
+    path_result result;
+
+    if ((root == NULL) || (path == NULL))
+    {
+        return 0;
+    }
+    evaluation.path = path;
+    evaluation.root = root;
+    result.callback = callback;
+    result.context = context;
+    result.count = 0;
+
+    if (path->queries[0].singular)
+    {
+        cJSON *node = get_singular_node(&evaluation, &path->queries[0], root);
+        if (node != NULL)
+        {
+            (void)deliver_path_node(node, &result);
+        }
+    }
+    else
+    {
+        (void)select_path_nodes(&evaluation, path->queries[0].first_segment, root, deliver_path_node, &result);
+    }
+
+    return result.count;
+}
+
+/* Predicates on a field of array elements, compared like the comparisons of JSONPath filters. */
+#define PREDICATE_RANGE (-1)
+
+struct cJSONUtils_Predicate
+{
+    cJSONUtils_Pointer *field;
+    int operation;
+    /* copies of the operands, low is the value of single comparisons */
+    cJSON *low;
+    cJSON *high;
+    path_value low_value;
+    path_value high_value;
+};
+
+static cJSON_bool is_ordered(const cJSON * const value)
+{
+    return cJSON_IsNumber(value) || cJSON_IsString(value);
+}
+
+static cJSONUtils_Predicate *create_predicate(const char * const pointer, const int operation, const cJSON * const low, const cJSON * const high)
+{
+    cJSONUtils_Predicate *predicate = (cJSONUtils_Predicate*)cJSON_malloc(sizeof(cJSONUtils_Predicate));
+    if (predicate == NULL)
+    {
+        return NULL;
+    }
+    memset(predicate, '\0', sizeof(cJSONUtils_Predicate));
+    predicate->operation = operation;
+
+    predicate->field = cJSONUtils_CompilePointer(pointer);
+    if (predicate->field == NULL)
+    {
+        goto fail;
+    }
+    if (low != NULL)
+    {
+        predicate->low = cJSON_Duplicate(low, true);
+        if (predicate->low == NULL)
+        {
+            goto fail;
+        }
+    }
+    if (high != NULL)
+    {
+        predicate->high = cJSON_Duplicate(high, true);
+        if (predicate->high == NULL)
+        {
+            goto fail;
+        }
+    }
+    get_node_value(predicate->low, &predicate->low_value);
+    get_node_value(predicate->high, &predicate->high_value);
+
+    return predicate;
+
+fail:
+    cJSONUtils_DeletePredicate(predicate);
+    return NULL;
+}
+
+CJSON_PUBLIC(cJSONUtils_Predicate *) cJSONUtils_CompilePredicate(const char *pointer, int operation, const cJSON *value)
+{
+    if ((pointer == NULL) || (value == NULL))
+    {
+        return NULL;
+    }
+    switch (operation)
+    {
+        case cJSONUtils_PredicateEqual:
+        case cJSONUtils_PredicateNotEqual:
+            break;
+
+        case cJSONUtils_PredicateLess:
+        case cJSONUtils_PredicateLessEqual:
+        case cJSONUtils_PredicateGreater:
+        case cJSONUtils_PredicateGreaterEqual:
+            if (!is_ordered(value))
+            {
+                return NULL;
+            }
+            break;
+
+        case cJSONUtils_PredicatePrefix:
+            if (!cJSON_IsString(value))
+            {
+                return NULL;
+            }
+            break;
+
+        default:
+            return NULL;
+    }
+
+    return create_predicate(pointer, operation, value, NULL);
+}
+
+CJSON_PUBLIC(cJSONUtils_Predicate *) cJSONUtils_CompileRangePredicate(const char *pointer, const cJSON *low, const cJSON *high)
+{
+    if ((pointer == NULL) || ((low == NULL) && (high == NULL)))
+    {
+        return NULL;
+    }
+    if (((low != NULL) && !is_ordered(low)) || ((high != NULL) && !is_ordered(high)))
+    {
+        return NULL;
+    }
+    if ((low != NULL) && (high != NULL) && ((low->type & 0xFF) != (high->type & 0xFF)))
+    {
+        return NULL;
+    }
+
+    return create_predicate(pointer, PREDICATE_RANGE, low, high);
+}
+
+CJSON_PUBLIC(void) cJSONUtils_DeletePredicate(cJSONUtils_Predicate *predicate)
+{
+    if (predicate == NULL)
+    {
+        return;
+    }
+    cJSONUtils_DeletePointer(predicate->field);
+    cJSON_Delete(predicate->low);
+    cJSON_Delete(predicate->high);
+    cJSON_free(predicate);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_MatchPredicate(const cJSONUtils_Predicate *predicate, cJSON *item)
+{
+    path_value field;
+    const path_value *low = NULL;
+
+    if ((predicate == NULL) || (item == NULL))
+    {
+        return false;
+    }
+    /* a missing field is Nothing, which is only unequal to values */
+    get_node_value(cJSONUtils_EvalPointerCaseSensitive(item, predicate->field), &field);
+    low = &predicate->low_value;
+
+    switch (predicate->operation)
+    {
+        case cJSONUtils_PredicateEqual:
+            return path_values_equal(&field, low);
+        case cJSONUtils_PredicateNotEqual:
+            return !path_values_equal(&field, low);
+        case cJSONUtils_PredicateLess:
+            return path_value_less(&field, low);
+        case cJSONUtils_PredicateLessEqual:
+            return path_value_less(&field, low) || path_values_equal(&field, low);
+        case cJSONUtils_PredicateGreater:
+            return path_value_less(low, &field);
+        case cJSONUtils_PredicateGreaterEqual:
+            return path_value_less(low, &field) || path_values_equal(&field, low);
+        case cJSONUtils_PredicatePrefix:
+            return (field.type == cJSON_String) && (field.length >= low->length) && (memcmp(field.string, low->string, low->length) == 0);
+        case PREDICATE_RANGE:
+            /* low <= field < high, with the type of the bounds */
+            if (field.type != ((predicate->low != NULL) ? low->type : predicate->high_value.type))
+            {
+                return false;
+            }
+            if ((predicate->low != NULL) && path_value_less(&field, low))
+            {
+                return false;
+            }
+            return (predicate->high == NULL) || path_value_less(&field, &predicate->high_value);
+        default:
+            return false;
+    }
+}
+
+static cJSON_bool filter_by_predicate(cJSON *element, void *context)
+{
+    return cJSONUtils_MatchPredicate((const cJSONUtils_Predicate*)context, element);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_ParseFiltered(const char *value, size_t buffer_length, const cJSONUtils_Predicate *predicate)
+{
+    if (predicate == NULL)
+    {
+        return cJSON_ParseWithLength(value, buffer_length);
+    }
+
+    return cJSON_ParseFiltered(value, buffer_length, filter_by_predicate, (void*)predicate);
+}
+
+/* Secondary indices: the elements of an array sorted by the value of a field, elements with equal values in the order they were
+ * added. Only false, true, null, numbers and strings are indexed, ordered by type and then like in JSONPath filters. */
+typedef struct
+{
+    cJSON *element;
+    size_t sequence;
+    path_value key;
+} index_entry;
+
+struct cJSONUtils_Index
+{
+    cJSONUtils_Pointer *field;
+    index_entry *entries;
+    size_t count;
+    size_t size;
+    size_t sequence;
+};
+
+static cJSON_bool is_indexed(const path_value * const key)
+{
+    return (key->type == cJSON_False) || (key->type == cJSON_True) || (key->type == cJSON_NULL) || (key->type == cJSON_Number) || (key->type == cJSON_String);
+}
+
+static int compare_index_keys(const path_value * const a, const path_value * const b)
+{
+    if (a->type != b->type)
+    {
+        return (a->type < b->type) ? -1 : 1;
+    }
+    if (path_value_less(a, b))
+    {
+        return -1;
+    }
+
+    return path_value_less(b, a) ? 1 : 0;
+}
+
+static int compare_index_entries(const index_entry * const a, const index_entry * const b)
+{
+    int difference = compare_index_keys(&a->key, &b->key);
+    if (difference != 0)
+    {
+        return difference;
+    }
+
+    return (a->sequence < b->sequence) ? -1 : ((a->sequence > b->sequence) ? 1 : 0);
+}
+
+/* first entry with a key that isn't less than key, or greater than key with after */
+static size_t search_index(const cJSONUtils_Index * const index, const path_value * const key, const cJSON_bool after)
+{
+    size_t low = 0;
+    size_t high = index->count;
+
+    while (low < high)
+    {
+        const size_t middle = low + ((high - low) / 2);
+        const int difference = compare_index_keys(&index->entries[middle].key, key);
+        if ((difference < 0) || (after && (difference == 0)))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/* first entry of a type after all entries of the types before it, or after all entries of the type with after */
+static size_t search_index_type(const cJSONUtils_Index * const index, const int type, const cJSON_bool after)
+{
+    size_t low = 0;
+    size_t high = index->count;
+
+    while (low < high)
+    {
+        const size_t middle = low + ((high - low) / 2);
+        if ((index->entries[middle].key.type < type) || (after && (index->entries[middle].key.type == type)))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static void get_index_key(const cJSONUtils_Index * const index, cJSON * const element, path_value * const key)
+{
+    get_node_value(cJSONUtils_EvalPointerCaseSensitive(element, index->field), key);
+}
+
+/* merge sort of the entries into scratch, stable because of the sequence numbers */
+static void sort_index_entries(index_entry * const entries, index_entry * const scratch, const size_t count)
+{
+    size_t width = 0;
+    index_entry *from = entries;
+    index_entry *to = scratch;
+
+    for (width = 1; width < count; width *= 2)
+    {
+        size_t start = 0;
+        index_entry *swap = NULL;
+
+        for (start = 0; start < count; start += 2 * width)
+        {
+            size_t left = start;
+            const size_t middle = ((start + width) < count) ? (start + width) : count;
+            size_t right = middle;
+            const size_t end = ((start + (2 * width)) < count) ? (start + (2 * width)) : count;
+            size_t output = start;
+
+            while ((left < middle) && (right < end))
+            {
+                to[output++] = (compare_index_entries(&from[right], &from[left]) < 0) ? from[right++] : from[left++];
+            }
+            while (left < middle)
+            {
+                to[output++] = from[left++];
+            }
+            while (right < end)
+            {
+                to[output++] = from[right++];
+            }
+        }
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != entries)
+    {
+        memcpy(entries, from, count * sizeof(index_entry));
+    }
+}
+
+CJSON_PUBLIC(cJSONUtils_Index *) cJSONUtils_CreateIndex(cJSON * const array, const char *pointer)
+{
+    cJSONUtils_Index *index = NULL;
+    index_entry *scratch = NULL;
+    cJSON *element = NULL;
+    size_t count = 0;
+
+    if (!cJSON_IsArray(array) || (pointer == NULL))
+    {
+        return NULL;
+    }
+    index = (cJSONUtils_Index*)cJSON_malloc(sizeof(cJSONUtils_Index));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    memset(index, '\0', sizeof(cJSONUtils_Index));
+    index->field = cJSONUtils_CompilePointer(pointer);
+    if (index->field == NULL)
+    {
+        goto fail;
+    }
+
+    for (element = array->child; element != NULL; element = element->next)
+    {
+        count++;
+    }
+    index->size = (count > 0) ? count : 1;
+    index->entries = (index_entry*)cJSON_malloc(index->size * sizeof(index_entry));
+    if (index->entries == NULL)
+    {
+        goto fail;
+    }
+    for (element = array->child; element != NULL; element = element->next)
+    {
+        index_entry *entry = &index->entries[index->count];
+        entry->element = element;
+        entry->sequence = index->sequence++;
+        get_index_key(index, element, &entry->key);
+        index->count += is_indexed(&entry->key) ? 1 : 0;
+    }
+
+    if (index->count > 1)
+    {
+        scratch = (index_entry*)cJSON_malloc(index->count * sizeof(index_entry));
+        if (scratch == NULL)
+        {
+            goto fail;
+        }
+        sort_index_entries(index->entries, scratch, index->count);
+        cJSON_free(scratch);
+    }
+
+    return index;
+
+fail:
+    cJSONUtils_DeleteIndex(index);
+    return NULL;
+}
+
+CJSON_PUBLIC(void) cJSONUtils_DeleteIndex(cJSONUtils_Index *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+    cJSONUtils_DeletePointer(index->field);
+    if (index->entries != NULL)
+    {
+        cJSON_free(index->entries);
+    }
+    cJSON_free(index);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_IndexAdd(cJSONUtils_Index *index, cJSON *element)
+{
+    index_entry entry;
+    size_t position = 0;
+
+    if ((index == NULL) || (element == NULL))
+    {
+        return false;
+    }
+    entry.element = element;
+    entry.sequence = index->sequence;
+    get_index_key(index, element, &entry.key);
+    if (!is_indexed(&entry.key))
+    {
+        index->sequence++;
+        return true;
+    }
+
+    if (index->count == index->size)
+    {
+        index_entry *grown = (index_entry*)cJSON_malloc(2 * index->size * sizeof(index_entry));
+        if (grown == NULL)
+        {
+            return false;
+        }
+        memcpy(grown, index->entries, index->count * sizeof(index_entry));
+        cJSON_free(index->entries);
+        index->entries = grown;
+        index->size *= 2;
+    }
+
+    /* after the entries with the same key, added before */
+    position = search_index(index, &entry.key, true);
+    memmove(&index->entries[position + 1], &index->entries[position], (index->count - position) * sizeof(index_entry));
+    index->entries[position] = entry;
+    index->count++;
+    index->sequence++;
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_IndexRemove(cJSONUtils_Index *index, const cJSON *element)
+{
+    path_value key;
+    size_t position = 0;
+
+    if ((index == NULL) || (element == NULL))
+    {
+        return false;
+    }
+    get_index_key(index, (cJSON*)element, &key);
+    if (!is_indexed(&key))
+    {
+        return true;
+    }
+
+    for (position = search_index(index, &key, false); (position < index->count) && (compare_index_keys(&index->entries[position].key, &key) == 0); position++)
+    {
+        if (index->entries[position].element == element)
+        {
+            index->count--;
+            memmove(&index->entries[position], &index->entries[position + 1], (index->count - position) * sizeof(index_entry));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static size_t deliver_index_entries(const cJSONUtils_Index * const index, size_t start, const size_t end, const cJSONUtils_PathCallback callback, void * const context)
+{
+    size_t count = 0;
+
+    for (; start < end; start++)
+    {
+        count++;
+        if ((callback != NULL) && !callback(index->entries[start].element, context))
+        {
+            break;
+        }
+    }
+
+    return count;
+}
+
+CJSON_PUBLIC(size_t) cJSONUtils_IndexFind(const cJSONUtils_Index *index, const cJSON *value, cJSONUtils_PathCallback callback, void *context)
+{
+    path_value key;
+
+    if ((index == NULL) || (value == NULL))
+    {
+        return 0;
+    }
+    get_node_value(value, &key);
+    if (!is_indexed(&key))
+    {
+        return 0;
+    }
+
+    return deliver_index_entries(index, search_index(index, &key, false), search_index(index, &key, true), callback, context);
+}
+
+CJSON_PUBLIC(size_t) cJSONUtils_IndexRange(const cJSONUtils_Index *index, const cJSON *low, const cJSON *high, cJSONUtils_PathCallback callback, void *context)
+{
+    path_value low_key;
+    path_value high_key;
+    size_t start = 0;
+    size_t end = 0;
+
+    if ((index == NULL) || ((low == NULL) && (high == NULL)))
+    {
+        return 0;
+    }
+    if (((low != NULL) && !is_ordered(low)) || ((high != NULL) && !is_ordered(high)))
+    {
+        return 0;
+    }
+    if ((low != NULL) && (high != NULL) && ((low->type & 0xFF) != (high->type & 0xFF)))
+    {
+        return 0;
+    }
+    get_node_value(low, &low_key);
+    get_node_value(high, &high_key);
+
+    /* low <= key < high within the type of the bounds */
+    start = (low != NULL) ? search_index(index, &low_key, false) : search_index_type(index, high_key.type, false);
+    end = (high != NULL) ? search_index(index, &high_key, false) : search_index_type(index, low_key.type, true);
+    if (start >= end)
+    {
+        return 0;
+    }
+
+    return deliver_index_entries(index, start, end, callback, context);
+}
+
+/* JSON Patch implementation. */
+static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
+{
+    cJSON *first = list;
+    cJSON *second = list;
+    cJSON *current_item = list;
+    cJSON *result = list;
+    cJSON *result_tail = NULL;
+
+    if ((list == NULL) || (list->next == NULL))
+    {
+        /* One entry is sorted already. */
+        return result;
+    }
+
+    while ((current_item != NULL) && (current_item->next != NULL) && (compare_strings((unsigned char*)current_item->string, (unsigned char*)current_item->next->string, case_sensitive) < 0))
+    {
+        /* Test for list sorted. */
+        current_item = current_item->next;
+    }
+    if ((current_item == NULL) || (current_item->next == NULL))
+    {
+        /* Leave sorted lists unmodified. */
+        return result;
+    }
+
+    /* reset pointer to the beginning */
+    current_item = list;
+    while (current_item != NULL)
+    {
+        /* Walk two pointers to find the middle. */
+        second = second->next;
+        current_item = current_item->next;
+        /* advances current_item two steps at a time */
+        if (current_item != NULL)
+        {
+            current_item = current_item->next;
+        }
+    }
+    if ((second != NULL) && (second->prev != NULL))
+    {
+        /* Split the lists */
+        second->prev->next = NULL;
+        second->prev = NULL;
+    }
+
+    /* Recursively sort the sub-lists. */
+    first = sort_list(first, case_sensitive);
+    second = sort_list(second, case_sensitive);
+    result = NULL;
+
+    /* Merge the sub-lists */
+    while ((first != NULL) && (second != NULL))
+    {
+        cJSON *smaller = NULL;
+        /* take the first list on ties, so members with equal keys keep their order like in sort_entries */
+        if (compare_strings((unsigned char*)first->string, (unsigned char*)second->string, case_sensitive) <= 0)
+        {
+            smaller = first;
+        }
+        else
+        {
+            smaller = second;
+        }
+
+        if (result == NULL)
+        {
+            /* start merged list with the smaller element */
+            result_tail = smaller;
+            result = smaller;
+        }
+        else
+        {
+            /* add smaller element to the list */
+            result_tail->next = smaller;
+            smaller->prev = result_tail;
+            result_tail = smaller;
+        }
+
+        if (first == smaller)
+        {
+            first = first->next;
+        }
+        else
+        {
+            second = second->next;
+        }
+    }
+
+    if (first != NULL)
+    {
+        /* Append rest of first list. */
+        if (result == NULL)
+        {
+            return first;
+        }
+        result_tail->next = first;
+        first->prev = result_tail;
+    }
+    if (second != NULL)
+    {
+        /* Append rest of second list */
+        if (result == NULL)
+        {
+            return second;
+        }
+        result_tail->next = second;
+        second->prev = result_tail;
+    }
+
+    return result;
+}
+
+/* Array sort of object members. Every entry caches 8 bytes of its key (lowercased for case insensitive sorting) packed
+ * big endian, so most comparisons are one integer comparison without touching the key. Large arrays are radix sorted by
+ * the cached bytes, runs of keys that share them are sorted again by the next 8 bytes. */
+typedef struct
+{
+    cJSON *item;
+    unsigned long long prefix;
+} sort_entry;
+
+#define SORT_PREFIX_LENGTH sizeof(unsigned long long)
+/* runs of this many entries are sorted by insertion before merging */
+#define SORT_RUN_LENGTH 16
+/* arrays of at least this many entries are radix sorted, the others merge sorted */
+#define SORT_RADIX_MIN 64
+#define SORT_RADIX_SIZE (SORT_PREFIX_LENGTH * 256 * sizeof(size_t))
+/* keys that share this many bytes are merge sorted, which bounds the recursion */
+#define SORT_RADIX_DEPTH (4 * SORT_PREFIX_LENGTH)
+
+/* 8 bytes of key starting at offset, which is at most the length of the key */
+static unsigned long long key_prefix(const cJSON * const item, const size_t offset, const cJSON_bool case_sensitive)
+{
+    const unsigned char *key = (const unsigned char*)item->string;
+    unsigned long long prefix = 0;
+    size_t i = 0;
+
+    if (key == NULL)
+    {
+        return 0;
+    }
+    for (key += offset; i < SORT_PREFIX_LENGTH; i++)
+    {
+        prefix <<= 8;
+        if (*key != '\0')
+        {
+            prefix |= (unsigned long long)(case_sensitive ? *key : (unsigned char)tolower(*key));
+            key++;
+        }
+    }
+
+    return prefix;
+}
+
+/* same order as compare_strings for keys that are equal up to offset, the keys are only read if the prefixes are equal.
+ * Members without a key have the prefix of an empty key and are never equal to another member */
+static int compare_entries(const sort_entry * const a, const sort_entry * const b, const size_t offset, const cJSON_bool case_sensitive)
+{
+    const unsigned char *a_key = NULL;
+    const unsigned char *b_key = NULL;
+
+    if (a->prefix != b->prefix)
+    {
+        return (a->prefix < b->prefix) ? -1 : 1;
+    }
+    a_key = (const unsigned char*)a->item->string;
+    b_key = (const unsigned char*)b->item->string;
+    if ((a_key == NULL) || (b_key == NULL))
+    {
+        return 1;
+    }
+    /* the keys end within the prefix, the last byte of the prefix is only 0 if they do */
+    if ((a->prefix & 0xFF) == 0)
+    {
+        return 0;
+    }
+
+    return compare_strings(a_key + offset + SORT_PREFIX_LENGTH, b_key + offset + SORT_PREFIX_LENGTH, case_sensitive);
+}
+
+/* Stable bottom up merge sort of count entries, buffer has room for count entries as well */
+static void merge_sort_entries(sort_entry * const entries, sort_entry * const buffer, const size_t count, const size_t offset, const cJSON_bool case_sensitive)
+{
+    sort_entry *source = entries;
+    sort_entry *destination = buffer;
+    sort_entry *swap = NULL;
+    size_t width = SORT_RUN_LENGTH;
+    size_t start = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    for (start = 0; start < count; start += SORT_RUN_LENGTH)
+    {
+        size_t end = ((count - start) < SORT_RUN_LENGTH) ? count : (start + SORT_RUN_LENGTH);
+        for (i = start + 1; i < end; i++)
+        {
+            sort_entry entry = entries[i];
+            for (j = i; (j > start) && (compare_entries(&entries[j - 1], &entry, offset, case_sensitive) > 0); j--)
+            {
+                entries[j] = entries[j - 1];
+            }
+            entries[j] = entry;
+        }
+    }
+
+    for (; width < count; width *= 2)
+    {
+        for (start = 0; start < count; start += 2 * width)
+        {
+            size_t middle = ((count - start) < width) ? count : (start + width);
+            size_t end = ((count - middle) < width) ? count : (middle + width);
+            size_t k = start;
+
+            /* on equal keys the entry of the left run comes first. Which run to take from is computed without
+             * branching on the prefixes, which are as good as random */
+            for ((void)(i = start), j = middle; (i < middle) && (j < end); k++)
+            {
+                size_t take_right = source[j].prefix < source[i].prefix;
+                if (source[j].prefix == source[i].prefix)
+                {
+                    take_right = compare_entries(&source[i], &source[j], offset, case_sensitive) > 0;
+                }
+                destination[k] = source[take_right ? j : i];
+                j += take_right;
+                i += 1 - take_right;
+            }
+            memcpy(destination + k, source + i, (middle - i) * sizeof(sort_entry));
+            k += middle - i;
+            memcpy(destination + k, source + j, (end - j) * sizeof(sort_entry));
+        }
+        swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != entries)
+    {
+        memcpy(entries, source, count * sizeof(sort_entry));
+    }
+}
+
+/* Stable LSD radix sort of count entries by their prefixes, a byte at a time. Bytes that are the same in every prefix
+ * are skipped. counts has room for SORT_PREFIX_LENGTH histograms of 256 counts. */
+static void radix_sort_entries(sort_entry * const entries, sort_entry * const buffer, const size_t count, size_t (* const counts)[256])
+{
+    sort_entry *source = entries;
+    sort_entry *destination = buffer;
+    sort_entry *swap = NULL;
+    size_t byte = 0;
+    size_t i = 0;
+
+    memset(counts, '\0', SORT_RADIX_SIZE);
+    for (i = 0; i < count; i++)
+    {
+        for (byte = 0; byte < SORT_PREFIX_LENGTH; byte++)
+        {
+            counts[byte][(entries[i].prefix >> (8 * byte)) & 0xFF]++;
+        }
+    }
+
+    for (byte = 0; byte < SORT_PREFIX_LENGTH; byte++)
+    {
+        size_t offset = 0;
+        if (counts[byte][(source[0].prefix >> (8 * byte)) & 0xFF] == count)
+        {
+            continue;
+        }
+        /* turn the counts into the offsets of the buckets */
+        for (i = 0; i < 256; i++)
+        {
+            size_t bucket = counts[byte][i];
+            counts[byte][i] = offset;
+            offset += bucket;
+        }
+        for (i = 0; i < count; i++)
+        {
+            destination[counts[byte][(source[i].prefix >> (8 * byte)) & 0xFF]++] = source[i];
+        }
+        swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != entries)
+    {
+        memcpy(entries, source, count * sizeof(sort_entry));
+    }
+}
+
+/* Stable sort of count entries whose keys are equal up to offset, the prefixes are at offset 0 already. buffer has room for count entries and, for at least
+ * SORT_RADIX_MIN entries, SORT_RADIX_SIZE bytes of counts after them. */
+static void sort_entries(sort_entry * const entries, sort_entry * const buffer, const size_t count, const size_t offset, const cJSON_bool case_sensitive)
+{
+    size_t start = 0;
+    size_t end = 0;
+
+    for (start = 0; (offset > 0) && (start < count); start++)
+    {
+        entries[start].prefix = key_prefix(entries[start].item, offset, case_sensitive);
+    }
+
+    if ((count < SORT_RADIX_MIN) || (offset >= SORT_RADIX_DEPTH))
+    {
+        merge_sort_entries(entries, buffer, count, offset, case_sensitive);
+        return;
+    }
+
+    radix_sort_entries(entries, buffer, count, (size_t (*)[256])(void*)(buffer + count));
+    /* keys that are longer than the prefix and share it are in runs now, they are sorted by the bytes after it */
+    for (start = 0; start < count; start = end)
+    {
+        for (end = start + 1; (end < count) && (entries[end].prefix == entries[start].prefix); end++)
+        {
+        }
+        if (((end - start) > 1) && ((entries[start].prefix & 0xFF) != 0))
+        {
+            sort_entries(entries + start, buffer, end - start, offset + SORT_PREFIX_LENGTH, case_sensitive);
+        }
+    }
+}
+
+/* the members of object in sorted order, in the first *count of 2 * *count entries. NULL if out of memory */
+static sort_entry *get_sorted_entries(const cJSON * const object, const cJSON_bool case_sensitive, size_t * const count)
+{
+    sort_entry *entries = NULL;
+    cJSON *child = NULL;
+    size_t i = 0;
+
+    *count = 0;
+    for (child = object->child; child != NULL; child = child->next)
+    {
+        (*count)++;
+    }
+
+    entries = (sort_entry*)cJSON_malloc((2 * (*count) + 1) * sizeof(sort_entry) + ((*count >= SORT_RADIX_MIN) ? SORT_RADIX_SIZE : 0));
+    if (entries == NULL)
+    {
+        return NULL;
+    }
+    for ((void)(i = 0), child = object->child; child != NULL; (void)i++, child = child->next)
+    {
+        entries[i].item = child;
+        entries[i].prefix = key_prefix(child, 0, case_sensitive);
+    }
+    sort_entries(entries, entries + *count, *count, 0, case_sensitive);
+
+    return entries;
+}
+
+static void sort_object(cJSON * const object, const cJSON_bool case_sensitive)
+{
+    cJSON *child = NULL;
+    sort_entry *entries = NULL;
+    size_t count = 0;
+    size_t i = 0;
+
+    if (object == NULL)
+    {
+        return;
+    }
+    for (child = object->child; (child != NULL) && (child->next != NULL); child = child->next)
+    {
+        if (compare_strings((unsigned char*)child->string, (unsigned char*)child->next->string, case_sensitive) >= 0)
+        {
+            break;
+        }
+    }
+    if ((child == NULL) || (child->next == NULL))
+    {
+        /* sorted already */
+        return;
+    }
+
+    entries = get_sorted_entries(object, case_sensitive, &count);
+    if (entries == NULL)
+    {
+        /* out of memory, sort the list in place */
+        object->child = sort_list(object->child, case_sensitive);
+    }
+    else
+    {
+        /* relink the members in sorted order */
+        for (i = 0; i < count; i++)
+        {
+            entries[i].item->prev = (i > 0) ? entries[i - 1].item : NULL;
+            entries[i].item->next = ((i + 1) < count) ? entries[i + 1].item : NULL;
+        }
+        object->child = entries[0].item;
+        cJSON_free(entries);
+    }
+    /* the hash doesn't depend on the order of the members, but the printed text does */
+    cJSON_InvalidateHash(object);
+}
+
+static cJSON_bool compare_json(cJSON *a, cJSON *b, const cJSON_bool case_sensitive)
+{
+    if ((a == NULL) || (b == NULL) || ((a->type & 0xFF) != (b->type & 0xFF)))
+    {
+        /* mismatched type. */
+        return false;
+    }
+    if (case_sensitive)
+    {
+        /* keys are hashed case sensitive, so only then a different hash means a difference. Equal hashes may still differ,
+         * and 0 means the hash couldn't be computed */
+        unsigned long long a_hash = cJSON_GetHash(a);
+        unsigned long long b_hash = cJSON_GetHash(b);
+        if ((a_hash != 0) && (b_hash != 0) && (a_hash != b_hash))
+        {
+            return false;
+        }
+    }
+    switch (a->type & 0xFF)
+    {
+        case cJSON_Number:
+            /* numeric mismatch. */
+            if ((a->valueint != b->valueint) || (a->valuedouble != b->valuedouble))
+            {
+                return false;
+            }
+            else
+            {
+                return true;
+            }
+
+        case cJSON_String:
+            /* string mismatch. */
+            if (strcmp(a->valuestring, b->valuestring) != 0)
+            {
+                return false;
+            }
+            else
+            {
+                return true;
+            }
+
+        case cJSON_Array:
+            for ((void)(a = a->child), b = b->child; (a != NULL) && (b != NULL); (void)(a = a->next), b = b->next)
+            {
+                cJSON_bool identical = compare_json(a, b, case_sensitive);
+                if (!identical)
+                {
+                    return false;
+                }
+            }
+
+            /* array size mismatch? (one of both children is not NULL) */
+            if ((a != NULL) || (b != NULL))
+            {
+                return false;
+            }
+            else
+            {
+                return true;
+            }
+
+        case cJSON_Object:
+            sort_object(a, case_sensitive);
+            sort_object(b, case_sensitive);
+            for ((void)(a = a->child), b = b->child; (a != NULL) && (b != NULL); (void)(a = a->next), b = b->next)
+            {
+                cJSON_bool identical = false;
+                /* compare object keys */
+                if (compare_strings((unsigned char*)a->string, (unsigned char*)b->string, case_sensitive))
+                {
+                    /* missing member */
+                    return false;
+                }
+                identical = compare_json(a, b, case_sensitive);
+                if (!identical)
+                {
+                    return false;
+                }
+            }
+
+            /* object length mismatch (one of both children is not null) */
+            if ((a != NULL) || (b != NULL))
+            {
+                return false;
+            }
+            else
+            {
+                return true;
+            }
+
+        default:
+            break;
+    }
+
+    /* null, true or false */
+    return true;
+}
+
+/* non broken version of cJSON_InsertItemInArray */
+static cJSON_bool insert_item_in_array(cJSON *array, size_t which, cJSON *newitem)
+{
+    cJSON *child = array->child;
+    while (child && (which > 0))
+    {
+        child = child->next;
+        which--;
+    }
+    if (which > 0)
+    {
+        /* item is after the end of the array */
+        return 0;
+    }
+    if (child == NULL)
+    {
+        cJSON_AddItemToArray(array, newitem);
+        return 1;
+    }
+
+    /* insert into the linked list */
+    newitem->parent = array;
+    cJSON_InvalidateHash(array);
+    newitem->next = child;
+    newitem->prev = child->prev;
+    child->prev = newitem;
+
+    /* was it at the beginning */
+    if (child == array->child)
+    {
+        array->child = newitem;
+    }
+    else
+    {
+        newitem->prev->next = newitem;
+    }
+
+    return 1;
+}
+
+static cJSON *get_object_item(const cJSON * const object, const char* name, const cJSON_bool case_sensitive)
+{
+    if (case_sensitive)
+    {
+        return cJSON_GetObjectItemCaseSensitive(object, name);
+    }
+
+    return cJSON_GetObjectItem(object, name);
+}
+
+enum patch_operation { INVALID, ADD, REMOVE, REPLACE, MOVE, COPY, TEST };
+
+static enum patch_operation decode_patch_operation(const cJSON * const patch, const cJSON_bool case_sensitive)
+{
+    cJSON *operation = get_object_item(patch, "op", case_sensitive);
+    if (!cJSON_IsString(operation))
+    {
+        return INVALID;
+    }
+
+    if (strcmp(operation->valuestring, "add") == 0)
+    {
+        return ADD;
+    }
+
+    if (strcmp(operation->valuestring, "remove") == 0)
+    {
+        return REMOVE;
+    }
+
+    if (strcmp(operation->valuestring, "replace") == 0)
+    {
+        return REPLACE;
+    }
+
+    if (strcmp(operation->valuestring, "move") == 0)
+    {
+        return MOVE;
+    }
+
+    if (strcmp(operation->valuestring, "copy") == 0)
+    {
+        return COPY;
+    }
+
+    if (strcmp(operation->valuestring, "test") == 0)
+    {
+        return TEST;
+    }
+
+    return INVALID;
+}
+
+/* overwrite and existing item with another one and free resources on the way */
+static void overwrite_item(cJSON * const root, const cJSON replacement)
+{
+    cJSON *parent = NULL;
+    cJSON *child = NULL;
+    int kept_flags = 0;
+
+    if (root == NULL)
+    {
+        return;
+    }
+    cJSON_InvalidateHash(root);
+    parent = root->parent;
+    kept_flags = root->type & (cJSON_InBlock | cJSON_Watched);
+
+    if (!(root->type & cJSON_StringIsConst) && (root->string != NULL))
+    {
+        cJSON_free(root->string);
+    }
+    if (!(root->type & cJSON_IsReference) && (root->valuestring != NULL))
+    {
+        cJSON_free(root->valuestring);
+    }
+    if (root->child != NULL)
+    {
+        cJSON_Delete(root->child);
+    }
+
+    memcpy(root, &replacement, sizeof(cJSON));
+    /* the memory of the root itself doesn't change, and it is still watched */
+    root->type |= kept_flags;
+
+    /* root stays where it is, the children of the replacement move over to it */
+    root->parent = parent;
+    for (child = root->child; child != NULL; child = child->next)
+    {
+        child->parent = root;
+    }
+    root->hash = 0;
+    root->type &= ~cJSON_PrintCached;
+}
+
+/* number of resolved containers cJSONUtils_ApplyPatchesWithOpts remembers */
+#define PATCH_CACHE_SIZE 64
+
+typedef struct
+{
+    const unsigned char *pointer; /* the pointer prefix, points into a "path" or "from" of the patches and isn't copied */
+    size_t length;
+    cJSON *item;
+} patch_cache_entry;
+
+/* how to revert one change of an atomic cJSONUtils_ApplyPatchesWithOpts */
+enum undo_action { UNDO_REATTACH, UNDO_DETACH, UNDO_RESTORE_ROOT };
+
+typedef struct
+{
+    enum undo_action action;
+    /* UNDO_REATTACH: the detached item, UNDO_DETACH: the attached item, UNDO_RESTORE_ROOT: a copy of the old root */
+    cJSON *item;
+    /* UNDO_REATTACH: where the item was, in front of next (NULL if it was the last child) */
+    cJSON *parent;
+    cJSON *next;
+    /* UNDO_REATTACH: the item was removed or replaced and is deleted on success, otherwise it was moved */
+    cJSON_bool discarded;
+    /* UNDO_DETACH: the item was moved here and gets back its old key, otherwise it was created by the patch */
+    cJSON_bool moved;
+    /* UNDO_DETACH: the item got a new key, the old one is freed on success (moves into arrays keep the key) */
+    cJSON_bool key_replaced;
+    char *string;
+    int type;
+} patch_undo;
+
+typedef struct
+{
+    cJSON *object;
+    cJSON_bool case_sensitive;
+    /* containers resolved by earlier operations, direct mapped by the hash of their pointer */
+    patch_cache_entry cache[PATCH_CACHE_SIZE];
+    /* NULL unless the patches are applied atomically, every operation logs at most PATCH_UNDO_PER_OPERATION changes */
+    patch_undo *undo;
+    size_t undo_count;
+    /* object is a new document version, containers are unshared before they are changed */
+    cJSON_bool versioned;
+    cJSON_bool out_of_memory;
+} patch_context;
+
+/* "move" onto an existing member: the source, the old member and the new member */
+#define PATCH_UNDO_PER_OPERATION 3
+
+/* the children of container are about to change, forget everything that was resolved through it */
+static void invalidate_patch_cache(patch_context * const context, const cJSON * const container)
+{
+    size_t i = 0;
+
+    for (i = 0; i < PATCH_CACHE_SIZE; i++)
+    {
+        const cJSON *ancestor = NULL;
+        if (context->cache[i].item == NULL)
+        {
+            continue;
+        }
+        for (ancestor = context->cache[i].item->parent; ancestor != NULL; ancestor = ancestor->parent)
+        {
+            if (ancestor == container)
+            {
+                context->cache[i].item = NULL;
+                break;
+            }
+        }
+    }
+}
+
+/* object member named by a (still encoded) pointer token */
+static cJSON *get_member_by_token(const cJSON * const object, const unsigned char * const token, const cJSON_bool case_sensitive)
+{
+    cJSON *member = NULL;
+
+    for (member = object->child; member != NULL; member = member->next)
+    {
+        if (compare_pointers((const unsigned char*)member->string, token, case_sensitive))
+        {
+            return member;
+        }
+    }
+
+    return NULL;
+}
+
+/* Resolve the first length characters of pointer in a new document version, every container on the way
+ * gets its own children so the container that is found can be changed. */
+static cJSON *get_version_container(patch_context * const context, const unsigned char *pointer, const size_t length)
+{
+    const unsigned char * const end = pointer + length;
+    cJSON *current_element = context->object;
+
+    while (current_element != NULL)
+    {
+        if (!cJSON_Unshare(current_element))
+        {
+            context->out_of_memory = true;
+            return NULL;
+        }
+        if ((pointer >= end) || (pointer[0] != '/'))
+        {
+            break;
+        }
+        pointer++;
+        if (cJSON_IsArray(current_element))
+        {
+            size_t index = 0;
+            if (!decode_array_index_from_pointer(pointer, &index))
+            {
+                return NULL;
+            }
+            current_element = get_array_item(current_element, index);
+        }
+        else if (cJSON_IsObject(current_element))
+        {
+            current_element = get_member_by_token(current_element, pointer, context->case_sensitive);
+        }
+        else
+        {
+            return NULL;
+        }
+
+        /* skip to the next path token or end of string */
+        while ((pointer < end) && (pointer[0] != '/'))
+        {
+            pointer++;
+        }
+    }
+
+    return current_element;
+}
+
+/* Resolve the first length characters of pointer, containers are cached. In a new document version
+ * the container is only cached if it will be changed (writable), the others can still be shared. */
+static cJSON *get_cached_item(patch_context * const context, const unsigned char * const pointer, const size_t length, const cJSON_bool writable)
+{
+    patch_cache_entry *entry = NULL;
+    cJSON *item = NULL;
+
+    if (length == 0)
+    {
+        return context->object;
+    }
+
+    entry = &context->cache[hash_key(pointer, length) % PATCH_CACHE_SIZE];
+    if ((entry->item != NULL) && (entry->length == length) && (memcmp(entry->pointer, pointer, length) == 0))
+    {
+        return entry->item;
+    }
+
+    if (context->versioned)
+    {
+        if (!writable)
+        {
+            return get_item_from_pointer_range(context->object, (const char*)pointer, (const char*)pointer + length, context->case_sensitive);
+        }
+        item = get_version_container(context, pointer, length);
+    }
+    else
+    {
+        item = get_item_from_pointer_range(context->object, (const char*)pointer, (const char*)pointer + length, context->case_sensitive);
+    }
+    if (cJSON_IsArray(item) || cJSON_IsObject(item))
+    {
+        entry->pointer = pointer;
+        entry->length = length;
+        entry->item = item;
+    }
+
+    return item;
+}
+
+/* Split pointer into its parent and last token, the parent is resolved through the cache.
+ * Returns false if the pointer has no parent. */
+static cJSON_bool get_pointer_parent(patch_context * const context, const unsigned char * const pointer, cJSON ** const parent, const unsigned char ** const token, const cJSON_bool writable)
+{
+    const unsigned char *last_slash = (const unsigned char*)strrchr((const char*)pointer, '/');
+
+    if (last_slash == NULL)
+    {
+        return false;
+    }
+
+    *parent = get_cached_item(context, pointer, (size_t)(last_slash - pointer), writable);
+    *token = last_slash + 1;
+
+    return true;
+}
+
+/* the item at pointer, NULL if it doesn't exist */
+static cJSON *get_patch_item(patch_context * const context, const unsigned char * const pointer)
+{
+    cJSON *parent = NULL;
+    const unsigned char *token = NULL;
+
+    if (!get_pointer_parent(context, pointer, &parent, &token, false))
+    {
+        return get_item_from_pointer(context->object, (const char*)pointer, context->case_sensitive);
+    }
+
+    if (cJSON_IsArray(parent))
+    {
+        size_t index = 0;
+        if (!decode_array_index_from_pointer(token, &index))
+        {
+            return NULL;
+        }
+        return get_array_item(parent, index);
+    }
+    if (cJSON_IsObject(parent))
+    {
+        return get_member_by_token(parent, token, context->case_sensitive);
+    }
+
+    return NULL;
+}
+
+/* append an entry to the undo log, there is always room for it (see cJSONUtils_ApplyPatchesWithOpts) */
+static patch_undo *push_undo(patch_context * const context, const enum undo_action action, cJSON * const item)
+{
+    patch_undo *undo = &context->undo[context->undo_count++];
+
+    memset(undo, '\0', sizeof(patch_undo));
+    undo->action = action;
+    undo->item = item;
+
+    return undo;
+}
+
+/* Detach item from parent. Atomic patches remember where it was, discarded tells whether
+ * the item is deleted afterwards or attached somewhere else. */
+static cJSON *detach_logged(patch_context * const context, cJSON * const parent, cJSON * const item, const cJSON_bool discarded)
+{
+    invalidate_patch_cache(context, parent);
+    if (context->undo != NULL)
+    {
+        patch_undo *undo = push_undo(context, UNDO_REATTACH, item);
+        undo->parent = parent;
+        undo->next = item->next;
+        undo->discarded = discarded;
+    }
+
+    return cJSON_DetachItemViaPointer(parent, item);
+}
+
+/* delete a detached item, atomic patches keep it until all operations succeeded */
+static void discard_item(const patch_context * const context, cJSON * const item)
+{
+    if (context->undo == NULL)
+    {
+        cJSON_Delete(item);
+    }
+}
+
+/* detach the item at pointer, NULL if it doesn't exist */
+static cJSON *detach_patch_item(patch_context * const context, const unsigned char * const pointer, const cJSON_bool discarded)
+{
+    cJSON *parent = NULL;
+    cJSON *item = NULL;
+    const unsigned char *token = NULL;
+
+    if (!get_pointer_parent(context, pointer, &parent, &token, true))
+    {
+        return NULL;
+    }
+
+    if (cJSON_IsArray(parent))
+    {
+        size_t index = 0;
+        if (!decode_array_index_from_pointer(token, &index))
+        {
+            return NULL;
+        }
+        item = get_array_item(parent, index);
+    }
+    else if (cJSON_IsObject(parent))
+    {
+        item = get_member_by_token(parent, token, context->case_sensitive);
+    }
+    if (item == NULL)
+    {
+        return NULL;
+    }
+
+    return detach_logged(context, parent, item, discarded);
+}
+
+/* log that item was attached by the patch, a moved item gets back its old key on rollback */
+static void log_attached(patch_context * const context, cJSON * const item, const cJSON_bool moved, char * const string, const int type)
+{
+    patch_undo *undo = NULL;
+
+    if (context->undo == NULL)
+    {
+        return;
+    }
+
+    undo = push_undo(context, UNDO_DETACH, item);
+    undo->moved = moved;
+    undo->key_replaced = item->string != string;
+    undo->string = string;
+    undo->type = type;
+}
+
+/* put item back in front of next, or at the end of parent if next is NULL */
+static void reattach_item(cJSON * const parent, cJSON * const item, cJSON * const next)
+{
+    if (next == NULL)
+    {
+        cJSON_AddItemToArray(parent, item);
+        return;
+    }
+
+    item->parent = parent;
+    item->next = next;
+    item->prev = next->prev;
+    next->prev = item;
+    if (next == parent->child)
+    {
+        parent->child = item;
+    }
+    else
+    {
+        item->prev->next = item;
+    }
+    cJSON_InvalidateHash(parent);
+}
+
+/* the contents of the root are replaced, atomic patches keep the old contents in a new item */
+static cJSON_bool replace_root(patch_context * const context, const cJSON replacement)
+{
+    cJSON *object = context->object;
+    const cJSON saved_position = *object;
+    cJSON *saved = NULL;
+    cJSON *child = NULL;
+
+    memset(context->cache, '\0', sizeof(context->cache));
+    if (context->undo == NULL)
+    {
+        overwrite_item(object, replacement);
+        return true;
+    }
+    cJSON_InvalidateHash(object);
+
+    saved = cJSON_CreateNull();
+    if (saved == NULL)
+    {
+        return false;
+    }
+    memcpy(saved, object, sizeof(cJSON));
+    saved->next = NULL;
+    saved->prev = NULL;
+    saved->parent = NULL;
+    saved->type &= ~(cJSON_InBlock | cJSON_Watched);
+
+    /* the root keeps its place, only its contents change */
+    memcpy(object, &replacement, sizeof(cJSON));
+    object->type |= saved_position.type & (cJSON_InBlock | cJSON_Watched);
+    object->next = saved_position.next;
+    object->prev = saved_position.prev;
+    object->parent = saved_position.parent;
+    for (child = object->child; child != NULL; child = child->next)
+    {
+        child->parent = object;
+    }
+    object->hash = 0;
+    object->type &= ~cJSON_PrintCached;
+
+    push_undo(context, UNDO_RESTORE_ROOT, saved);
+
+    return true;
+}
+
+/* Decode the escapes of a pointer token into buffer, or into new memory if it is too long.
+ * Returns NULL if out of memory. */
+static unsigned char *decode_pointer_token(const unsigned char *token, unsigned char * const buffer, const size_t buffer_size)
+{
+    size_t length = strlen((const char*)token);
+    unsigned char *decoded = buffer;
+    unsigned char *destination = NULL;
+
+    if (length >= buffer_size)
+    {
+        decoded = (unsigned char*)cJSON_malloc(length + sizeof(""));
+        if (decoded == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    for (destination = decoded; *token != '\0'; (void)token++, destination++)
+    {
+        if ((token[0] == '~') && (token[1] == '0'))
+        {
+            *destination = '~';
+            token++;
+        }
+        else if ((token[0] == '~') && (token[1] == '1'))
+        {
+            *destination = '/';
+            token++;
+        }
+        else
+        {
+            *destination = *token;
+        }
+    }
+    *destination = '\0';
+
+    return decoded;
+}
+
+/* restore the contents of the root that replace_root saved */
+static void restore_root(cJSON * const object, cJSON * const saved)
+{
+    const cJSON position = *object;
+
+    cJSON_InvalidateHash(object);
+    if (!(object->type & cJSON_StringIsConst) && (object->string != NULL))
+    {
+        cJSON_free(object->string);
+    }
+    if (!(object->type & cJSON_IsReference) && (object->valuestring != NULL))
+    {
+        cJSON_free(object->valuestring);
+    }
+    if (object->child != NULL)
+    {
+        cJSON_Delete(object->child);
+    }
+
+    /* the children of saved still point to object */
+    memcpy(object, saved, sizeof(cJSON));
+    object->type |= position.type & (cJSON_InBlock | cJSON_Watched);
+    object->next = position.next;
+    object->prev = position.prev;
+    object->parent = position.parent;
+    cJSON_free(saved);
+}
+
+/* revert the logged changes from the last to the first */
+static void rollback_patches(patch_context * const context)
+{
+    while (context->undo_count > 0)
+    {
+        patch_undo *undo = &context->undo[--context->undo_count];
+        cJSON *item = undo->item;
+
+        switch (undo->action)
+        {
+            case UNDO_REATTACH:
+                reattach_item(undo->parent, item, undo->next);
+                break;
+
+            case UNDO_DETACH:
+                cJSON_DetachItemViaPointer(item->parent, item);
+                if (!undo->moved)
+                {
+                    cJSON_Delete(item);
+                    break;
+                }
+                if (item->string != undo->string)
+                {
+                    if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
+                    {
+                        cJSON_free(item->string);
+                    }
+                    item->string = undo->string;
+                }
+                item->type = undo->type;
+                break;
+
+            case UNDO_RESTORE_ROOT:
+                restore_root(context->object, item);
+                break;
+        }
+    }
+}
+
+/* all operations succeeded, release what the undo log kept alive. Items are only ever freed by entries
+ * after the ones that refer to them, so the log is walked from the first entry to the last. */
+static void commit_patches(patch_context * const context)
+{
+    size_t i = 0;
+
+    for (i = 0; i < context->undo_count; i++)
+    {
+        patch_undo *undo = &context->undo[i];
+
+        switch (undo->action)
+        {
+            case UNDO_REATTACH:
+                if (undo->discarded)
+                {
+                    cJSON_Delete(undo->item);
+                }
+                break;
+
+            case UNDO_DETACH:
+                /* the old key of a moved item */
+                if (undo->moved && undo->key_replaced && (undo->string != NULL) && !(undo->type & cJSON_StringIsConst))
+                {
+                    cJSON_free(undo->string);
+                }
+                break;
+
+            case UNDO_RESTORE_ROOT:
+                cJSON_Delete(undo->item);
+                break;
+        }
+    }
+    context->undo_count = 0;
+}
+
+/* copy for "copy" in a new document version: containers of the new version are copied, everything else is shared */
+static cJSON *copy_version_item(const patch_context * const context, const cJSON * const item)
+{
+    const cJSON *ancestor = NULL;
+    const cJSON *child = NULL;
+    cJSON *copy = NULL;
+    cJSON *tail = NULL;
+
+    for (ancestor = item; (ancestor != NULL) && (ancestor != context->object); ancestor = ancestor->parent)
+    {
+    }
+    if ((ancestor == NULL) || (item->type & cJSON_IsReference) || !(cJSON_IsArray(item) || cJSON_IsObject(item)))
+    {
+        /* part of another version (or a scalar) */
+        return cJSON_CreateSharedReference(item);
+    }
+
+    copy = cJSON_Duplicate(item, false);
+    for (child = item->child; (copy != NULL) && (child != NULL); child = child->next)
+    {
+        cJSON *child_copy = copy_version_item(context, child);
+        if (child_copy == NULL)
+        {
+            cJSON_Delete(copy);
+            return NULL;
+        }
+        child_copy->parent = copy;
+        if (tail == NULL)
+        {
+            copy->child = child_copy;
+        }
+        else
         {
-            /* add smaller element to the list */
-            result_tail->next = smaller;
-            smaller->prev = result_tail;
-            result_tail = smaller;
+            tail->next = child_copy;
+            child_copy->prev = tail;
         }
+        tail = child_copy;
+    }
 
-        if (first == smaller)
+    return copy;
+}
+
+static int apply_patch(patch_context * const context, const cJSON *patch)
+{
+    const cJSON_bool case_sensitive = context->case_sensitive;
+    cJSON *object = context->object;
+    cJSON *path = NULL;
+    cJSON *value = NULL;
+    cJSON *parent = NULL;
+    enum patch_operation opcode = INVALID;
+    const unsigned char *child_pointer = NULL;
+    unsigned char key_buffer[128];
+    unsigned char *key = NULL;
+    /* key and type of a moved item before it was attached at "path" */
+    char *moved_string = NULL;
+    int moved_type = 0;
+    int status = 0;
+
+    path = get_object_item(patch, "path", case_sensitive);
+    if (!cJSON_IsString(path))
+    {
+        /* malformed patch. */
+        status = 2;
+        goto cleanup;
+    }
+
+    opcode = decode_patch_operation(patch, case_sensitive);
+    if (opcode == INVALID)
+    {
+        status = 3;
+        goto cleanup;
+    }
+    else if (opcode == TEST)
+    {
+        /* compare value: {...} with the given path */
+        cJSON *item = get_patch_item(context, (unsigned char*)path->valuestring);
+        if ((context->undo != NULL) || context->versioned)
         {
-            first = first->next;
+            /* compare_json sorts objects, a rollback has to find the members in their old order
+             * and the objects of other versions must not change */
+            status = !cJSON_Compare(item, get_object_item(patch, "value", case_sensitive), case_sensitive);
         }
         else
         {
-            second = second->next;
+            status = !compare_json(item, get_object_item(patch, "value", case_sensitive), case_sensitive);
         }
+        goto cleanup;
     }
 
-    if (first != NULL)
+    /* special case for replacing the root */
+    if (path->valuestring[0] == '\0')
     {
-        /* Append rest of first list. */
-        if (result == NULL)
+        if (opcode == REMOVE)
         {
-            return first;
+            static const cJSON invalid = { NULL, NULL, NULL, cJSON_Invalid, NULL, 0, 0, NULL, NULL, 0, 0 };
+
+            if (!replace_root(context, invalid))
+            {
+                /* out of memory for the undo log. */
+                status = 14;
+                goto cleanup;
+            }
+
+            status = 0;
+            goto cleanup;
+        }
+
+        if ((opcode == REPLACE) || (opcode == ADD))
+        {
+            value = get_object_item(patch, "value", case_sensitive);
+            if (value == NULL)
+            {
+                /* missing "value" for add/replace. */
+                status = 7;
+                goto cleanup;
+            }
+
+            value = cJSON_Duplicate(value, 1);
+            if (value == NULL)
+            {
+                /* out of memory for add/replace. */
+                status = 8;
+                goto cleanup;
+            }
+
+            if (!replace_root(context, *value))
+            {
+                /* out of memory for the undo log. */
+                status = 14;
+                goto cleanup;
+            }
+
+            /* delete the duplicated value */
+            cJSON_free(value);
+            value = NULL;
+
+            /* the string "value" isn't needed */
+            if (object->string != NULL)
+            {
+                cJSON_free(object->string);
+                object->string = NULL;
+            }
+
+            status = 0;
+            goto cleanup;
+        }
+    }
+
+    if ((opcode == REMOVE) || (opcode == REPLACE))
+    {
+        /* Get rid of old. */
+        cJSON *old_item = detach_patch_item(context, (unsigned char*)path->valuestring, true);
+        if (old_item == NULL)
+        {
+            status = 13;
+            goto cleanup;
+        }
+        discard_item(context, old_item);
+        if (opcode == REMOVE)
+        {
+            /* For Remove, this job is done. */
+            status = 0;
+            goto cleanup;
+        }
+    }
+
+    /* Copy/Move uses "from". */
+    if ((opcode == MOVE) || (opcode == COPY))
+    {
+        cJSON *from = get_object_item(patch, "from", case_sensitive);
+        if (!cJSON_IsString(from))
+        {
+            /* missing "from" for copy/move. */
+            status = 4;
+            goto cleanup;
+        }
+
+        if (opcode == MOVE)
+        {
+            value = detach_patch_item(context, (unsigned char*)from->valuestring, false);
+            if (value != NULL)
+            {
+                moved_string = value->string;
+                moved_type = value->type;
+            }
+        }
+        if (opcode == COPY)
+        {
+            value = get_patch_item(context, (unsigned char*)from->valuestring);
+        }
+        if (value == NULL)
+        {
+            /* missing "from" for copy/move. */
+            status = 5;
+            goto cleanup;
+        }
+        if ((opcode == COPY) && context->versioned)
+        {
+            value = copy_version_item(context, value);
+        }
+        else if (opcode == COPY)
+        {
+            value = cJSON_Duplicate(value, 1);
+        }
+        if (value == NULL)
+        {
+            /* out of memory for copy/move. */
+            status = 6;
+            goto cleanup;
+        }
+    }
+    else /* Add/Replace uses "value". */
+    {
+        value = get_object_item(patch, "value", case_sensitive);
+        if (value == NULL)
+        {
+            /* missing "value" for add/replace. */
+            status = 7;
+            goto cleanup;
+        }
+        value = cJSON_Duplicate(value, 1);
+        if (value == NULL)
+        {
+            /* out of memory for add/replace. */
+            status = 8;
+            goto cleanup;
+        }
+    }
+
+    /* Now, just add "value" to "path". */
+    if (!get_pointer_parent(context, (unsigned char*)path->valuestring, &parent, &child_pointer, true) || (parent == NULL))
+    {
+        /* Couldn't find object to add to. */
+        status = 9;
+        goto cleanup;
+    }
+    else if (cJSON_IsArray(parent))
+    {
+        invalidate_patch_cache(context, parent);
+        if (strcmp((const char*)child_pointer, "-") == 0)
+        {
+            cJSON_AddItemToArray(parent, value);
+        }
+        else
+        {
+            size_t index = 0;
+            if (!decode_array_index_from_pointer(child_pointer, &index))
+            {
+                status = 11;
+                goto cleanup;
+            }
+
+            if (!insert_item_in_array(parent, index, value))
+            {
+                status = 10;
+                goto cleanup;
+            }
+        }
+    }
+    else if (cJSON_IsObject(parent))
+    {
+        cJSON *old_item = get_member_by_token(parent, child_pointer, case_sensitive);
+
+        key = decode_pointer_token(child_pointer, key_buffer, sizeof(key_buffer));
+        if (key == NULL)
+        {
+            /* out of memory for add/replace. */
+            status = 8;
+            goto cleanup;
+        }
+
+        if (old_item != NULL)
+        {
+            discard_item(context, detach_logged(context, parent, old_item, true));
+        }
+        invalidate_patch_cache(context, parent);
+        if ((opcode == MOVE) && (context->undo != NULL))
+        {
+            /* keep the old key for a rollback */
+            value->string = NULL;
+        }
+        cJSON_AddItemToObject(parent, (char*)key, value);
+        if (value->parent != parent)
+        {
+            /* out of memory for the key. */
+            if ((opcode == MOVE) && (context->undo != NULL))
+            {
+                value->string = moved_string;
+            }
+            status = 8;
+            goto cleanup;
+        }
+    }
+    else /* parent is not an object */
+    {
+        /* Couldn't find object to add to. */
+        status = 9;
+        goto cleanup;
+    }
+
+    log_attached(context, value, opcode == MOVE, moved_string, moved_type);
+    value = NULL;
+
+cleanup:
+    /* a moved item that couldn't be added is put back by the rollback of atomic patches */
+    if ((value != NULL) && !((opcode == MOVE) && (context->undo != NULL)))
+    {
+        cJSON_Delete(value);
+    }
+    if ((key != NULL) && (key != key_buffer))
+    {
+        cJSON_free(key);
+    }
+
+    return status;
+}
+
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatches(cJSON * const object, const cJSON * const patches)
+{
+    return cJSONUtils_ApplyPatchesWithOpts(object, patches, 0);
+}
+
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesCaseSensitive(cJSON * const object, const cJSON * const patches)
+{
+    return cJSONUtils_ApplyPatchesWithOpts(object, patches, cJSONUtils_PatchCaseSensitive);
+}
+
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesWithOpts(cJSON * const object, const cJSON * const patches, int flags)
+{
+    patch_context context;
+    const cJSON *current_patch = NULL;
+    int status = 0;
+
+    if (!cJSON_IsArray(patches))
+    {
+        /* malformed patches. */
+        return 1;
+    }
+
+    memset(&context, '\0', sizeof(context));
+    context.object = object;
+    context.case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+
+    if ((flags & cJSONUtils_PatchAtomic) && (patches->child != NULL))
+    {
+        size_t operations = 0;
+        for (current_patch = patches->child; current_patch != NULL; current_patch = current_patch->next)
+        {
+            operations++;
+        }
+
+        /* the whole log is allocated up front, so logging a change can't fail halfway through an operation */
+        context.undo = (patch_undo*)cJSON_malloc(operations * PATCH_UNDO_PER_OPERATION * sizeof(patch_undo));
+        if (context.undo == NULL)
+        {
+            /* out of memory for the undo log. */
+            return 14;
+        }
+    }
+
+    for (current_patch = patches->child; current_patch != NULL; current_patch = current_patch->next)
+    {
+        status = apply_patch(&context, current_patch);
+        if (status != 0)
+        {
+            break;
         }
-        result_tail->next = first;
-        first->prev = result_tail;
     }
-    if (second != NULL)
+
+    if (context.undo != NULL)
     {
-        /* Append rest of second list */
-        if (result == NULL)
+        if (status != 0)
         {
-            return second;
+            rollback_patches(&context);
         }
-        result_tail->next = second;
-        second->prev = result_tail;
+        else
+        {
+            commit_patches(&context);
+        }
+        cJSON_free(context.undo);
     }
 
-    return result;
+    return status;
 }
 
-static void sort_object(cJSON * const object, const cJSON_bool case_sensitive)
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesToVersion(cJSON * const version, const cJSON * const patches, int flags, cJSON ** const result)
 {
-    if (object == NULL)
-    {
-        return;
-    }
-    object->child = sort_list(object->child, case_sensitive);
-}
+    patch_context context;
+    const cJSON *current_patch = NULL;
+    int status = 0;
 
-static cJSON_bool compare_json(cJSON *a, cJSON *b, const cJSON_bool case_sensitive)
-{
-    if ((a == NULL) || (b == NULL) || ((a->type & 0xFF) != (b->type & 0xFF)))
+    if (result == NULL)
     {
-        /* mismatched type. */
-        return false;
+        return 1;
     }
-    switch (a->type & 0xFF)
+    *result = NULL;
+    if (!cJSON_IsArray(patches))
     {
-        case cJSON_Number:
-            /* numeric mismatch. */
-            if ((a->valueint != b->valueint) || (a->valuedouble != b->valuedouble))
-            {
-                return false;
-            }
-            else
-            {
-                return true;
-            }
-
-        case cJSON_String:
-            /* string mismatch. */
-            if (strcmp(a->valuestring, b->valuestring) != 0)
-            {
-                return false;
-            }
-            else
-            {
-                return true;
-            }
-
-        case cJSON_Array:
-            for ((void)(a = a->child), b = b->child; (a != NULL) && (b != NULL); (void)(a = a->next), b = b->next)
-            {
-                cJSON_bool identical = compare_json(a, b, case_sensitive);
-                if (!identical)
-                {
-                    return false;
-                }
-            }
-
-            /* array size mismatch? (one of both children is not NULL) */
-            if ((a != NULL) || (b != NULL))
-            {
-                return false;
-            }
-            else
-            {
-                return true;
-            }
-
-        case cJSON_Object:
-            sort_object(a, case_sensitive);
-            sort_object(b, case_sensitive);
-            for ((void)(a = a->child), b = b->child; (a != NULL) && (b != NULL); (void)(a = a->next), b = b->next)
-            {
-                cJSON_bool identical = false;
-                /* compare object keys */
-                if (compare_strings((unsigned char*)a->string, (unsigned char*)b->string, case_sensitive))
-                {
-                    /* missing member */
-                    return false;
-                }
-                identical = compare_json(a, b, case_sensitive);
-                if (!identical)
-                {
-                    return false;
-                }
-            }
+        /* malformed patches. */
+        return 1;
+    }
 
-            /* object length mismatch (one of both children is not null) */
-            if ((a != NULL) || (b != NULL))
-            {
-                return false;
-            }
-            else
-            {
-                return true;
-            }
+    memset(&context, '\0', sizeof(context));
+    context.case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+    context.versioned = true;
+    /* the new root shares the children of the old one, they are unshared on the paths that are changed */
+    context.object = cJSON_CreateSharedReference(version);
+    if ((context.object == NULL) || !cJSON_Unshare(context.object))
+    {
+        cJSON_Delete(context.object);
+        /* out of memory for the new version. */
+        return 15;
+    }
 
-        default:
-            break;
+    for (current_patch = patches->child; current_patch != NULL; current_patch = current_patch->next)
+    {
+        status = apply_patch(&context, current_patch);
+        if (context.out_of_memory)
+        {
+            status = 15;
+        }
+        if (status != 0)
+        {
+            /* the old version was never changed */
+            cJSON_Delete(context.object);
+            return status;
+        }
     }
 
-    /* null, true or false */
-    return true;
+    *result = context.object;
+
+    return 0;
 }
 
-/* non broken version of cJSON_InsertItemInArray */
-static cJSON_bool insert_item_in_array(cJSON *array, size_t which, cJSON *newitem)
+static void compose_patch(cJSON * const patches, const unsigned char * const operation, const unsigned char * const path, const unsigned char *suffix, const cJSON * const value)
 {
-    cJSON *child = array->child;
-    while (child && (which > 0))
+    cJSON *patch = NULL;
+
+    if ((patches == NULL) || (operation == NULL) || (path == NULL))
     {
-        child = child->next;
-        which--;
+        return;
     }
-    if (which > 0)
+
+    patch = cJSON_CreateObject();
+    if (patch == NULL)
     {
-        /* item is after the end of the array */
-        return 0;
+        return;
     }
-    if (child == NULL)
+    cJSON_AddItemToObject(patch, "op", cJSON_CreateString((const char*)operation));
+
+    if (suffix == NULL)
     {
-        cJSON_AddItemToArray(array, newitem);
-        return 1;
+        cJSON_AddItemToObject(patch, "path", cJSON_CreateString((const char*)path));
     }
+    else
+    {
+        size_t suffix_length = pointer_encoded_length(suffix);
+        size_t path_length = strlen((const char*)path);
+        unsigned char *full_path = (unsigned char*)cJSON_malloc(path_length + suffix_length + sizeof("/"));
 
-    /* insert into the linked list */
-    newitem->next = child;
-    newitem->prev = child->prev;
-    child->prev = newitem;
+        sprintf((char*)full_path, "%s/", (const char*)path);
+        encode_string_as_pointer(full_path + path_length + 1, suffix);
 
-    /* was it at the beginning */
-    if (child == array->child)
-    {
-        array->child = newitem;
+        cJSON_AddItemToObject(patch, "path", cJSON_CreateString((const char*)full_path));
+        cJSON_free(full_path);
     }
-    else
+
+    if (value != NULL)
     {
-        newitem->prev->next = newitem;
+        cJSON_AddItemToObject(patch, "value", cJSON_Duplicate(value, 1));
     }
+    cJSON_AddItemToArray(patches, patch);
+}
 
-    return 1;
+CJSON_PUBLIC(void) cJSONUtils_AddPatchToArray(cJSON * const array, const char * const operation, const char * const path, const cJSON * const value)
+{
+    compose_patch(array, (const unsigned char*)operation, (const unsigned char*)path, NULL, value);
 }
 
-static cJSON *get_object_item(const cJSON * const object, const char* name, const cJSON_bool case_sensitive)
+/* hash of item, only cached in the items if the inputs may be modified */
+static unsigned long long get_hash(cJSON * const item, const int flags)
 {
-    if (case_sensitive)
+    if (flags & cJSONUtils_PatchPreserveInput)
     {
-        return cJSON_GetObjectItemCaseSensitive(object, name);
+        return cJSON_ComputeHash(item);
     }
 
-    return cJSON_GetObjectItem(object, name);
+    return cJSON_GetHash(item);
 }
 
-enum patch_operation { INVALID, ADD, REMOVE, REPLACE, MOVE, COPY, TEST };
-
-static enum patch_operation decode_patch_operation(const cJSON * const patch, const cJSON_bool case_sensitive)
+/* compare two items, without modifying them if the inputs have to be preserved */
+static cJSON_bool items_equal(cJSON * const a, cJSON * const b, const int flags)
 {
-    cJSON *operation = get_object_item(patch, "op", case_sensitive);
-    if (!cJSON_IsString(operation))
+    const cJSON_bool case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+
+    if (flags & cJSONUtils_PatchPreserveInput)
     {
-        return INVALID;
+        return cJSON_Compare(a, b, case_sensitive);
     }
 
-    if (strcmp(operation->valuestring, "add") == 0)
+    return compare_json(a, b, case_sensitive);
+}
+
+/* The members of an object ordered by key. Unless the inputs have to be preserved the object is sorted in place,
+ * otherwise a sorted view is built next to it. *count is set to the number of members, returns NULL if out of memory. */
+static cJSON **get_sorted_members(cJSON * const object, const int flags, size_t * const count)
+{
+    const cJSON_bool case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+    sort_entry *entries = NULL;
+    cJSON **view = NULL;
+    cJSON *child = NULL;
+    size_t i = 0;
+
+    if (flags & cJSONUtils_PatchPreserveInput)
     {
-        return ADD;
+        entries = get_sorted_entries(object, case_sensitive, count);
+        if (entries == NULL)
+        {
+            return NULL;
+        }
     }
-
-    if (strcmp(operation->valuestring, "remove") == 0)
+    else
     {
-        return REMOVE;
+        sort_object(object, case_sensitive);
+        *count = 0;
+        for (child = object->child; child != NULL; child = child->next)
+        {
+            (*count)++;
+        }
     }
 
-    if (strcmp(operation->valuestring, "replace") == 0)
+    view = (cJSON**)cJSON_malloc((*count + 1) * sizeof(cJSON*));
+    if (view == NULL)
     {
-        return REPLACE;
+        cJSON_free(entries);
+        return NULL;
     }
 
-    if (strcmp(operation->valuestring, "move") == 0)
+    for ((void)(i = 0), child = object->child; child != NULL; (void)i++, child = child->next)
     {
-        return MOVE;
+        view[i] = (entries != NULL) ? entries[i].item : child;
     }
+    view[*count] = NULL;
+    cJSON_free(entries);
 
-    if (strcmp(operation->valuestring, "copy") == 0)
+    return view;
+}
+
+static void compose_move_patch(cJSON * const patches, const unsigned char * const path, const size_t from, const size_t to)
+{
+    cJSON *patch = NULL;
+    size_t path_length = strlen((const char*)path);
+    unsigned char *pointer = NULL;
+
+    if (from == to)
     {
-        return COPY;
+        /* nothing to do */
+        return;
     }
 
-    if (strcmp(operation->valuestring, "test") == 0)
+    pointer = (unsigned char*)cJSON_malloc(path_length + 20 + sizeof("/")); /* Allow space for 64bit int. log10(2^64) = 20 */
+    patch = cJSON_CreateObject();
+    if ((pointer == NULL) || (patch == NULL))
     {
-        return TEST;
+        cJSON_free(pointer);
+        cJSON_Delete(patch);
+        return;
     }
 
-    return INVALID;
+    cJSON_AddItemToObject(patch, "op", cJSON_CreateString("move"));
+    sprintf((char*)pointer, "%s/%lu", path, (unsigned long)from);
+    cJSON_AddItemToObject(patch, "from", cJSON_CreateString((const char*)pointer));
+    sprintf((char*)pointer, "%s/%lu", path, (unsigned long)to);
+    cJSON_AddItemToObject(patch, "path", cJSON_CreateString((const char*)pointer));
+    cJSON_AddItemToArray(patches, patch);
+
+    cJSON_free(pointer);
 }
 
-/* overwrite and existing item with another one and free resources on the way */
-static void overwrite_item(cJSON * const root, const cJSON replacement)
+#ifndef CJSON_ARRAY_DIFF_LIMIT
+/* maximum number of inserted plus removed elements the array diff looks for before falling back to the positional diff */
+#define CJSON_ARRAY_DIFF_LIMIT 1024
+#endif
+
+/* edit script operations */
+#define DIFF_KEEP 'k'
+#define DIFF_DELETE 'd'
+#define DIFF_INSERT 'i'
+
+/* what happens to a removed element of 'from' or an inserted element of 'to' */
+#define ELEMENT_PLAIN 0 /* plain remove or add */
+#define ELEMENT_MOVE 1 /* moved, partner is the element on the other side */
+#define ELEMENT_SUBSTITUTE 2 /* 'from' element is patched into the 'to' element, partner is the element on the other side */
+
+typedef struct
 {
-    if (root == NULL)
+    cJSON **from;
+    cJSON **to;
+    unsigned long long *from_hashes;
+    unsigned long long *to_hashes;
+    size_t from_count;
+    size_t to_count;
+    /* the edit script */
+    unsigned char *script;
+    size_t script_length;
+    /* pairing of removed and inserted elements */
+    unsigned char *from_kind;
+    unsigned char *to_kind;
+    size_t *from_partner;
+    size_t *to_partner;
+    /* bookkeeping while emitting the patches */
+    cJSON_bool *taken; /* 'from' element was already moved away */
+    size_t *pending; /* 'from' elements waiting to be moved to a later position, in the part that is already done */
+    size_t *pending_position;
+    size_t pending_count;
+} array_diff;
+
+static void free_array_diff(array_diff * const diff)
+{
+    /* to, to_hashes, to_kind and to_partner share the allocations of their 'from' counterparts */
+    void *allocations[8];
+    size_t i = 0;
+
+    allocations[0] = diff->from;
+    allocations[1] = diff->from_hashes;
+    allocations[2] = diff->script;
+    allocations[3] = diff->from_kind;
+    allocations[4] = diff->from_partner;
+    allocations[5] = diff->taken;
+    allocations[6] = diff->pending;
+    allocations[7] = diff->pending_position;
+    for (i = 0; i < (sizeof(allocations) / sizeof(allocations[0])); i++)
     {
-        return;
+        if (allocations[i] != NULL)
+        {
+            cJSON_free(allocations[i]);
+        }
     }
+}
+
+static cJSON_bool load_array_diff(array_diff * const diff, const cJSON * const from, const cJSON * const to, const int flags)
+{
+    size_t total = 0;
+    size_t i = 0;
+    cJSON *child = NULL;
 
-    if (root->string != NULL)
+    memset(diff, '\0', sizeof(array_diff));
+    for (child = from->child; child != NULL; child = child->next)
     {
-        cJSON_free(root->string);
+        diff->from_count++;
     }
-    if (root->valuestring != NULL)
+    for (child = to->child; child != NULL; child = child->next)
     {
-        cJSON_free(root->valuestring);
+        diff->to_count++;
     }
-    if (root->child != NULL)
+    total = diff->from_count + diff->to_count + 1;
+
+    diff->from = (cJSON**)cJSON_malloc(total * sizeof(cJSON*));
+    diff->to = diff->from + diff->from_count;
+    diff->from_hashes = (unsigned long long*)cJSON_malloc(total * sizeof(unsigned long long));
+    diff->to_hashes = diff->from_hashes + diff->from_count;
+    diff->script = (unsigned char*)cJSON_malloc(total);
+    diff->from_kind = (unsigned char*)cJSON_malloc(total);
+    diff->to_kind = diff->from_kind + diff->from_count;
+    diff->from_partner = (size_t*)cJSON_malloc(total * sizeof(size_t));
+    diff->to_partner = diff->from_partner + diff->from_count;
+    diff->taken = (cJSON_bool*)cJSON_malloc(total * sizeof(cJSON_bool));
+    diff->pending = (size_t*)cJSON_malloc(total * sizeof(size_t));
+    diff->pending_position = (size_t*)cJSON_malloc(total * sizeof(size_t));
+    if ((diff->from == NULL) || (diff->from_hashes == NULL) || (diff->script == NULL) || (diff->from_kind == NULL)
+        || (diff->from_partner == NULL) || (diff->taken == NULL) || (diff->pending == NULL) || (diff->pending_position == NULL))
     {
-        cJSON_Delete(root->child);
+        return false;
     }
 
-    memcpy(root, &replacement, sizeof(cJSON));
+    for ((void)(i = 0), child = from->child; child != NULL; (void)i++, child = child->next)
+    {
+        diff->from[i] = child;
+        diff->from_hashes[i] = get_hash(child, flags);
+        diff->from_kind[i] = ELEMENT_PLAIN;
+        diff->taken[i] = false;
+    }
+    for ((void)(i = 0), child = to->child; child != NULL; (void)i++, child = child->next)
+    {
+        diff->to[i] = child;
+        diff->to_hashes[i] = get_hash(child, flags);
+        diff->to_kind[i] = ELEMENT_PLAIN;
+    }
+
+    return true;
 }
 
-static int apply_patch(cJSON *object, const cJSON *patch, const cJSON_bool case_sensitive)
+/* Myers' O((N+M)D) shortest edit script on the element hashes, between the common prefix and suffix.
+ * Returns false if more than CJSON_ARRAY_DIFF_LIMIT elements have to be inserted or removed. */
+static cJSON_bool find_edit_script(array_diff * const diff)
 {
-    cJSON *path = NULL;
-    cJSON *value = NULL;
-    cJSON *parent = NULL;
-    enum patch_operation opcode = INVALID;
-    unsigned char *parent_pointer = NULL;
-    unsigned char *child_pointer = NULL;
-    int status = 0;
+    const unsigned long long *a = diff->from_hashes;
+    const unsigned long long *b = diff->to_hashes;
+    size_t prefix = 0;
+    size_t suffix = 0;
+    long n = 0;
+    long m = 0;
+    long max_edits = 0;
+    long d = 0;
+    long edits = 0;
+    long k = 0;
+    long x = 0;
+    long y = 0;
+    long **trace = NULL;
+    size_t position = 0;
+    size_t i = 0;
+    cJSON_bool found = false;
 
-    path = get_object_item(patch, "path", case_sensitive);
-    if (!cJSON_IsString(path))
+    while ((prefix < diff->from_count) && (prefix < diff->to_count) && (a[prefix] == b[prefix]))
     {
-        /* malformed patch. */
-        status = 2;
-        goto cleanup;
+        prefix++;
+    }
+    while (((prefix + suffix) < diff->from_count) && ((prefix + suffix) < diff->to_count)
+        && (a[diff->from_count - suffix - 1] == b[diff->to_count - suffix - 1]))
+    {
+        suffix++;
     }
-
-    opcode = decode_patch_operation(patch, case_sensitive);
-    if (opcode == INVALID)
+    if (((diff->from_count - prefix - suffix) + (diff->to_count - prefix - suffix)) > (size_t)LONG_MAX)
     {
-        status = 3;
-        goto cleanup;
+        return false;
     }
-    else if (opcode == TEST)
+    a += prefix;
+    b += prefix;
+    n = (long)(diff->from_count - prefix - suffix);
+    m = (long)(diff->to_count - prefix - suffix);
+    max_edits = ((n + m) < CJSON_ARRAY_DIFF_LIMIT) ? (n + m) : CJSON_ARRAY_DIFF_LIMIT;
+
+    /* trace[d][k + d] is the furthest x on diagonal k after d edits */
+    trace = (long**)cJSON_malloc((size_t)(max_edits + 1) * sizeof(long*));
+    if (trace == NULL)
     {
-        /* compare value: {...} with the given path */
-        status = !compare_json(get_item_from_pointer(object, path->valuestring, case_sensitive), get_object_item(patch, "value", case_sensitive), case_sensitive);
-        goto cleanup;
+        return false;
     }
-
-    /* special case for replacing the root */
-    if (path->valuestring[0] == '\0')
+    for (d = 0; d <= max_edits; d++)
     {
-        if (opcode == REMOVE)
+        long *row = (long*)cJSON_malloc((size_t)(2 * d + 1) * sizeof(long));
+        trace[d] = row;
+        if (row == NULL)
         {
-            static const cJSON invalid = { NULL, NULL, NULL, cJSON_Invalid, NULL, 0, 0, NULL};
-
-            overwrite_item(object, invalid);
-
-            status = 0;
-            goto cleanup;
+            break;
         }
-
-        if ((opcode == REPLACE) || (opcode == ADD))
+        for (k = -d; k <= d; k += 2)
         {
-            value = get_object_item(patch, "value", case_sensitive);
-            if (value == NULL)
+            if (d == 0)
             {
-                /* missing "value" for add/replace. */
-                status = 7;
-                goto cleanup;
+                x = 0;
             }
-
-            value = cJSON_Duplicate(value, 1);
-            if (value == NULL)
+            else if ((k == -d) || ((k != d) && (trace[d - 1][k - 1 + d - 1] < trace[d - 1][k + 1 + d - 1])))
             {
-                /* out of memory for add/replace. */
-                status = 8;
-                goto cleanup;
+                /* insertion, coming down from diagonal k + 1 */
+                x = trace[d - 1][k + 1 + d - 1];
             }
-
-            overwrite_item(object, *value);
-
-            /* delete the duplicated value */
-            cJSON_free(value);
-            value = NULL;
-
-            /* the string "value" isn't needed */
-            if (object->string != NULL)
+            else
             {
-                cJSON_free(object->string);
-                object->string = NULL;
+                /* deletion, coming right from diagonal k - 1 */
+                x = trace[d - 1][k - 1 + d - 1] + 1;
+            }
+            y = x - k;
+            while ((x < n) && (y < m) && (a[x] == b[y]))
+            {
+                x++;
+                y++;
+            }
+            row[k + d] = x;
+            if ((x >= n) && (y >= m))
+            {
+                found = true;
+                break;
             }
-
-            status = 0;
-            goto cleanup;
-        }
-    }
-
-    if ((opcode == REMOVE) || (opcode == REPLACE))
-    {
-        /* Get rid of old. */
-        cJSON *old_item = detach_path(object, (unsigned char*)path->valuestring, case_sensitive);
-        if (old_item == NULL)
-        {
-            status = 13;
-            goto cleanup;
         }
-        cJSON_Delete(old_item);
-        if (opcode == REMOVE)
+        if (found)
         {
-            /* For Remove, this job is done. */
-            status = 0;
-            goto cleanup;
+            break;
         }
     }
 
-    /* Copy/Move uses "from". */
-    if ((opcode == MOVE) || (opcode == COPY))
+    edits = d;
+    if (found)
     {
-        cJSON *from = get_object_item(patch, "from", case_sensitive);
-        if (from == NULL)
-        {
-            /* missing "from" for copy/move. */
-            status = 4;
-            goto cleanup;
-        }
-
-        if (opcode == MOVE)
+        /* backtrack from the end, filling the script from the back */
+        diff->script_length = prefix + suffix + (size_t)((n + m + d) / 2);
+        position = diff->script_length;
+        for (i = 0; i < suffix; i++)
         {
-            value = detach_path(object, (unsigned char*)from->valuestring, case_sensitive);
+            diff->script[--position] = DIFF_KEEP;
         }
-        if (opcode == COPY)
-        {
-            value = get_item_from_pointer(object, from->valuestring, case_sensitive);
-        }
-        if (value == NULL)
+        x = n;
+        y = m;
+        for (; d > 0; d--)
         {
-            /* missing "from" for copy/move. */
-            status = 5;
-            goto cleanup;
+            long previous_k = 0;
+            long previous_x = 0;
+            long previous_y = 0;
+
+            k = x - y;
+            if ((k == -d) || ((k != d) && (trace[d - 1][k - 1 + d - 1] < trace[d - 1][k + 1 + d - 1])))
+            {
+                previous_k = k + 1;
+            }
+            else
+            {
+                previous_k = k - 1;
+            }
+            previous_x = trace[d - 1][previous_k + d - 1];
+            previous_y = previous_x - previous_k;
+
+            /* the snake after the edit */
+            while (x > ((previous_k == (k - 1)) ? (previous_x + 1) : previous_x))
+            {
+                diff->script[--position] = DIFF_KEEP;
+                x--;
+                y--;
+            }
+            diff->script[--position] = (previous_k == (k - 1)) ? DIFF_DELETE : DIFF_INSERT;
+            x = previous_x;
+            y = previous_y;
         }
-        if (opcode == COPY)
+        for (; x > 0; x--)
         {
-            value = cJSON_Duplicate(value, 1);
+            diff->script[--position] = DIFF_KEEP;
         }
-        if (value == NULL)
+        for (i = 0; i < prefix; i++)
         {
-            /* out of memory for copy/move. */
-            status = 6;
-            goto cleanup;
+            diff->script[--position] = DIFF_KEEP;
         }
     }
-    else /* Add/Replace uses "value". */
+
+    for (k = 0; (k <= max_edits) && (k <= edits); k++)
     {
-        value = get_object_item(patch, "value", case_sensitive);
-        if (value == NULL)
-        {
-            /* missing "value" for add/replace. */
-            status = 7;
-            goto cleanup;
-        }
-        value = cJSON_Duplicate(value, 1);
-        if (value == NULL)
+        if (trace[k] == NULL)
         {
-            /* out of memory for add/replace. */
-            status = 8;
-            goto cleanup;
+            break;
         }
+        cJSON_free(trace[k]);
     }
+    cJSON_free(trace);
 
-    /* Now, just add "value" to "path". */
+    return found;
+}
+
+/* turn removed/inserted pairs of equal elements into moves, and removals next to insertions into substitutions */
+static void pair_edits(array_diff * const diff, const int flags)
+{
+    size_t from_index = 0;
+    size_t to_index = 0;
+    size_t position = 0;
+    size_t i = 0;
+    size_t j = 0;
 
-    /* split pointer in parent and child */
-    parent_pointer = cJSONUtils_strdup((unsigned char*)path->valuestring);
-    child_pointer = (unsigned char*)strrchr((char*)parent_pointer, '/');
-    if (child_pointer != NULL)
+    /* removed and inserted elements in script order, reusing the pending arrays */
+    size_t *removed = diff->pending;
+    size_t *inserted = diff->pending_position;
+    size_t removed_count = 0;
+    size_t inserted_count = 0;
+
+    for (position = 0; position < diff->script_length; position++)
     {
-        child_pointer[0] = '\0';
-        child_pointer++;
+        switch (diff->script[position])
+        {
+            case DIFF_DELETE:
+                removed[removed_count++] = from_index++;
+                break;
+            case DIFF_INSERT:
+                inserted[inserted_count++] = to_index++;
+                break;
+            default:
+                from_index++;
+                to_index++;
+                break;
+        }
     }
-    parent = get_item_from_pointer(object, (char*)parent_pointer, case_sensitive);
-    decode_pointer_inplace(child_pointer);
 
-    /* add, remove, replace, move, copy, test. */
-    if ((parent == NULL) || (child_pointer == NULL))
+    for (j = 0; j < inserted_count; j++)
     {
-        /* Couldn't find object to add to. */
-        status = 9;
-        goto cleanup;
+        for (i = 0; i < removed_count; i++)
+        {
+            size_t from = removed[i];
+            size_t to = inserted[j];
+            if ((diff->from_kind[from] == ELEMENT_PLAIN) && (diff->from_hashes[from] == diff->to_hashes[to])
+                && items_equal(diff->from[from], diff->to[to], flags))
+            {
+                diff->from_kind[from] = ELEMENT_MOVE;
+                diff->from_partner[from] = to;
+                diff->to_kind[to] = ELEMENT_MOVE;
+                diff->to_partner[to] = from;
+                break;
+            }
+        }
     }
-    else if (cJSON_IsArray(parent))
+
+    /* within every run of edits between two kept elements, pair the remaining removals and insertions in order */
+    from_index = 0;
+    to_index = 0;
+    position = 0;
+    while (position < diff->script_length)
     {
-        if (strcmp((char*)child_pointer, "-") == 0)
+        size_t run_from = from_index;
+        size_t run_to = to_index;
+
+        if (diff->script[position] == DIFF_KEEP)
         {
-            cJSON_AddItemToArray(parent, value);
-            value = NULL;
+            from_index++;
+            to_index++;
+            position++;
+            continue;
         }
-        else
+        for (; (position < diff->script_length) && (diff->script[position] != DIFF_KEEP); position++)
         {
-            size_t index = 0;
-            if (!decode_array_index_from_pointer(child_pointer, &index))
+            if (diff->script[position] == DIFF_DELETE)
             {
-                status = 11;
-                goto cleanup;
+                from_index++;
             }
-
-            if (!insert_item_in_array(parent, index, value))
+            else
             {
-                status = 10;
-                goto cleanup;
+                to_index++;
             }
-            value = NULL;
         }
-    }
-    else if (cJSON_IsObject(parent))
-    {
-        if (case_sensitive)
-        {
-            cJSON_DeleteItemFromObjectCaseSensitive(parent, (char*)child_pointer);
-        }
-        else
+
+        i = run_from;
+        j = run_to;
+        for (;;)
         {
-            cJSON_DeleteItemFromObject(parent, (char*)child_pointer);
+            while ((i < from_index) && (diff->from_kind[i] != ELEMENT_PLAIN))
+            {
+                i++;
+            }
+            while ((j < to_index) && (diff->to_kind[j] != ELEMENT_PLAIN))
+            {
+                j++;
+            }
+            if ((i == from_index) || (j == to_index))
+            {
+                break;
+            }
+            diff->from_kind[i] = ELEMENT_SUBSTITUTE;
+            diff->from_partner[i] = j;
+            diff->to_kind[j] = ELEMENT_SUBSTITUTE;
+            diff->to_partner[j] = i;
         }
-        cJSON_AddItemToObject(parent, (char*)child_pointer, value);
-        value = NULL;
-    }
-    else /* parent is not an object */
-    {
-        /* Couldn't find object to add to. */
-        status = 9;
-        goto cleanup;
-    }
-
-cleanup:
-    if (value != NULL)
-    {
-        cJSON_Delete(value);
-    }
-    if (parent_pointer != NULL)
-    {
-        cJSON_free(parent_pointer);
     }
-
-    return status;
 }
 
-CJSON_PUBLIC(int) cJSONUtils_ApplyPatches(cJSON * const object, const cJSON * const patches)
-{
-    const cJSON *current_patch = NULL;
-    int status = 0;
+static void create_patches(cJSON * const patches, const unsigned char * const path, cJSON * const from, cJSON * const to, const int flags);
 
-    if (!cJSON_IsArray(patches))
-    {
-        /* malformed patches. */
-        return 1;
-    }
+/* the 'from' element at position has been moved away, pending elements behind it move forward */
+static void remove_pending(array_diff * const diff, const size_t from_index)
+{
+    size_t i = 0;
+    size_t removed_position = 0;
 
-    if (patches != NULL)
+    for (i = 0; i < diff->pending_count; i++)
     {
-        current_patch = patches->child;
+        if (diff->pending[i] == from_index)
+        {
+            removed_position = diff->pending_position[i];
+            diff->pending_count--;
+            diff->pending[i] = diff->pending[diff->pending_count];
+            diff->pending_position[i] = diff->pending_position[diff->pending_count];
+            break;
+        }
     }
-
-    while (current_patch != NULL)
+    for (i = 0; i < diff->pending_count; i++)
     {
-        status = apply_patch(object, current_patch, false);
-        if (status != 0)
+        if (diff->pending_position[i] > removed_position)
         {
-            return status;
+            diff->pending_position[i]--;
         }
-        current_patch = current_patch->next;
     }
-
-    return 0;
 }
 
-CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesCaseSensitive(cJSON * const object, const cJSON * const patches)
+/* Emit the patches for the 'from' elements in [*from_index, end), i.e. the part of the array that hasn't been processed yet.
+ * *position is the index in the patched array where the next element goes. */
+static void flush_removed(cJSON * const patches, const unsigned char * const path, array_diff * const diff, size_t * const from_index, const size_t end, size_t * const position)
 {
-    const cJSON *current_patch = NULL;
-    int status = 0;
-
-    if (!cJSON_IsArray(patches))
-    {
-        /* malformed patches. */
-        return 1;
-    }
+    unsigned char index_string[21];
 
-    if (patches != NULL)
+    for (; *from_index < end; (*from_index)++)
     {
-        current_patch = patches->child;
-    }
-
-    while (current_patch != NULL)
-    {
-        status = apply_patch(object, current_patch, true);
-        if (status != 0)
+        size_t i = *from_index;
+        if (diff->taken[i])
         {
-            return status;
+            /* already moved to an earlier position */
+            continue;
+        }
+        if (diff->from_kind[i] == ELEMENT_MOVE)
+        {
+            /* moves to a later position, it stays until its destination is reached */
+            diff->pending[diff->pending_count] = i;
+            diff->pending_position[diff->pending_count] = *position;
+            diff->pending_count++;
+            (*position)++;
+            continue;
         }
-        current_patch = current_patch->next;
+        /* plain removal, substitutions are only flushed after they are done */
+        sprintf((char*)index_string, "%lu", (unsigned long)*position);
+        compose_patch(patches, (const unsigned char*)"remove", path, index_string, NULL);
     }
-
-    return 0;
 }
 
-static void compose_patch(cJSON * const patches, const unsigned char * const operation, const unsigned char * const path, const unsigned char *suffix, const cJSON * const value)
+static void emit_array_diff(cJSON * const patches, const unsigned char * const path, array_diff * const diff, const int flags)
 {
-    cJSON *patch = NULL;
+    unsigned char index_string[21];
+    unsigned char *new_path = (unsigned char*)cJSON_malloc(strlen((const char*)path) + 20 + sizeof("/")); /* Allow space for 64bit int. log10(2^64) = 20 */
+    size_t script_position = 0;
+    size_t from_index = 0; /* next 'from' element that hasn't been processed */
+    size_t from_done = 0; /* 'from' elements up to here are removed or pending */
+    size_t to_index = 0;
+    size_t position = 0;
 
-    if ((patches == NULL) || (operation == NULL) || (path == NULL))
+    if (new_path == NULL)
     {
         return;
     }
 
-    patch = cJSON_CreateObject();
-    if (patch == NULL)
+    while (script_position < diff->script_length)
     {
-        return;
-    }
-    cJSON_AddItemToObject(patch, "op", cJSON_CreateString((const char*)operation));
+        unsigned char operation = diff->script[script_position++];
+        size_t from = 0;
 
-    if (suffix == NULL)
-    {
-        cJSON_AddItemToObject(patch, "path", cJSON_CreateString((const char*)path));
+        if (operation == DIFF_DELETE)
+        {
+            from_index++;
+            continue;
+        }
+        if (operation == DIFF_KEEP)
+        {
+            /* kept elements have the same hash, which almost always means there is nothing to patch */
+            flush_removed(patches, path, diff, &from_done, from_index, &position);
+            sprintf((char*)new_path, "%s/%lu", path, (unsigned long)position);
+            create_patches(patches, new_path, diff->from[from_index], diff->to[to_index], flags);
+            from_index++;
+            from_done++;
+            to_index++;
+            position++;
+            continue;
+        }
+
+        /* insertion */
+        switch (diff->to_kind[to_index])
+        {
+            case ELEMENT_MOVE:
+                from = diff->to_partner[to_index];
+                if (from < from_done)
+                {
+                    /* pending in the processed part: it is behind the current position, removing it shifts the position */
+                    size_t i = 0;
+                    for (i = 0; diff->pending[i] != from; i++)
+                    {
+                        /* find it */
+                    }
+                    compose_move_patch(patches, path, diff->pending_position[i], position - 1);
+                    remove_pending(diff, from);
+                }
+                else
+                {
+                    /* still ahead of the current position */
+                    size_t source = position;
+                    size_t i = 0;
+                    for (i = from_done; i < from; i++)
+                    {
+                        if (!diff->taken[i])
+                        {
+                            source++;
+                        }
+                    }
+                    compose_move_patch(patches, path, source, position);
+                    diff->taken[from] = true;
+                    position++;
+                }
+                break;
+
+            case ELEMENT_SUBSTITUTE:
+                from = diff->to_partner[to_index];
+                flush_removed(patches, path, diff, &from_done, from, &position);
+                sprintf((char*)new_path, "%s/%lu", path, (unsigned long)position);
+                create_patches(patches, new_path, diff->from[from], diff->to[to_index], flags);
+                from_done++;
+                position++;
+                break;
+
+            default:
+                sprintf((char*)index_string, "%lu", (unsigned long)position);
+                compose_patch(patches, (const unsigned char*)"add", path, index_string, diff->to[to_index]);
+                position++;
+                break;
+        }
+        to_index++;
     }
-    else
-    {
-        size_t suffix_length = pointer_encoded_length(suffix);
-        size_t path_length = strlen((const char*)path);
-        unsigned char *full_path = (unsigned char*)cJSON_malloc(path_length + suffix_length + sizeof("/"));
+    flush_removed(patches, path, diff, &from_done, from_index, &position);
 
-        sprintf((char*)full_path, "%s/", (const char*)path);
-        encode_string_as_pointer(full_path + path_length + 1, suffix);
+    cJSON_free(new_path);
+}
 
-        cJSON_AddItemToObject(patch, "path", cJSON_CreateString((const char*)full_path));
-        cJSON_free(full_path);
-    }
+/* Sequence diff of two arrays: elements are matched by their structural hash, so inserting or removing elements
+ * only produces patches for those elements, and elements that only changed their position are moved.
+ * Returns false if the arrays are too different, the caller falls back to comparing by position. */
+static cJSON_bool create_array_diff(cJSON * const patches, const unsigned char * const path, cJSON * const from, cJSON * const to, const int flags)
+{
+    array_diff diff;
+    cJSON_bool success = false;
 
-    if (value != NULL)
+    if (load_array_diff(&diff, from, to, flags) && find_edit_script(&diff))
     {
-        cJSON_AddItemToObject(patch, "value", cJSON_Duplicate(value, 1));
+        pair_edits(&diff, flags);
+        emit_array_diff(patches, path, &diff, flags);
+        success = true;
     }
-    cJSON_AddItemToArray(patches, patch);
-}
+    free_array_diff(&diff);
 
-CJSON_PUBLIC(void) cJSONUtils_AddPatchToArray(cJSON * const array, const char * const operation, const char * const path, const cJSON * const value)
-{
-    compose_patch(array, (const unsigned char*)operation, (const unsigned char*)path, NULL, value);
+    return success;
 }
 
-static void create_patches(cJSON * const patches, const unsigned char * const path, cJSON * const from, cJSON * const to, const cJSON_bool case_sensitive)
+static void create_patches(cJSON * const patches, const unsigned char * const path, cJSON * const from, cJSON * const to, const int flags)
 {
+    const cJSON_bool case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+
     if ((from == NULL) || (to == NULL))
     {
         return;
     }
 
+    /* different hashes prove a change, equal ones are confirmed by comparing (only using hashes that are already cached if the
+     * inputs have to be preserved) */
+    if (((flags & cJSONUtils_PatchPreserveInput) ? ((from->hash != 0) && (from->hash == to->hash)) : (cJSON_GetHash(from) == cJSON_GetHash(to)))
+        && items_equal(from, to, flags))
+    {
+        /* unchanged subtree */
+        return;
+    }
+
     if ((from->type & 0xFF) != (to->type & 0xFF))
     {
         compose_patch(patches, (const unsigned char*)"replace", path, 0, to);
@@ -1153,8 +6079,14 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
             size_t index = 0;
             cJSON *from_child = from->child;
             cJSON *to_child = to->child;
-            unsigned char *new_path = (unsigned char*)cJSON_malloc(strlen((const char*)path) + 20 + sizeof("/")); /* Allow space for 64bit int. log10(2^64) = 20 */
+            unsigned char *new_path = NULL;
+
+            if ((flags & cJSONUtils_PatchArrayDiff) && create_array_diff(patches, path, from, to, flags))
+            {
+                return;
+            }
 
+            new_path = (unsigned char*)cJSON_malloc(strlen((const char*)path) + 20 + sizeof("/")); /* Allow space for 64bit int. log10(2^64) = 20 */
             /* generate patches for all array elements that exist in both "from" and "to" */
             for (index = 0; (from_child != NULL) && (to_child != NULL); (void)(from_child = from_child->next), (void)(to_child = to_child->next), index++)
             {
@@ -1167,7 +6099,7 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
                     return;
                 }
                 sprintf((char*)new_path, "%s/%lu", path, (unsigned long)index); /* path of the current array element */
-                create_patches(patches, new_path, from_child, to_child, case_sensitive);
+                create_patches(patches, new_path, from_child, to_child, flags);
             }
 
             /* remove leftover elements from 'from' that are not in 'to' */
@@ -1197,15 +6129,30 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
         {
             cJSON *from_child = NULL;
             cJSON *to_child = NULL;
-            sort_object(from, case_sensitive);
-            sort_object(to, case_sensitive);
+            size_t from_count = 0;
+            size_t to_count = 0;
+            cJSON **from_members = get_sorted_members(from, flags, &from_count);
+            cJSON **to_members = get_sorted_members(to, flags, &to_count);
+            cJSON **from_member = from_members;
+            cJSON **to_member = to_members;
+
+            if ((from_members == NULL) || (to_members == NULL))
+            {
+                cJSON_free(from_members);
+                cJSON_free(to_members);
+                return;
+            }
 
-            from_child = from->child;
-            to_child = to->child;
             /* for all object values in the object with more of them */
-            while ((from_child != NULL) || (to_child != NULL))
+            for (;;)
             {
                 int diff;
+                from_child = *from_member;
+                to_child = *to_member;
+                if ((from_child == NULL) && (to_child == NULL))
+                {
+                    break;
+                }
                 if (from_child == NULL)
                 {
                     diff = 1;
@@ -1226,232 +6173,844 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
                     size_t from_child_name_length = pointer_encoded_length((unsigned char*)from_child->string);
                     unsigned char *new_path = (unsigned char*)cJSON_malloc(path_length + from_child_name_length + sizeof("/"));
 
-                    sprintf((char*)new_path, "%s/", path);
-                    encode_string_as_pointer(new_path + path_length + 1, (unsigned char*)from_child->string);
+                    sprintf((char*)new_path, "%s/", path);
+                    encode_string_as_pointer(new_path + path_length + 1, (unsigned char*)from_child->string);
+
+                    /* create a patch for the element */
+                    create_patches(patches, new_path, from_child, to_child, flags);
+                    cJSON_free(new_path);
+
+                    from_member++;
+                    to_member++;
+                }
+                else if (diff < 0)
+                {
+                    /* object element doesn't exist in 'to' --> remove it */
+                    compose_patch(patches, (const unsigned char*)"remove", path, (unsigned char*)from_child->string, NULL);
+
+                    from_member++;
+                }
+                else
+                {
+                    /* object element doesn't exist in 'from' --> add it */
+                    compose_patch(patches, (const unsigned char*)"add", path, (unsigned char*)to_child->string, to_child);
+
+                    to_member++;
+                }
+            }
+            cJSON_free(from_members);
+            cJSON_free(to_members);
+            return;
+        }
+
+        default:
+            break;
+    }
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatches(cJSON * const from, cJSON * const to)
+{
+    return cJSONUtils_GeneratePatchesWithOpts(from, to, 0);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatchesCaseSensitive(cJSON * const from, cJSON * const to)
+{
+    return cJSONUtils_GeneratePatchesWithOpts(from, to, cJSONUtils_PatchCaseSensitive);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatchesWithOpts(cJSON * const from, cJSON * const to, int flags)
+{
+    cJSON *patches = NULL;
+
+    if ((from == NULL) || (to == NULL))
+    {
+        return NULL;
+    }
+
+    patches = cJSON_CreateArray();
+    create_patches(patches, (const unsigned char*)"", from, to, flags);
+
+    return patches;
+}
+
+CJSON_PUBLIC(void) cJSONUtils_SortObject(cJSON * const object)
+{
+    sort_object(object, false);
+}
+
+CJSON_PUBLIC(void) cJSONUtils_SortObjectCaseSensitive(cJSON * const object)
+{
+    sort_object(object, true);
+}
+
+static cJSON *merge_patch(cJSON *target, const cJSON * const patch, const cJSON_bool case_sensitive, const cJSON_bool versioned)
+{
+    cJSON *patch_child = NULL;
+
+    if (!cJSON_IsObject(patch))
+    {
+        /* scalar value, array or NULL, just duplicate */
+        cJSON_Delete(target);
+        return cJSON_Duplicate(patch, 1);
+    }
+
+    if (!cJSON_IsObject(target))
+    {
+        cJSON_Delete(target);
+        target = cJSON_CreateObject();
+    }
+    else if (versioned && !cJSON_Unshare(target))
+    {
+        cJSON_Delete(target);
+        return NULL;
+    }
+
+    patch_child = patch->child;
+    while (patch_child != NULL)
+    {
+        if (cJSON_IsNull(patch_child))
+        {
+            /* NULL is the indicator to remove a value, see RFC7396 */
+            if (case_sensitive)
+            {
+                cJSON_DeleteItemFromObjectCaseSensitive(target, patch_child->string);
+            }
+            else
+            {
+                cJSON_DeleteItemFromObject(target, patch_child->string);
+            }
+        }
+        else
+        {
+            cJSON *replace_me = NULL;
+            cJSON *replacement = NULL;
+
+            if (case_sensitive)
+            {
+                replace_me = cJSON_DetachItemFromObjectCaseSensitive(target, patch_child->string);
+            }
+            else
+            {
+                replace_me = cJSON_DetachItemFromObject(target, patch_child->string);
+            }
+
+            replacement = merge_patch(replace_me, patch_child, case_sensitive, versioned);
+            if (replacement == NULL)
+            {
+                if (versioned)
+                {
+                    cJSON_Delete(target);
+                }
+                return NULL;
+            }
+
+            cJSON_AddItemToObject(target, patch_child->string, replacement);
+        }
+        patch_child = patch_child->next;
+    }
+    return target;
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatch(cJSON *target, const cJSON * const patch)
+{
+    return merge_patch(target, patch, false, false);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatchCaseSensitive(cJSON *target, const cJSON * const patch)
+{
+    return merge_patch(target, patch, true, false);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatchToVersion(cJSON * const version, const cJSON * const patch, int flags)
+{
+    cJSON *target = NULL;
+
+    if (patch == NULL)
+    {
+        return NULL;
+    }
+    target = cJSON_CreateSharedReference(version);
+    if (target == NULL)
+    {
+        return NULL;
+    }
+
+    return merge_patch(target, patch, (flags & cJSONUtils_PatchCaseSensitive) != 0, true);
+}
+
+static cJSON *generate_merge_patch(cJSON * const from, cJSON * const to, const int flags)
+{
+    cJSON *from_child = NULL;
+    cJSON *to_child = NULL;
+    cJSON **from_members = NULL;
+    cJSON **to_members = NULL;
+    cJSON **from_member = NULL;
+    cJSON **to_member = NULL;
+    size_t from_count = 0;
+    size_t to_count = 0;
+    cJSON *patch = NULL;
+    if (to == NULL)
+    {
+        /* patch to delete everything */
+        return cJSON_CreateNull();
+    }
+    if (!cJSON_IsObject(to) || !cJSON_IsObject(from))
+    {
+        return cJSON_Duplicate(to, 1);
+    }
+    if (((flags & cJSONUtils_PatchPreserveInput) ? ((from->hash != 0) && (from->hash == to->hash)) : (cJSON_GetHash(from) == cJSON_GetHash(to)))
+        && items_equal(from, to, flags))
+    {
+        /* no patch needed */
+        return NULL;
+    }
+
+    from_members = get_sorted_members(from, flags, &from_count);
+    to_members = get_sorted_members(to, flags, &to_count);
+    patch = cJSON_CreateObject();
+    if ((from_members == NULL) || (to_members == NULL) || (patch == NULL))
+    {
+        cJSON_free(from_members);
+        cJSON_free(to_members);
+        cJSON_Delete(patch);
+        return NULL;
+    }
+
+    from_member = from_members;
+    to_member = to_members;
+    for (;;)
+    {
+        int diff;
+        from_child = *from_member;
+        to_child = *to_member;
+        if ((from_child == NULL) && (to_child == NULL))
+        {
+            break;
+        }
+
+        if (from_child != NULL)
+        {
+            if (to_child != NULL)
+            {
+                diff = strcmp(from_child->string, to_child->string);
+            }
+            else
+            {
+                diff = -1;
+            }
+        }
+        else
+        {
+            diff = 1;
+        }
+
+        if (diff < 0)
+        {
+            /* from has a value that to doesn't have -> remove */
+            cJSON_AddItemToObject(patch, from_child->string, cJSON_CreateNull());
+
+            from_member++;
+        }
+        else if (diff > 0)
+        {
+            /* to has a value that from doesn't have -> add to patch */
+            cJSON_AddItemToObject(patch, to_child->string, cJSON_Duplicate(to_child, 1));
+
+            to_member++;
+        }
+        else
+        {
+            /* object key exists in both objects */
+            if (!items_equal(from_child, to_child, flags))
+            {
+                /* not identical --> generate a patch */
+                cJSON_AddItemToObject(patch, to_child->string, generate_merge_patch(from_child, to_child, flags));
+            }
+
+            /* next key in the object */
+            from_member++;
+            to_member++;
+        }
+    }
+    cJSON_free(from_members);
+    cJSON_free(to_members);
+    if (patch->child == NULL)
+    {
+        /* no patch generated */
+        cJSON_Delete(patch);
+        return NULL;
+    }
+
+    return patch;
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatch(cJSON * const from, cJSON * const to)
+{
+    return generate_merge_patch(from, to, 0);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatchCaseSensitive(cJSON * const from, cJSON * const to)
+{
+    return generate_merge_patch(from, to, cJSONUtils_PatchCaseSensitive);
+}
+
+CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatchWithOpts(cJSON * const from, cJSON * const to, int flags)
+{
+    return generate_merge_patch(from, to, flags);
+}
+
+/* Patch compaction: the locations of the operations are merged into a trie of their (still encoded) pointer tokens,
+ * so that the operations above, at and below a location can be found without comparing every pair of operations. */
+enum member_state { MEMBER_UNKNOWN, MEMBER_EXISTS, MEMBER_ABSENT };
+
+typedef struct
+{
+    const unsigned char *token; /* points into a "path" or "from", not zero terminated */
+    size_t length;
+    unsigned long hash; /* hash_key of token */
+    size_t parent;
+    size_t depth;
+    size_t first_child; /* node index, 0 if there is none (the root is never a child) */
+    size_t next_sibling;
+    size_t first_use; /* 1 + index of the first use of the node by "path" or "from" of an operation, 0 if none */
+    size_t first_shift; /* 1 + index of the first use by an operation that inserts or removes a child of the node */
+} path_trie_node;
+
+typedef struct
+{
+    size_t operation;
+    size_t next; /* 1 + index of the next use in the same list, 0 if there is none */
+} path_trie_use;
+
+typedef struct
+{
+    const cJSON *patch;
+    enum patch_operation opcode;
+    cJSON_bool converted; /* a "replace" that folding turned into an "add" */
+    cJSON_bool dropped;
+    size_t path_node;
+    size_t from_node;
+    cJSON_bool path_is_index; /* the last token of "path" could be an array index */
+    cJSON_bool from_is_index;
+    enum member_state before; /* whether "path" existed before the operation */
+} compact_operation;
+
+typedef struct
+{
+    path_trie_node *nodes;
+    size_t node_count;
+    size_t *table; /* 1 + index of the node, by parent and token */
+    size_t table_mask;
+    path_trie_use *uses;
+    size_t use_count;
+    compact_operation *operations;
+    size_t operation_count;
+    size_t *candidates;
+    size_t candidate_count;
+    cJSON_bool case_sensitive;
+} patch_compactor;
+
+/* "-" or a decimal number, might address an array element and move the following ones */
+static cJSON_bool is_index_token(const unsigned char *token, size_t length)
+{
+    if ((length == 1) && (token[0] == '-'))
+    {
+        return true;
+    }
+    if (length == 0)
+    {
+        return false;
+    }
+    for (; length > 0; (void)token++, length--)
+    {
+        if ((*token < '0') || (*token > '9'))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-                    /* create a patch for the element */
-                    create_patches(patches, new_path, from_child, to_child, case_sensitive);
-                    cJSON_free(new_path);
+static cJSON_bool path_tokens_equal(const path_trie_node * const node, const unsigned char * const token, const size_t length, const unsigned long hash, const cJSON_bool case_sensitive)
+{
+    size_t i = 0;
 
-                    from_child = from_child->next;
-                    to_child = to_child->next;
-                }
-                else if (diff < 0)
-                {
-                    /* object element doesn't exist in 'to' --> remove it */
-                    compose_patch(patches, (const unsigned char*)"remove", path, (unsigned char*)from_child->string, NULL);
+    if ((node->length != length) || (node->hash != hash))
+    {
+        return false;
+    }
+    if (case_sensitive)
+    {
+        return memcmp(node->token, token, length) == 0;
+    }
+    for (i = 0; i < length; i++)
+    {
+        if (tolower(node->token[i]) != tolower(token[i]))
+        {
+            return false;
+        }
+    }
 
-                    from_child = from_child->next;
-                }
-                else
-                {
-                    /* object element doesn't exist in 'from' --> add it */
-                    compose_patch(patches, (const unsigned char*)"add", path, (unsigned char*)to_child->string, to_child);
+    return true;
+}
 
-                    to_child = to_child->next;
-                }
-            }
-            return;
-        }
+/* the child of parent for token, created if it doesn't exist yet */
+static size_t get_path_trie_child(patch_compactor * const compactor, const size_t parent, const unsigned char * const token, const size_t length)
+{
+    unsigned long hash = hash_key(token, length);
+    size_t slot = (size_t)(hash ^ ((unsigned long)parent * 2654435761UL)) & compactor->table_mask;
+    path_trie_node *node = NULL;
 
-        default:
-            break;
+    while (compactor->table[slot] != 0)
+    {
+        size_t index = compactor->table[slot] - 1;
+        if ((compactor->nodes[index].parent == parent) && path_tokens_equal(&compactor->nodes[index], token, length, hash, compactor->case_sensitive))
+        {
+            return index;
+        }
+        slot = (slot + 1) & compactor->table_mask;
     }
+
+    node = &compactor->nodes[compactor->node_count];
+    memset(node, '\0', sizeof(path_trie_node));
+    node->token = token;
+    node->length = length;
+    node->hash = hash;
+    node->parent = parent;
+    node->depth = compactor->nodes[parent].depth + 1;
+    node->next_sibling = compactor->nodes[parent].first_child;
+    compactor->nodes[parent].first_child = compactor->node_count;
+    compactor->table[slot] = compactor->node_count + 1;
+
+    return compactor->node_count++;
 }
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatches(cJSON * const from, cJSON * const to)
+/* Insert the tokens of pointer into the trie. Returns false if it isn't a valid pointer. */
+static cJSON_bool insert_path(patch_compactor * const compactor, const unsigned char *pointer, size_t * const node, cJSON_bool * const is_index)
 {
-    cJSON *patches = NULL;
-
-    if ((from == NULL) || (to == NULL))
+    *node = 0;
+    *is_index = false;
+    if (*pointer == '\0')
     {
-        return NULL;
+        return true;
+    }
+    if (*pointer != '/')
+    {
+        return false;
     }
 
-    patches = cJSON_CreateArray();
-    create_patches(patches, (const unsigned char*)"", from, to, false);
+    while (*pointer == '/')
+    {
+        const unsigned char *token = pointer + 1;
+        for (pointer = token; (*pointer != '\0') && (*pointer != '/'); pointer++)
+        {
+        }
+        *node = get_path_trie_child(compactor, *node, token, (size_t)(pointer - token));
+        *is_index = is_index_token(token, (size_t)(pointer - token));
+    }
 
-    return patches;
+    return true;
 }
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatchesCaseSensitive(cJSON * const from, cJSON * const to)
+static void add_path_use(patch_compactor * const compactor, size_t * const list, const size_t operation)
 {
-    cJSON *patches = NULL;
+    path_trie_use *use = &compactor->uses[compactor->use_count];
 
-    if ((from == NULL) || (to == NULL))
+    use->operation = operation;
+    use->next = *list;
+    *list = ++compactor->use_count;
+}
+
+/* is node the same as ancestor or below it */
+static cJSON_bool is_below_path(const patch_compactor * const compactor, size_t node, const size_t ancestor)
+{
+    while (compactor->nodes[node].depth > compactor->nodes[ancestor].depth)
     {
-        return NULL;
+        node = compactor->nodes[node].parent;
     }
 
-    patches = cJSON_CreateArray();
-    create_patches(patches, (const unsigned char*)"", from, to, true);
+    return node == ancestor;
+}
 
-    return patches;
+static void collect_path_uses(patch_compactor * const compactor, size_t use)
+{
+    for (; use != 0; use = compactor->uses[use - 1].next)
+    {
+        size_t operation = compactor->uses[use - 1].operation;
+        if (!compactor->operations[operation].dropped)
+        {
+            compactor->candidates[compactor->candidate_count++] = operation;
+        }
+    }
 }
 
-CJSON_PUBLIC(void) cJSONUtils_SortObject(cJSON * const object)
+static void collect_subtree_uses(patch_compactor * const compactor, const size_t node)
 {
-    sort_object(object, false);
+    size_t child = 0;
+
+    collect_path_uses(compactor, compactor->nodes[node].first_use);
+    for (child = compactor->nodes[node].first_child; child != 0; child = compactor->nodes[child].next_sibling)
+    {
+        collect_subtree_uses(compactor, child);
+    }
 }
 
-CJSON_PUBLIC(void) cJSONUtils_SortObjectCaseSensitive(cJSON * const object)
+/* is an operation between first and last (both exclusive) still using node or something below it */
+static cJSON_bool has_uses_between(const patch_compactor * const compactor, const size_t node, const size_t first, const size_t last)
 {
-    sort_object(object, true);
+    size_t use = 0;
+    size_t child = 0;
+
+    for (use = compactor->nodes[node].first_use; use != 0; use = compactor->uses[use - 1].next)
+    {
+        size_t operation = compactor->uses[use - 1].operation;
+        if ((operation > first) && (operation < last) && !compactor->operations[operation].dropped)
+        {
+            return true;
+        }
+    }
+    for (child = compactor->nodes[node].first_child; child != 0; child = compactor->nodes[child].next_sibling)
+    {
+        if (has_uses_between(compactor, child, first, last))
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-static cJSON *merge_patch(cJSON *target, const cJSON * const patch, const cJSON_bool case_sensitive)
+static int compare_operations_descending(const void *a, const void *b)
 {
-    cJSON *patch_child = NULL;
+    size_t first = *(const size_t*)a;
+    size_t second = *(const size_t*)b;
 
-    if (!cJSON_IsObject(patch))
+    return (first < second) ? 1 : ((first > second) ? -1 : 0);
+}
+
+/* Drop the earlier operations that the operation at index makes pointless. They are visited from the latest to the
+ * earliest, the first one that has to stay (or that a later kept operation depends on) ends the search. */
+static void fold_operation(patch_compactor * const compactor, const size_t index)
+{
+    compact_operation *operation = &compactor->operations[index];
+    const size_t node = operation->path_node;
+    size_t ancestor = node;
+    size_t previous = index;
+    size_t i = 0;
+
+    /* only these replace everything at "path" without moving anything next to it */
+    if (!((operation->opcode == REPLACE) || (operation->opcode == REMOVE) || ((operation->opcode == ADD) && !operation->path_is_index)))
     {
-        /* scalar value, array or NULL, just duplicate */
-        cJSON_Delete(target);
-        return cJSON_Duplicate(patch, 1);
+        return;
     }
 
-    if (!cJSON_IsObject(target))
+    compactor->candidate_count = 0;
+    while (ancestor != 0)
     {
-        cJSON_Delete(target);
-        target = cJSON_CreateObject();
+        ancestor = compactor->nodes[ancestor].parent;
+        collect_path_uses(compactor, compactor->nodes[ancestor].first_use);
+        collect_path_uses(compactor, compactor->nodes[ancestor].first_shift);
     }
+    collect_subtree_uses(compactor, node);
+    qsort(compactor->candidates, compactor->candidate_count, sizeof(size_t), compare_operations_descending);
 
-    patch_child = patch->child;
-    while (patch_child != NULL)
+    for (i = 0; i < compactor->candidate_count; i++)
     {
-        if (cJSON_IsNull(patch_child))
+        compact_operation *earlier = &compactor->operations[compactor->candidates[i]];
+
+        if (compactor->candidates[i] == previous)
         {
-            /* NULL is the indicator to remove a value, see RFC7396 */
-            if (case_sensitive)
-            {
-                cJSON_DeleteItemFromObjectCaseSensitive(target, patch_child->string);
-            }
-            else
-            {
-                cJSON_DeleteItemFromObject(target, patch_child->string);
-            }
+            /* used by "path" and "from" */
+            continue;
         }
-        else
+        previous = compactor->candidates[i];
+
+        if ((earlier->opcode == INVALID) || (earlier->opcode == TEST) || !is_below_path(compactor, earlier->path_node, node))
         {
-            cJSON *replace_me = NULL;
-            cJSON *replacement = NULL;
+            return;
+        }
+        if ((earlier->opcode == MOVE) && (!is_below_path(compactor, earlier->from_node, node) || ((earlier->from_node == node) && earlier->from_is_index)))
+        {
+            /* it also removed something somewhere else or moved the elements after "path" */
+            return;
+        }
 
-            if (case_sensitive)
-            {
-                replace_me = cJSON_DetachItemFromObjectCaseSensitive(target, patch_child->string);
-            }
-            else
-            {
-                replace_me = cJSON_DetachItemFromObject(target, patch_child->string);
-            }
+        if (earlier->path_node != node)
+        {
+            /* changed something below "path" */
+            earlier->dropped = true;
+            continue;
+        }
 
-            replacement = merge_patch(replace_me, patch_child, case_sensitive);
-            if (replacement == NULL)
-            {
-                return NULL;
-            }
+        switch (earlier->opcode)
+        {
+            case REPLACE:
+                earlier->dropped = true;
+                operation->before = MEMBER_EXISTS;
+                break;
+
+            case REMOVE:
+            case MOVE:
+                if (earlier->path_is_index)
+                {
+                    /* moved the elements after it */
+                    return;
+                }
+                earlier->dropped = true;
+                operation->before = MEMBER_EXISTS;
+                break;
 
-            cJSON_AddItemToObject(target, patch_child->string, replacement);
+            case ADD:
+            case COPY:
+                if (earlier->path_is_index)
+                {
+                    /* Inserting a value and replacing it is inserting the new value. The insert moves to the
+                     * position of the replace, so nothing in between may use the indices it shifted. */
+                    if ((operation->opcode == REPLACE) && !has_uses_between(compactor, compactor->nodes[node].parent, previous, index))
+                    {
+                        earlier->dropped = true;
+                        operation->opcode = ADD;
+                        operation->converted = true;
+                    }
+                    return;
+                }
+                if (operation->opcode == REMOVE)
+                {
+                    if (earlier->before == MEMBER_ABSENT)
+                    {
+                        /* the member is gone again */
+                        earlier->dropped = true;
+                        operation->dropped = true;
+                        return;
+                    }
+                    if (earlier->before == MEMBER_UNKNOWN)
+                    {
+                        /* removing it fails if the member didn't exist before */
+                        return;
+                    }
+                }
+                earlier->dropped = true;
+                operation->before = earlier->before;
+                if ((operation->opcode == REPLACE) && (operation->before != MEMBER_EXISTS))
+                {
+                    /* the member might not exist without the earlier operation */
+                    operation->opcode = ADD;
+                    operation->converted = true;
+                }
+                break;
+
+            default:
+                return;
         }
-        patch_child = patch_child->next;
     }
-    return target;
 }
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatch(cJSON *target, const cJSON * const patch)
+/* make the operation at index visible to the following ones */
+static void register_operation(patch_compactor * const compactor, const size_t index)
 {
-    return merge_patch(target, patch, false);
-}
+    compact_operation *operation = &compactor->operations[index];
+    path_trie_node *path = &compactor->nodes[operation->path_node];
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatchCaseSensitive(cJSON *target, const cJSON * const patch)
-{
-    return merge_patch(target, patch, true);
+    add_path_use(compactor, &path->first_use, index);
+    if ((operation->opcode == MOVE) || (operation->opcode == COPY))
+    {
+        add_path_use(compactor, &compactor->nodes[operation->from_node].first_use, index);
+    }
+    if (operation->path_is_index && (operation->opcode != REPLACE) && (operation->opcode != TEST))
+    {
+        add_path_use(compactor, &compactor->nodes[path->parent].first_shift, index);
+    }
+    if ((operation->opcode == MOVE) && operation->from_is_index)
+    {
+        add_path_use(compactor, &compactor->nodes[compactor->nodes[operation->from_node].parent].first_shift, index);
+    }
 }
 
-static cJSON *generate_merge_patch(cJSON * const from, cJSON * const to, const cJSON_bool case_sensitive)
+/* read an operation into the trie, anything ApplyPatches would reject ends up as INVALID at the root */
+static void load_operation(patch_compactor * const compactor, const cJSON * const patch)
 {
-    cJSON *from_child = NULL;
-    cJSON *to_child = NULL;
-    cJSON *patch = NULL;
-    if (to == NULL)
+    compact_operation *operation = &compactor->operations[compactor->operation_count];
+    cJSON *path = get_object_item(patch, "path", compactor->case_sensitive);
+    cJSON *from = get_object_item(patch, "from", compactor->case_sensitive);
+
+    memset(operation, '\0', sizeof(compact_operation));
+    operation->patch = patch;
+    operation->opcode = decode_patch_operation(patch, compactor->case_sensitive);
+    if (!cJSON_IsString(path) || !insert_path(compactor, (const unsigned char*)path->valuestring, &operation->path_node, &operation->path_is_index))
     {
-        /* patch to delete everything */
-        return cJSON_CreateNull();
+        operation->opcode = INVALID;
     }
-    if (!cJSON_IsObject(to) || !cJSON_IsObject(from))
+    if ((operation->opcode == MOVE) || (operation->opcode == COPY))
     {
-        return cJSON_Duplicate(to, 1);
+        if (!cJSON_IsString(from) || !insert_path(compactor, (const unsigned char*)from->valuestring, &operation->from_node, &operation->from_is_index))
+        {
+            operation->opcode = INVALID;
+        }
+    }
+    else if ((operation->opcode != REMOVE) && (get_object_item(patch, "value", compactor->case_sensitive) == NULL))
+    {
+        operation->opcode = INVALID;
+    }
+
+    if (operation->opcode == INVALID)
+    {
+        operation->path_node = 0;
+        operation->path_is_index = false;
+    }
+    else if ((operation->path_node == 0) || (operation->opcode == REPLACE) || (operation->opcode == REMOVE))
+    {
+        operation->before = MEMBER_EXISTS;
     }
 
-    sort_object(from, case_sensitive);
-    sort_object(to, case_sensitive);
+    compactor->operation_count++;
+}
 
-    from_child = from->child;
-    to_child = to->child;
-    patch = cJSON_CreateObject();
-    while (from_child || to_child)
+/* number of pointer tokens in the "path" and "from" of a patch */
+static size_t count_patch_tokens(const cJSON * const patch)
+{
+    size_t count = 0;
+    const cJSON *member = NULL;
+
+    for (member = patch->child; member != NULL; member = member->next)
     {
-        int diff;
-        if (from_child != NULL)
+        const char *character = NULL;
+        if (!cJSON_IsString(member))
         {
-            if (to_child != NULL)
-            {
-                diff = strcmp(from_child->string, to_child->string);
-            }
-            else
-            {
-                diff = -1;
-            }
+            continue;
         }
-        else
+        for (character = member->valuestring; *character != '\0'; character++)
         {
-            diff = 1;
+            count += (*character == '/') ? 1 : 0;
         }
+    }
 
-        if (diff < 0)
-        {
-            /* from has a value that to doesn't have -> remove */
-            cJSON_AddItemToObject(patch, from_child->string, cJSON_CreateNull());
+    return count;
+}
 
-            from_child = from_child->next;
+static cJSON *compact_patches(const cJSON * const * const lists, const size_t list_count, const int flags)
+{
+    patch_compactor compactor;
+    const cJSON *patch = NULL;
+    cJSON *result = NULL;
+    size_t operations = 0;
+    size_t tokens = 0;
+    size_t table_size = 1;
+    size_t i = 0;
+
+    for (i = 0; i < list_count; i++)
+    {
+        if (!cJSON_IsArray(lists[i]))
+        {
+            return NULL;
         }
-        else if (diff > 0)
+        for (patch = lists[i]->child; patch != NULL; patch = patch->next)
         {
-            /* to has a value that from doesn't have -> add to patch */
-            cJSON_AddItemToObject(patch, to_child->string, cJSON_Duplicate(to_child, 1));
-
-            to_child = to_child->next;
+            operations++;
+            tokens += count_patch_tokens(patch);
         }
-        else
+    }
+
+    memset(&compactor, '\0', sizeof(compactor));
+    compactor.case_sensitive = (flags & cJSONUtils_PatchCaseSensitive) != 0;
+    while (table_size < (2 * (tokens + 1)))
+    {
+        table_size *= 2;
+    }
+    compactor.table_mask = table_size - 1;
+
+    /* everything is sized up front: one node per token, up to four uses per operation */
+    compactor.nodes = (path_trie_node*)cJSON_malloc((tokens + 1) * sizeof(path_trie_node));
+    compactor.table = (size_t*)cJSON_malloc(table_size * sizeof(size_t));
+    compactor.uses = (path_trie_use*)cJSON_malloc((operations * 4 + 1) * sizeof(path_trie_use));
+    compactor.operations = (compact_operation*)cJSON_malloc((operations + 1) * sizeof(compact_operation));
+    compactor.candidates = (size_t*)cJSON_malloc((operations * 4 + 1) * sizeof(size_t));
+    result = cJSON_CreateArray();
+    if ((compactor.nodes == NULL) || (compactor.table == NULL) || (compactor.uses == NULL) || (compactor.operations == NULL) || (compactor.candidates == NULL) || (result == NULL))
+    {
+        goto fail;
+    }
+    memset(compactor.nodes, '\0', sizeof(path_trie_node));
+    memset(compactor.table, '\0', table_size * sizeof(size_t));
+    compactor.node_count = 1;
+
+    for (i = 0; i < list_count; i++)
+    {
+        for (patch = lists[i]->child; patch != NULL; patch = patch->next)
         {
-            /* object key exists in both objects */
-            if (!compare_json(from_child, to_child, case_sensitive))
+            load_operation(&compactor, patch);
+            fold_operation(&compactor, compactor.operation_count - 1);
+            if (!compactor.operations[compactor.operation_count - 1].dropped)
             {
-                /* not identical --> generate a patch */
-                cJSON_AddItemToObject(patch, to_child->string, cJSONUtils_GenerateMergePatch(from_child, to_child));
+                register_operation(&compactor, compactor.operation_count - 1);
             }
+        }
+    }
 
-            /* next key in the object */
-            from_child = from_child->next;
-            to_child = to_child->next;
+    for (i = 0; i < compactor.operation_count; i++)
+    {
+        compact_operation *operation = &compactor.operations[i];
+        cJSON *copy = NULL;
+
+        if (operation->dropped)
+        {
+            continue;
+        }
+        if (operation->converted)
+        {
+            compose_patch(result, (const unsigned char*)"add", (const unsigned char*)get_object_item(operation->patch, "path", compactor.case_sensitive)->valuestring, NULL, get_object_item(operation->patch, "value", compactor.case_sensitive));
+            continue;
+        }
+        copy = cJSON_Duplicate(operation->patch, 1);
+        if (copy == NULL)
+        {
+            goto fail;
         }
+        cJSON_AddItemToArray(result, copy);
     }
-    if (patch->child == NULL)
+
+    goto cleanup;
+
+fail:
+    cJSON_Delete(result);
+    result = NULL;
+
+cleanup:
+    if (compactor.nodes != NULL)
     {
-        /* no patch generated */
-        cJSON_Delete(patch);
-        return NULL;
+        cJSON_free(compactor.nodes);
+    }
+    if (compactor.table != NULL)
+    {
+        cJSON_free(compactor.table);
+    }
+    if (compactor.uses != NULL)
+    {
+        cJSON_free(compactor.uses);
+    }
+    if (compactor.operations != NULL)
+    {
+        cJSON_free(compactor.operations);
+    }
+    if (compactor.candidates != NULL)
+    {
+        cJSON_free(compactor.candidates);
     }
 
-    return patch;
+    return result;
 }
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatch(cJSON * const from, cJSON * const to)
+CJSON_PUBLIC(cJSON *) cJSONUtils_CompactPatches(const cJSON * const patches, int flags)
 {
-    return generate_merge_patch(from, to, false);
+    return compact_patches(&patches, 1, flags);
 }
 
-CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatchCaseSensitive(cJSON * const from, cJSON * const to)
+CJSON_PUBLIC(cJSON *) cJSONUtils_ComposePatches(const cJSON * const first, const cJSON * const second, int flags)
 {
-    return generate_merge_patch(from, to, true);
+    const cJSON *lists[2];
+
+    lists[0] = first;
+    lists[1] = second;
+
+    return compact_patches(lists, 2, flags);
 }
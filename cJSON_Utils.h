@@ -33,48 +33,139 @@ extern "C"
 /* Implement RFC6901 (https://tools.ietf.org/html/rfc6901) JSON Pointer spec. */
 CJSON_PUBLIC(cJSON *) cJSONUtils_GetPointer(cJSON * const object, const char *pointer);
 CJSON_PUBLIC(cJSON *) cJSONUtils_GetPointerCaseSensitive(cJSON * const object, const char *pointer);
+/* Compile a pointer once (split, unescape ~0/~1, parse array indices, hash keys) to evaluate it repeatedly without any parsing
+ * or allocation. Returns NULL for invalid pointers. Release it with cJSONUtils_DeletePointer. */
+typedef struct cJSONUtils_Pointer cJSONUtils_Pointer;
+CJSON_PUBLIC(cJSONUtils_Pointer *) cJSONUtils_CompilePointer(const char *pointer);
+CJSON_PUBLIC(void) cJSONUtils_DeletePointer(cJSONUtils_Pointer *pointer);
+CJSON_PUBLIC(cJSON *) cJSONUtils_EvalPointer(cJSON * const object, const cJSONUtils_Pointer * const pointer);
+CJSON_PUBLIC(cJSON *) cJSONUtils_EvalPointerCaseSensitive(cJSON * const object, const cJSONUtils_Pointer * const pointer);
+/* Resolve many compiled pointers in a single walk: they are merged into a prefix trie so shared prefixes are resolved once and every
+ * container on the way is scanned once. results[i] is set to the item of pointers[i] (NULL if not found or pointers[i] is NULL).
+ * Returns false if memory for the trie couldn't be allocated. */
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_EvalPointers(cJSON * const object, const cJSONUtils_Pointer * const * const pointers, const size_t count, cJSON ** const results);
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_EvalPointersCaseSensitive(cJSON * const object, const cJSONUtils_Pointer * const * const pointers, const size_t count, cJSON ** const results);
+
+/* Implement RFC9535 (https://www.rfc-editor.org/rfc/rfc9535) JSONPath: name, wildcard, index, slice and filter selectors, child and
+ * descendant segments and the functions length(), count(), match(), search() and value(). A path is compiled once (NULL if it isn't
+ * valid or uses unknown functions) and evaluated without allocating: every selected node is passed to the callback in the order
+ * of the RFC's nodelist. Member names are matched case sensitively, queries with only names and indices are resolved like compiled
+ * pointers. match() and search() use I-Regexp (RFC9485) without \p{..} categories, matched in linear time by a fixed size matcher:
+ * paths with patterns too long for it aren't compiled, such patterns taken from the document don't match. Descendant segments
+ * recurse once per level of the document. */
+typedef struct cJSONUtils_Path cJSONUtils_Path;
+/* Return false to stop the query. */
+typedef cJSON_bool (*cJSONUtils_PathCallback)(cJSON *item, void *context);
+CJSON_PUBLIC(cJSONUtils_Path *) cJSONUtils_CompilePath(const char *path);
+CJSON_PUBLIC(void) cJSONUtils_DeletePath(cJSONUtils_Path *path);
+/* Returns the number of nodes passed to callback, which can be NULL to only count them. */
+CJSON_PUBLIC(size_t) cJSONUtils_QueryPath(cJSON * const root, const cJSONUtils_Path * const path, cJSONUtils_PathCallback callback, void *context);
+
+/* Predicates on a field of the elements of an array, to keep only matching records while parsing (see cJSON_ParseFiltered). The
+ * field is a JSON pointer into the element, matched case sensitively, and is compared like in JSONPath filters: equality is
+ * structural, numbers and strings (by code point) are ordered, values of other types never are. A missing field is only unequal.
+ * Returns NULL for invalid pointers and operations or operands that can't be compared. */
+typedef struct cJSONUtils_Predicate cJSONUtils_Predicate;
+#define cJSONUtils_PredicateEqual        0
+#define cJSONUtils_PredicateNotEqual     1
+#define cJSONUtils_PredicateLess         2 /* ordering needs a number or string value */
+#define cJSONUtils_PredicateLessEqual    3
+#define cJSONUtils_PredicateGreater      4
+#define cJSONUtils_PredicateGreaterEqual 5
+#define cJSONUtils_PredicatePrefix       6 /* strings starting with the string value */
+CJSON_PUBLIC(cJSONUtils_Predicate *) cJSONUtils_CompilePredicate(const char *pointer, int operation, const cJSON *value);
+/* low <= field < high for numbers or strings of the type of the bounds, either bound can be NULL for no limit */
+CJSON_PUBLIC(cJSONUtils_Predicate *) cJSONUtils_CompileRangePredicate(const char *pointer, const cJSON *low, const cJSON *high);
+CJSON_PUBLIC(void) cJSONUtils_DeletePredicate(cJSONUtils_Predicate *predicate);
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_MatchPredicate(const cJSONUtils_Predicate *predicate, cJSON *item);
+/* Parse a top level array keeping only the elements that match predicate, the others are deleted as soon as they are parsed. */
+CJSON_PUBLIC(cJSON *) cJSONUtils_ParseFiltered(const char *value, size_t buffer_length, const cJSONUtils_Predicate *predicate);
+
+/* Secondary index over an array of objects: the elements sorted by the value of a field (a JSON pointer into the element, matched case
+ * sensitively), for lookups and range queries in O(log n) instead of a scan. Only elements whose field is false, true, null, a number
+ * or a string are indexed. Values are compared like in JSONPath filters. The index doesn't follow changes of the array: call
+ * cJSONUtils_IndexAdd after adding an element and cJSONUtils_IndexRemove before removing one, other changes to the array or the
+ * indexed fields need a new index. Returns NULL if array isn't an array or the pointer is invalid. */
+typedef struct cJSONUtils_Index cJSONUtils_Index;
+CJSON_PUBLIC(cJSONUtils_Index *) cJSONUtils_CreateIndex(cJSON * const array, const char *pointer);
+CJSON_PUBLIC(void) cJSONUtils_DeleteIndex(cJSONUtils_Index *index);
+/* Return false if memory couldn't be allocated or the element isn't in the index. */
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_IndexAdd(cJSONUtils_Index *index, cJSON *element);
+CJSON_PUBLIC(cJSON_bool) cJSONUtils_IndexRemove(cJSONUtils_Index *index, const cJSON *element);
+/* Pass the elements with a field equal to value, or with low <= field < high (see cJSONUtils_CompileRangePredicate), to callback in
+ * the order of the values and then of the array. Return the number of elements passed, callback can be NULL to only count them. */
+CJSON_PUBLIC(size_t) cJSONUtils_IndexFind(const cJSONUtils_Index *index, const cJSON *value, cJSONUtils_PathCallback callback, void *context);
+CJSON_PUBLIC(size_t) cJSONUtils_IndexRange(const cJSONUtils_Index *index, const cJSON *low, const cJSON *high, cJSONUtils_PathCallback callback, void *context);
 
 /* Implement RFC6902 (https://tools.ietf.org/html/rfc6902) JSON Patch spec. */
-/* NOTE: This modifies objects in 'from' and 'to' by sorting the elements by their key */
+/* NOTE: This modifies objects in 'from' and 'to' by sorting the elements by their key and caches their hashes,
+ * use cJSONUtils_PatchPreserveInput to leave them unchanged */
 CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatches(cJSON * const from, cJSON * const to);
 CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatchesCaseSensitive(cJSON * const from, cJSON * const to);
+/* Flags for cJSONUtils_GeneratePatchesWithOpts */
+#define cJSONUtils_PatchCaseSensitive 1 /* compare object keys case sensitive */
+#define cJSONUtils_PatchArrayDiff     2 /* diff arrays as sequences: elements are matched by a structural hash and only inserted,
+                                         * removed or moved elements produce patches, instead of comparing element by element by
+                                         * position. Falls back to the positional diff if more than CJSON_ARRAY_DIFF_LIMIT (1024)
+                                         * elements are inserted or removed. */
+#define cJSONUtils_PatchPreserveInput 4 /* don't sort the objects or cache hashes in 'from' and 'to', objects are compared through
+                                         * temporary sorted views. Safe on read-only documents shared between threads. */
+#define cJSONUtils_PatchAtomic        8 /* cJSONUtils_ApplyPatchesWithOpts only: log every detached, replaced and added item while applying
+                                         * and undo the changes in reverse order if an operation fails, so the document is either fully
+                                         * patched or left as it was. Costs O(operations) memory instead of a copy of the document.
+                                         * Returns 14 if the log couldn't be allocated. */
+CJSON_PUBLIC(cJSON *) cJSONUtils_GeneratePatchesWithOpts(cJSON * const from, cJSON * const to, int flags);
 /* Utility for generating patch array entries. */
 CJSON_PUBLIC(void) cJSONUtils_AddPatchToArray(cJSON * const array, const char * const operation, const char * const path, const cJSON * const value);
 /* Returns 0 for success. */
 CJSON_PUBLIC(int) cJSONUtils_ApplyPatches(cJSON * const object, const cJSON * const patches);
 CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesCaseSensitive(cJSON * const object, const cJSON * const patches);
+/* Takes cJSONUtils_PatchCaseSensitive and cJSONUtils_PatchAtomic. All ApplyPatches functions resolve the parents of "path"
+ * and "from" through a small cache of containers (keyed by pointer prefix, dropped when something above them changes),
+ * without copying the pointers, so long patches that touch the same few containers don't walk the document again for
+ * every operation. */
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesWithOpts(cJSON * const object, const cJSON * const patches, int flags);
 
-/*
-// Note that ApplyPatches is NOT atomic on failure. To implement an atomic ApplyPatches, use:
-//int cJSONUtils_AtomicApplyPatches(cJSON **object, cJSON *patches)
-//{
-//    cJSON *modme = cJSON_Duplicate(*object, 1);
-//    int error = cJSONUtils_ApplyPatches(modme, patches);
-//    if (!error)
-//    {
-//        cJSON_Delete(*object);
-//        *object = modme;
-//    }
-//    else
-//    {
-//        cJSON_Delete(modme);
-//    }
-//
-//    return error;
-//}
-// Code not added to library since this strategy is a LOT slower.
-*/
+/* Fold a patch into a shorter one with the same effect on every document it applies to without an error: operations
+ * that a later "replace", "remove" or "add" of a member overwrites are dropped, an "add" followed by a "replace" of the
+ * same location becomes one "add", and an "add" of a member that didn't exist before followed by its "remove" disappears.
+ * Operations are only folded across operations that don't touch the same location, its ancestors, its descendants or
+ * (for array indices) the elements next to it; "test" operations are always kept.
+ * Takes cJSONUtils_PatchCaseSensitive, which has to match the flags the patch is applied with.
+ * Returns a new patch, the inputs are not modified. Returns NULL if a patch isn't an array or memory ran out. */
+CJSON_PUBLIC(cJSON *) cJSONUtils_CompactPatches(const cJSON * const patches, int flags);
+/* Compact the operations of first followed by the operations of second */
+CJSON_PUBLIC(cJSON *) cJSONUtils_ComposePatches(const cJSON * const first, const cJSON * const second, int flags);
+
+/* Note that ApplyPatches is NOT atomic on failure, the operations before the failing one stay applied.
+ * Use cJSONUtils_ApplyPatchesWithOpts with cJSONUtils_PatchAtomic to roll them back. */
+
+/* Persistent document versions: apply the patches to a new version of the document instead of changing it. The new root
+ * shares every subtree the patches don't touch with version (see cJSON_CreateSharedReference), only the containers on the
+ * changed paths are copied (their children are shared), so a version costs the changed items and their siblings.
+ * version and the items it shares must not be changed afterwards, every version is deleted with cJSON_Delete on its own,
+ * in any order; shared items are deleted with the last version using them. Not thread safe while versions are created or deleted.
+ * Takes cJSONUtils_PatchCaseSensitive. Returns 0 and the new version in result, or the error of ApplyPatches
+ * (15 if out of memory), version is never changed. */
+CJSON_PUBLIC(int) cJSONUtils_ApplyPatchesToVersion(cJSON * const version, const cJSON * const patches, int flags, cJSON ** const result);
 
 /* Implement RFC7386 (https://tools.ietf.org/html/rfc7396) JSON Merge Patch spec. */
 /* target will be modified by patch. return value is new ptr for target. */
 CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatch(cJSON *target, const cJSON * const patch);
 CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatchCaseSensitive(cJSON *target, const cJSON * const patch);
+/* Merge patch into a new version sharing the untouched subtrees of version, like cJSONUtils_ApplyPatchesToVersion.
+ * Takes cJSONUtils_PatchCaseSensitive. Returns NULL if out of memory. */
+CJSON_PUBLIC(cJSON *) cJSONUtils_MergePatchToVersion(cJSON * const version, const cJSON * const patch, int flags);
 /* generates a patch to move from -> to */
-/* NOTE: This modifies objects in 'from' and 'to' by sorting the elements by their key */
+/* NOTE: This modifies objects in 'from' and 'to' by sorting the elements by their key, unless cJSONUtils_PatchPreserveInput is used */
 CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatch(cJSON * const from, cJSON * const to);
 CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatchCaseSensitive(cJSON * const from, cJSON * const to);
+/* Takes cJSONUtils_PatchCaseSensitive and cJSONUtils_PatchPreserveInput */
+CJSON_PUBLIC(cJSON *) cJSONUtils_GenerateMergePatchWithOpts(cJSON * const from, cJSON * const to, int flags);
 
-/* Given a root object and a target object, construct a pointer from one to the other. */
+/* Given a root object and a target object, construct a pointer from one to the other.
+ * Follows the parent links up from target (O(depth + the positions of the array elements on the way)), only items reached
+ * through references need a full search. */
 CJSON_PUBLIC(char *) cJSONUtils_FindPointerFromObjectTo(const cJSON * const object, const cJSON * const target);
 
 /* Sorts the members of the object into alphabetical order. */
@@ -1,6 +1,7 @@
 #include "easy_json.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 static void ensure_valid(EasyJSON *ej) {
     if (!ej) return; /* 由调用者处理空指针 */
@@ -52,6 +53,98 @@ EasyJSON *ej_parse(const char *json_str) {
     return wrap_cjson(node, 1);
 }
 
+EasyJSON *ej_parse_parallel(const char *json_str, size_t length, int threads) {
+    cJSONPool *pool = NULL;
+    cJSON *node;
+
+    if (!json_str) return NULL;
+    if (threads != 1) pool = cJSONPool_Create(threads);
+    node = cJSON_ParseParallel(json_str, length, pool);
+    cJSONPool_Delete(pool);
+    return wrap_cjson(node, 1);
+}
+
+EasyJSON *ej_parse_projected(const char *json_str, size_t length, const char * const *pointers, size_t count) {
+    cJSON_Projection *projection;
+    cJSON *node;
+
+    if (!json_str) return NULL;
+    projection = cJSON_CreateProjection(pointers, count);
+    if (!projection) return NULL;
+    node = cJSON_ParseProjected(json_str, length, projection);
+    cJSON_DeleteProjection(projection);
+    return wrap_cjson(node, 1);
+}
+
+/* 每个节点单独分配，从克隆中取下的节点在释放克隆后仍然有效；
+ * cJSON_DuplicateBlock 更快，但其节点随根节点一起释放，不适合通用的包装 */
+EasyJSON *ej_clone(const EasyJSON *ej) {
+    if (!ej || !ej->node) return NULL;
+    return wrap_cjson(cJSON_Duplicate(ej->node, 1), 1);
+}
+
+/* 二级索引：数组节点标记为 cJSON_Watched，cJSON 在数组或其子孙被修改、数组被释放时回调 watch_index，
+ * 无论通过哪个包装、补丁还是直接调用 cJSON 修改都能得知，登记表中只保留仍然存活的数组 */
+enum { INDEX_CURRENT, INDEX_STALE, INDEX_DELETED };
+
+struct EJIndex {
+    cJSONUtils_Index *index;
+    cJSON *array;           /* 数组释放后为 NULL */
+    char *pointer;          /* 过期后重建索引用 */
+    int state;
+    int expected;           /* ej_append/ej_remove_index 已同步更新、不应使索引过期的修改次数 */
+    struct EJIndex *next;   /* 登记表中的下一个索引 */
+};
+
+static EJIndex *registered_indexes = NULL;
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* cJSON 的回调，只对被索引的数组调用，index_lock 由这里获取 */
+static void watch_index(cJSON *item, cJSON_bool deleted) {
+    EJIndex **link = &registered_indexes;
+
+    pthread_mutex_lock(&index_lock);
+    while (*link) {
+        EJIndex *index = *link;
+        if (index->array != item) {
+            link = &index->next;
+            continue;
+        }
+        if (deleted) {
+            index->state = INDEX_DELETED;
+            index->array = NULL;
+            *link = index->next;
+            index->next = NULL;
+            continue;
+        }
+        if (index->expected > 0) {
+            index->expected--;
+        } else {
+            index->state = INDEX_STALE;
+        }
+        link = &index->next;
+    }
+    pthread_mutex_unlock(&index_lock);
+}
+
+/* element 加入 array 之前、从 array 移除之前调用：同步更新建在 array 上的最新索引，并让随后的那次修改通知不使它们过期 */
+static void update_indexes(cJSON *array, cJSON *element, int added) {
+    EJIndex *index;
+
+    if (!(array->type & cJSON_Watched)) return;
+    pthread_mutex_lock(&index_lock);
+    for (index = registered_indexes; index; index = index->next) {
+        if (index->array != array) continue;
+        if (index->state == INDEX_CURRENT
+            && (added ? cJSONUtils_IndexAdd(index->index, element) : cJSONUtils_IndexRemove(index->index, element))) {
+            index->expected++;
+        } else {
+            index->state = INDEX_STALE;
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+}
+
 /* 释放函数 */
 void ej_free(EasyJSON *ej) {
     if (ej && ej->owns_memory && ej->node) {
@@ -68,6 +161,12 @@ void ej_free_string(char *str) {
     }
 }
 
+void ej_free_buffer(void *buffer) {
+    if (buffer) {
+        cJSON_free(buffer);
+    }
+}
+
 /* 类型检查 */
 EJType ej_type(const EasyJSON *ej) {
     if (!ej || !ej->node) return EJ_INVALID;
@@ -124,6 +223,202 @@ EasyJSON *ej_pointer(const EasyJSON *ej, const char *pointer) {
     return wrap_cjson(node, 0); /* 不拥有内存 */
 }
 
+EJPointer *ej_pointer_compile(const char *pointer) {
+    return cJSONUtils_CompilePointer(pointer);
+}
+
+EasyJSON *ej_pointer_eval(const EasyJSON *ej, const EJPointer *compiled) {
+    if (!ej || !ej->node || !compiled) return NULL;
+    return wrap_cjson(cJSONUtils_EvalPointer(ej->node, compiled), 0); /* 不拥有内存 */
+}
+
+void ej_pointer_free(EJPointer *compiled) {
+    cJSONUtils_DeletePointer(compiled);
+}
+
+int ej_pointer_multi(const EasyJSON *ej, const EJPointer * const *compiled, size_t n, EasyJSON **out) {
+    cJSON **nodes;
+    size_t i;
+    int found = 0;
+
+    if (!ej || !ej->node || !compiled || !out) return -1;
+    nodes = (cJSON **)malloc((n ? n : 1) * sizeof(cJSON *));
+    if (!nodes) return -1;
+    if (!cJSONUtils_EvalPointers(ej->node, compiled, n, nodes)) {
+        free(nodes);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        out[i] = wrap_cjson(nodes[i], 0); /* 不拥有内存 */
+        if (out[i]) found++;
+    }
+    free(nodes);
+    return found;
+}
+
+char *ej_find_pointer(const EasyJSON *root, const EasyJSON *target) {
+    if (!root || !root->node || !target || !target->node) return NULL;
+    return cJSONUtils_FindPointerFromObjectTo(root->node, target->node);
+}
+
+/* JSONPath 查询 */
+EJPath *ej_path_compile(const char *path) {
+    return cJSONUtils_CompilePath(path);
+}
+
+void ej_path_free(EJPath *compiled) {
+    cJSONUtils_DeletePath(compiled);
+}
+
+typedef struct {
+    EJPathCallback callback;
+    void *context;
+} EJPathAdapter;
+
+static cJSON_bool path_callback(cJSON *item, void *context) {
+    EJPathAdapter *adapter = (EJPathAdapter *)context;
+    EasyJSON node = { item, 0 }; /* 栈上的包装，不分配内存 */
+    return adapter->callback(&node, adapter->context) ? 1 : 0;
+}
+
+long ej_path_query(const EasyJSON *ej, const EJPath *compiled, EJPathCallback callback, void *context) {
+    EJPathAdapter adapter = { callback, context };
+    if (!ej || !ej->node || !compiled) return -1;
+    return (long)cJSONUtils_QueryPath(ej->node, compiled, callback ? path_callback : NULL, &adapter);
+}
+
+long ej_query(const EasyJSON *ej, const char *path, EJPathCallback callback, void *context) {
+    EJPath *compiled = ej_path_compile(path);
+    long count;
+
+    if (!compiled) return -1;
+    count = ej_path_query(ej, compiled, callback, context);
+    ej_path_free(compiled);
+    return count;
+}
+
+EJPredicate *ej_predicate_compile(const char *pointer, int operation, const EasyJSON *value) {
+    if (!value) return NULL;
+    return cJSONUtils_CompilePredicate(pointer, operation, value->node);
+}
+
+EJPredicate *ej_predicate_range(const char *pointer, const EasyJSON *low, const EasyJSON *high) {
+    return cJSONUtils_CompileRangePredicate(pointer, low ? low->node : NULL, high ? high->node : NULL);
+}
+
+void ej_predicate_free(EJPredicate *predicate) {
+    cJSONUtils_DeletePredicate(predicate);
+}
+
+int ej_predicate_match(const EJPredicate *predicate, const EasyJSON *ej) {
+    if (!ej) return 0;
+    return cJSONUtils_MatchPredicate(predicate, ej->node) ? 1 : 0;
+}
+
+EasyJSON *ej_parse_filtered(const char *json_str, size_t length, const EJPredicate *predicate) {
+    if (!json_str) return NULL;
+    return wrap_cjson(cJSONUtils_ParseFiltered(json_str, length, predicate), 1);
+}
+
+EJIndex *ej_index_build(EasyJSON *array, const char *pointer) {
+    EJIndex *index;
+    size_t length;
+
+    if (!ej_is_array(array) || !pointer) return NULL;
+    index = (EJIndex *)malloc(sizeof(EJIndex));
+    if (!index) return NULL;
+    length = strlen(pointer) + 1;
+    index->pointer = (char *)malloc(length);
+    index->index = index->pointer ? cJSONUtils_CreateIndex(array->node, pointer) : NULL;
+    if (!index->index) {
+        free(index->pointer);
+        free(index);
+        return NULL;
+    }
+    memcpy(index->pointer, pointer, length);
+    index->array = array->node;
+    index->state = INDEX_CURRENT;
+    index->expected = 0;
+    pthread_mutex_lock(&index_lock);
+    if (!registered_indexes) cJSON_SetWatchHook(watch_index);
+    index->next = registered_indexes;
+    registered_indexes = index;
+    array->node->type |= cJSON_Watched;
+    pthread_mutex_unlock(&index_lock);
+    return index;
+}
+
+void ej_index_free(EJIndex *index) {
+    EJIndex **link;
+    EJIndex *other;
+    int watched = 0;
+
+    if (!index) return;
+    pthread_mutex_lock(&index_lock);
+    for (link = &registered_indexes; *link; link = &(*link)->next) {
+        if (*link == index) {
+            *link = index->next;
+            break;
+        }
+    }
+    if (index->array) {
+        for (other = registered_indexes; other; other = other->next) {
+            if (other->array == index->array) watched = 1;
+        }
+        if (!watched) index->array->type &= ~cJSON_Watched;
+    }
+    if (!registered_indexes) cJSON_SetWatchHook(NULL);
+    pthread_mutex_unlock(&index_lock);
+    cJSONUtils_DeleteIndex(index->index);
+    free(index->pointer);
+    free(index);
+}
+
+/* 过期的索引在这里按数组的当前内容重建，数组已释放或不再是数组时返回 0 */
+static int index_usable(EJIndex *index) {
+    cJSONUtils_Index *rebuilt;
+    int usable;
+
+    if (!index) return 0;
+    pthread_mutex_lock(&index_lock);
+    if (index->state == INDEX_STALE) {
+        rebuilt = cJSONUtils_CreateIndex(index->array, index->pointer);
+        if (rebuilt) {
+            cJSONUtils_DeleteIndex(index->index);
+            index->index = rebuilt;
+            index->state = INDEX_CURRENT;
+            index->expected = 0;
+        }
+    }
+    usable = index->state == INDEX_CURRENT;
+    pthread_mutex_unlock(&index_lock);
+    return usable;
+}
+
+long ej_index_find(EJIndex *index, const EasyJSON *value, EJPathCallback callback, void *context) {
+    EJPathAdapter adapter = { callback, context };
+    if (!index_usable(index) || !value || !value->node) return -1;
+    return (long)cJSONUtils_IndexFind(index->index, value->node, callback ? path_callback : NULL, &adapter);
+}
+
+long ej_index_range(EJIndex *index, const EasyJSON *low, const EasyJSON *high, EJPathCallback callback, void *context) {
+    EJPathAdapter adapter = { callback, context };
+    if (!index_usable(index)) return -1;
+    return (long)cJSONUtils_IndexRange(index->index, low ? low->node : NULL, high ? high->node : NULL, callback ? path_callback : NULL, &adapter);
+}
+
+static cJSON_bool first_element(cJSON *item, void *context) {
+    *(cJSON **)context = item;
+    return 0;
+}
+
+EasyJSON *ej_index_get(EJIndex *index, const EasyJSON *value) {
+    cJSON *found = NULL;
+    if (!index_usable(index) || !value || !value->node) return NULL;
+    cJSONUtils_IndexFind(index->index, value->node, first_element, &found);
+    return wrap_cjson(found, 0); /* 不拥有内存 */
+}
+
 /* 设置值 */
 void ej_set(EasyJSON *ej, const char *key, EasyJSON *value) {
     if (!ej) return;
@@ -179,6 +474,7 @@ void ej_append(EasyJSON *ej, EasyJSON *value) {
         ej->owns_memory = 1;
     }
     if (!value || !value->node) return; /* 无效值，跳过 */
+    update_indexes(ej->node, value->node, 1);
     cJSON_AddItemToArray(ej->node, value->node);
     value->owns_memory = 0; /* 转移所有权 */
     ej_free(value);
@@ -222,8 +518,10 @@ void ej_remove(EasyJSON *ej, const char *key) {
 
 void ej_remove_index(EasyJSON *ej, int index) {
     if (ej && ej_is_array(ej) && index >= 0) {
-        cJSON *old = cJSON_DetachItemFromArray(ej->node, index);
-        if (old) cJSON_Delete(old);
+        cJSON *old = cJSON_GetArrayItem(ej->node, index);
+        if (!old) return;
+        update_indexes(ej->node, old, 0);
+        cJSON_Delete(cJSON_DetachItemViaPointer(ej->node, old));
     }
 }
 
@@ -233,18 +531,213 @@ char *ej_to_string(const EasyJSON *ej, int formatted) {
     return formatted ? cJSON_Print(ej->node) : cJSON_PrintUnformatted(ej->node);
 }
 
+char *ej_to_string_parallel(const EasyJSON *ej, int formatted, int threads) {
+    cJSONPool *pool = NULL;
+    char *result;
+
+    if (!ej || !ej->node) return NULL;
+    if (threads != 1) pool = cJSONPool_Create(threads);
+    result = cJSON_PrintParallel(ej->node, formatted ? 1 : 0, pool);
+    cJSONPool_Delete(pool);
+    return result;
+}
+
+EJPrintCache *ej_print_cache_create(size_t threshold) {
+    return cJSON_CreatePrintCache(threshold ? threshold : 4096);
+}
+
+char *ej_to_string_cached(const EasyJSON *ej, int formatted, EJPrintCache *cache) {
+    if (!ej || !ej->node) return NULL;
+    if (!cache) return ej_to_string(ej, formatted);
+    return cJSON_PrintWithCache(ej->node, formatted ? 1 : 0, cache);
+}
+
+void ej_print_cache_free(EJPrintCache *cache) {
+    cJSON_DeletePrintCache(cache);
+}
+
+#ifndef _WIN32
+int ej_write_fd(const EasyJSON *ej, int fd, int formatted, int threads) {
+    cJSONPool *pool = NULL;
+    int result;
+
+    if (!ej || !ej->node || fd < 0) return 0;
+    if (threads != 1) pool = cJSONPool_Create(threads);
+    result = cJSON_PrintParallelToFd(ej->node, formatted ? 1 : 0, pool, fd) ? 1 : 0;
+    cJSONPool_Delete(pool);
+    return result;
+}
+#endif
+
+/* 规范化 JSON（RFC 8785） */
+char *ej_to_canonical(const EasyJSON *ej) {
+    if (!ej || !ej->node) return NULL;
+    return cJSONJCS_Print(ej->node);
+}
+
+int ej_canonical_digest(const EasyJSON *ej, unsigned char digest[32]) {
+    if (!ej || !ej->node || !digest) return 0;
+    return cJSONJCS_Digest(ej->node, digest) ? 1 : 0;
+}
+
+/* MessagePack 编解码 */
+unsigned char *ej_to_msgpack(const EasyJSON *ej, size_t *length) {
+    if (!ej || !ej->node || !length) return NULL;
+    return cJSONMsgPack_Encode(ej->node, length);
+}
+
+EasyJSON *ej_from_msgpack(const unsigned char *data, size_t length) {
+    if (!data) return NULL;
+    return wrap_cjson(cJSONMsgPack_Decode(data, length, NULL), 1);
+}
+
+/* CBOR 编解码 */
+unsigned char *ej_to_cbor(const EasyJSON *ej, size_t *length) {
+    if (!ej || !ej->node || !length) return NULL;
+    return cJSONCBOR_Encode(ej->node, length);
+}
+
+EasyJSON *ej_from_cbor(const unsigned char *data, size_t length) {
+    if (!data) return NULL;
+    return wrap_cjson(cJSONCBOR_Decode(data, length, cJSONCBOR_BytesBase64Url, NULL), 1);
+}
+
+EJCborDecoder *ej_cbor_decoder_create(void) {
+    return cJSONCBOR_CreateDecoder(cJSONCBOR_BytesBase64Url);
+}
+
+int ej_cbor_decoder_feed(EJCborDecoder *decoder, const unsigned char *data, size_t length, size_t *consumed) {
+    return cJSONCBOR_Feed(decoder, data, length, consumed);
+}
+
+EasyJSON *ej_cbor_decoder_take(EJCborDecoder *decoder) {
+    return wrap_cjson(cJSONCBOR_TakeResult(decoder), 1);
+}
+
+void ej_cbor_decoder_free(EJCborDecoder *decoder) {
+    cJSONCBOR_DeleteDecoder(decoder);
+}
+
+/* NDJSON 并行解析 */
+typedef struct {
+    EJLineCallback callback;
+    void *context;
+} EJLineAdapter;
+
+static cJSON_bool ndjson_line_callback(cJSON *item, size_t line, void *context) {
+    EJLineAdapter *adapter = (EJLineAdapter *)context;
+    return adapter->callback(wrap_cjson(item, 1), line, adapter->context) ? 1 : 0;
+}
+
+static int run_ndjson(const char *data, size_t length, FILE *file, int threads, int ordered, EJLineCallback callback, void *context) {
+    EJLineAdapter adapter = { callback, context };
+    cJSONPool *pool = NULL;
+    int flags = ordered ? cJSONNDJSON_Ordered : cJSONNDJSON_Unordered;
+    int result;
+
+    if (threads != 1) {
+        pool = cJSONPool_Create(threads);
+        if (!pool) return 0;
+    }
+    if (file) {
+        result = cJSONNDJSON_ParseFile(file, pool, flags, ndjson_line_callback, &adapter);
+    } else {
+        result = cJSONNDJSON_Parse(data, length, pool, flags, ndjson_line_callback, &adapter);
+    }
+    cJSONPool_Delete(pool);
+    return result ? 1 : 0;
+}
+
+int ej_parse_ndjson(const char *data, size_t length, int threads, int ordered, EJLineCallback callback, void *context) {
+    if ((!data && length > 0) || !callback) return 0;
+    return run_ndjson(data, length, NULL, threads, ordered, callback, context);
+}
+
+int ej_parse_ndjson_file(const char *path, int threads, int ordered, EJLineCallback callback, void *context) {
+    FILE *file;
+    int result;
+
+    if (!path || !callback) return 0;
+    file = fopen(path, "rb");
+    if (!file) return 0;
+    result = run_ndjson(NULL, 0, file, threads, ordered, callback, context);
+    fclose(file);
+    return result;
+}
+
 /* 补丁操作 */
+int ej_equals(const EasyJSON *a, const EasyJSON *b) {
+    if (!a || !b || !a->node || !b->node) return 0;
+    return cJSON_Compare(a->node, b->node, 1);
+}
+
+unsigned long long ej_hash(EasyJSON *ej) {
+    if (!ej || !ej->node) return 0;
+    return cJSON_GetHash(ej->node);
+}
+
 EasyJSON *ej_generate_patch(EasyJSON *from, EasyJSON *to) {
     if (!from || !to || !from->node || !to->node) return NULL;
     cJSON *patch = cJSONUtils_GeneratePatches(from->node, to->node);
     return wrap_cjson(patch, 1);
 }
 
+EasyJSON *ej_generate_patch_opts(EasyJSON *from, EasyJSON *to, int flags) {
+    if (!from || !to || !from->node || !to->node) return NULL;
+    cJSON *patch = cJSONUtils_GeneratePatchesWithOpts(from->node, to->node, flags);
+    return wrap_cjson(patch, 1);
+}
+
+EasyJSON *ej_generate_merge_patch(EasyJSON *from, EasyJSON *to, int flags) {
+    if (!from || !to || !from->node || !to->node) return NULL;
+    cJSON *patch = cJSONUtils_GenerateMergePatchWithOpts(from->node, to->node, flags);
+    return wrap_cjson(patch, 1);
+}
+
 int ej_apply_patch(EasyJSON *ej, EasyJSON *patch) {
     if (!ej || !patch || !ej->node || !patch->node) return -1;
     return cJSONUtils_ApplyPatches(ej->node, patch->node);
 }
 
+int ej_apply_patch_opts(EasyJSON *ej, EasyJSON *patch, int flags) {
+    if (!ej || !patch || !ej->node || !patch->node) return -1;
+    return cJSONUtils_ApplyPatchesWithOpts(ej->node, patch->node, flags);
+}
+
+/* 与 RFC 6902 的 JSON Pointer 一样按大小写敏感的方式匹配路径 */
+EasyJSON *ej_patch_compose(EasyJSON *p1, EasyJSON *p2) {
+    return ej_patch_compose_opts(p1, p2, cJSONUtils_PatchCaseSensitive);
+}
+
+EasyJSON *ej_patch_compose_opts(EasyJSON *p1, EasyJSON *p2, int flags) {
+    if (!p1 || !p2 || !p1->node || !p2->node) return NULL;
+    cJSON *patch = cJSONUtils_ComposePatches(p1->node, p2->node, flags);
+    return wrap_cjson(patch, 1);
+}
+
+EasyJSON *ej_patch_compact(EasyJSON *p) {
+    return ej_patch_compact_opts(p, cJSONUtils_PatchCaseSensitive);
+}
+
+EasyJSON *ej_patch_compact_opts(EasyJSON *p, int flags) {
+    if (!p || !p->node) return NULL;
+    cJSON *patch = cJSONUtils_CompactPatches(p->node, flags);
+    return wrap_cjson(patch, 1);
+}
+
+/* 文档版本：新版本与旧版本共享未修改的子树，各版本都用 ej_free 释放，顺序任意 */
+EasyJSON *ej_apply_patch_version(EasyJSON *version, EasyJSON *patch, int flags) {
+    cJSON *next = NULL;
+    if (!version || !patch || !version->node || !patch->node) return NULL;
+    if (cJSONUtils_ApplyPatchesToVersion(version->node, patch->node, flags, &next) != 0) return NULL;
+    return wrap_cjson(next, 1);
+}
+
+EasyJSON *ej_merge_patch_version(EasyJSON *version, EasyJSON *patch, int flags) {
+    if (!version || !patch || !version->node || !patch->node) return NULL;
+    return wrap_cjson(cJSONUtils_MergePatchToVersion(version->node, patch->node, flags), 1);
+}
+
 /* 内存所有权控制 */
 void ej_take_ownership(EasyJSON *ej) {
     if (ej) ej->owns_memory = 1;
@@ -3,6 +3,10 @@
 
 #include "cJSON.h"
 #include "cJSON_Utils.h"
+#include "cJSON_MsgPack.h"
+#include "cJSON_CBOR.h"
+#include "cJSON_NDJSON.h"
+#include "cJSON_JCS.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,10 +37,14 @@ EasyJSON *ej_create_bool(int value);
 EasyJSON *ej_create_number(double value);
 EasyJSON *ej_create_string(const char *value);
 EasyJSON *ej_parse(const char *json_str);
+EasyJSON *ej_parse_parallel(const char *json_str, size_t length, int threads); /* 顶层大数组的元素分块多线程解析，结果与 ej_parse 一致；threads 为 0 时使用全部 CPU */
+EasyJSON *ej_parse_projected(const char *json_str, size_t length, const char * const *pointers, size_t count); /* 只解析 JSON 指针选中的对象成员（字段掩码，数组透明），其余成员只校验跳过；pointers 非法时返回 NULL */
+EasyJSON *ej_clone(const EasyJSON *ej); /* 深拷贝，克隆中的节点可以取下后单独保留 */
 
 /* 释放函数 */
 void ej_free(EasyJSON *ej);
 void ej_free_string(char *str); /* 释放 ej_to_string 返回的字符串 */
+void ej_free_buffer(void *buffer); /* 释放 ej_to_msgpack 等返回的二进制缓冲区 */
 
 /* 类型检查 */
 EJType ej_type(const EasyJSON *ej);
@@ -55,6 +63,38 @@ EasyJSON *ej_get(const EasyJSON *ej, const char *key); /* 对象键 */
 EasyJSON *ej_get_index(const EasyJSON *ej, int index); /* 数组索引 */
 EasyJSON *ej_pointer(const EasyJSON *ej, const char *pointer); /* JSON 指针 */
 
+/* 预编译的 JSON 指针，适合反复查询同一路径 */
+typedef struct cJSONUtils_Pointer EJPointer;
+EJPointer *ej_pointer_compile(const char *pointer); /* 指针非法时返回 NULL，需用 ej_pointer_free 释放 */
+EasyJSON *ej_pointer_eval(const EasyJSON *ej, const EJPointer *compiled); /* 与 ej_pointer 结果相同，返回的包装不拥有内存 */
+void ej_pointer_free(EJPointer *compiled);
+int ej_pointer_multi(const EasyJSON *ej, const EJPointer * const *compiled, size_t n, EasyJSON **out); /* 一次遍历解析多个指针，out[i] 需用 ej_free 释放（不拥有内存），返回找到的个数，失败返回 -1 */
+char *ej_find_pointer(const EasyJSON *root, const EasyJSON *target); /* 由 target 反查其在 root 中的 JSON 指针，找不到返回 NULL，需用 ej_free_string 释放 */
+
+/* JSONPath 查询（RFC 9535），支持通配符、递归下降、切片和过滤表达式，可预编译后反复查询 */
+typedef struct cJSONUtils_Path EJPath;
+typedef int (*EJPathCallback)(EasyJSON *node, void *context); /* node 不拥有内存且只在回调内有效，不要 ej_free；返回 0 停止查询 */
+EJPath *ej_path_compile(const char *path); /* 路径非法时返回 NULL，需用 ej_path_free 释放 */
+void ej_path_free(EJPath *compiled);
+long ej_path_query(const EasyJSON *ej, const EJPath *compiled, EJPathCallback callback, void *context); /* 按文档顺序把命中节点交给回调，查询过程不分配内存；返回交给回调的节点数，callback 为 NULL 时只计数，参数无效返回 -1 */
+long ej_query(const EasyJSON *ej, const char *path, EJPathCallback callback, void *context); /* 编译后查询一次，路径非法返回 -1 */
+
+/* 按记录字段过滤顶层数组：每个元素解析完立即用谓词判断，不匹配的立刻释放，内存只随匹配的记录增长 */
+typedef struct cJSONUtils_Predicate EJPredicate;
+EJPredicate *ej_predicate_compile(const char *pointer, int operation, const EasyJSON *value); /* pointer 为元素内字段的 JSON 指针，operation 为 cJSONUtils_Predicate*（相等、大小比较、字符串前缀），参数非法时返回 NULL */
+EJPredicate *ej_predicate_range(const char *pointer, const EasyJSON *low, const EasyJSON *high); /* low <= 字段 < high，low/high 可为 NULL 表示不限 */
+void ej_predicate_free(EJPredicate *predicate);
+int ej_predicate_match(const EJPredicate *predicate, const EasyJSON *ej);
+EasyJSON *ej_parse_filtered(const char *json_str, size_t length, const EJPredicate *predicate); /* predicate 为 NULL 时保留全部元素 */
+
+/* 对象数组的二级索引：按元素字段值排序，等值查找和范围查询 O(log n)，只索引值为 bool/null/数字/字符串的元素 */
+typedef struct EJIndex EJIndex;
+EJIndex *ej_index_build(EasyJSON *array, const char *pointer); /* pointer 为元素内字段的 JSON 指针；对该数组 ej_append/ej_remove_index 时索引同步更新，其他修改（对元素 ej_set、应用补丁、直接调用 cJSON 等）使索引过期，下次查询时自动重建 */
+void ej_index_free(EJIndex *index); /* 可在数组释放之后调用 */
+long ej_index_find(EJIndex *index, const EasyJSON *value, EJPathCallback callback, void *context); /* 按数组顺序把字段等于 value 的元素交给回调，返回个数；数组已释放（无论以何种方式）或重建失败返回 -1 */
+long ej_index_range(EJIndex *index, const EasyJSON *low, const EasyJSON *high, EJPathCallback callback, void *context); /* low <= 字段 < high，low/high 可为 NULL 表示不限，按字段值排序 */
+EasyJSON *ej_index_get(EJIndex *index, const EasyJSON *value); /* 第一个字段等于 value 的元素，返回的包装不拥有内存 */
+
 /* 设置值 */
 void ej_set(EasyJSON *ej, const char *key, EasyJSON *value); /* 对象 */
 void ej_set_string(EasyJSON *ej, const char *key, const char *value);
@@ -75,10 +115,59 @@ void ej_remove_index(EasyJSON *ej, int index); /* 从数组删除 */
 
 /* 序列化 */
 char *ej_to_string(const EasyJSON *ej, int formatted); /* 返回字符串，需用 ej_free_string 释放 */
+char *ej_to_string_parallel(const EasyJSON *ej, int formatted, int threads); /* 大数组/对象分段多线程序列化，结果与 ej_to_string 一致 */
+#ifndef _WIN32
+int ej_write_fd(const EasyJSON *ej, int fd, int formatted, int threads); /* 并行序列化后用 writev 写入 fd，成功返回 1 */
+#endif
+
+/* 增量序列化：缓存保存上次输出中不小于 threshold 字节的数组/对象文本，再次序列化时未修改的子树直接拷贝，只重新生成修改过的路径 */
+typedef struct cJSON_PrintCache EJPrintCache;
+EJPrintCache *ej_print_cache_create(size_t threshold); /* threshold 为 0 时使用 4096 */
+char *ej_to_string_cached(const EasyJSON *ej, int formatted, EJPrintCache *cache); /* 结果与 ej_to_string 一致，一个缓存只用于一个文档 */
+void ej_print_cache_free(EJPrintCache *cache);
+
+/* 规范化 JSON（RFC 8785）：对象键按 UTF-16 排序、数字取最短往返形式、无空白，相等的文档输出的字节相同，可用于缓存键和签名；不修改文档 */
+char *ej_to_canonical(const EasyJSON *ej); /* 需用 ej_free_string 释放；含重复键、NaN/Inf 或 raw 值时返回 NULL */
+int ej_canonical_digest(const EasyJSON *ej, unsigned char digest[32]); /* 规范化文本的 SHA-256，边序列化边计算，不生成字符串，成功返回 1 */
+
+/* MessagePack 编解码，直接在 cJSON 树和二进制之间转换 */
+unsigned char *ej_to_msgpack(const EasyJSON *ej, size_t *length); /* 返回缓冲区，长度写入 length，需用 ej_free_buffer 释放 */
+EasyJSON *ej_from_msgpack(const unsigned char *data, size_t length);
+
+/* CBOR 编解码，字节串解码为 base64url 字符串 */
+unsigned char *ej_to_cbor(const EasyJSON *ej, size_t *length); /* 返回缓冲区，需用 ej_free_buffer 释放 */
+EasyJSON *ej_from_cbor(const unsigned char *data, size_t length);
+
+/* CBOR 增量解码，数据可以任意切分后分多次喂入 */
+typedef struct cJSONCBOR_Decoder EJCborDecoder;
+EJCborDecoder *ej_cbor_decoder_create(void);
+int ej_cbor_decoder_feed(EJCborDecoder *decoder, const unsigned char *data, size_t length, size_t *consumed); /* 1 完成，0 需要更多数据，-1 出错 */
+EasyJSON *ej_cbor_decoder_take(EJCborDecoder *decoder); /* 取出解码结果，解码器可继续解码下一个数据项 */
+void ej_cbor_decoder_free(EJCborDecoder *decoder);
+
+/* NDJSON（每行一个 JSON）并行解析，threads 为 0 时使用全部 CPU，为 1 时只在当前线程解析 */
+typedef int (*EJLineCallback)(EasyJSON *record, size_t line, void *context); /* record 需用 ej_free 释放，该行解析失败时为 NULL；返回 0 停止读取 */
+int ej_parse_ndjson(const char *data, size_t length, int threads, int ordered, EJLineCallback callback, void *context); /* ordered 为 0 时回调在工作线程中并发调用 */
+int ej_parse_ndjson_file(const char *path, int threads, int ordered, EJLineCallback callback, void *context);
+
+/* 比较与结构哈希 */
+int ej_equals(const EasyJSON *a, const EasyJSON *b); /* 深度比较，对象成员顺序无关 */
+unsigned long long ej_hash(EasyJSON *ej); /* 64 位结构哈希，缓存在节点中，修改后自动失效；相等的值哈希相同 */
 
 /* 补丁操作 */
 EasyJSON *ej_generate_patch(EasyJSON *from, EasyJSON *to);
+EasyJSON *ej_generate_patch_opts(EasyJSON *from, EasyJSON *to, int flags); /* flags 为 cJSONUtils_Patch* 的组合，如 cJSONUtils_PatchArrayDiff 按序列比较数组，生成最少的 add/remove/move；cJSONUtils_PatchPreserveInput 不修改输入，可在多线程间共享只读文档 */
+EasyJSON *ej_generate_merge_patch(EasyJSON *from, EasyJSON *to, int flags); /* RFC 7396 合并补丁，两者相同时返回 NULL */
 int ej_apply_patch(EasyJSON *ej, EasyJSON *patch);
+int ej_apply_patch_opts(EasyJSON *ej, EasyJSON *patch, int flags); /* flags 可含 cJSONUtils_PatchAtomic：任一操作失败时按撤销日志回滚，文档保持原样，无需预先复制整个文档 */
+EasyJSON *ej_patch_compose(EasyJSON *p1, EasyJSON *p2); /* 把 p1 之后应用 p2 合并为一个等价的补丁，被后续操作覆盖的操作会被去掉 */
+EasyJSON *ej_patch_compact(EasyJSON *p); /* 压缩补丁：同一位置上反复的 replace、先 add 后 replace 等折叠为一个操作 */
+/* ej_patch_compose / ej_patch_compact 按大小写敏感的方式比较路径；_opts 版本的 flags 应与之后应用补丁时的 flags 一致，
+ * 按大小写不敏感应用（ej_apply_patch）时传 0 */
+EasyJSON *ej_patch_compose_opts(EasyJSON *p1, EasyJSON *p2, int flags);
+EasyJSON *ej_patch_compact_opts(EasyJSON *p, int flags);
+EasyJSON *ej_apply_patch_version(EasyJSON *version, EasyJSON *patch, int flags); /* 不修改 version，返回共享未修改子树的新版本，失败返回 NULL；之后 version 不能再被修改 */
+EasyJSON *ej_merge_patch_version(EasyJSON *version, EasyJSON *patch, int flags); /* RFC 7396 合并补丁生成新版本，规则同上 */
 
 /* 内存所有权控制 */
 void ej_take_ownership(EasyJSON *ej);
@@ -0,0 +1,658 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "easy_json.h"
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        printf("%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static int count_node(EasyJSON *node, void *context) {
+    (void)node;
+    (*(int *)context)++;
+    return 1;
+}
+
+/* 通过另一个包装修改数组时，建在数组上的索引同步更新；数组被删除后索引失效 */
+static void test_index_other_wrapper(void) {
+    EasyJSON *doc = ej_parse("{\"t\":[{\"id\":1},{\"id\":2},{\"id\":3}]}");
+    EasyJSON *two = ej_create_number(2);
+    EasyJSON *table = ej_get(doc, "t");
+    EasyJSON *other;
+    EasyJSON *found;
+    EasyJSON *id;
+    EJIndex *index = ej_index_build(table, "/id");
+    int count = 0;
+
+    CHECK(index != NULL);
+    CHECK(ej_index_find(index, two, count_node, &count) == 1);
+
+    other = ej_get(doc, "t");
+    ej_remove_index(other, 1);
+    ej_free(other);
+    CHECK(ej_index_find(index, two, count_node, &count) == 0);
+
+    other = ej_get(doc, "t");
+    ej_append(other, ej_parse("{\"id\":2}"));
+    ej_free(other);
+    CHECK(ej_index_find(index, two, NULL, NULL) == 1);
+    found = ej_index_get(index, two);
+    id = ej_get(found, "id");
+    CHECK(ej_get_number(id, 0) == 2);
+    ej_free(id);
+    ej_free(found);
+
+    /* 建索引用的包装释放后索引仍然有效 */
+    ej_free(table);
+    CHECK(ej_index_find(index, two, NULL, NULL) == 1);
+
+    ej_remove(doc, "t");
+    CHECK(ej_index_find(index, two, NULL, NULL) == -1);
+
+    ej_index_free(index);
+    ej_free(two);
+    ej_free(doc);
+}
+
+/* 补丁删除了被索引的数组，之后释放其他文档不会访问已释放的数组 */
+static void test_index_patch_remove(void) {
+    EasyJSON *doc = ej_parse("{\"t\":[{\"id\":1},{\"id\":2}]}");
+    EasyJSON *other = ej_parse("{\"u\":[1,2,3]}");
+    EasyJSON *patch = ej_parse("[{\"op\":\"remove\",\"path\":\"/t\"}]");
+    EasyJSON *one = ej_create_number(1);
+    EasyJSON *table = ej_get(doc, "t");
+    EJIndex *index = ej_index_build(table, "/id");
+
+    ej_free(table);
+    CHECK(ej_index_find(index, one, NULL, NULL) == 1);
+    CHECK(ej_apply_patch(doc, patch) == 0);
+    CHECK(ej_index_find(index, one, NULL, NULL) == -1);
+    ej_free(other);
+    CHECK(ej_index_find(index, one, NULL, NULL) == -1);
+
+    ej_index_free(index);
+    ej_free(one);
+    ej_free(patch);
+    ej_free(doc);
+}
+
+/* 合并补丁替换了被索引的字段，索引过期后按新内容重建 */
+static void test_index_rebuilt_after_change(void) {
+    EasyJSON *doc = ej_parse("{\"t\":[{\"name\":\"a\"},{\"name\":\"b\"}]}");
+    EasyJSON *a = ej_create_string("a");
+    EasyJSON *c = ej_create_string("c");
+    EasyJSON *table = ej_get(doc, "t");
+    EJIndex *index = ej_index_build(table, "/name");
+    cJSON *merge = cJSON_Parse("{\"t\":[{\"name\":\"c\"}]}");
+
+    CHECK(ej_index_find(index, a, NULL, NULL) == 1);
+    cJSON_ReplaceItemInArray(table->node, 0, cJSON_Parse("{\"name\":\"c\"}"));
+    CHECK(ej_index_find(index, a, NULL, NULL) == 0);
+    CHECK(ej_index_find(index, c, NULL, NULL) == 1);
+
+    /* 合并补丁整体替换数组：旧数组被释放，索引失效 */
+    doc->node = cJSONUtils_MergePatchCaseSensitive(doc->node, merge);
+    CHECK(ej_index_find(index, c, NULL, NULL) == -1);
+
+    cJSON_Delete(merge);
+    ej_index_free(index);
+    ej_free(table);
+    ej_free(c);
+    ej_free(a);
+    ej_free(doc);
+}
+
+/* 合并与压缩补丁按大小写敏感的方式比较路径："/a" 与 "/A" 是不同的成员 */
+static void test_patch_compose_case_sensitive(void) {
+    EasyJSON *doc = ej_parse("{\"A\":0}");
+    EasyJSON *expected = ej_parse("{\"A\":0}");
+    EasyJSON *p1 = ej_parse("[{\"op\":\"add\",\"path\":\"/a\",\"value\":1}]");
+    EasyJSON *p2 = ej_parse("[{\"op\":\"remove\",\"path\":\"/A\"}]");
+    EasyJSON *replaces = ej_parse("[{\"op\":\"replace\",\"path\":\"/a\",\"value\":1},"
+                                  "{\"op\":\"replace\",\"path\":\"/A\",\"value\":2}]");
+    EasyJSON *composed = ej_patch_compose(p1, p2);
+    EasyJSON *compacted = ej_patch_compact(replaces);
+
+    CHECK(composed != NULL);
+    CHECK(cJSON_GetArraySize(composed->node) == 2);
+    CHECK(ej_apply_patch_opts(expected, p1, cJSONUtils_PatchCaseSensitive) == 0);
+    CHECK(ej_apply_patch_opts(expected, p2, cJSONUtils_PatchCaseSensitive) == 0);
+    CHECK(ej_apply_patch_opts(doc, composed, cJSONUtils_PatchCaseSensitive) == 0);
+    CHECK(ej_equals(doc, expected));
+
+    CHECK(compacted != NULL);
+    CHECK(cJSON_GetArraySize(compacted->node) == 2);
+
+    ej_free(compacted);
+    ej_free(composed);
+    ej_free(replaces);
+    ej_free(p2);
+    ej_free(p1);
+    ej_free(expected);
+    ej_free(doc);
+}
+
+/* 从克隆中取下的节点在释放克隆后仍然有效 */
+static void test_clone_detach(void) {
+    EasyJSON *doc = ej_parse("{\"user\":{\"name\":\"alice\",\"tags\":[\"a\",\"b\"]},\"n\":1}");
+    EasyJSON *clone = ej_clone(doc);
+    cJSON *user;
+
+    CHECK(clone != NULL);
+    CHECK(ej_equals(doc, clone));
+    user = cJSON_DetachItemFromObjectCaseSensitive(clone->node, "user");
+    ej_free(clone);
+
+    CHECK(user != NULL);
+    CHECK(strcmp(cJSON_GetObjectItemCaseSensitive(user, "name")->valuestring, "alice") == 0);
+    CHECK(cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(user, "tags")) == 2);
+    CHECK(cJSON_Compare(user, cJSON_GetObjectItemCaseSensitive(doc->node, "user"), 1));
+
+    cJSON_Delete(user);
+    ej_free(doc);
+}
+
+/* 各种类型和长度边界的值经 MessagePack 编码再解码后与原文档相等 */
+static void test_msgpack_round_trip(void) {
+    static const unsigned char small[] = { 0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x93, 0xc0, 0xc3, 0xff };
+    EasyJSON *doc = ej_parse("{\"n\":null,\"t\":true,\"f\":false,\"ints\":[0,127,128,255,256,65535,65536,4294967296,-1,-32,-33,-129,-32769],"
+                             "\"reals\":[0.5,-1.25,1e300],\"s\":\"\",\"u\":\"\u4e2d\u6587\",\"o\":{\"x\":{\"y\":[[],{}]}}}");
+    EasyJSON *strings = ej_create_array();
+    EasyJSON *decoded;
+    unsigned char *data;
+    size_t length = 0;
+    char text[70000];
+    int i;
+
+    /* 长度跨过 fixstr、str8、str16 边界的字符串，元素个数超过 fixarray 的数组 */
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    for (i = 0; i < 20; i++) {
+        static const size_t lengths[] = { 31, 32, 255, 256, 65535, 65536 };
+        size_t cut = lengths[i % 6];
+        char saved = text[cut];
+        text[cut] = '\0';
+        ej_append_string(strings, text);
+        text[cut] = saved;
+    }
+    ej_set(doc, "strings", strings);
+
+    data = ej_to_msgpack(doc, &length);
+    CHECK(data != NULL);
+    decoded = ej_from_msgpack(data, length);
+    CHECK(decoded != NULL);
+    CHECK(ej_equals(doc, decoded));
+    /* 截断的数据解码失败 */
+    CHECK(ej_from_msgpack(data, length - 1) == NULL);
+    ej_free(decoded);
+    ej_free_buffer(data);
+
+    decoded = ej_from_msgpack(small, sizeof(small));
+    CHECK(decoded != NULL);
+    data = ej_to_msgpack(decoded, &length);
+    CHECK(length == sizeof(small) && memcmp(data, small, length) == 0);
+    ej_free_buffer(data);
+    ej_free(decoded);
+
+    ej_free(doc);
+}
+
+/* CBOR 编码再解码后与原文档相等；增量解码器逐字节喂入得到同样的结果，并能接着解码下一个数据项 */
+static void test_cbor_round_trip(void) {
+    /* RFC 8949 附录 A：{"a": 1, "b": [2, 3]}，以及字节串 h'01020304' */
+    static const unsigned char rfc[] = { 0xa2, 0x61, 'a', 0x01, 0x61, 'b', 0x82, 0x02, 0x03 };
+    static const unsigned char bytes[] = { 0x44, 0x01, 0x02, 0x03, 0x04 };
+    EasyJSON *doc = ej_parse("{\"n\":null,\"t\":true,\"f\":false,\"ints\":[0,23,24,255,256,65535,65536,4294967296,-1,-24,-25,-257],"
+                             "\"reals\":[0.5,-1.25,1e300],\"s\":\"\",\"u\":\"\u4e2d\u6587\",\"o\":{\"x\":{\"y\":[[],{}]}}}");
+    EasyJSON *decoded;
+    EasyJSON *expected;
+    EJCborDecoder *decoder;
+    unsigned char *data;
+    size_t length = 0;
+    size_t consumed = 0;
+    size_t i;
+    int status = 0;
+
+    data = ej_to_cbor(doc, &length);
+    CHECK(data != NULL);
+    decoded = ej_from_cbor(data, length);
+    CHECK(decoded != NULL);
+    CHECK(ej_equals(doc, decoded));
+    CHECK(ej_from_cbor(data, length - 1) == NULL);
+    ej_free(decoded);
+
+    decoder = ej_cbor_decoder_create();
+    for (i = 0; i < length && status == 0; i++) {
+        status = ej_cbor_decoder_feed(decoder, data + i, 1, &consumed);
+        CHECK(consumed == 1);
+    }
+    CHECK(status == 1 && i == length);
+    decoded = ej_cbor_decoder_take(decoder);
+    CHECK(ej_equals(doc, decoded));
+    ej_free(decoded);
+
+    CHECK(ej_cbor_decoder_feed(decoder, rfc, sizeof(rfc), &consumed) == 1);
+    CHECK(consumed == sizeof(rfc));
+    decoded = ej_cbor_decoder_take(decoder);
+    expected = ej_parse("{\"a\":1,\"b\":[2,3]}");
+    CHECK(ej_equals(decoded, expected));
+    ej_free_buffer(data);
+    data = ej_to_cbor(expected, &length);
+    CHECK(length == sizeof(rfc) && memcmp(data, rfc, length) == 0);
+    ej_free_buffer(data);
+    ej_free(expected);
+    ej_free(decoded);
+    ej_cbor_decoder_free(decoder);
+
+    decoded = ej_from_cbor(bytes, sizeof(bytes));
+    CHECK(decoded != NULL && strcmp(ej_get_string(decoded, ""), "AQIDBA") == 0);
+    ej_free(decoded);
+
+    ej_free(doc);
+}
+
+/* 40000 个对象组成的数组，足够大，会被并行解析；separator 为元素 20000 之后的分隔符，closer 为数组的结尾 */
+static char *make_records(char separator, char closer) {
+    char *json = (char *)malloc(40000 * 40 + 2);
+    size_t length = 0;
+    int i;
+
+    if (!json) return NULL;
+    json[length++] = '[';
+    for (i = 0; i < 40000; i++) {
+        if (i > 0) json[length++] = (i == 20001) ? separator : ',';
+        length += (size_t)sprintf(json + length, "{\"id\":%d,\"name\":\"n%d\"}", i, i);
+    }
+    json[length++] = closer;
+    json[length] = '\0';
+    return json;
+}
+
+/* 并行解析与串行解析结果一致，括号不匹配时同样返回 NULL */
+static void test_parse_parallel_malformed(void) {
+    const char separators[] = { ',', '}', ']' };
+    const char closers[] = { ']', '}' };
+    size_t i, j;
+
+    for (i = 0; i < sizeof(separators); i++) {
+        for (j = 0; j < sizeof(closers); j++) {
+            char *json = make_records(separators[i], closers[j]);
+            EasyJSON *serial = ej_parse(json);
+            EasyJSON *parallel = ej_parse_parallel(json, strlen(json), 4);
+
+            CHECK((serial == NULL) == (parallel == NULL));
+            if (serial && parallel) CHECK(ej_equals(serial, parallel));
+            if (separators[i] == ',' && closers[j] == ']') CHECK(parallel != NULL);
+            /* 提前出现的 ']' 结束数组，之后的内容与 ej_parse 一样被忽略 */
+            if (separators[i] == '}' || (separators[i] == ',' && closers[j] == '}')) CHECK(parallel == NULL);
+            ej_free(parallel);
+            ej_free(serial);
+            free(json);
+        }
+    }
+}
+
+/* 并行序列化的结果与 ej_to_string 逐字节相同：顶层小对象中的大数组和大对象会被拆分，格式化与否都一样 */
+static void test_print_parallel(void) {
+    char *json = make_records(',', ']');
+    EasyJSON *records = ej_parse(json);
+    EasyJSON *doc = ej_create_object();
+    EasyJSON *map = ej_create_object();
+    char key[32];
+    int formatted;
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        sprintf(key, "k%d", i);
+        if (i % 3 == 0) ej_set_string(map, key, "tab\t\"quote\" \xe4\xb8\xad");
+        else if (i % 3 == 1) ej_set_number(map, key, i * 0.25);
+        else ej_set(map, key, ej_parse("[true,null,{\"x\":[]}]"));
+    }
+    ej_set_number(doc, "count", 40000);
+    ej_set(doc, "records", records);
+    ej_set(doc, "map", map);
+    ej_set(doc, "empty", ej_create_array());
+
+    for (formatted = 0; formatted <= 1; formatted++) {
+        char *serial = ej_to_string(doc, formatted);
+        char *parallel = ej_to_string_parallel(doc, formatted, 4);
+
+        CHECK(serial != NULL && parallel != NULL);
+        if (serial && parallel) CHECK(strcmp(serial, parallel) == 0);
+        ej_free_string(parallel);
+        ej_free_string(serial);
+    }
+
+    ej_free(doc);
+    free(json);
+}
+
+/* 按序列比较数组生成的补丁应用到 from 后得到 to；在长数组中间插入一个元素只生成一个 add */
+static void test_patch_array_diff(void) {
+    static const char *const pairs[][2] = {
+        { "[1,2,3,4,5]", "[1,3,4,6,5,2]" },
+        { "[]", "[1,2]" },
+        { "[1,2]", "[]" },
+        { "[1,1,2,1]", "[1,2,1,1]" },
+        { "[{\"a\":1},{\"b\":2},{\"c\":3}]", "[{\"c\":3},{\"a\":1},{\"b\":[2]}]" },
+        { "{\"x\":[[1,2],[3]],\"y\":[\"a\",\"b\",\"c\"]}", "{\"x\":[[3],[1,2,0]],\"y\":[\"c\",\"a\"]}" }
+    };
+    EasyJSON *from;
+    EasyJSON *to;
+    EasyJSON *patch;
+    cJSON *op;
+    size_t i;
+    int flags = cJSONUtils_PatchArrayDiff | cJSONUtils_PatchCaseSensitive;
+
+    for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        from = ej_parse(pairs[i][0]);
+        to = ej_parse(pairs[i][1]);
+        patch = ej_generate_patch_opts(from, to, flags);
+        CHECK(patch != NULL);
+        CHECK(ej_apply_patch_opts(from, patch, cJSONUtils_PatchCaseSensitive) == 0);
+        CHECK(ej_equals(from, to));
+        ej_free(patch);
+        ej_free(to);
+        ej_free(from);
+    }
+
+    from = ej_create_array();
+    to = ej_create_array();
+    for (i = 0; i < 1000; i++) {
+        ej_append_number(from, (double)i);
+        if (i == 500) ej_append_string(to, "new");
+        ej_append_number(to, (double)i);
+    }
+    patch = ej_generate_patch_opts(from, to, flags);
+    CHECK(cJSON_GetArraySize(patch->node) == 1);
+    op = cJSON_GetArrayItem(patch->node, 0);
+    CHECK(strcmp(cJSON_GetObjectItem(op, "op")->valuestring, "add") == 0);
+    CHECK(strcmp(cJSON_GetObjectItem(op, "path")->valuestring, "/500") == 0);
+    ej_free(patch);
+    ej_free(to);
+    ej_free(from);
+}
+
+/* 相等的文档哈希相同（与成员顺序无关）；修改后缓存的哈希失效，与新内容的哈希一致 */
+static void test_hash_after_change(void) {
+    EasyJSON *a = ej_parse("{\"x\":1,\"y\":{\"z\":[1,2,\"s\"]}}");
+    EasyJSON *b = ej_parse("{\"y\":{\"z\":[1,2,\"s\"]},\"x\":1}");
+    EasyJSON *changed = ej_parse("{\"x\":1,\"y\":{\"z\":[1,2,\"t\"]}}");
+    EasyJSON *y;
+    unsigned long long before;
+
+    before = ej_hash(a);
+    CHECK(before == ej_hash(b));
+    CHECK(before != ej_hash(changed));
+    CHECK(ej_equals(a, b));
+
+    /* 通过子节点修改，根节点缓存的哈希也要失效 */
+    y = ej_get(a, "y");
+    cJSON_ReplaceItemInArray(cJSON_GetObjectItem(y->node, "z"), 2, cJSON_CreateString("t"));
+    ej_free(y);
+    CHECK(ej_hash(a) == ej_hash(changed));
+    CHECK(!ej_equals(a, b));
+    CHECK(ej_equals(a, changed));
+
+    ej_set_number(a, "x", 2);
+    CHECK(ej_hash(a) != ej_hash(changed));
+
+    ej_free(changed);
+    ej_free(b);
+    ej_free(a);
+}
+
+/* cJSONUtils_PatchPreserveInput 不修改输入：成员顺序和缓存的哈希都保持原样，生成的补丁仍然正确 */
+static void test_patch_preserve_input(void) {
+    const char *from_text = "{\"b\":1,\"a\":{\"d\":[1,2],\"c\":\"x\"},\"e\":null}";
+    const char *to_text = "{\"e\":null,\"a\":{\"c\":\"y\",\"d\":[2]},\"f\":true}";
+    EasyJSON *from = ej_parse(from_text);
+    EasyJSON *to = ej_parse(to_text);
+    EasyJSON *target = ej_parse(from_text);
+    EasyJSON *patch;
+    EasyJSON *merge;
+    char *printed;
+    int flags = cJSONUtils_PatchPreserveInput | cJSONUtils_PatchCaseSensitive;
+
+    patch = ej_generate_patch_opts(from, to, flags);
+    merge = ej_generate_merge_patch(from, to, flags);
+    CHECK(patch != NULL && merge != NULL);
+
+    printed = ej_to_string(from, 0);
+    CHECK(strcmp(printed, from_text) == 0);
+    ej_free_string(printed);
+    printed = ej_to_string(to, 0);
+    CHECK(strcmp(printed, to_text) == 0);
+    ej_free_string(printed);
+    CHECK(from->node->hash == 0 && to->node->hash == 0);
+
+    CHECK(ej_apply_patch_opts(target, patch, cJSONUtils_PatchCaseSensitive) == 0);
+    CHECK(ej_equals(target, to));
+    target->node = cJSONUtils_MergePatchCaseSensitive(target->node, merge->node);
+    CHECK(ej_equals(target, to));
+    CHECK(cJSONUtils_MergePatchCaseSensitive(from->node, merge->node) == from->node);
+    CHECK(ej_equals(from, to));
+
+    ej_free(merge);
+    ej_free(patch);
+    ej_free(target);
+    ej_free(to);
+    ej_free(from);
+}
+
+/* 一次应用整个补丁（路径经容器缓存解析）与逐个操作分别应用的结果相同，包括替换、移动、删除缓存中容器的操作 */
+static void test_patch_path_cache(void) {
+    EasyJSON *batch = ej_parse("{\"a\":{\"b\":{\"c\":[1,2,3]}},\"d\":{\"e\":1}}");
+    EasyJSON *single = ej_clone(batch);
+    EasyJSON *patch = ej_parse("["
+        "{\"op\":\"add\",\"path\":\"/a/b/c/1\",\"value\":9},"
+        "{\"op\":\"replace\",\"path\":\"/a/b/c/0\",\"value\":8},"
+        "{\"op\":\"replace\",\"path\":\"/a/b\",\"value\":{\"c\":[]}},"
+        "{\"op\":\"add\",\"path\":\"/a/b/c/-\",\"value\":7},"
+        "{\"op\":\"move\",\"from\":\"/d\",\"path\":\"/a/b/d\"},"
+        "{\"op\":\"add\",\"path\":\"/a/b/d/f\",\"value\":2},"
+        "{\"op\":\"copy\",\"from\":\"/a/b\",\"path\":\"/g\"},"
+        "{\"op\":\"remove\",\"path\":\"/a\"},"
+        "{\"op\":\"add\",\"path\":\"/a\",\"value\":{\"b\":{}}},"
+        "{\"op\":\"add\",\"path\":\"/a/b/c\",\"value\":[0]},"
+        "{\"op\":\"test\",\"path\":\"/g/d/f\",\"value\":2},"
+        "{\"op\":\"remove\",\"path\":\"/g/c/0\"}"
+        "]");
+    EasyJSON *expected = ej_parse("{\"a\":{\"b\":{\"c\":[0]}},\"g\":{\"c\":[],\"d\":{\"e\":1,\"f\":2}}}");
+    cJSON *op;
+
+    CHECK(ej_apply_patch_opts(batch, patch, cJSONUtils_PatchCaseSensitive) == 0);
+    cJSON_ArrayForEach(op, patch->node) {
+        cJSON *one = cJSON_CreateArray();
+        cJSON_AddItemToArray(one, cJSON_Duplicate(op, 1));
+        CHECK(cJSONUtils_ApplyPatchesCaseSensitive(single->node, one) == 0);
+        cJSON_Delete(one);
+    }
+    CHECK(ej_equals(batch, single));
+    CHECK(ej_equals(batch, expected));
+
+    ej_free(expected);
+    ej_free(patch);
+    ej_free(single);
+    ej_free(batch);
+}
+
+/* cJSONUtils_PatchAtomic：最后一个操作失败时，之前的各种操作都被撤销，文档按原样输出；不加该标志时保留已应用的操作 */
+static void test_patch_atomic_rollback(void) {
+    const char *text = "{\"b\":[1,2,3],\"a\":{\"x\":\"s\",\"y\":null},\"c\":true}";
+    EasyJSON *doc = ej_parse(text);
+    EasyJSON *patch = ej_parse("["
+        "{\"op\":\"add\",\"path\":\"/b/1\",\"value\":9},"
+        "{\"op\":\"remove\",\"path\":\"/b/0\"},"
+        "{\"op\":\"replace\",\"path\":\"/a/x\",\"value\":{\"deep\":[1]}},"
+        "{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/a/c\"},"
+        "{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/d\"},"
+        "{\"op\":\"remove\",\"path\":\"/a/y\"},"
+        "{\"op\":\"replace\",\"path\":\"\",\"value\":{\"root\":[]}},"
+        "{\"op\":\"add\",\"path\":\"/root/0\",\"value\":1},"
+        "{\"op\":\"test\",\"path\":\"/root/0\",\"value\":2}"
+        "]");
+    char *printed;
+
+    CHECK(ej_apply_patch_opts(doc, patch, cJSONUtils_PatchAtomic | cJSONUtils_PatchCaseSensitive) != 0);
+    printed = ej_to_string(doc, 0);
+    CHECK(strcmp(printed, text) == 0);
+    ej_free_string(printed);
+
+    CHECK(ej_apply_patch_opts(doc, patch, cJSONUtils_PatchCaseSensitive) != 0);
+    printed = ej_to_string(doc, 0);
+    CHECK(strcmp(printed, "{\"root\":[1]}") == 0);
+    ej_free_string(printed);
+
+    ej_free(patch);
+    ej_free(doc);
+}
+
+/* 合并后的补丁与依次应用两个补丁的结果相同，被覆盖的操作被去掉 */
+static void test_patch_compose(void) {
+    const char *text = "{\"a\":1,\"list\":[1,2,3],\"o\":{\"k\":\"v\"}}";
+    EasyJSON *p1 = ej_parse("["
+        "{\"op\":\"replace\",\"path\":\"/a\",\"value\":2},"
+        "{\"op\":\"add\",\"path\":\"/new\",\"value\":{}},"
+        "{\"op\":\"add\",\"path\":\"/list/1\",\"value\":7},"
+        "{\"op\":\"replace\",\"path\":\"/o/k\",\"value\":\"w\"}"
+        "]");
+    EasyJSON *p2 = ej_parse("["
+        "{\"op\":\"replace\",\"path\":\"/a\",\"value\":3},"
+        "{\"op\":\"remove\",\"path\":\"/new\"},"
+        "{\"op\":\"remove\",\"path\":\"/list/0\"},"
+        "{\"op\":\"replace\",\"path\":\"/o\",\"value\":[]}"
+        "]");
+    EasyJSON *repeated = ej_parse("["
+        "{\"op\":\"add\",\"path\":\"/b\",\"value\":1},"
+        "{\"op\":\"replace\",\"path\":\"/b\",\"value\":2},"
+        "{\"op\":\"replace\",\"path\":\"/b\",\"value\":3}"
+        "]");
+    EasyJSON *sequential = ej_parse(text);
+    EasyJSON *doc = ej_parse(text);
+    EasyJSON *composed = ej_patch_compose(p1, p2);
+    EasyJSON *compacted = ej_patch_compact(repeated);
+    int flags = cJSONUtils_PatchCaseSensitive;
+
+    CHECK(composed != NULL);
+    CHECK(cJSON_GetArraySize(composed->node) < cJSON_GetArraySize(p1->node) + cJSON_GetArraySize(p2->node));
+    CHECK(ej_apply_patch_opts(sequential, p1, flags) == 0);
+    CHECK(ej_apply_patch_opts(sequential, p2, flags) == 0);
+    CHECK(ej_apply_patch_opts(doc, composed, flags) == 0);
+    CHECK(ej_equals(doc, sequential));
+
+    /* 先 add 后 replace 折叠为一个 add */
+    CHECK(compacted != NULL && cJSON_GetArraySize(compacted->node) == 1);
+    CHECK(ej_apply_patch_opts(doc, compacted, flags) == 0);
+    CHECK(ej_apply_patch_opts(sequential, repeated, flags) == 0);
+    CHECK(ej_equals(doc, sequential));
+
+    ej_free(compacted);
+    ej_free(composed);
+    ej_free(doc);
+    ej_free(sequential);
+    ej_free(repeated);
+    ej_free(p2);
+    ej_free(p1);
+}
+
+/* RFC 8785 第 3.2.2、3.2.3 节的示例和附录 B 的数字，以及规范化文本的 SHA-256 */
+static void test_canonical_rfc8785(void) {
+    static const struct { unsigned long long bits; const char *text; } numbers[] = {
+        { 0x0000000000000000ULL, "0" },
+        { 0x8000000000000000ULL, "0" },
+        { 0x0000000000000001ULL, "5e-324" },
+        { 0x8000000000000001ULL, "-5e-324" },
+        { 0x7fefffffffffffffULL, "1.7976931348623157e+308" },
+        { 0x4340000000000000ULL, "9007199254740992" },
+        { 0xc340000000000000ULL, "-9007199254740992" },
+        { 0x4430000000000000ULL, "295147905179352830000" },
+        { 0x44b52d02c7e14af5ULL, "9.999999999999997e+22" },
+        { 0x44b52d02c7e14af6ULL, "1e+23" },
+        { 0x44b52d02c7e14af7ULL, "1.0000000000000001e+23" },
+        { 0x444b1ae4d6e2ef4eULL, "999999999999999700000" },
+        { 0x444b1ae4d6e2ef4fULL, "999999999999999900000" },
+        { 0x444b1ae4d6e2ef50ULL, "1e+21" },
+        { 0x3eb0c6f7a0b5ed8cULL, "9.999999999999997e-7" },
+        { 0x3eb0c6f7a0b5ed8dULL, "0.000001" },
+        { 0x41b3de4355555553ULL, "333333333.3333332" },
+        { 0x41b3de4355555554ULL, "333333333.33333325" },
+        { 0x41b3de4355555555ULL, "333333333.3333333" },
+        { 0x41b3de4355555556ULL, "333333333.3333334" },
+        { 0x41b3de4355555557ULL, "333333333.33333343" },
+        { 0xbecbf647612f3696ULL, "-0.0000033333333333333333" },
+        { 0x43143ff3c1cb0959ULL, "1424953923781206.2" }
+    };
+    static const unsigned char digest_expected[32] = {
+        0x2d, 0x5e, 0x01, 0xa3, 0x18, 0xd0, 0xf0, 0x87, 0x9a, 0xb5, 0x68, 0xc4, 0xbe, 0x28, 0x9c, 0x8b,
+        0x1f, 0x64, 0xef, 0x89, 0x21, 0xa5, 0x3c, 0x62, 0x77, 0xd5, 0xe0, 0x69, 0x97, 0x8b, 0xaa, 0xcb
+    };
+    EasyJSON *doc = ej_parse("{\"numbers\":[333333333.33333329,1E30,4.50,2e-3,0.000000000000000000000000001],"
+                             "\"string\":\"\\u20ac$\\u000F\\u000aA'\\u0042\\u0022\\u005c\\\\\\\"\\/\","
+                             "\"literals\":[null,true,false]}");
+    EasyJSON *keys = ej_parse("{\"\\u20ac\":\"Euro Sign\",\"\\r\":\"Carriage Return\",\"\\ufb33\":\"Hebrew Letter Dalet With Dagesh\","
+                              "\"1\":\"One\",\"\\ud83d\\ude00\":\"Emoji: Grinning Face\",\"\\u0080\":\"Control\","
+                              "\"\\u00f6\":\"Latin Small Letter O With Diaeresis\"}");
+    EasyJSON *number;
+    unsigned char digest[32];
+    char *canonical;
+    size_t i;
+
+    canonical = ej_to_canonical(doc);
+    CHECK(canonical != NULL && strcmp(canonical, "{\"literals\":[null,true,false],"
+        "\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27],"
+        "\"string\":\"\xe2\x82\xac$\\u000f\\nA'B\\\"\\\\\\\\\\\"/\"}") == 0);
+    ej_free_string(canonical);
+    CHECK(ej_canonical_digest(doc, digest) == 1);
+    CHECK(memcmp(digest, digest_expected, sizeof(digest)) == 0);
+
+    /* 键按 UTF-16 码元排序：U+1F600 的代理对排在 U+FB33 之前 */
+    canonical = ej_to_canonical(keys);
+    CHECK(canonical != NULL && strcmp(canonical, "{\"\\r\":\"Carriage Return\",\"1\":\"One\",\"\xc2\x80\":\"Control\","
+        "\"\xc3\xb6\":\"Latin Small Letter O With Diaeresis\",\"\xe2\x82\xac\":\"Euro Sign\","
+        "\"\xf0\x9f\x98\x80\":\"Emoji: Grinning Face\",\"\xef\xac\xb3\":\"Hebrew Letter Dalet With Dagesh\"}") == 0);
+    ej_free_string(canonical);
+
+    for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        double value;
+        memcpy(&value, &numbers[i].bits, sizeof(value));
+        number = ej_create_number(value);
+        canonical = ej_to_canonical(number);
+        CHECK(canonical != NULL && strcmp(canonical, numbers[i].text) == 0);
+        ej_free_string(canonical);
+        ej_free(number);
+    }
+
+    ej_free(keys);
+    ej_free(doc);
+}
+
+int main(void) {
+    test_index_other_wrapper();
+    test_index_patch_remove();
+    test_index_rebuilt_after_change();
+    test_parse_parallel_malformed();
+    test_patch_compose_case_sensitive();
+    test_clone_detach();
+    test_msgpack_round_trip();
+    test_cbor_round_trip();
+    test_print_parallel();
+    test_patch_array_diff();
+    test_hash_after_change();
+    test_patch_preserve_input();
+    test_patch_path_cache();
+    test_patch_atomic_rollback();
+    test_patch_compose();
+    test_canonical_rfc8785();
+    if (failures) {
+        printf("%d 项检查失败\n", failures);
+        return 1;
+    }
+    printf("全部通过\n");
+    return 0;
+}